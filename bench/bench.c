@@ -0,0 +1,25 @@
+#include "bench.h"
+
+/* monotonic wall clock time, in seconds */
+double bench_now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* create an interpreter with nocsim loaded into it, and return it's state */
+nocsim_state* bench_create(Tcl_Interp** interp) {
+	Tcl_Namespace* ns;
+
+	*interp = Tcl_CreateInterp();
+	if (Nocsim_Init(*interp) != TCL_OK) {
+		errx(1, "failed to initialize nocsim: %s", Tcl_GetStringResult(*interp));
+	}
+
+	ns = Tcl_FindNamespace(*interp, "nocsim", NULL, TCL_GLOBAL_ONLY);
+	return (nocsim_state*) ns->clientData;
+}
+
+void bench_destroy(Tcl_Interp* interp) {
+	Tcl_DeleteInterp(interp);
+}
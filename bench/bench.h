@@ -0,0 +1,16 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+/* utilities shared between benchmark drivers */
+
+#include "nocsim.h"
+
+#include <tcl.h>
+
+int Nocsim_Init(Tcl_Interp* interp);
+
+double bench_now(void);
+nocsim_state* bench_create(Tcl_Interp** interp);
+void bench_destroy(Tcl_Interp* interp);
+
+#endif
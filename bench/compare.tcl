@@ -0,0 +1,87 @@
+# Compare two sets of results produced by bench/throughput, and report any
+# metric which has regressed by more than the threshold.
+#
+# usage: tclsh compare.tcl ?-threshold PERCENT? BASELINE.json RESULTS.json
+#
+# Exits with status 1 if any regression was found, and 0 otherwise. Only the
+# output format of bench/throughput is understood, in which each result is
+# on it's own line.
+
+# metrics, and whether larger values are better
+set metrics {
+	ticks_per_sec 1
+	flits_per_sec 1
+	ns_per_op 0
+}
+
+proc usage {} {
+	puts stderr "usage: tclsh compare.tcl ?-threshold PERCENT? BASELINE.json RESULTS.json"
+	exit 2
+}
+
+# return a dict mapping result name -> metric -> value
+proc load_results {path} {
+	set results {}
+	set f [open $path r]
+	foreach line [split [read $f] "\n"] {
+		if {![regexp {"name": "([^"]+)"} $line -> name]} { continue }
+		foreach {metric better} $::metrics {
+			if {[regexp "\"$metric\": (\[-+0-9.eE\]+)" $line -> value]} {
+				dict set results $name $metric $value
+			}
+		}
+	}
+	close $f
+	return $results
+}
+
+set threshold 5.0
+if {[lindex $argv 0] eq "-threshold"} {
+	if {[llength $argv] < 2} { usage }
+	set threshold [lindex $argv 1]
+	set argv [lrange $argv 2 end]
+}
+if {[llength $argv] != 2} { usage }
+
+set baseline [load_results [lindex $argv 0]]
+set current [load_results [lindex $argv 1]]
+set regressions 0
+
+puts [format "%-40s %-14s %14s %14s %9s" result metric baseline current change]
+
+dict for {name values} $baseline {
+	if {![dict exists $current $name]} {
+		puts [format "%-40s missing from [lindex $argv 1]" $name]
+		continue
+	}
+
+	dict for {metric old} $values {
+		if {![dict exists $current $name $metric]} { continue }
+		set new [dict get $current $name $metric]
+		set better [dict get $metrics $metric]
+
+		if {$old == 0} { continue }
+		set change [expr {100.0 * ($new - $old) / $old}]
+
+		# a positive change is an improvement for rates, and a
+		# regression for times
+		set worse [expr {$better ? -$change : $change}]
+
+		set flag ""
+		if {$worse > $threshold} {
+			set flag "  REGRESSION"
+			incr regressions
+		}
+
+		puts [format "%-40s %-14s %14.3f %14.3f %+8.1f%%%s" \
+			$name $metric $old $new $change $flag]
+	}
+}
+
+if {$regressions > 0} {
+	puts "$regressions metrics regressed by more than $threshold%"
+	exit 1
+}
+
+puts "no metrics regressed by more than $threshold%"
+exit 0
@@ -0,0 +1,217 @@
+/* Benchmark for flip_state(), comparing the pointer-chasing traversal used
+ * before the compacted layout existed against the layout built by
+ * nocsim_layout_build().
+ *
+ * To reproduce what happens when large topologies are built from TCL, links
+ * are created in a random order, with unrelated allocations interleaved
+ * between them, so that they end up scattered across the heap.
+ *
+ * Where perf_event_open(2) is available, hardware cache misses are reported
+ * alongside the wall clock time.
+ *
+ * usage: flip_state [SIZE [ITERATIONS]]
+ */
+
+#include "bench.h"
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+typedef struct bench_link_t {
+	char* from;
+	char* to;
+} bench_link;
+
+/* the traversal flip_state() used to perform, walking from each node to each
+ * of it's incoming links */
+static void legacy_flip_state(nocsim_state* state) {
+	unsigned int i;
+	nocsim_node* cursor;
+
+	vec_foreach(state->nodes, cursor, i) {
+		for (nocsim_direction dir = N ; dir <= P ; dir++) {
+			if (cursor->incoming[dir] != NULL) {
+				if (cursor->incoming[dir]->flit != NULL) {
+					err(1, "invalid state: router %s has unhandled incoming flits after behavior execution",
+						cursor->id);
+				}
+
+				cursor->incoming[dir]->flit = \
+					cursor->incoming[dir]->flit_next;
+				cursor->incoming[dir]->flit_next = NULL;
+			}
+		}
+	}
+
+	vec_foreach(state->nodes, cursor, i) {
+		for (nocsim_direction dir = N ; dir <= P ; dir++) {
+			if (cursor->incoming[dir] != NULL) {
+				nocsim_handle_arrival(state, cursor, dir);
+			}
+		}
+	}
+}
+
+static int cache_miss_counter(void) {
+#ifdef __linux__
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.size = sizeof(attr);
+	attr.config = PERF_COUNT_HW_CACHE_MISSES;
+	attr.disabled = 1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+
+	return (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+	return -1;
+#endif
+}
+
+/* run fn ITERATIONS times, returning seconds elapsed and storing cache misses
+ * into misses (or -1 if they cannot be counted) */
+static double run(nocsim_state* state, void (*fn)(nocsim_state*), int iterations, long long* misses) {
+	int fd;
+	double start;
+	double elapsed;
+
+	*misses = -1;
+	fd = cache_miss_counter();
+
+#ifdef __linux__
+	if (fd >= 0) {
+		ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+		ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+	}
+#endif
+
+	start = bench_now();
+	for (int i = 0 ; i < iterations ; i++) {
+		fn(state);
+	}
+	elapsed = bench_now() - start;
+
+#ifdef __linux__
+	if (fd >= 0) {
+		ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+		if (read(fd, misses, sizeof(*misses)) != sizeof(*misses)) {
+			*misses = -1;
+		}
+		close(fd);
+	}
+#endif
+
+	return elapsed;
+}
+
+static void build_scattered_mesh(nocsim_state* state, unsigned int size) {
+	bench_link* pending;
+	bench_link tmp;
+	unsigned int npending = 0;
+	unsigned int j;
+	vec_void_t junk;
+	void* p;
+	char* id;
+
+	alloc(sizeof(bench_link) * size * size * 6, pending);
+	vec_init(&junk);
+
+	for (unsigned int row = 0 ; row < size ; row++) {
+		for (unsigned int col = 0 ; col < size ; col++) {
+			id = alloc_printf("R.%u.%u", row, col);
+			nocsim_grid_create_router(state, id, row, col, "nop");
+			id = alloc_printf("PE.%u.%u", row, col);
+			nocsim_grid_create_PE(state, id, row, col, "nop");
+
+			pending[npending].from = alloc_printf("PE.%u.%u", row, col);
+			pending[npending++].to = alloc_printf("R.%u.%u", row, col);
+			pending[npending].from = alloc_printf("R.%u.%u", row, col);
+			pending[npending++].to = alloc_printf("PE.%u.%u", row, col);
+
+			if (row + 1 < size) {
+				pending[npending].from = alloc_printf("R.%u.%u", row, col);
+				pending[npending++].to = alloc_printf("R.%u.%u", row + 1, col);
+				pending[npending].from = alloc_printf("R.%u.%u", row + 1, col);
+				pending[npending++].to = alloc_printf("R.%u.%u", row, col);
+			}
+
+			if (col + 1 < size) {
+				pending[npending].from = alloc_printf("R.%u.%u", row, col);
+				pending[npending++].to = alloc_printf("R.%u.%u", row, col + 1);
+				pending[npending].from = alloc_printf("R.%u.%u", row, col + 1);
+				pending[npending++].to = alloc_printf("R.%u.%u", row, col);
+			}
+		}
+	}
+
+	/* Fisher-Yates shuffle, so that links are not allocated in the order
+	 * they are traversed */
+	for (unsigned int i = npending - 1 ; i > 0 ; i--) {
+		j = (unsigned int) rand() % (i + 1);
+		tmp = pending[i];
+		pending[i] = pending[j];
+		pending[j] = tmp;
+	}
+
+	for (unsigned int i = 0 ; i < npending ; i++) {
+		alloc(32 + (rand() % 512), p);
+		vec_push(&junk, p);
+
+		if (nocsim_grid_create_link(state, pending[i].from, pending[i].to, DIR_UNDEF, DIR_UNDEF) != NOCSIM_RESULT_OK) {
+			errx(1, "%s", state->errstr);
+		}
+		free(pending[i].from);
+		free(pending[i].to);
+	}
+
+	vec_foreach(&junk, p, j) { free(p); }
+	vec_deinit(&junk);
+	free(pending);
+}
+
+int main(int argc, char** argv) {
+	Tcl_Interp* interp;
+	nocsim_state* state;
+	unsigned int size = 64;
+	int iterations = 1000;
+	double legacy_time;
+	double layout_time;
+	long long legacy_misses;
+	long long layout_misses;
+
+	if (argc > 1) { size = (unsigned int) atoi(argv[1]); }
+	if (argc > 2) { iterations = atoi(argv[2]); }
+
+	srand(1);
+
+	state = bench_create(&interp);
+
+	build_scattered_mesh(state, size);
+
+	/* warm up, then measure the scattered links */
+	run(state, legacy_flip_state, iterations / 10 + 1, &legacy_misses);
+	legacy_time = run(state, legacy_flip_state, iterations, &legacy_misses);
+
+	nocsim_layout_build(state);
+
+	run(state, flip_state, iterations / 10 + 1, &layout_misses);
+	layout_time = run(state, flip_state, iterations, &layout_misses);
+
+	printf("mesh %ux%u, %u nodes, %u links, %d iterations\n",
+		size, size, state->nodes->length, state->links->length, iterations);
+	printf("%-10s %14s %14s %16s\n", "traversal", "total (s)", "ns/link", "cache misses");
+	printf("%-10s %14.6f %14.3f %16lld\n", "pointer", legacy_time,
+		1e9 * legacy_time / ((double) iterations * state->links->length), legacy_misses);
+	printf("%-10s %14.6f %14.3f %16lld\n", "layout", layout_time,
+		1e9 * layout_time / ((double) iterations * state->links->length), layout_misses);
+	printf("speedup: %.2fx\n", legacy_time / layout_time);
+
+	bench_destroy(interp);
+
+	return 0;
+}
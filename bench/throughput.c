@@ -0,0 +1,270 @@
+/* Throughput and microbenchmark suite for nocsim.
+ *
+ * Measures ticks per second and flits (arrived) per second for meshes of
+ * several sizes, routed either by a TCL implementation of DOR or by
+ * native:DOR, native:BLESS, or native:CHIPPER, at injection rates from 0.01
+ * up to saturation. PEs use
+ * native:uniform, so that the cost of injection is the same for both.
+ *
+ * Microbenchmarks measure the cost of individual operations: spawning a flit,
+ * routing a flit through a router, a PE dequeueing a flit into it's outgoing
+ * link, and a flit arriving at it's destination.
+ *
+ * Results are written to standard output as JSON, one result per line, which
+ * bench/compare.tcl can use to detect regressions between two runs. Progress
+ * is written to standard error.
+ *
+ * usage: throughput [-q] [-t SECONDS]
+ *
+ *	-q		quick mode, skip 64x64 meshes and use fewer loads
+ *	-t SECONDS	minimum time to measure each configuration for
+ */
+
+#include "bench.h"
+
+/* a TCL implementation of DOR deflection routing, equivalent to
+ * examples/mesh_DOR.tcl */
+static const char* bench_tcl_DOR =
+	"proc bench_DOR {} {\n"
+	"	set row [nocsim::nodeinfo [nocsim::current] row]\n"
+	"	set col [nocsim::nodeinfo [nocsim::current] col]\n"
+	"	foreach dir {0 1 2 3 4} {\n"
+	"		if {[nocsim::incoming $dir] != 1} { continue }\n"
+	"		set to_row [nocsim::peek $dir to_row]\n"
+	"		set to_col [nocsim::peek $dir to_col]\n"
+	"		if {$to_row > $row} {\n"
+	"			set pri {1 0 2 3 4}\n"
+	"		} elseif {$to_row < $row} {\n"
+	"			set pri {0 1 2 3 4}\n"
+	"		} elseif {$to_col > $col} {\n"
+	"			set pri {2 3 1 0 4}\n"
+	"		} elseif {$to_col < $col} {\n"
+	"			set pri {3 2 1 0 4}\n"
+	"		} else {\n"
+	"			set pri {4 3 0 1 2}\n"
+	"		}\n"
+	"		foreach out $pri {\n"
+	"			if {[nocsim::avail $out] == 0} {\n"
+	"				nocsim::route $dir $out\n"
+	"				break\n"
+	"			}\n"
+	"		}\n"
+	"	}\n"
+	"}\n";
+
+static const unsigned int bench_sizes[] = {8, 32, 64};
+static const double bench_loads[] = {0.01, 0.02, 0.05, 0.1, 0.2, 0.5, 1.0};
+static const double bench_quick_loads[] = {0.01, 0.1, 1.0};
+
+/* minimum number of ticks and operations measured, regardless of time */
+#define BENCH_MIN_TICKS 5
+#define BENCH_MICRO_BATCH 4096
+
+static double bench_min_time = 0.5;
+static int bench_first_result = 1;
+
+static void bench_result_begin(const char* name) {
+	printf("%s\t{\"name\": \"%s\"", bench_first_result ? "" : ",\n", name);
+	bench_first_result = 0;
+}
+
+static void bench_result_end(void) {
+	printf("}");
+	fflush(stdout);
+}
+
+static void bench_mesh_run(unsigned int size, const char* router, double load) {
+	Tcl_Interp* interp;
+	nocsim_state* state;
+	char* name;
+	unsigned long ticks = 0;
+	long arrived;
+	long routed;
+	double start;
+	double elapsed;
+
+	state = bench_create(&interp);
+
+	if (Tcl_Eval(interp, bench_tcl_DOR) != TCL_OK) {
+		errx(1, "failed to define TCL DOR: %s", Tcl_GetStringResult(interp));
+	}
+
+	srand(1);
+	state->default_P_inject = (float) load;
+	if (nocsim_grid_create_mesh(state, size, size, "native:uniform",
+			strcmp(router, "tcl:DOR") ? (char*) router : "bench_DOR") != NOCSIM_RESULT_OK ||
+		nocsim_finalize(state) != NOCSIM_RESULT_OK) {
+		errx(1, "%s", state->errstr);
+	}
+
+	/* let the network reach a steady state before measuring */
+	for (unsigned int i = 0 ; i < 2 * size ; i++) {
+		nocsim_step(state, interp);
+	}
+
+	arrived = state->arrived;
+	routed = state->routed;
+	start = bench_now();
+	do {
+		nocsim_step(state, interp);
+		ticks++;
+		elapsed = bench_now() - start;
+	} while (ticks < BENCH_MIN_TICKS || elapsed < bench_min_time);
+
+	name = alloc_printf("mesh/%ux%u/%s/load=%.2f", size, size, router, load);
+	fprintf(stderr, "%-40s %12.1f ticks/s %14.1f flits/s\n", name,
+		ticks / elapsed, (state->arrived - arrived) / elapsed);
+
+	bench_result_begin(name);
+	printf(", \"ticks_per_sec\": %.3f", ticks / elapsed);
+	printf(", \"flits_per_sec\": %.3f", (state->arrived - arrived) / elapsed);
+	printf(", \"hops_per_sec\": %.3f", (state->routed - routed) / elapsed);
+	printf(", \"accepted\": %.5f", (state->arrived - arrived) / ((double) ticks * state->num_PE));
+	bench_result_end();
+
+	free(name);
+	bench_destroy(interp);
+}
+
+/* a router R with a PE on either side, A -> R -> B, all using native
+ * behaviors that do nothing unless flits are present */
+static nocsim_state* bench_micro_create(Tcl_Interp** interp, nocsim_node** A, nocsim_node** R, nocsim_node** B) {
+	nocsim_state* state = bench_create(interp);
+
+	if (nocsim_grid_create_router(state, "R", 0, 1, "native:DOR") != NOCSIM_RESULT_OK ||
+		nocsim_grid_create_PE(state, "A", 0, 0, "native:uniform") != NOCSIM_RESULT_OK ||
+		nocsim_grid_create_PE(state, "B", 0, 2, "native:uniform") != NOCSIM_RESULT_OK ||
+		nocsim_grid_create_link(state, "A", "R", P, P) != NOCSIM_RESULT_OK ||
+		nocsim_grid_create_link(state, "R", "A", W, P) != NOCSIM_RESULT_OK ||
+		nocsim_grid_create_link(state, "R", "B", E, P) != NOCSIM_RESULT_OK ||
+		nocsim_grid_create_link(state, "B", "R", P, E) != NOCSIM_RESULT_OK ||
+		nocsim_finalize(state) != NOCSIM_RESULT_OK) {
+		errx(1, "%s", state->errstr);
+	}
+
+	*A = nocsim_node_by_id(state, "A");
+	*R = nocsim_node_by_id(state, "R");
+	*B = nocsim_node_by_id(state, "B");
+
+	return state;
+}
+
+static void bench_micro_report(const char* name, unsigned long ops, double elapsed) {
+	fprintf(stderr, "%-40s %12.3f ns/op\n", name, 1e9 * elapsed / ops);
+	bench_result_begin(name);
+	printf(", \"ns_per_op\": %.3f", 1e9 * elapsed / ops);
+	bench_result_end();
+}
+
+/* run body in batches of BENCH_MICRO_BATCH until the minimum time has
+ * elapsed, only timing the body itself -- setup is run before each batch */
+#define bench_micro(name, setup, body) do { \
+		unsigned long __ops = 0; \
+		double __elapsed = 0; \
+		double __start; \
+		while (__elapsed < bench_min_time) { \
+			setup; \
+			__start = bench_now(); \
+			for (int __i = 0 ; __i < BENCH_MICRO_BATCH ; __i++) { body; } \
+			__elapsed += bench_now() - __start; \
+			__ops += BENCH_MICRO_BATCH; \
+		} \
+		bench_micro_report(name, __ops, __elapsed); \
+	} while (0)
+
+static void bench_micro_all(void) {
+	Tcl_Interp* interp;
+	nocsim_state* state;
+	nocsim_node* A;
+	nocsim_node* R;
+	nocsim_node* B;
+	nocsim_flit* flit;
+	nocsim_flit* batch[BENCH_MICRO_BATCH];
+	unsigned int i;
+
+	state = bench_micro_create(&interp, &A, &R, &B);
+
+	/* spawn, including the allocation of the flit */
+	bench_micro("micro/spawn",
+		vec_foreach(A->pending, flit, i) { free(flit); } vec_clear(A->pending),
+		nocsim_spawn(state, A, B));
+	vec_foreach(A->pending, flit, i) { free(flit); }
+	vec_clear(A->pending);
+
+	/* route from the PE link to the east link */
+	nocsim_spawn(state, A, B);
+	flit = vec_dequeue(A->pending);
+	bench_micro("micro/route",
+		(void) 0,
+		R->incoming[P]->flit = flit;
+		nocsim_route(state, R, P, E);
+		R->outgoing[E]->flit_next = NULL);
+	free(flit);
+
+	/* a PE moving a flit from it's FIFO into it's outgoing link, as done
+	 * by next_state() */
+	nocsim_spawn(state, A, B);
+	flit = vec_dequeue(A->pending);
+	bench_micro("micro/dequeue",
+		(void) 0,
+		vec_push(A->pending, flit);
+		next_state(state, interp);
+		A->outgoing[P]->flit_next = NULL);
+	free(flit);
+
+	/* a flit arriving at it's destination, including freeing it */
+	bench_micro("micro/arrival",
+		for (int j = 0 ; j < BENCH_MICRO_BATCH ; j++) {
+			nocsim_spawn(state, A, B);
+			batch[j] = vec_dequeue(A->pending);
+		},
+		B->incoming[P]->flit = batch[__i];
+		nocsim_handle_arrival(state, B, P));
+
+	bench_destroy(interp);
+}
+
+int main(int argc, char** argv) {
+	int quick = 0;
+	int opt;
+	const double* loads = bench_loads;
+	size_t num_loads = sizeof(bench_loads) / sizeof(bench_loads[0]);
+	const char* routers[] = {"tcl:DOR", "native:DOR", "native:BLESS", "native:CHIPPER"};
+
+	while ((opt = getopt(argc, argv, "qt:")) != -1) {
+		switch (opt) {
+			case 'q':
+				quick = 1;
+				break;
+			case 't':
+				bench_min_time = atof(optarg);
+				break;
+			default:
+				fprintf(stderr, "usage: %s [-q] [-t SECONDS]\n", argv[0]);
+				return 1;
+		}
+	}
+
+	if (quick) {
+		loads = bench_quick_loads;
+		num_loads = sizeof(bench_quick_loads) / sizeof(bench_quick_loads[0]);
+	}
+
+	printf("{\n\"version\": \"%s\",\n\"min_time\": %.3f,\n\"results\": [\n",
+		NOC_TOOLS_VERSION, bench_min_time);
+
+	bench_micro_all();
+
+	for (size_t s = 0 ; s < sizeof(bench_sizes) / sizeof(bench_sizes[0]) ; s++) {
+		if (quick && bench_sizes[s] > 32) { continue; }
+		for (size_t r = 0 ; r < sizeof(routers) / sizeof(routers[0]) ; r++) {
+			for (size_t l = 0 ; l < num_loads ; l++) {
+				bench_mesh_run(bench_sizes[s], routers[r], loads[l]);
+			}
+		}
+	}
+
+	printf("\n]\n}\n");
+
+	return 0;
+}
@@ -58,18 +58,16 @@ proc simpleinject {} {
 	if {[with_P 0.2]} { inject [randnode [current]] }
 }
 
-proc on_arrive {origin dest flitno hops spawned_at injected_at} {
+proc on_arrive {origin dest flitno hops spawned_at injected_at deflections backlog distance} {
 	lappend age_on_arrive [expr $::nocsim::nocsim_tick - $spawned_at]
 }
 
 proc on_route {origin dest flitno spawnedat injectedat hops fromnode tonode} {
-	if {$flitno == 37} {
-		conswrite "(tick=$::nocsim::nocsim_tick) flitno $flitno routed from $fromnode to $tonode"
-	}
+	conswrite "(tick=$::nocsim::nocsim_tick) flitno $flitno routed from $fromnode to $tonode"
 }
 
 registerinstrument arrive on_arrive
-#registerinstrument route on_route
+#registerinstrument route on_route -flits 37
 
 create_mesh 10 10 simpleinject simpleDOR
 
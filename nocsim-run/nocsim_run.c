@@ -0,0 +1,75 @@
+/* nocsim-run runs a scenario file without a TCL interpreter, see
+ * doc/nocsim-run.md and nocsim/scenario.c.
+ *
+ * usage: nocsim-run [-o OUTPUT] [-s SEED] SCENARIO
+ *
+ *	-o OUTPUT	write results to OUTPUT, overriding the scenario
+ *	-s SEED		seed the RNG with SEED, overriding the scenario
+ */
+
+#include "nocsim.h"
+
+static void usage(const char* name) {
+	fprintf(stderr, "usage: %s [-o OUTPUT] [-s SEED] SCENARIO\n", name);
+	exit(1);
+}
+
+int main(int argc, char** argv) {
+	nocsim_state* state;
+	nocsim_scenario* scenario;
+	char* output = NULL;
+	char* end;
+	unsigned long seed = 0;
+	int seeded = 0;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "o:s:")) != -1) {
+		switch (opt) {
+			case 'o':
+				output = optarg;
+				break;
+			case 's':
+				errno = 0;
+				seed = strtoul(optarg, &end, 10);
+				if (errno != 0 || *end != '\0') {
+					errx(1, "invalid seed '%s'", optarg);
+				}
+				seeded = 1;
+				break;
+			default:
+				usage(argv[0]);
+		}
+	}
+
+	if (optind != argc - 1) { usage(argv[0]); }
+
+	alloc(sizeof(nocsim_state), state);
+	nocsim_init_state(state);
+
+	/* unlike the TCL package, runs are repeatable by default */
+	state->RNG_seed = 1;
+	srand(state->RNG_seed);
+
+	if (nocsim_scenario_load(state, argv[optind], &scenario) != NOCSIM_RESULT_OK) {
+		errx(1, "%s", state->errstr);
+	}
+
+	if (seeded) {
+		state->RNG_seed = (unsigned int) seed;
+		srand(state->RNG_seed);
+	}
+
+	if (output != NULL) {
+		free(scenario->output);
+		scenario->output = strcmp(output, "-") ? strdup(output) : NULL;
+	}
+
+	if (nocsim_scenario_run(state, scenario) != NOCSIM_RESULT_OK) {
+		errx(1, "%s", state->errstr);
+	}
+
+	nocsim_scenario_free(scenario);
+	nocsim_free_state(state);
+
+	return 0;
+}
@@ -0,0 +1,141 @@
+#include "nocsim.h"
+
+/* This file contains methods relating to arbitration, which decides the
+ * order in which a router considers it's incoming flits. Since each outgoing
+ * link can carry only one flit per tick, flits considered earlier get the
+ * first choice of outgoing links, and later ones are more likely to be
+ * deflected or buffered.
+ *
+ * Each tick, before a router's behavior runs, the directions which have an
+ * incoming flit are placed in router->arbitrated in order. Native behaviors
+ * route flits in that order, and allincoming returns it to TCL behaviors.
+ *
+ * The policies are:
+ *
+ *	fixed		always in the order given by state->priority
+ *	oldest		oldest flit (by spawned_at) first
+ *	roundrobin	state->priority, rotated so that the direction after
+ *			the one which went first last time goes first
+ *	random		a random permutation
+ * */
+
+/**
+ * @brief Reset arbitration to the fixed N, S, E, W, PE order.
+ *
+ * @param state
+ */
+void nocsim_arbitration_reset(nocsim_state* state) {
+	state->arbitration = ARBITRATION_FIXED;
+	for (nocsim_direction dir = N ; dir <= P ; dir++) {
+		state->priority[dir] = dir;
+	}
+}
+
+/**
+ * @brief Set the arbitration policy used by every router.
+ *
+ * @param state
+ * @param arbitration
+ * @param priority if not NULL, the order of all NOCSIM_NUM_LINKS directions,
+ * which sets the order used by fixed arbitration, and the ring used by
+ * round-robin arbitration
+ *
+ * @return
+ */
+nocsim_result nocsim_set_arbitration(nocsim_state* state, nocsim_arbitration arbitration, nocsim_direction* priority) {
+	unsigned char seen = 0;
+	nocsim_node* node;
+	unsigned int i;
+
+	if (arbitration >= ENUMSIZE_ARBITRATION) {
+		nocsim_return_error(state, "%s", "arbitration policy should be one of fixed, oldest, roundrobin, or random");
+	}
+
+	if (priority != NULL) {
+		for (i = 0 ; i < NOCSIM_NUM_LINKS ; i++) {
+			if (priority[i] > P || (seen & (1 << priority[i]))) {
+				nocsim_return_error(state, "%s", "priority must list each direction exactly once");
+			}
+			seen |= 1 << priority[i];
+		}
+
+		for (i = 0 ; i < NOCSIM_NUM_LINKS ; i++) {
+			state->priority[i] = priority[i];
+		}
+	}
+
+	state->arbitration = arbitration;
+	vec_foreach(state->nodes, node, i) {
+		node->arbiter = 0;
+	}
+
+	return NOCSIM_RESULT_OK;
+}
+
+/**
+ * @brief Place the directions from which the router has an incoming flit
+ * into router->arbitrated, in the order they should be routed.
+ *
+ * @param state
+ * @param router
+ */
+void nocsim_arbitrate(nocsim_state* state, nocsim_node* router) {
+	nocsim_direction* order = router->arbitrated;
+	nocsim_direction dir;
+	unsigned int start = 0;
+	unsigned int first = 0;
+	unsigned int count = 0;
+	unsigned int i;
+	unsigned int j;
+
+	if (state->arbitration == ARBITRATION_ROUNDROBIN) {
+		start = router->arbiter;
+	}
+
+	for (i = 0 ; i < NOCSIM_NUM_LINKS ; i++) {
+		dir = state->priority[(start + i) % NOCSIM_NUM_LINKS];
+		if (router->incoming[dir] == NULL || router->incoming[dir]->flit == NULL) {
+			continue;
+		}
+
+		if (count == 0) { first = (start + i) % NOCSIM_NUM_LINKS; }
+		order[count++] = dir;
+	}
+
+	router->num_arbitrated = count;
+	router->activity[ENERGY_ARBITRATION] += count;
+	if (count < 2 && state->arbitration != ARBITRATION_ROUNDROBIN) { return; }
+
+	switch (state->arbitration) {
+	case ARBITRATION_OLDEST:
+		/* insertion sort, there are at most NOCSIM_NUM_LINKS flits */
+		for (i = 1 ; i < count ; i++) {
+			dir = order[i];
+			for (j = i ; j > 0 && nocsim_flit_older(
+						router->incoming[dir]->flit,
+						router->incoming[order[j - 1]]->flit) ; j--) {
+				order[j] = order[j - 1];
+			}
+			order[j] = dir;
+		}
+		break;
+
+	case ARBITRATION_ROUNDROBIN:
+		if (count > 0) {
+			router->arbiter = (first + 1) % NOCSIM_NUM_LINKS;
+		}
+		break;
+
+	case ARBITRATION_RANDOM:
+		for (i = count - 1 ; i > 0 ; i--) {
+			j = randrange(0, i + 1) % (i + 1);
+			dir = order[i];
+			order[i] = order[j];
+			order[j] = dir;
+		}
+		break;
+
+	default:
+		break;
+	}
+}
@@ -0,0 +1,212 @@
+#include "nocsim.h"
+
+/* This file contains methods relating to the energy model, which estimates
+ * the energy consumed by the network from counts of the activity which
+ * consumes it, in the manner of DSENT or ORION.
+ *
+ * Activity is counted natively while simulating, in the same places as the
+ * performance counters, and is only multiplied by the model when energy is
+ * reported, so the model may be changed at any time. The events are:
+ *
+ *	buffer_read	a flit leaves a router backlog
+ *	buffer_write	a flit enters a router backlog
+ *	crossbar	a router sends a flit to an outgoing link
+ *	arbitration	a flit takes part in arbitration at a router
+ *	link		a flit is sent over a link, per unit of length, which
+ *			is the distance between the rows and columns of it's
+ *			ends (at least 1)
+ *	static		a router exists for a tick
+ *
+ * A model file gives the energy in pJ of some or all of the events, one per
+ * line as EVENT ENERGY. Blank lines, and anything following a #, are ignored.
+ * Events which are not given keep the energy they had before.
+ * */
+
+/* the default model, loosely based on ORION 2.0 estimates for a 5 port
+ * router with 128 bit flits at 45nm */
+static const double nocsim_energy_defaults[] = {
+	[ENERGY_BUFFER_READ] = 1.5,
+	[ENERGY_BUFFER_WRITE] = 1.8,
+	[ENERGY_CROSSBAR] = 2.0,
+	[ENERGY_ARBITRATION] = 0.2,
+	[ENERGY_LINK] = 1.2,
+	[ENERGY_STATIC] = 0.5,
+};
+
+/**
+ * @brief Reset the energy model to the default.
+ *
+ * @param state
+ */
+void nocsim_energy_default_model(nocsim_state* state) {
+	for (int e = 0 ; e < (int) ENUMSIZE_ENERGY ; e++) {
+		state->energy.cost[e] = nocsim_energy_defaults[e];
+	}
+}
+
+/* fail while loading, prefixing the error with the location in the file */
+#define energy_error(fmt, ...) do { \
+		char* __ee_buf = alloc_printf("%s:%u: " fmt, path, lineno, __VA_ARGS__); \
+		fclose(stream); \
+		free(line); \
+		free(state->errstr); \
+		state->errstr = __ee_buf; \
+		return NOCSIM_RESULT_ERROR; \
+	} while (0)
+
+/**
+ * @brief Read an energy model file. The model is only changed if the whole
+ * file is valid.
+ *
+ * @param state
+ * @param path
+ *
+ * @return
+ */
+nocsim_result nocsim_energy_load_model(nocsim_state* state, const char* path) {
+	double cost[(int) ENUMSIZE_ENERGY];
+	FILE* stream;
+	char* line = NULL;
+	size_t linecap = 0;
+	char* saveptr;
+	char* token;
+	char* event_name;
+	char* value;
+	char* end;
+	unsigned int lineno = 0;
+	nocsim_energy_event event;
+
+	if ((stream = fopen(path, "r")) == NULL) {
+		nocsim_return_error(state, "could not open energy model '%s': %s", path, strerror(errno));
+	}
+
+	memcpy(cost, state->energy.cost, sizeof(cost));
+
+	while (getline(&line, &linecap, stream) != -1) {
+		lineno++;
+
+		if ((token = strchr(line, '#')) != NULL) { *token = '\0'; }
+		line[strcspn(line, "\r\n")] = '\0';
+
+		if ((event_name = strtok_r(line, " \t", &saveptr)) == NULL) { continue; }
+		value = strtok_r(NULL, " \t", &saveptr);
+
+		if (value == NULL || strtok_r(NULL, " \t", &saveptr) != NULL) {
+			energy_error("%s", "usage: EVENT ENERGY");
+		}
+
+		event = NOCSIM_STR_TO_ENERGY_EVENT(event_name);
+		if (event == ENUMSIZE_ENERGY) {
+			energy_error("unknown event '%s', should be one of buffer_read, buffer_write, crossbar, arbitration, link, or static", event_name);
+		}
+
+		errno = 0;
+		cost[event] = strtod(value, &end);
+		if (errno != 0 || *end != '\0' || !(cost[event] >= 0)) {
+			energy_error("invalid energy '%s'", value);
+		}
+	}
+
+	fclose(stream);
+	free(line);
+
+	memcpy(state->energy.cost, cost, sizeof(cost));
+
+	return NOCSIM_RESULT_OK;
+}
+
+#undef energy_error
+
+/**
+ * @brief Reset the activity counts, for example after a warm-up period.
+ *
+ * @param state
+ */
+void nocsim_energy_reset(nocsim_state* state) {
+	nocsim_node* cursor;
+	nocsim_link* link;
+	unsigned int i;
+
+	vec_foreach(state->nodes, cursor, i) {
+		for (int e = 0 ; e < (int) ENERGY_LINK ; e++) {
+			cursor->activity[e] = 0;
+		}
+	}
+
+	vec_foreach(state->links, link, i) {
+		link->traversals = 0;
+	}
+
+	state->energy.start = state->tick;
+}
+
+/**
+ * @brief Compute the length of a link for the purpose of the energy model.
+ *
+ * @param link
+ *
+ * @return the distance between the rows and columns of the nodes at either
+ * end, or 1 if they are at the same position
+ */
+unsigned int nocsim_energy_link_length(nocsim_link* link) {
+	unsigned int length = abs((int) link->from->row - (int) link->to->row) +
+		abs((int) link->from->col - (int) link->to->col);
+
+	return (length == 0) ? 1 : length;
+}
+
+/**
+ * @brief Compute the energy consumed by a node, and it's outgoing links,
+ * since the activity counts were last reset.
+ *
+ * @param state
+ * @param node
+ * @param energy ENUMSIZE_ENERGY values in pJ, one per event, which will be
+ * overwritten
+ */
+void nocsim_energy_node(nocsim_state* state, nocsim_node* node, double* energy) {
+	double* cost = state->energy.cost;
+	nocsim_link* link;
+
+	for (int e = 0 ; e < (int) ENUMSIZE_ENERGY ; e++) {
+		energy[e] = 0;
+	}
+
+	if (node->type == node_router) {
+		for (int e = 0 ; e < (int) ENERGY_LINK ; e++) {
+			energy[e] = cost[e] * node->activity[e];
+		}
+		energy[ENERGY_STATIC] = cost[ENERGY_STATIC] * (state->tick - state->energy.start);
+	}
+
+	for (nocsim_direction dir = N ; dir <= P ; dir++) {
+		if ((link = node->outgoing[dir]) == NULL) { continue; }
+		energy[ENERGY_LINK] += cost[ENERGY_LINK] *
+			link->traversals * nocsim_energy_link_length(link);
+	}
+}
+
+/**
+ * @brief Compute the energy consumed by the whole network since the
+ * activity counts were last reset.
+ *
+ * @param state
+ * @param energy ENUMSIZE_ENERGY values in pJ, one per event, which will be
+ * overwritten
+ */
+void nocsim_energy_total(nocsim_state* state, double* energy) {
+	double node_energy[(int) ENUMSIZE_ENERGY];
+	nocsim_node* cursor;
+	unsigned int i;
+
+	for (int e = 0 ; e < (int) ENUMSIZE_ENERGY ; e++) {
+		energy[e] = 0;
+	}
+
+	vec_foreach(state->nodes, cursor, i) {
+		nocsim_energy_node(state, cursor, node_energy);
+		for (int e = 0 ; e < (int) ENUMSIZE_ENERGY ; e++) {
+			energy[e] += node_energy[e];
+		}
+	}
+}
@@ -0,0 +1,161 @@
+#include "nocsim.h"
+
+/* This file contains methods relating to fault injection, which allows links
+ * and routers to fail and be repaired while the simulation runs.
+ *
+ * A failed link is still part of the topology, but no flit may be routed
+ * over it: avail reports it as failed, route refuses it, native behaviors
+ * treat it as unavailable, and a PE whose outgoing link has failed holds
+ * it's flits in it's FIFO. A failed router is one whose every incoming and
+ * outgoing link has failed.
+ *
+ * Flits which are in flight on a link when it fails, or waiting in the
+ * backlog of a router when it fails, are retried: they are returned to the
+ * front of the FIFO of the PE which spawned them, and state->retried is
+ * incremented.
+ *
+ * Routing tables are brought up to date as each link changes, see
+ * nocsim_routing_fault(), so that native table routing avoids failed links
+ * without rebuilding the tables from scratch.
+ *
+ * Failures and repairs may also be scheduled for a later tick, in which case
+ * they are applied at the start of that tick, before the tick instrument.
+ * */
+
+/* return a flit to the FIFO of the PE that spawned it */
+static void nocsim_fault_retry(nocsim_state* state, nocsim_flit* flit) {
+	vec_insert(flit->from->pending, 0, flit);
+	state->retried ++;
+}
+
+static void nocsim_fault_set(nocsim_state* state, nocsim_link* link, unsigned char failed) {
+	if (link->failed == failed) { return; }
+
+	link->failed = failed;
+
+	if (failed && link->flit != NULL) {
+		nocsim_fault_retry(state, link->flit);
+		link->flit = NULL;
+	}
+
+	if (failed && link->flit_next != NULL) {
+		nocsim_fault_retry(state, link->flit_next);
+		link->flit_next = NULL;
+	}
+
+	nocsim_routing_fault(state, link);
+}
+
+static nocsim_link* nocsim_fault_find(nocsim_node* from, nocsim_node* to) {
+	for (nocsim_direction dir = N ; dir <= P ; dir++) {
+		if (from->outgoing[dir] != NULL && from->outgoing[dir]->to == to) {
+			return from->outgoing[dir];
+		}
+	}
+
+	return NULL;
+}
+
+static void nocsim_fault_apply(nocsim_state* state, nocsim_fault* fault) {
+	nocsim_node* router = fault->from;
+	nocsim_flit* flit;
+
+	if (fault->to != NULL) {
+		nocsim_fault_set(state, nocsim_fault_find(fault->from, fault->to), fault->failed);
+		return;
+	}
+
+	for (nocsim_direction dir = N ; dir <= P ; dir++) {
+		if (router->outgoing[dir] != NULL) {
+			nocsim_fault_set(state, router->outgoing[dir], fault->failed);
+		}
+		if (router->incoming[dir] != NULL) {
+			nocsim_fault_set(state, router->incoming[dir], fault->failed);
+		}
+	}
+
+	/* retry from the back, so that the flits which have waited longest
+	 * end up first in their FIFOs */
+	while (fault->failed && router->pending->length > 0) {
+		flit = vec_pop(router->pending);
+		flit->backlog += state->tick - flit->backlog_since;
+		nocsim_fault_retry(state, flit);
+	}
+}
+
+/**
+ * @brief Fail or repair a link, or every link of a router.
+ *
+ * @param state
+ * @param from node the link leaves from, or the router to fail or repair
+ * @param to node the link leads to, or NULL to affect every link to and from
+ * the router
+ * @param failed 1 to fail, 0 to repair
+ * @param at tick at which to apply the change, if it is in the past the
+ * change is applied immediately
+ *
+ * @return
+ */
+nocsim_result nocsim_fault_schedule(nocsim_state* state, nocsim_node* from, nocsim_node* to, unsigned char failed, unsigned long at) {
+	nocsim_fault fault;
+
+	if (to == NULL && from->type != node_router) {
+		nocsim_return_error(state, "%s is not a router", from->id);
+	}
+
+	if (to != NULL && nocsim_fault_find(from, to) == NULL) {
+		nocsim_return_error(state, "no link from %s to %s", from->id, to->id);
+	}
+
+	fault.at = at;
+	fault.from = from;
+	fault.to = to;
+	fault.failed = failed;
+
+	if (at > state->tick) {
+		vec_push(&(state->faults), fault);
+	} else {
+		nocsim_fault_apply(state, &fault);
+	}
+
+	return NOCSIM_RESULT_OK;
+}
+
+/**
+ * @brief Repair every failed link, and discard any scheduled failures or
+ * repairs.
+ *
+ * @param state
+ */
+void nocsim_fault_repair_all(nocsim_state* state) {
+	nocsim_link* link;
+	unsigned int i;
+
+	vec_clear(&(state->faults));
+
+	vec_foreach(state->links, link, i) {
+		nocsim_fault_set(state, link, 0);
+	}
+}
+
+/**
+ * @brief Apply the scheduled failures and repairs which are due, in the order
+ * they were scheduled.
+ *
+ * @param state
+ */
+void nocsim_fault_tick(nocsim_state* state) {
+	nocsim_fault fault;
+	unsigned int i = 0;
+
+	while (i < (unsigned int) state->faults.length) {
+		if (state->faults.data[i].at > state->tick) {
+			i++;
+			continue;
+		}
+
+		fault = state->faults.data[i];
+		vec_splice(&(state->faults), i, 1);
+		nocsim_fault_apply(state, &fault);
+	}
+}
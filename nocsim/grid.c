@@ -6,10 +6,56 @@
 #include <stdio.h>
 #include <tcl.h>
 
+/**
+ * @brief Make room for a number of nodes and links in addition to those which
+ * already exist, so that creating them does not grow the node and link
+ * vectors or rehash the node map.
+ *
+ * Nothing is reserved if there would be more nodes or links than the vectors
+ * can hold, or if the memory cannot be allocated.
+ *
+ * @param state
+ * @param nodes
+ * @param links
+ *
+ * @return
+ */
+nocsim_result nocsim_grid_reserve(nocsim_state* state, unsigned int nodes, unsigned int links) {
+	/* the vectors are sized in bytes by an unsigned int */
+	unsigned int max_nodes = UINT_MAX / sizeof(*state->nodes->data);
+	unsigned int max_links = UINT_MAX / sizeof(*state->links->data);
+	unsigned int total;
+
+	if (state->nodes->length > max_nodes || nodes > max_nodes - state->nodes->length ||
+			state->links->length > max_links || links > max_links - state->links->length) {
+		nocsim_return_error(state, "cannot reserve %u nodes and %u links in addition to the "
+			"%u nodes and %u links which exist, at most %u nodes and %u links are allowed",
+			nodes, links, state->nodes->length, state->links->length, max_nodes, max_links);
+	}
+	total = state->nodes->length + nodes;
+
+	if (vec_reserve(state->nodes, total) != 0 ||
+			vec_reserve(state->links, state->links->length + links) != 0) {
+		nocsim_return_error(state, "could not allocate memory for %u nodes and %u links", nodes, links);
+	}
+
+	/* khash grows once it is more than __ac_HASH_UPPER full */
+	if (kh_resize(nnptr, state->node_map, (khint_t) (total / __ac_HASH_UPPER) + 1) < 0) {
+		nocsim_return_error(state, "could not allocate memory for %u nodes and %u links", nodes, links);
+	}
+
+	return NOCSIM_RESULT_OK;
+}
+
 /* note that the caller must verify that the ID is unique */
-void nocsim_grid_create_router(nocsim_state* state, char* id, unsigned int row, unsigned int col, char* behavior) {
+nocsim_result nocsim_grid_create_router(nocsim_state* state, char* id, unsigned int row, unsigned int col, char* behavior) {
 	nocsim_node* router;
 	flitlist* pending;
+	nocsim_behavior native;
+
+	if (nocsim_resolve_behavior(state, node_router, behavior, &native) != NOCSIM_RESULT_OK) {
+		return NOCSIM_RESULT_ERROR;
+	}
 
 	alloc(sizeof(nocsim_node), router);
 
@@ -23,14 +69,17 @@ void nocsim_grid_create_router(nocsim_state* state, char* id, unsigned int row,
 	state->num_node++;
 	state->num_router++;
 	router->behavior = behavior;
+	router->native = native;
 
 	if (row > state->max_row) { state->max_row = row; }
 	if (col > state->max_col) { state->max_col = col; }
 
 	vec_push(state->nodes, router);
 	ez_kv_insert(state->node_map, id, router);
+	nocsim_layout_invalidate(state);
+	nocsim_routing_invalidate(state);
 
-	if (state->instruments[INSTRUMENT_NODE] != NULL) {
+	if (nocsim_instrument_enabled(state, INSTRUMENT_NODE, NULL)) {
 		if (Tcl_Evalf(state->interp, "%s {%s} {%u} {%u} {%u} {%s}",
 					state->instruments[INSTRUMENT_NODE],
 					router->id,
@@ -42,12 +91,19 @@ void nocsim_grid_create_router(nocsim_state* state, char* id, unsigned int row,
 			err(1, "unable to proceed, exiting with failure state");
 		}
 	}
+
+	return NOCSIM_RESULT_OK;
 }
 
 /* note that the caller must verify that the ID is unique */
-void nocsim_grid_create_PE(nocsim_state* state, char* id, unsigned int row, unsigned int col, char* behavior) {
+nocsim_result nocsim_grid_create_PE(nocsim_state* state, char* id, unsigned int row, unsigned int col, char* behavior) {
 	nocsim_node* PE;
 	flitlist* pending;
+	nocsim_behavior native;
+
+	if (nocsim_resolve_behavior(state, node_PE, behavior, &native) != NOCSIM_RESULT_OK) {
+		return NOCSIM_RESULT_ERROR;
+	}
 
 	alloc(sizeof(nocsim_node), PE);
 
@@ -61,13 +117,17 @@ void nocsim_grid_create_PE(nocsim_state* state, char* id, unsigned int row, unsi
 	PE->type_number = state->num_PE;
 	state->num_PE++;
 	PE->behavior = behavior;
+	PE->native = native;
+	PE->P_inject = state->default_P_inject;
 	if (row > state->max_row) { state->max_row = row; }
 	if (col > state->max_col) { state->max_col = col; }
 
 	vec_push(state->nodes, PE);
 	ez_kv_insert(state->node_map, id, PE);
+	nocsim_layout_invalidate(state);
+	nocsim_routing_invalidate(state);
 
-	if (state->instruments[INSTRUMENT_NODE] != NULL) {
+	if (nocsim_instrument_enabled(state, INSTRUMENT_NODE, NULL)) {
 		if (Tcl_Evalf(state->interp, "%s {%s} {%u} {%u} {%u} {%s}",
 					state->instruments[INSTRUMENT_NODE],
 					PE->id,
@@ -79,18 +139,52 @@ void nocsim_grid_create_PE(nocsim_state* state, char* id, unsigned int row, unsi
 			err(1, "unable to proceed, exiting with failure state");
 		}
 	}
+
+	return NOCSIM_RESULT_OK;
 }
 
 nocsim_result nocsim_grid_create_link(nocsim_state* state, char* from_id, char* to_id, nocsim_direction from_dir, nocsim_direction to_dir) {
+	nocsim_node* from;
+	nocsim_node* to;
+
+	from = nocsim_node_by_id(state, from_id);
+	to = nocsim_node_by_id(state, to_id);
+
+	if (from == NULL) {
+		nocsim_return_error(state, "could not link from unknown node '%s'", from_id);
+	}
+
+	if (to == NULL) {
+		nocsim_return_error(state, "could not link to unknown node '%s'", to_id);
+	}
+
+	return nocsim_grid_connect(state, from, to, from_dir, to_dir);
+}
+
+/**
+ * @brief Create a link between two existing nodes.
+ *
+ * This is nocsim_grid_create_link(), for callers which already have the
+ * nodes, and so do not need to look them up by ID.
+ *
+ * @param state
+ * @param from
+ * @param to
+ * @param from_dir direction of the link leaving from, or DIR_UNDEF
+ * @param to_dir direction of the link entering to, or DIR_UNDEF
+ *
+ * @return
+ */
+nocsim_result nocsim_grid_connect(nocsim_state* state, nocsim_node* from, nocsim_node* to, nocsim_direction from_dir, nocsim_direction to_dir) {
 
 	// #lizard forgives the complexity
 
 	/* if d is DIR_UNDEF, infer the direction, otherwise it is assume
 	 * that d is the direction the link is pointing */
 
-	nocsim_node* from;
-	nocsim_node* to;
 	nocsim_link* link;
+	char* from_id = from->id;
+	char* to_id = to->id;
 	int bidir;
 
 	if (state->instruments[INSTRUMENT_LINK] != NULL) {
@@ -100,9 +194,6 @@ nocsim_result nocsim_grid_create_link(nocsim_state* state, char* from_id, char*
 
 	alloc(sizeof(nocsim_link), link);
 
-	from = nocsim_node_by_id(state, from_id);
-	to = nocsim_node_by_id(state, to_id);
-
 	dbprintf("from node=");
 	dbprint_node(from);
 	drprintf("\n");
@@ -111,16 +202,6 @@ nocsim_result nocsim_grid_create_link(nocsim_state* state, char* from_id, char*
 	dbprint_node(to);
 	drprintf("\n");
 
-	if (from == NULL) {
-		free(link);
-		nocsim_return_error(state, "could not link from unknown node '%s'", from_id);
-	}
-
-	if (to == NULL) {
-		free(link);
-		nocsim_return_error(state, "could not link to unknown node '%s'", to_id);
-	}
-
 	if (from == to) {
 		free(link);
 		nocsim_return_error(state, "could not link node '%s' to node '%s' which is the same node", from_id, to_id);
@@ -131,6 +212,10 @@ nocsim_result nocsim_grid_create_link(nocsim_state* state, char* from_id, char*
 	link->flit = NULL;
 	link->flit_next = NULL;
 	link->load = 0;
+	link->busy = 0;
+	link->carried = 0;
+	link->traversals = 0;
+	link->failed = 0;
 
 	nocsim_direction selected_to_dir;
 	nocsim_direction selected_from_dir;
@@ -198,8 +283,10 @@ nocsim_result nocsim_grid_create_link(nocsim_state* state, char* from_id, char*
 	}
 
 	vec_push(state->links, link);
+	nocsim_layout_invalidate(state);
+	nocsim_routing_invalidate(state);
 
-	if (state->instruments[INSTRUMENT_LINK] != NULL) {
+	if (nocsim_instrument_enabled(state, INSTRUMENT_LINK, NULL)) {
 		if (Tcl_Evalf(state->interp, "%s {%s} {%s} {%i}",
 					state->instruments[INSTRUMENT_LINK],
 					link->from->id,
@@ -214,3 +301,88 @@ nocsim_result nocsim_grid_create_link(nocsim_state* state, char* from_id, char*
 	return NOCSIM_RESULT_OK;
 
 }
+
+/**
+ * @brief Create a mesh of routers, each with a PE attached to it.
+ *
+ * Nodes are named and linked in the same way as by the create_mesh TCL
+ * procedure, i.e. R.ROW.COL and PE.ROW.COL.
+ *
+ * @param state
+ * @param rows
+ * @param cols
+ * @param inject behavior for the PEs
+ * @param route behavior for the routers
+ *
+ * @return
+ */
+nocsim_result nocsim_grid_create_mesh(nocsim_state* state, unsigned int rows, unsigned int cols, char* inject, char* route) {
+	char* router;
+	char* PE;
+	char* other;
+	nocsim_result result;
+	unsigned long long nodes;
+	unsigned long long links;
+	int r;
+	int c;
+
+	/* each router has a PE, and a pair of links to it and to each neighbor */
+	if (rows > 0 && cols > 0) {
+		nodes = 2ULL * rows * cols;
+		links = nodes + 2ULL * ((cols - 1ULL) * rows + cols * (rows - 1ULL));
+		if (links > UINT_MAX) {
+			nocsim_return_error(state, "a %u by %u mesh has too many nodes and links", rows, cols);
+		}
+		if (nocsim_grid_reserve(state, nodes, links) != NOCSIM_RESULT_OK) {
+			return NOCSIM_RESULT_ERROR;
+		}
+	}
+
+	for (unsigned int row = 0 ; row < rows ; row++) {
+		for (unsigned int col = 0 ; col < cols ; col++) {
+			/* node IDs are owned by the nodes from here on */
+			router = alloc_printf("R.%u.%u", row, col);
+			PE = alloc_printf("PE.%u.%u", row, col);
+
+			if (nocsim_node_by_id(state, router) != NULL || nocsim_node_by_id(state, PE) != NULL) {
+				free(router);
+				free(PE);
+				nocsim_return_error(state, "a node with the ID R.%u.%u or PE.%u.%u exists already",
+					row, col, row, col);
+			}
+
+			if (nocsim_grid_create_router(state, router, row, col, route) != NOCSIM_RESULT_OK ||
+				nocsim_grid_create_PE(state, PE, row, col, inject) != NOCSIM_RESULT_OK ||
+				nocsim_grid_create_link(state, PE, router, DIR_UNDEF, DIR_UNDEF) != NOCSIM_RESULT_OK ||
+				nocsim_grid_create_link(state, router, PE, DIR_UNDEF, DIR_UNDEF) != NOCSIM_RESULT_OK) {
+				return NOCSIM_RESULT_ERROR;
+			}
+		}
+	}
+
+	for (unsigned int row = 0 ; row < rows ; row++) {
+		for (unsigned int col = 0 ; col < cols ; col++) {
+			router = alloc_printf("R.%u.%u", row, col);
+
+			/* north, south, west, and east neighbors */
+			for (int d = 0 ; d < 4 ; d++) {
+				r = (int) row + ((d == 0) ? -1 : (d == 1) ? 1 : 0);
+				c = (int) col + ((d == 2) ? -1 : (d == 3) ? 1 : 0);
+				if (r < 0 || c < 0 || r >= (int) rows || c >= (int) cols) { continue; }
+
+				other = alloc_printf("R.%d.%d", r, c);
+				result = nocsim_grid_create_link(state, router, other, DIR_UNDEF, DIR_UNDEF);
+				free(other);
+
+				if (result != NOCSIM_RESULT_OK) {
+					free(router);
+					return result;
+				}
+			}
+
+			free(router);
+		}
+	}
+
+	return NOCSIM_RESULT_OK;
+}
@@ -0,0 +1,151 @@
+#include "nocsim.h"
+
+/* This file contains methods relating to heatmaps, which summarize where
+ * in the topology traffic is concentrated.
+ *
+ * Accumulators are kept on each link and node, and are updated during the
+ * simulation as a side effect of moving flits around, so no instruments are
+ * needed to collect them. A heatmap sums the accumulators of every router,
+ * and it's outgoing links, at each row and column.
+ *
+ * If a window is set, the accumulators are reset every window ticks, and the
+ * values they held are kept as a snapshot, so that the heatmap describes the
+ * most recent complete window rather than the whole simulation.
+ * */
+
+/* distance from node to the destination of flit, ignoring topology */
+static inline unsigned int nocsim_heatmap_distance(nocsim_node* node, nocsim_flit* flit) {
+	return abs((int) node->row - (int) flit->to->row) +
+		abs((int) node->col - (int) flit->to->col);
+}
+
+/**
+ * @brief Account for a flit being routed, for the purpose of heatmaps.
+ *
+ * A route which moves the flit to it's destination, or to a node closer to
+ * it's destination, is productive, and all others are deflections, which are
+ * also counted against the flit.
+ *
+ * @param router
+ * @param flit
+ * @param to node the flit is being sent to, or NULL if it is being placed
+ * into the backlog
+ */
+void nocsim_heatmap_route(nocsim_node* router, nocsim_flit* flit, nocsim_node* to) {
+	if (to == NULL) {
+		router->buffered ++;
+	} else if (to == flit->to ||
+		(to->type == node_router &&
+		 nocsim_heatmap_distance(to, flit) < nocsim_heatmap_distance(router, flit))) {
+		router->productive ++;
+	} else {
+		router->deflected ++;
+		flit->deflections ++;
+	}
+}
+
+/**
+ * @brief Sum the accumulators into a set of grids.
+ *
+ * @param state
+ * @param grids ENUMSIZE_HEATMAP * rows * cols values, which will be
+ * overwritten
+ * @param rows
+ * @param cols
+ */
+void nocsim_heatmap_collect(nocsim_state* state, long* grids, unsigned int rows, unsigned int cols) {
+	nocsim_node* cursor;
+	nocsim_link* link;
+	unsigned int i;
+	size_t cell;
+	size_t size = (size_t) rows * cols;
+
+	memset(grids, 0, sizeof(long) * ENUMSIZE_HEATMAP * size);
+
+#define grid(metric) grids[(metric) * size + cell]
+
+	vec_foreach(state->nodes, cursor, i) {
+		if (cursor->type != node_router) { continue; }
+		if (cursor->row >= rows || cursor->col >= cols) { continue; }
+
+		cell = (size_t) cursor->row * cols + cursor->col;
+
+		for (nocsim_direction dir = N ; dir <= P ; dir++) {
+			if ((link = cursor->outgoing[dir]) == NULL) { continue; }
+			grid(HEATMAP_CARRIED) += link->carried;
+			grid(HEATMAP_BUSY) += link->busy;
+			grid(HEATMAP_BUSY_N + dir) += link->busy;
+		}
+
+		grid(HEATMAP_PRODUCTIVE) += cursor->productive;
+		grid(HEATMAP_DEFLECTED) += cursor->deflected;
+		grid(HEATMAP_BUFFERED) += cursor->buffered;
+		grid(HEATMAP_OCCUPANCY) += cursor->occupancy;
+	}
+
+#undef grid
+}
+
+/**
+ * @brief Reset every accumulator to 0, starting a new window.
+ *
+ * @param state
+ */
+void nocsim_heatmap_reset(nocsim_state* state) {
+	nocsim_node* cursor;
+	nocsim_link* link;
+	unsigned int i;
+
+	vec_foreach(state->nodes, cursor, i) {
+		cursor->productive = 0;
+		cursor->deflected = 0;
+		cursor->buffered = 0;
+		cursor->occupancy = 0;
+	}
+
+	vec_foreach(state->links, link, i) {
+		link->busy = 0;
+		link->carried = 0;
+	}
+
+	state->heatmap.start = state->tick;
+}
+
+/**
+ * @brief Set the number of ticks after which the accumulators are reset.
+ *
+ * This discards the current accumulators, and any previous window.
+ *
+ * @param state
+ * @param window number of ticks, or 0 to never reset the accumulators
+ */
+void nocsim_heatmap_set_window(nocsim_state* state, unsigned long window) {
+	free(state->heatmap.grids);
+	state->heatmap.grids = NULL;
+	state->heatmap.ticks = 0;
+	state->heatmap.window = window;
+
+	nocsim_heatmap_reset(state);
+}
+
+/**
+ * @brief Called once every tick, completes the current window if needed.
+ *
+ * @param state
+ */
+void nocsim_heatmap_tick(nocsim_state* state) {
+	nocsim_heatmap* heatmap = &(state->heatmap);
+
+	if (heatmap->window == 0) { return; }
+	if (state->tick - heatmap->start < heatmap->window) { return; }
+
+	free(heatmap->grids);
+	heatmap->rows = state->max_row + 1;
+	heatmap->cols = state->max_col + 1;
+	alloc(sizeof(long) * ENUMSIZE_HEATMAP * heatmap->rows * heatmap->cols, heatmap->grids);
+
+	nocsim_heatmap_collect(state, heatmap->grids, heatmap->rows, heatmap->cols);
+	heatmap->ticks = state->tick - heatmap->start;
+
+	nocsim_heatmap_reset(state);
+}
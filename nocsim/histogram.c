@@ -0,0 +1,100 @@
+#include "nocsim.h"
+
+/* This file contains methods relating to histograms, which count how many
+ * flits arrived with each value of a per-flit quantity, such as the number
+ * of hops taken, so that latency and path inflation can be analyzed without
+ * tracking flits in TCL.
+ *
+ * The quantities are kept in each flit as it moves, and are added to the
+ * histograms when it arrives. The metrics are:
+ *
+ *	latency		ticks from when the flit was spawned to when it arrived
+ *	hops		links taken, not counting the link out of the PE
+ *	deflections	links taken which did not bring the flit closer to it's
+ *			destination, see heatmap.c
+ *	backlog		ticks spent in router backlogs
+ *	inflation	hops beyond the fewest needed, see
+ *			nocsim_routing_distance()
+ * */
+
+/* smallest number of entries allocated for a histogram */
+#define NOCSIM_HISTOGRAM_MIN_SIZE 64
+
+static inline void nocsim_histogram_count(nocsim_histogram* histogram, nocsim_histogram_metric metric, unsigned long value) {
+	unsigned long size = histogram->size[metric];
+
+	if (value >= size) {
+		size = (size < NOCSIM_HISTOGRAM_MIN_SIZE) ? NOCSIM_HISTOGRAM_MIN_SIZE : size;
+		while (size <= value) { size *= 2; }
+
+		histogram->counts[metric] = realloc(histogram->counts[metric], sizeof(unsigned long) * size);
+		if (histogram->counts[metric] == NULL) { err(1, "could not allocate memory"); }
+
+		memset(&(histogram->counts[metric][histogram->size[metric]]), 0,
+			sizeof(unsigned long) * (size - histogram->size[metric]));
+		histogram->size[metric] = size;
+	}
+
+	histogram->counts[metric][value] ++;
+}
+
+/**
+ * @brief Account for a flit arriving at it's destination.
+ *
+ * @param state
+ * @param flit
+ */
+void nocsim_histogram_arrive(nocsim_state* state, nocsim_flit* flit) {
+	nocsim_histogram* histogram = &(state->histogram);
+
+	nocsim_histogram_count(histogram, HISTOGRAM_LATENCY, state->tick - flit->spawned_at);
+	nocsim_histogram_count(histogram, HISTOGRAM_HOPS, flit->hops);
+	nocsim_histogram_count(histogram, HISTOGRAM_DEFLECTIONS, flit->deflections);
+	nocsim_histogram_count(histogram, HISTOGRAM_BACKLOG, flit->backlog);
+	nocsim_histogram_count(histogram, HISTOGRAM_INFLATION,
+		(flit->hops > flit->distance) ? flit->hops - flit->distance : 0);
+}
+
+/**
+ * @brief Retrieve the number of meaningful entries in a histogram.
+ *
+ * @param state
+ * @param metric
+ *
+ * @return one more than the largest value any arrived flit had, so entries
+ * beyond this are all 0
+ */
+unsigned long nocsim_histogram_length(nocsim_state* state, nocsim_histogram_metric metric) {
+	unsigned long length = state->histogram.size[metric];
+
+	while (length > 0 && state->histogram.counts[metric][length - 1] == 0) {
+		length--;
+	}
+
+	return length;
+}
+
+/**
+ * @brief Reset every histogram, for example at the start of a measurement.
+ *
+ * @param state
+ */
+void nocsim_histogram_reset(nocsim_state* state) {
+	for (int m = 0 ; m < (int) ENUMSIZE_HISTOGRAM ; m++) {
+		if (state->histogram.counts[m] == NULL) { continue; }
+		memset(state->histogram.counts[m], 0, sizeof(unsigned long) * state->histogram.size[m]);
+	}
+}
+
+/**
+ * @brief Free the memory used by every histogram.
+ *
+ * @param state
+ */
+void nocsim_histogram_free(nocsim_state* state) {
+	for (int m = 0 ; m < (int) ENUMSIZE_HISTOGRAM ; m++) {
+		free(state->histogram.counts[m]);
+		state->histogram.counts[m] = NULL;
+		state->histogram.size[m] = 0;
+	}
+}
@@ -0,0 +1,137 @@
+#include "nocsim.h"
+
+/* This file contains methods relating to instrument filters, which allow an
+ * instrument to be called for only a subset of events.
+ *
+ * Filters are checked before the instrument's arguments are formatted, so
+ * events which are filtered out cost a few comparisons, rather than a TCL
+ * evaluation.
+ * */
+
+static int nocsim_instrument_cmp_flit(const void* a, const void* b) {
+	unsigned long x = *((const unsigned long*) a);
+	unsigned long y = *((const unsigned long*) b);
+
+	return (x > y) - (x < y);
+}
+
+/**
+ * @brief Allocate a filter which accepts every event.
+ *
+ * @param seed seed for the filter's random number generator
+ *
+ * @return
+ */
+nocsim_instrument_filter* nocsim_instrument_filter_create(unsigned int seed) {
+	nocsim_instrument_filter* filter;
+
+	alloc(sizeof(nocsim_instrument_filter), filter);
+
+	filter->has_tick_range = 0;
+	filter->tick_first = 0;
+	filter->tick_last = 0;
+	filter->flits = NULL;
+	filter->num_flits = 0;
+	filter->src_id = NULL;
+	filter->dst_id = NULL;
+	filter->src = NULL;
+	filter->dst = NULL;
+	filter->every = 1;
+	filter->count = 0;
+	filter->probability = 1.0;
+	filter->seed = seed;
+
+	return filter;
+}
+
+void nocsim_instrument_filter_free(nocsim_instrument_filter* filter) {
+	if (filter == NULL) { return; }
+
+	free(filter->flits);
+	free(filter->src_id);
+	free(filter->dst_id);
+	free(filter);
+}
+
+/**
+ * @brief Restrict a filter to a set of flit numbers.
+ *
+ * @param filter
+ * @param flits
+ * @param num_flits
+ */
+void nocsim_instrument_filter_flits(nocsim_instrument_filter* filter, unsigned long* flits, unsigned int num_flits) {
+	free(filter->flits);
+	alloc(sizeof(unsigned long) * (num_flits + 1), filter->flits);
+	memcpy(filter->flits, flits, sizeof(unsigned long) * num_flits);
+	qsort(filter->flits, num_flits, sizeof(unsigned long), nocsim_instrument_cmp_flit);
+	filter->num_flits = num_flits;
+}
+
+/**
+ * @brief Replace the filter for an instrument.
+ *
+ * @param state
+ * @param instrument
+ * @param filter may be NULL, in which case the instrument is called for
+ * every event
+ */
+void nocsim_instrument_set_filter(nocsim_state* state, nocsim_instrument instrument, nocsim_instrument_filter* filter) {
+	nocsim_instrument_filter_free(state->filters[instrument]);
+	state->filters[instrument] = filter;
+}
+
+/* check if node is the one named by id, looking it up and remembering it the
+ * first time it exists */
+static inline unsigned char nocsim_instrument_is_node(nocsim_state* state, nocsim_node* node, char* id, nocsim_node** cache) {
+	if (*cache == NULL) {
+		*cache = nocsim_node_by_id(state, id);
+	}
+
+	return node == *cache;
+}
+
+/**
+ * @brief Decide whether an event passes a filter.
+ *
+ * @param state
+ * @param filter
+ * @param flit flit the event concerns, or NULL if it does not concern a flit
+ *
+ * @return 1 if the instrument should be called
+ */
+unsigned char nocsim_instrument_sample(nocsim_state* state, nocsim_instrument_filter* filter, nocsim_flit* flit) {
+	if (filter->has_tick_range &&
+		(state->tick < filter->tick_first || state->tick > filter->tick_last)) {
+		return 0;
+	}
+
+	if (flit != NULL) {
+		if (filter->flits != NULL &&
+			bsearch(&(flit->flit_no), filter->flits, filter->num_flits,
+				sizeof(unsigned long), nocsim_instrument_cmp_flit) == NULL) {
+			return 0;
+		}
+
+		if (filter->src_id != NULL &&
+			!nocsim_instrument_is_node(state, flit->from, filter->src_id, &(filter->src))) {
+			return 0;
+		}
+
+		if (filter->dst_id != NULL &&
+			!nocsim_instrument_is_node(state, flit->to, filter->dst_id, &(filter->dst))) {
+			return 0;
+		}
+	}
+
+	if (filter->every > 1 && (filter->count++ % filter->every) != 0) {
+		return 0;
+	}
+
+	if (filter->probability < 1.0 &&
+		rand_r(&(filter->seed)) >= filter->probability * (1.0f * RAND_MAX)) {
+		return 0;
+	}
+
+	return 1;
+}
@@ -23,6 +23,13 @@
 	} while (0)
 
 
+#define validate_not_finalized(state) do { \
+		if (state->finalized) { \
+			Tcl_SetResult(interp, "the topology may not be modified after it has been finalized", NULL); \
+			return TCL_ERROR; \
+		} \
+	} while (0)
+
 #define validate_incoming_link_exists(state, direction) __extension__ ({ \
 	if (state->current->incoming[direction] == NULL) { \
 		Tcl_SetResult(interp, "no incoming link from specified direction", NULL); \
@@ -30,6 +37,20 @@
 	} \
 })
 
+#define validate_incoming_flit_exists(state, direction) __extension__ ({ \
+	if (state->current->incoming[direction]->flit == NULL) { \
+		Tcl_SetResult(interp, "no flit incoming from specified direction", NULL); \
+		return TCL_ERROR; \
+	} \
+})
+
+#define validate_backlog_flit_exists(state) __extension__ ({ \
+	if (state->current->pending->length < 1) { \
+		Tcl_SetResult(interp, "backlog has no flits available", NULL); \
+		return TCL_ERROR; \
+	} \
+})
+
 #define validate_outgoing_link_exists(state, direction) __extension__ ({ \
 	if (state->current->outgoing[direction] == NULL) { \
 		Tcl_SetResult(interp, "no outgoing link from specified direction", NULL); \
@@ -43,6 +64,10 @@
 		Tcl_SetResult(interp, "cannot route multiple flits through the same outgoing link", NULL); \
 		return TCL_ERROR; \
 	} \
+	if (state->current->outgoing[direction]->failed) { \
+		Tcl_SetResult(interp, "cannot route a flit through a failed link", NULL); \
+		return TCL_ERROR; \
+	} \
 })
 
 
@@ -56,6 +81,7 @@ interp_command(nocsim_create_router) {
 	int col = -1;
 
 	req_args(5, "ID ROW COL BEHAVIOR");
+	validate_not_finalized(state);
 
 	id = Tcl_GetStringFromObj(argv[1], NULL);
 	get_int(interp, argv[2], &row);
@@ -78,7 +104,10 @@ interp_command(nocsim_create_router) {
 		return TCL_ERROR;
 	}
 
-	nocsim_grid_create_router(state, id, row, col, behavior);
+	if (nocsim_grid_create_router(state, id, row, col, behavior) != NOCSIM_RESULT_OK) {
+		Tcl_SetResult(interp, state->errstr, NULL);
+		return TCL_ERROR;
+	}
 
 	return TCL_OK;
 }
@@ -92,6 +121,7 @@ interp_command(nocsim_create_PE) {
 	int col = -1;
 
 	req_args(5, "ID ROW COL BEHAVIOR");
+	validate_not_finalized(state);
 
 	id = Tcl_GetStringFromObj(argv[1], NULL);
 	get_int(interp, argv[2], &row);
@@ -106,7 +136,10 @@ interp_command(nocsim_create_PE) {
 		return TCL_ERROR;
 	}
 
-	nocsim_grid_create_PE(state, id, row, col, behavior);
+	if (nocsim_grid_create_PE(state, id, row, col, behavior) != NOCSIM_RESULT_OK) {
+		Tcl_SetResult(interp, state->errstr, NULL);
+		return TCL_ERROR;
+	}
 
 	return TCL_OK;
 }
@@ -124,6 +157,8 @@ interp_command(nocsim_create_link) {
 		return TCL_ERROR;
 	}
 
+	validate_not_finalized(state);
+
 	if (argc >= 3 ) {
 		src = Tcl_GetStringFromObj(argv[1], NULL);
 		dst = Tcl_GetStringFromObj(argv[2], NULL);
@@ -246,6 +281,30 @@ interp_command(nocsim_nodeinfo) {
 		Tcl_SetObjResult(interp, Tcl_NewLongObj(node->arrived));
 		return TCL_OK;
 
+	} else if (!strncmp(attr, "P_inject", length)) {
+		Tcl_SetObjResult(interp, Tcl_NewDoubleObj(node->P_inject));
+		return TCL_OK;
+
+	} else if (!strncmp(attr, "productive", length)) {
+		Tcl_SetObjResult(interp, Tcl_NewLongObj(node->productive));
+		return TCL_OK;
+
+	} else if (!strncmp(attr, "deflected", length)) {
+		Tcl_SetObjResult(interp, Tcl_NewLongObj(node->deflected));
+		return TCL_OK;
+
+	} else if (!strncmp(attr, "buffered", length)) {
+		Tcl_SetObjResult(interp, Tcl_NewLongObj(node->buffered));
+		return TCL_OK;
+
+	} else if (!strncmp(attr, "occupancy", length)) {
+		Tcl_SetObjResult(interp, Tcl_NewLongObj(node->occupancy));
+		return TCL_OK;
+
+	} else if (!strncmp(attr, "pending", length)) {
+		Tcl_SetObjResult(interp, Tcl_NewIntObj(node->pending->length));
+		return TCL_OK;
+
 	} else {
 		Tcl_SetResult(interp, "unknown attribute", NULL);
 		return TCL_ERROR;
@@ -298,6 +357,14 @@ interp_command(nocsim_linkinfo) {
 		Tcl_SetObjResult(interp, Tcl_NewLongObj(l->load));
 		return TCL_OK;
 
+	} else if (!strncmp(attr, "busy", length)) {
+		Tcl_SetObjResult(interp, Tcl_NewLongObj(l->busy));
+		return TCL_OK;
+
+	} else if (!strncmp(attr, "carried", length)) {
+		Tcl_SetObjResult(interp, Tcl_NewLongObj(l->carried));
+		return TCL_OK;
+
 	} else if (!strncmp(attr, "from_dir", length)) {
 		for (nocsim_direction i = N; i < DIR_UNDEF; i++) {
 			if (l->from->outgoing[i] == l) { d = i; break; }
@@ -322,6 +389,10 @@ interp_command(nocsim_linkinfo) {
 		Tcl_SetObjResult(interp, Tcl_NewIntObj((int) d));
 		return TCL_OK;
 
+	} else if (!strncmp(attr, "failed", length)) {
+		Tcl_SetObjResult(interp, Tcl_NewIntObj(l->failed));
+		return TCL_OK;
+
 	} else {
 		Tcl_SetResult(interp, "invalid attribute", NULL);
 		return TCL_ERROR;
@@ -396,7 +467,43 @@ interp_command(nocsim_set_behavior) {
 	}
 
 	/* XXX: need to free old value? */
-	node->behavior = behavior;
+	if (nocsim_bind_behavior(state, node, behavior) != NOCSIM_RESULT_OK) {
+		Tcl_SetResult(interp, state->errstr, NULL);
+		return TCL_ERROR;
+	}
+
+	return TCL_OK;
+}
+
+/*** injectrate P / injectrate ID P ******************************************/
+interp_command(nocsim_injectrate_command) {
+	nocsim_state* state = (nocsim_state*) data;
+	nocsim_node* node = NULL;
+	double P;
+
+	if (argc != 2 && argc != 3) {
+		Tcl_WrongNumArgs(interp, 0, argv, "injectrate P / injectrate ID P");
+		return TCL_ERROR;
+	}
+
+	if (argc == 3) {
+		node = nocsim_node_by_id(state, Tcl_GetStringFromObj(argv[1], NULL));
+		if (node == NULL) {
+			Tcl_SetResult(interp, "no node found with requested id", NULL);
+			return TCL_ERROR;
+		}
+	}
+
+	if (Tcl_GetDoubleFromObj(interp, argv[argc - 1], &P) != TCL_OK) {
+		return TCL_ERROR;
+	}
+
+	if (P < 0 || P > 1) {
+		Tcl_SetResult(interp, "P must be between 0 and 1", NULL);
+		return TCL_ERROR;
+	}
+
+	nocsim_set_injectrate(state, node, (float) P);
 
 	return TCL_OK;
 }
@@ -510,10 +617,6 @@ interp_command(nocsim_route_command) {
 	nocsim_state* state = (nocsim_state*) data;
 	nocsim_direction from;
 	nocsim_direction to;
-	nocsim_flit* flit = NULL;
-	nocsim_node* from_node = NULL;
-	nocsim_node* to_node = NULL;
-	const nocsim_node* router = state->current;
 	unsigned char backlog_usage = 0; /* bitflags */
 
 	req_args(3, "route FROM TO");
@@ -543,100 +646,28 @@ interp_command(nocsim_route_command) {
 	switch (backlog_usage) {
 		case 0x0: /* dir,    dir */
 			validate_incoming_link_exists(state, from);
+			validate_incoming_flit_exists(state, from);
 			validate_outgoing_link_exists(state, to);
 			validate_outgoing_link_open(state, to);
-
-			flit      = router->incoming[from]->flit;
-			from_node = router->incoming[from]->from;
-			to_node   = router->outgoing[to]->to;
-
-			/* move flit to next state */
-			router->outgoing[to]->flit_next = router->incoming[from]->flit;
-			router->incoming[from]->flit = NULL;
-			/* TODO: incr perf counters on flit */
 			break;
 		case 0x1: /* dir,    buffer */
 			validate_incoming_link_exists(state, from);
+			validate_incoming_flit_exists(state, from);
 			/* buffer is assumed to exist */
-
-			flit      = state->current->incoming[from]->flit;
-			from_node = state->current->incoming[from]->from;
-			to_node   = state->current;
-			/* put flit at back of backlog FIFO queue */
-			vec_push(router->pending, flit);
-			router->incoming[from]->flit = NULL;
 			break;
 		case 0x2: /* buffer, dir */
 			/* buffer is assumed to exist. */
+			validate_backlog_flit_exists(state);
 			validate_outgoing_link_exists(state, to);
 			validate_outgoing_link_open(state, to);
-
-			flit      = vec_dequeue(router->pending);
-			from_node = (nocsim_node*)router; /* discard const qualifier on this ptr copy */
-			to_node   = router->outgoing[to]->to;
-			/* move flit to next state */
-			router->outgoing[to]->flit_next = flit;
-			//router->incoming[from]->flit = NULL;
 			break;
 		case 0x3: /* buffer, buffer */
 			/* buffer is assumed to exist */
-
-			flit      = vec_dequeue(router->pending);
-			from_node = state->current;
-			to_node   = state->current;
-			/* put flit at back of backlog FIFO queue */
-			vec_push(router->pending, flit);
-			//router->incoming[from]->flit = NULL;
+			validate_backlog_flit_exists(state);
 			break;
 	}
 
-	/* TODO: should probably have a nocsim_route function in simulation.c
-	 * */
-
-	/* route callback */
-	/* note: we do not distinguish between backlog and normal routing yet */
-	state->routed ++;
-	if (state->instruments[INSTRUMENT_ROUTE] != NULL) {
-		if (Tcl_Evalf(state->interp, "%s \"%s\" \"%s\" %lu %lu %lu %lu \"%s\" \"%s\"",
-					state->instruments[INSTRUMENT_ROUTE],
-					flit->from->id, flit->to->id,
-					flit->flit_no,
-					flit->spawned_at,
-					flit->injected_at,
-					flit->hops,
-					from_node->id, to_node->id
-					)) {
-			print_tcl_error(state->interp);
-			err(1, "unable to proceed, exiting with failure state");
-		}
-	}
-
-	/* if we are being routed somewhere that isn't our origin, then this
-	 * counts as an injection event */
-	if ((flit->from != to_node) && (flit->from == from_node)) {
-		if (state->instruments[INSTRUMENT_INJECT] != NULL) {
-			if (Tcl_Evalf(state->interp, "%s \"%s\" \"%s\" %lu",
-					state->instruments[INSTRUMENT_INJECT],
-					flit->from->id,
-					flit->to->id,
-					flit->flit_no)) {
-				print_tcl_error(interp);
-				err(1, "unable to proceed, exiting with failure state");
-			}
-		}
-
-		state->injected ++;
-		flit->from->injected ++;
-	}
-
-	/* performance counters */
-	/* note: only bump counters when flit leaves on a link.
-	 *   We can tell when this happens by using masking to get the 'to' bit. */
-	if (!(backlog_usage & 0x01)) {
-		state->current->routed ++;
-		state->current->outgoing[to]->load ++;
-		flit->hops ++;
-	}
+	nocsim_route(state, state->current, from, to);
 
 	return TCL_OK;
 }
@@ -769,6 +800,22 @@ interp_command(nocsim_peek_command) {
 		Tcl_SetObjResult(interp, Tcl_NewIntObj(flit->injected_at));
 		return TCL_OK;
 
+	} else if (!strncmp(attr, "hops", length)) {
+		Tcl_SetObjResult(interp, Tcl_NewLongObj(flit->hops));
+		return TCL_OK;
+
+	} else if (!strncmp(attr, "deflections", length)) {
+		Tcl_SetObjResult(interp, Tcl_NewLongObj(flit->deflections));
+		return TCL_OK;
+
+	} else if (!strncmp(attr, "backlog", length)) {
+		Tcl_SetObjResult(interp, Tcl_NewLongObj(flit->backlog));
+		return TCL_OK;
+
+	} else if (!strncmp(attr, "distance", length)) {
+		Tcl_SetObjResult(interp, Tcl_NewLongObj(flit->distance));
+		return TCL_OK;
+
 	} else {
 		Tcl_SetObjResult(interp, str2obj("unrecognized attribute"));
 		return TCL_OK;
@@ -832,14 +879,12 @@ interp_command(nocsim_allincoming_command) {
 	}
 
 	/* retrieve a list of all directions from which there are incoming */
-	/* flits  */
+	/* flits, in the order decided by arbitration */
 	Tcl_Obj* listPtr = Tcl_NewListObj(0, NULL);
-	for (nocsim_direction dir = 0 ; dir < DIR_UNDEF ; dir++) {
-		if (state->current->incoming[dir] != NULL) {
-			if (state->current->incoming[dir]->flit != NULL) {
-				Tcl_ListObjAppendElement(interp, listPtr, Tcl_NewIntObj(dir));
-			}
-
+	for (unsigned int i = 0 ; i < state->current->num_arbitrated ; i++) {
+		nocsim_direction dir = state->current->arbitrated[i];
+		if (state->current->incoming[dir]->flit != NULL) {
+			Tcl_ListObjAppendElement(interp, listPtr, Tcl_NewIntObj(dir));
 		}
 	}
 	Tcl_SetObjResult(interp, listPtr);
@@ -873,6 +918,10 @@ interp_command(nocsim_avail_command) {
 		/* no such link */
 		Tcl_SetObjResult(interp, Tcl_NewIntObj(2));
 
+	} else if (state->current->outgoing[dir]->failed) {
+		/* failed */
+		Tcl_SetObjResult(interp, Tcl_NewIntObj(3));
+
 	} else if (state->current->outgoing[dir]->flit_next == NULL) {
 		/* available */
 		Tcl_SetObjResult(interp, Tcl_NewIntObj(0));
@@ -972,14 +1021,27 @@ interp_command(nocsim_int2type) {
 	}
 }
 
-/*** registerinstrument INSTRUMENT PROCEDURE *********************************/
+/*** registerinstrument INSTRUMENT PROCEDURE ?OPTIONS? ************************/
 interp_command(nocsim_registerinstrument) {
 	nocsim_state* state = (nocsim_state*) data;
 	char* instrument_str;
 	nocsim_instrument instrument;
 	char* procedure;
-
-	req_args(3, "registerinstrument INSTRUMENT PROCEDURE");
+	char* option;
+	nocsim_instrument_filter* filter = NULL;
+	unsigned long* flits;
+	Tcl_Obj** elems;
+	Tcl_WideInt wide;
+	Tcl_WideInt first;
+	Tcl_WideInt last;
+	double probability;
+	int count;
+	int i;
+
+	if (argc < 3) {
+		Tcl_WrongNumArgs(interp, 0, argv, "registerinstrument INSTRUMENT PROCEDURE ?-every N? ?-probability P? ?-flits LIST? ?-src ID? ?-dst ID? ?-tick-range A B?");
+		return TCL_ERROR;
+	}
 
 	instrument_str = Tcl_GetStringFromObj(argv[1], NULL);
 	procedure = Tcl_GetStringFromObj(argv[2], NULL);
@@ -991,8 +1053,99 @@ interp_command(nocsim_registerinstrument) {
 		return TCL_ERROR;
 	}
 
+	/* the filter is discarded on any error, leaving the previously
+	 * registered procedure and filter untouched */
+#define filter_error(msg) do { \
+		nocsim_instrument_filter_free(filter); \
+		Tcl_SetResult(interp, msg, NULL); \
+		return TCL_ERROR; \
+	} while (0)
+
+#define filter_get_wide(obj, ptr) do { \
+		if (Tcl_GetWideIntFromObj(interp, obj, ptr) != TCL_OK) { \
+			nocsim_instrument_filter_free(filter); \
+			return TCL_ERROR; \
+		} \
+	} while (0)
+
+	for (i = 3 ; i < argc ; i++) {
+		option = Tcl_GetStringFromObj(argv[i], NULL);
+
+		if (filter == NULL) {
+			filter = nocsim_instrument_filter_create(state->RNG_seed ^ (unsigned int) instrument);
+		}
+
+		if (i + 1 >= argc) {
+			filter_error("option requires a value");
+		}
+
+		if ((!strcmp(option, "-flits") || !strcmp(option, "-src") || !strcmp(option, "-dst")) &&
+			(instrument == INSTRUMENT_TICK || instrument == INSTRUMENT_NODE ||
+			 instrument == INSTRUMENT_LINK)) {
+			filter_error("flit filters may only be used with instruments concerning a flit");
+		}
+
+		if (!strcmp(option, "-every")) {
+			filter_get_wide(argv[++i], &wide);
+			if (wide < 1) { filter_error("-every must be at least 1"); }
+			filter->every = (unsigned long) wide;
+
+		} else if (!strcmp(option, "-probability")) {
+			if (Tcl_GetDoubleFromObj(interp, argv[++i], &probability) != TCL_OK) {
+				nocsim_instrument_filter_free(filter);
+				return TCL_ERROR;
+			}
+			if (probability < 0 || probability > 1) {
+				filter_error("-probability must be between 0 and 1");
+			}
+			filter->probability = (float) probability;
+
+		} else if (!strcmp(option, "-flits")) {
+			if (Tcl_ListObjGetElements(interp, argv[++i], &count, &elems) != TCL_OK) {
+				nocsim_instrument_filter_free(filter);
+				return TCL_ERROR;
+			}
+			alloc(sizeof(unsigned long) * (count + 1), flits);
+			for (int j = 0 ; j < count ; j++) {
+				if (Tcl_GetWideIntFromObj(interp, elems[j], &wide) != TCL_OK || wide < 0) {
+					free(flits);
+					filter_error("-flits must be a list of flit numbers");
+				}
+				flits[j] = (unsigned long) wide;
+			}
+			nocsim_instrument_filter_flits(filter, flits, (unsigned int) count);
+			free(flits);
+
+		} else if (!strcmp(option, "-src")) {
+			free(filter->src_id);
+			filter->src_id = strdup(Tcl_GetStringFromObj(argv[++i], NULL));
+
+		} else if (!strcmp(option, "-dst")) {
+			free(filter->dst_id);
+			filter->dst_id = strdup(Tcl_GetStringFromObj(argv[++i], NULL));
+
+		} else if (!strcmp(option, "-tick-range")) {
+			if (i + 2 >= argc) { filter_error("-tick-range requires two values"); }
+			filter_get_wide(argv[++i], &first);
+			filter_get_wide(argv[++i], &last);
+			if (first < 0 || last < first) {
+				filter_error("-tick-range must be two ticks A <= B");
+			}
+			filter->has_tick_range = 1;
+			filter->tick_first = (unsigned long) first;
+			filter->tick_last = (unsigned long) last;
+
+		} else {
+			filter_error("unknown option, should be one of -every, -probability, -flits, -src, -dst, or -tick-range");
+		}
+	}
+
+#undef filter_error
+#undef filter_get_wide
+
 	Tcl_IncrRefCount(argv[2]);  /* procedure */
 	state->instruments[instrument] = procedure;
+	nocsim_instrument_set_filter(state, instrument, filter);
 
 	return TCL_OK;
 }
@@ -1041,6 +1194,490 @@ interp_command(nocsim_errwrite) {
 	return TCL_OK;
 }
 
+/*** finalize **************************************************************/
+interp_command(nocsim_finalize_command) {
+	nocsim_state* state = (nocsim_state*) data;
+
+	req_args(1, "finalize");
+
+	if (nocsim_finalize(state) != NOCSIM_RESULT_OK) {
+		Tcl_SetResult(interp, state->errstr, NULL);
+		return TCL_ERROR;
+	}
+
+	return TCL_OK;
+}
+
+/*** arbitration / arbitration POLICY / arbitration POLICY DIR DIR DIR DIR DIR */
+interp_command(nocsim_arbitration_command) {
+	nocsim_state* state = (nocsim_state*) data;
+	nocsim_arbitration arbitration;
+	nocsim_direction priority[NOCSIM_NUM_LINKS];
+
+	if (argc != 1 && argc != 2 && argc != 2 + NOCSIM_NUM_LINKS) {
+		Tcl_WrongNumArgs(interp, 0, argv, "arbitration / arbitration POLICY / arbitration POLICY DIR DIR DIR DIR DIR");
+		return TCL_ERROR;
+	}
+
+	if (argc == 1) {
+		const char* name = NOCSIM_ARBITRATION_TO_STR(state->arbitration);
+		Tcl_SetObjResult(interp, str2obj(name));
+		return TCL_OK;
+	}
+
+	arbitration = NOCSIM_STR_TO_ARBITRATION(Tcl_GetStringFromObj(argv[1], NULL));
+
+	for (int i = 2 ; i < argc ; i++) {
+		get_int(interp, argv[i], (int*) &(priority[i - 2]));
+	}
+
+	if (nocsim_set_arbitration(state, arbitration, (argc > 2) ? priority : NULL) != NOCSIM_RESULT_OK) {
+		Tcl_SetResult(interp, state->errstr, NULL);
+		return TCL_ERROR;
+	}
+
+	return TCL_OK;
+}
+
+/*** reserve NODES LINKS ****************************************************/
+interp_command(nocsim_reserve_command) {
+	nocsim_state* state = (nocsim_state*) data;
+	Tcl_Obj* result;
+	int nodes;
+	int links;
+
+	req_args(3, "reserve NODES LINKS");
+	validate_not_finalized(state);
+
+	get_int(interp, argv[1], &nodes);
+	get_int(interp, argv[2], &links);
+
+	if (nodes < 0 || links < 0) {
+		Tcl_SetResult(interp, "NODES and LINKS may not be negative", NULL);
+		return TCL_ERROR;
+	}
+
+	if (nocsim_grid_reserve(state, nodes, links) != NOCSIM_RESULT_OK) {
+		Tcl_SetResult(interp, state->errstr, NULL);
+		return TCL_ERROR;
+	}
+
+	/* the number of nodes and links which can now exist without growing */
+	result = Tcl_NewListObj(0, NULL);
+	Tcl_ListObjAppendElement(interp, result, Tcl_NewWideIntObj(state->nodes->capacity));
+	Tcl_ListObjAppendElement(interp, result, Tcl_NewWideIntObj(state->links->capacity));
+	Tcl_SetObjResult(interp, result);
+
+	return TCL_OK;
+}
+
+/*** load FILE *************************************************************/
+interp_command(nocsim_load_command) {
+	nocsim_state* state = (nocsim_state*) data;
+
+	req_args(2, "load FILE");
+	validate_not_finalized(state);
+
+	if (nocsim_netlist_load(state, Tcl_GetStringFromObj(argv[1], NULL)) != NOCSIM_RESULT_OK) {
+		Tcl_SetResult(interp, state->errstr, NULL);
+		return TCL_ERROR;
+	}
+
+	return TCL_OK;
+}
+
+/*** save FILE *************************************************************/
+interp_command(nocsim_save_command) {
+	nocsim_state* state = (nocsim_state*) data;
+
+	req_args(2, "save FILE");
+
+	if (nocsim_netlist_save(state, Tcl_GetStringFromObj(argv[1], NULL)) != NOCSIM_RESULT_OK) {
+		Tcl_SetResult(interp, state->errstr, NULL);
+		return TCL_ERROR;
+	}
+
+	return TCL_OK;
+}
+
+/*** nexthop DIR / nexthop DIR ALGORITHM *************************************/
+interp_command(nocsim_nexthop_command) {
+	nocsim_state* state = (nocsim_state*) data;
+	nocsim_direction dir;
+	nocsim_algorithm algorithm = ALGORITHM_DOR;
+	nocsim_flit* flit;
+	nocsim_hop hop;
+	Tcl_Obj* listPtr;
+
+	if (argc != 2 && argc != 3) {
+		Tcl_WrongNumArgs(interp, 0, argv, "nexthop DIR / nexthop DIR ALGORITHM");
+		return TCL_ERROR;
+	}
+
+	get_int(interp, argv[1], (int*) &dir);
+	validate_direction(dir);
+
+	if (argc == 3) {
+		algorithm = NOCSIM_STR_TO_ALGORITHM(Tcl_GetStringFromObj(argv[2], NULL));
+		if (algorithm == ENUMSIZE_ALGORITHM) {
+			Tcl_SetResult(interp, "unknown routing algorithm", NULL);
+			return TCL_ERROR;
+		}
+	}
+
+	if (state->current == NULL) {
+		Tcl_SetResult(interp, "nexthop may only be called during a behavior callback", NULL);
+		return TCL_ERROR;
+	}
+
+	if (state->current->type != node_router) {
+		Tcl_SetResult(interp, "nexthop may only be called for router nodes", NULL);
+		return TCL_ERROR;
+	}
+
+	if (dir == BACKLOG) {
+		validate_backlog_flit_exists(state);
+		flit = vec_first(state->current->pending);
+	} else {
+		validate_incoming_link_exists(state, dir);
+		validate_incoming_flit_exists(state, dir);
+		flit = state->current->incoming[dir]->flit;
+	}
+
+	hop = nocsim_routing_lookup(state,
+		nocsim_routing_table(state, algorithm), state->current, dir, flit->to);
+
+	listPtr = Tcl_NewListObj(0, NULL);
+	if (NOCSIM_HOP_FIRST(hop) != DIR_UNDEF) {
+		Tcl_ListObjAppendElement(interp, listPtr, Tcl_NewIntObj(NOCSIM_HOP_FIRST(hop)));
+	}
+	if (NOCSIM_HOP_SECOND(hop) != DIR_UNDEF) {
+		Tcl_ListObjAppendElement(interp, listPtr, Tcl_NewIntObj(NOCSIM_HOP_SECOND(hop)));
+	}
+
+	Tcl_SetObjResult(interp, listPtr);
+	return TCL_OK;
+}
+
+/*** heatmap / heatmap -window N ********************************************/
+interp_command(nocsim_heatmap_command) {
+	nocsim_state* state = (nocsim_state*) data;
+	nocsim_heatmap* heatmap = &(state->heatmap);
+	long* grids = heatmap->grids;
+	unsigned long ticks = heatmap->ticks;
+	unsigned int rows = heatmap->rows;
+	unsigned int cols = heatmap->cols;
+	int window;
+	Tcl_Obj* dictPtr;
+	Tcl_Obj* gridPtr;
+	Tcl_Obj* rowPtr;
+
+	if (argc != 1 && argc != 3) {
+		Tcl_WrongNumArgs(interp, 0, argv, "heatmap / heatmap -window N");
+		return TCL_ERROR;
+	}
+
+	if (argc == 3) {
+		if (strcmp(Tcl_GetStringFromObj(argv[1], NULL), "-window")) {
+			Tcl_SetResult(interp, "unknown option, should be -window", NULL);
+			return TCL_ERROR;
+		}
+
+		get_int(interp, argv[2], &window);
+		if (window < 0) {
+			Tcl_SetResult(interp, "window may not be negative", NULL);
+			return TCL_ERROR;
+		}
+
+		nocsim_heatmap_set_window(state, (unsigned long) window);
+	}
+
+	/* without a window, or before the first window is complete, report
+	 * the accumulators as they are now */
+	if (heatmap->window == 0 || heatmap->grids == NULL) {
+		rows = state->max_row + 1;
+		cols = state->max_col + 1;
+		ticks = (heatmap->window == 0) ? state->tick - heatmap->start : 0;
+		alloc(sizeof(long) * ENUMSIZE_HEATMAP * rows * cols, grids);
+
+		if (heatmap->window == 0) {
+			nocsim_heatmap_collect(state, grids, rows, cols);
+		} else {
+			memset(grids, 0, sizeof(long) * ENUMSIZE_HEATMAP * rows * cols);
+		}
+	}
+
+	dictPtr = Tcl_NewDictObj();
+	Tcl_DictObjPut(interp, dictPtr, str2obj("ticks"), Tcl_NewLongObj((long) ticks));
+
+	for (int m = 0 ; m < (int) ENUMSIZE_HEATMAP ; m++) {
+		gridPtr = Tcl_NewListObj(0, NULL);
+		for (unsigned int row = 0 ; row < rows ; row++) {
+			rowPtr = Tcl_NewListObj(0, NULL);
+			for (unsigned int col = 0 ; col < cols ; col++) {
+				Tcl_ListObjAppendElement(interp, rowPtr,
+					Tcl_NewLongObj(grids[((size_t) m * rows + row) * cols + col]));
+			}
+			Tcl_ListObjAppendElement(interp, gridPtr, rowPtr);
+		}
+		Tcl_DictObjPut(interp, dictPtr,
+			str2obj((char*) (NOCSIM_HEATMAP_METRIC_TO_STR((nocsim_heatmap_metric) m))), gridPtr);
+	}
+
+	if (grids != heatmap->grids) { free(grids); }
+
+	Tcl_SetObjResult(interp, dictPtr);
+	return TCL_OK;
+}
+
+/*** histogram / histogram reset *********************************************/
+interp_command(nocsim_histogram_command) {
+	nocsim_state* state = (nocsim_state*) data;
+	unsigned long length;
+	Tcl_Obj* dictPtr;
+	Tcl_Obj* listPtr;
+
+	if (argc != 1 && argc != 2) {
+		Tcl_WrongNumArgs(interp, 0, argv, "histogram / histogram reset");
+		return TCL_ERROR;
+	}
+
+	if (argc == 2) {
+		if (strcmp(Tcl_GetStringFromObj(argv[1], NULL), "reset")) {
+			Tcl_SetResult(interp, "unknown subcommand, should be reset", NULL);
+			return TCL_ERROR;
+		}
+
+		nocsim_histogram_reset(state);
+		return TCL_OK;
+	}
+
+	dictPtr = Tcl_NewDictObj();
+
+	for (int m = 0 ; m < (int) ENUMSIZE_HISTOGRAM ; m++) {
+		length = nocsim_histogram_length(state, (nocsim_histogram_metric) m);
+		listPtr = Tcl_NewListObj(0, NULL);
+		for (unsigned long v = 0 ; v < length ; v++) {
+			Tcl_ListObjAppendElement(interp, listPtr,
+				Tcl_NewWideIntObj((Tcl_WideInt) state->histogram.counts[m][v]));
+		}
+		Tcl_DictObjPut(interp, dictPtr,
+			str2obj((char*) (NOCSIM_HISTOGRAM_METRIC_TO_STR((nocsim_histogram_metric) m))), listPtr);
+	}
+
+	Tcl_SetObjResult(interp, dictPtr);
+	return TCL_OK;
+}
+
+/*** energy / energy -model FILE / energy reset ******************************/
+interp_command(nocsim_energy_command) {
+	nocsim_state* state = (nocsim_state*) data;
+	double energy[(int) ENUMSIZE_ENERGY];
+	double components[(int) ENUMSIZE_ENERGY];
+	double total = 0;
+	nocsim_node* cursor;
+	unsigned int i;
+	Tcl_Obj* dictPtr;
+	Tcl_Obj* nodesPtr;
+	Tcl_Obj* nodePtr;
+
+	if (argc == 2 && !strcmp(Tcl_GetStringFromObj(argv[1], NULL), "reset")) {
+		nocsim_energy_reset(state);
+		return TCL_OK;
+	}
+
+	if (argc != 1 && argc != 3) {
+		Tcl_WrongNumArgs(interp, 0, argv, "energy / energy -model FILE / energy reset");
+		return TCL_ERROR;
+	}
+
+	if (argc == 3) {
+		if (strcmp(Tcl_GetStringFromObj(argv[1], NULL), "-model")) {
+			Tcl_SetResult(interp, "unknown option, should be -model", NULL);
+			return TCL_ERROR;
+		}
+
+		if (nocsim_energy_load_model(state, Tcl_GetStringFromObj(argv[2], NULL)) != NOCSIM_RESULT_OK) {
+			Tcl_SetResult(interp, state->errstr, NULL);
+			return TCL_ERROR;
+		}
+	}
+
+	for (int e = 0 ; e < (int) ENUMSIZE_ENERGY ; e++) {
+		components[e] = 0;
+	}
+
+	nodesPtr = Tcl_NewDictObj();
+	vec_foreach(state->nodes, cursor, i) {
+		nocsim_energy_node(state, cursor, energy);
+		nodePtr = Tcl_NewDictObj();
+		for (int e = 0 ; e < (int) ENUMSIZE_ENERGY ; e++) {
+			components[e] += energy[e];
+			total += energy[e];
+			Tcl_DictObjPut(interp, nodePtr,
+				str2obj((char*) (NOCSIM_ENERGY_EVENT_TO_STR((nocsim_energy_event) e))),
+				Tcl_NewDoubleObj(energy[e]));
+		}
+		Tcl_DictObjPut(interp, nodesPtr, str2obj(cursor->id), nodePtr);
+	}
+
+	dictPtr = Tcl_NewDictObj();
+	Tcl_DictObjPut(interp, dictPtr, str2obj("ticks"),
+		Tcl_NewLongObj((long) (state->tick - state->energy.start)));
+	Tcl_DictObjPut(interp, dictPtr, str2obj("total"), Tcl_NewDoubleObj(total));
+
+	nodePtr = Tcl_NewDictObj();
+	for (int e = 0 ; e < (int) ENUMSIZE_ENERGY ; e++) {
+		Tcl_DictObjPut(interp, nodePtr,
+			str2obj((char*) (NOCSIM_ENERGY_EVENT_TO_STR((nocsim_energy_event) e))),
+			Tcl_NewDoubleObj(components[e]));
+	}
+	Tcl_DictObjPut(interp, dictPtr, str2obj("components"), nodePtr);
+	Tcl_DictObjPut(interp, dictPtr, str2obj("nodes"), nodesPtr);
+
+	Tcl_SetObjResult(interp, dictPtr);
+	return TCL_OK;
+}
+
+/* shared by fail and repair, failed is 1 for fail and 0 for repair */
+static int nocsim_fault_command(nocsim_state* state, Tcl_Interp* interp, int argc, Tcl_Obj* CONST* argv, unsigned char failed) {
+	const char* usage = failed ?
+		"fail / fail link FROM TO ?-at TICK? / fail router ID ?-at TICK?" :
+		"repair all / repair link FROM TO ?-at TICK? / repair router ID ?-at TICK?";
+	char* subcommand;
+	nocsim_node* from;
+	nocsim_node* to = NULL;
+	nocsim_link* link;
+	unsigned int i;
+	int nargs;
+	int at = 0;
+	Tcl_Obj* listPtr;
+	Tcl_Obj* pairPtr;
+
+	/* fail with no arguments lists the failed links */
+	if (failed && argc == 1) {
+		listPtr = Tcl_NewListObj(0, NULL);
+		vec_foreach(state->links, link, i) {
+			if (!link->failed) { continue; }
+			pairPtr = Tcl_NewListObj(0, NULL);
+			Tcl_ListObjAppendElement(interp, pairPtr, str2obj(link->from->id));
+			Tcl_ListObjAppendElement(interp, pairPtr, str2obj(link->to->id));
+			Tcl_ListObjAppendElement(interp, listPtr, pairPtr);
+		}
+		Tcl_SetObjResult(interp, listPtr);
+		return TCL_OK;
+	}
+
+	if (argc < 2) {
+		Tcl_WrongNumArgs(interp, 0, argv, usage);
+		return TCL_ERROR;
+	}
+
+	subcommand = Tcl_GetStringFromObj(argv[1], NULL);
+
+	if (!failed && !strcmp(subcommand, "all")) {
+		req_args(2, usage);
+		nocsim_fault_repair_all(state);
+		return TCL_OK;
+	}
+
+	if (!strcmp(subcommand, "link")) {
+		nargs = 4;
+	} else if (!strcmp(subcommand, "router")) {
+		nargs = 3;
+	} else {
+		Tcl_SetResult(interp, failed ?
+			"unknown subcommand, should be link or router" :
+			"unknown subcommand, should be all, link, or router", NULL);
+		return TCL_ERROR;
+	}
+
+	if (argc != nargs && argc != nargs + 2) {
+		Tcl_WrongNumArgs(interp, 0, argv, usage);
+		return TCL_ERROR;
+	}
+
+	if (argc == nargs + 2) {
+		if (strcmp(Tcl_GetStringFromObj(argv[nargs], NULL), "-at")) {
+			Tcl_SetResult(interp, "unknown option, should be -at", NULL);
+			return TCL_ERROR;
+		}
+
+		get_int(interp, argv[nargs + 1], &at);
+		if (at < 0) {
+			Tcl_SetResult(interp, "TICK must not be negative", NULL);
+			return TCL_ERROR;
+		}
+	}
+
+	from = nocsim_node_by_id(state, Tcl_GetStringFromObj(argv[2], NULL));
+	if (nargs == 4) {
+		to = nocsim_node_by_id(state, Tcl_GetStringFromObj(argv[3], NULL));
+	}
+
+	if (from == NULL || (nargs == 4 && to == NULL)) {
+		Tcl_SetResult(interp, "no node found with requested id", NULL);
+		return TCL_ERROR;
+	}
+
+	if (nocsim_fault_schedule(state, from, to, failed, (unsigned long) at) != NOCSIM_RESULT_OK) {
+		Tcl_SetResult(interp, state->errstr, NULL);
+		return TCL_ERROR;
+	}
+
+	return TCL_OK;
+}
+
+/*** fail / fail link FROM TO ?-at TICK? / fail router ID ?-at TICK? *********/
+interp_command(nocsim_fail_command) {
+	return nocsim_fault_command((nocsim_state*) data, interp, argc, argv, 1);
+}
+
+/*** repair all / repair link FROM TO ?-at TICK? / repair router ID ... ******/
+interp_command(nocsim_repair_command) {
+	return nocsim_fault_command((nocsim_state*) data, interp, argc, argv, 0);
+}
+
+/*** profile report / profile reset / profile enabled ***********************/
+interp_command(nocsim_profile_command) {
+	nocsim_state* state = (nocsim_state*) data;
+	char* subcommand;
+
+	req_args(2, "profile report / profile reset / profile enabled");
+
+	subcommand = Tcl_GetStringFromObj(argv[1], NULL);
+
+	if (!strcmp(subcommand, "enabled")) {
+#ifdef NOCSIM_PROFILE
+		Tcl_SetObjResult(interp, Tcl_NewIntObj(1));
+#else
+		Tcl_SetObjResult(interp, Tcl_NewIntObj(0));
+#endif
+		return TCL_OK;
+	}
+
+	if (strcmp(subcommand, "report") && strcmp(subcommand, "reset")) {
+		Tcl_SetResult(interp, "unknown subcommand, should be one of report, reset, or enabled", NULL);
+		return TCL_ERROR;
+	}
+
+#ifdef NOCSIM_PROFILE
+	if (!strcmp(subcommand, "reset")) {
+		nocsim_profile_reset(state);
+		return TCL_OK;
+	}
+
+	subcommand = nocsim_profile_report(state);
+	Tcl_SetObjResult(interp, str2obj(subcommand));
+	free(subcommand);
+	return TCL_OK;
+#else
+	UNUSED(state);
+	Tcl_SetResult(interp, "nocsim was built without profiling, reconfigure with --enable-profile", NULL);
+	return TCL_ERROR;
+#endif
+}
+
 /*** allnodes ****************************************************************/
 interp_command(nocsim_allnodes_command) {
 	nocsim_state* state = (nocsim_state*) data;
@@ -1064,50 +1701,13 @@ interp_command(nocsim_allnodes_command) {
 
 /*** interpreter implementation **********************************************/
 
-/* XXX: in the future, this should really be split into actual simulation
- * state initialization in simulation.c, and Tcl initialization in nocsim.c.
- *
- * This function is written this way to reduce the friction of going from a C
- * program that instantiates a Tcl interpreter, to being a Tcl library.
- */
+/* Attach a new simulation state to an interpreter, creating the nocsim::
+ * commands and linked variables. See nocsim_init_state() for the part of
+ * this which does not involve TCL. */
 
 void nocsim_create_state(Tcl_Interp* interp, nocsim_state* state) {
-	nodelist* l;
-	linklist* links;
-
-/*** initialize nocsim state *************************************************/
-	alloc(sizeof(nodelist), l);
-	alloc(sizeof(linklist), links);
-
-	state->RNG_seed = (unsigned int) time(NULL);
-	state->num_PE = 0;
-	state->num_router = 0;
-	state->num_node = 0;
-	state->flit_no = 0;
-	state->tick = 0;
-	state->title = NULL; /* allocated as a linked var later */
-	state->current = NULL;
-	state->max_row = 0;
-	state->max_col = 0;
-	state->injected = 0;
-	state->dequeued = 0;
-	state->spawned = 0;
-	state->backrouted = 0;
-	state->routed = 0;
-	state->arrived = 0;
-	state->errstr = NULL;
-
-	for (int i = 0 ; i < (int) ENUMSIZE_INSTRUMENT ; i++) {
-		state->instruments[i] = NULL;
-	}
-
-	vec_init(l);
-	state->nodes = l;
-	state->node_map = kh_init(nnptr);
-
-	vec_init(links);
-	state->links = links;
 
+	nocsim_init_state(state);
 
 #define defcmd(func, name) \
 	Tcl_CreateObjCommand(interp, name, \
@@ -1141,6 +1741,19 @@ void nocsim_create_state(Tcl_Interp* interp, nocsim_state* state) {
 	defcmd(nocsim_allincoming_command, "nocsim::allincoming");
 	defcmd(nocsim_drop_command, "nocsim::drop");
 	defcmd(nocsim_allnodes_command, "nocsim::allnodes");
+	defcmd(nocsim_finalize_command, "nocsim::finalize");
+	defcmd(nocsim_nexthop_command, "nocsim::nexthop");
+	defcmd(nocsim_heatmap_command, "nocsim::heatmap");
+	defcmd(nocsim_histogram_command, "nocsim::histogram");
+	defcmd(nocsim_energy_command, "nocsim::energy");
+	defcmd(nocsim_fail_command, "nocsim::fail");
+	defcmd(nocsim_repair_command, "nocsim::repair");
+	defcmd(nocsim_injectrate_command, "nocsim::injectrate");
+	defcmd(nocsim_profile_command, "nocsim::profile");
+	defcmd(nocsim_arbitration_command, "nocsim::arbitration");
+	defcmd(nocsim_reserve_command, "nocsim::reserve");
+	defcmd(nocsim_load_command, "nocsim::load");
+	defcmd(nocsim_save_command, "nocsim::save");
 
 #undef defcmd
 
@@ -1164,6 +1777,8 @@ void nocsim_create_state(Tcl_Interp* interp, nocsim_state* state) {
 	link(long, "nocsim::nocsim_backrouted", &(state->backrouted), TCL_LINK_WIDE_INT | TCL_LINK_READ_ONLY);
 	link(long, "nocsim::nocsim_routed", &(state->routed), TCL_LINK_WIDE_INT | TCL_LINK_READ_ONLY);
 	link(long, "nocsim::nocsim_arrived", &(state->arrived), TCL_LINK_WIDE_INT | TCL_LINK_READ_ONLY);
+	link(long, "nocsim::nocsim_retried", &(state->retried), TCL_LINK_WIDE_INT | TCL_LINK_READ_ONLY);
+	link(int, "nocsim::nocsim_finalized", &(state->finalized), TCL_LINK_INT | TCL_LINK_READ_ONLY);
 #undef link
 
 	state->title = (char*) Tcl_Alloc(sizeof(char) * 512);
@@ -1184,3 +1799,4 @@ void nocsim_create_state(Tcl_Interp* interp, nocsim_state* state) {
 #undef interp_command
 #undef req_args
 #undef validate_direction
+#undef validate_not_finalized
@@ -0,0 +1,160 @@
+#include "nocsim.h"
+
+/* This file contains methods relating to the compacted "layout" of the grid.
+ *
+ * While the topology is being constructed, nodes and links are allocated one
+ * at a time and reached through pointers, which scatters them across the
+ * heap. Before the simulation is stepped, the layout is (re-)built: all links
+ * are moved into one contiguous slab, grouped by their destination node, and
+ * nodes are visited in row-major order. flip_state() can then stream through
+ * the slab linearly rather than pointer-chasing from each node.
+ *
+ * The layout is invalidated any time a node or link is created, and will be
+ * rebuilt on the next call to nocsim_step().
+ * */
+
+/* row-major ordering of nodes, ties are broken by creation order so that
+ * PEs and routers sharing a row and column stay adjacent */
+static int nocsim_layout_cmp(const void* a, const void* b) {
+	const nocsim_node* na = *((nocsim_node* const*) a);
+	const nocsim_node* nb = *((nocsim_node* const*) b);
+
+	if (na->row != nb->row) { return (na->row < nb->row) ? -1 : 1; }
+	if (na->col != nb->col) { return (na->col < nb->col) ? -1 : 1; }
+	if (na->node_number != nb->node_number) {
+		return (na->node_number < nb->node_number) ? -1 : 1;
+	}
+	return 0;
+}
+
+/**
+ * @brief Test if a link lives inside the contiguous link slab.
+ *
+ * Links created after the most recent layout build are allocated
+ * individually, and must be free()-ed individually.
+ *
+ * @param state
+ * @param link
+ *
+ * @return 1 if the link is part of the slab, 0 otherwise
+ */
+unsigned char nocsim_link_in_slab(nocsim_state* state, nocsim_link* link) {
+	if (state->link_slab == NULL) { return 0; }
+
+	return (link >= state->link_slab) &&
+		(link < state->link_slab + state->link_slab_len);
+}
+
+/**
+ * @brief Discard the layout, for example because the topology has changed.
+ *
+ * The link slab is left alone, as the existing links still live in it.
+ *
+ * @param state
+ */
+void nocsim_layout_invalidate(nocsim_state* state) {
+	nocsim_layout* layout = state->layout;
+
+	if (layout == NULL) { return; }
+
+	free(layout->order);
+	free(layout->type);
+	free(layout->pending);
+	free(layout->slots);
+	free(layout);
+
+	state->layout = NULL;
+}
+
+/**
+ * @brief Build the compacted layout for the current topology.
+ *
+ * All existing links are relocated into a new contiguous slab, and every
+ * pointer to them (in nodes and in state->links) is updated accordingly.
+ *
+ * @param state
+ */
+void nocsim_layout_build(nocsim_state* state) {
+	nocsim_layout* layout;
+	nocsim_link* slab;
+	nocsim_link* old;
+	nocsim_node* cursor;
+	unsigned int num_node;
+	unsigned int num_link;
+	unsigned int i;
+	unsigned int next;
+	nocsim_direction dir;
+	nocsim_direction from_dir;
+
+	nocsim_layout_invalidate(state);
+
+	num_node = state->nodes->length;
+	num_link = state->links->length;
+
+	alloc(sizeof(nocsim_layout), layout);
+	alloc(sizeof(nocsim_node*) * (num_node + 1), layout->order);
+	alloc(sizeof(nocsim_node_type) * (num_node + 1), layout->type);
+	alloc(sizeof(flitlist*) * (num_node + 1), layout->pending);
+	alloc(sizeof(unsigned int) * (num_node + 1) * NOCSIM_NUM_LINKS, layout->slots);
+	alloc(sizeof(nocsim_link) * (num_link + 1), slab);
+
+	layout->num_node = num_node;
+	layout->num_link = num_link;
+
+	if (num_node > 0) {
+		memcpy(layout->order, state->nodes->data, sizeof(nocsim_node*) * num_node);
+		qsort(layout->order, num_node, sizeof(nocsim_node*), nocsim_layout_cmp);
+	}
+
+	/* copy links into the slab, grouped by destination in layout order,
+	 * and re-point both endpoints at the new copy */
+	next = 0;
+	for (i = 0 ; i < num_node ; i++) {
+		cursor = layout->order[i];
+		layout->type[i] = cursor->type;
+		layout->pending[i] = cursor->pending;
+
+		for (dir = N ; dir <= P ; dir++) {
+			layout->slots[i * NOCSIM_NUM_LINKS + dir] = NOCSIM_LAYOUT_NO_LINK;
+
+			if (cursor->incoming[dir] == NULL) { continue; }
+
+			old = cursor->incoming[dir];
+
+			for (from_dir = N ; from_dir <= P ; from_dir++) {
+				if (old->from->outgoing[from_dir] == old) { break; }
+			}
+
+			if (from_dir > P) {
+				err(1, "invalid state: link from %s to %s is not attached to it's origin",
+					old->from->id, old->to->id);
+			}
+
+			slab[next] = *old;
+			cursor->incoming[dir] = &(slab[next]);
+			old->from->outgoing[from_dir] = &(slab[next]);
+			layout->slots[i * NOCSIM_NUM_LINKS + dir] = next;
+			next++;
+		}
+	}
+
+	if (next != num_link) {
+		err(1, "invalid state: %u links are attached to nodes, but %u links exist",
+			next, num_link);
+	}
+
+	/* release the old copies, which were either allocated one at a time,
+	 * or live in the previous slab */
+	for (i = 0 ; i < num_link ; i++) {
+		old = state->links->data[i];
+		if (!nocsim_link_in_slab(state, old)) {
+			free(old);
+		}
+		state->links->data[i] = &(slab[i]);
+	}
+
+	free(state->link_slab);
+	state->link_slab = slab;
+	state->link_slab_len = num_link;
+	state->layout = layout;
+}
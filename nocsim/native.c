@@ -0,0 +1,431 @@
+#include "nocsim.h"
+
+/* This file contains native behaviors, which are implemented in C rather
+ * than TCL. A node uses a native behavior if it's behavior string is the name
+ * of one of them, for example "native:DOR".
+ * */
+
+/* 1 if the router may route a flit to dir this tick */
+static inline unsigned char nocsim_native_avail(nocsim_node* router, nocsim_direction dir) {
+	return (dir < DIR_UNDEF) &&
+		(router->outgoing[dir] != NULL) &&
+		(router->outgoing[dir]->flit_next == NULL) &&
+		!router->outgoing[dir]->failed;
+}
+
+/* choose where a flit incoming from the direction from should go, given it's
+ * candidate directions -- if no candidate is available, the flit is
+ * deflected to any free link, and failing that it is backrouted (if it came
+ * from the PE) or buffered */
+static inline nocsim_direction nocsim_native_select(nocsim_node* router, nocsim_hop hop, nocsim_direction from) {
+	if (nocsim_native_avail(router, NOCSIM_HOP_FIRST(hop))) { return NOCSIM_HOP_FIRST(hop); }
+	if (nocsim_native_avail(router, NOCSIM_HOP_SECOND(hop))) { return NOCSIM_HOP_SECOND(hop); }
+
+	for (nocsim_direction dir = N ; dir <= W ; dir++) {
+		if (nocsim_native_avail(router, dir)) { return dir; }
+	}
+
+	if (from == P && nocsim_native_avail(router, P)) { return P; }
+
+	return BACKLOG;
+}
+
+/* route flits out of the router's backlog, which have waited the longest,
+ * but only along a productive link */
+static void nocsim_native_drain(nocsim_state* state, nocsim_node* router, nocsim_route_table* table) {
+	nocsim_flit* flit;
+	nocsim_hop hop;
+	nocsim_direction to;
+
+	while (router->pending->length > 0) {
+		flit = vec_first(router->pending);
+		hop = nocsim_routing_lookup(state, table, router, BACKLOG, flit->to);
+
+		if (nocsim_native_avail(router, NOCSIM_HOP_FIRST(hop))) {
+			to = NOCSIM_HOP_FIRST(hop);
+		} else if (nocsim_native_avail(router, NOCSIM_HOP_SECOND(hop))) {
+			to = NOCSIM_HOP_SECOND(hop);
+		} else {
+			break;
+		}
+
+		nocsim_route(state, router, BACKLOG, to);
+	}
+}
+
+/* route the incoming flit from the direction from to it's most preferred
+ * available link */
+static inline void nocsim_native_route_one(nocsim_state* state, nocsim_node* router, nocsim_route_table* table, nocsim_direction from) {
+	nocsim_flit* flit = router->incoming[from]->flit;
+	nocsim_hop hop = nocsim_routing_lookup(state, table, router, from, flit->to);
+
+	nocsim_route(state, router, from, nocsim_native_select(router, hop, from));
+}
+
+/* route every flit in the router's backlog and incoming links according to
+ * the given table, incoming flits in the order decided by arbitration */
+static void nocsim_native_route_table(nocsim_state* state, nocsim_node* router, nocsim_route_table* table) {
+	nocsim_direction from;
+
+	nocsim_native_drain(state, router, table);
+
+	for (unsigned int i = 0 ; i < router->num_arbitrated ; i++) {
+		from = router->arbitrated[i];
+		if (router->incoming[from]->flit == NULL) { continue; }
+
+		nocsim_native_route_one(state, router, table, from);
+	}
+}
+
+void nocsim_behavior_DOR(nocsim_state* state, nocsim_node* node) {
+	nocsim_native_route_table(state, node, nocsim_routing_table(state, ALGORITHM_DOR));
+}
+
+void nocsim_behavior_ADOR(nocsim_state* state, nocsim_node* node) {
+	nocsim_native_route_table(state, node, nocsim_routing_table(state, ALGORITHM_ADOR));
+}
+
+void nocsim_behavior_table(nocsim_state* state, nocsim_node* node) {
+	nocsim_native_route_table(state, node, nocsim_routing_table(state, ALGORITHM_TABLE));
+}
+
+void nocsim_behavior_updown(nocsim_state* state, nocsim_node* node) {
+	nocsim_native_route_table(state, node, nocsim_routing_table(state, ALGORITHM_UPDOWN));
+}
+
+void nocsim_behavior_escape(nocsim_state* state, nocsim_node* node) {
+	nocsim_native_route_table(state, node, nocsim_routing_table(state, ALGORITHM_ESCAPE));
+}
+
+/*** bufferless deflection routers *******************************************/
+
+/* BLESS and CHIPPER route every flit which arrives at a router out of it the
+ * same tick, deflecting flits which lose the competition for a productive
+ * link. A flit from the PE is only injected if a link is left over, and is
+ * otherwise backrouted to the PE to try again later. Both use the ADOR
+ * table, so either productive direction may be taken.
+ *
+ * In a mesh, a router has as many outgoing links as incoming, so the backlog
+ * is never used. On other topologies, flits which find no free link are
+ * buffered as by the other native routers. */
+
+/* BLESS, flits are routed oldest first, so the oldest flit in the network
+ * always moves closer to it's destination, which guarantees livelock
+ * freedom. The arbitration policy is not used, since BLESS is defined by
+ * it's own. */
+void nocsim_behavior_BLESS(nocsim_state* state, nocsim_node* router) {
+	nocsim_route_table* table = nocsim_routing_table(state, ALGORITHM_ADOR);
+	nocsim_direction order[NOCSIM_NUM_LINKS];
+	nocsim_direction dir;
+	unsigned int count = 0;
+	unsigned int i;
+
+	nocsim_native_drain(state, router, table);
+
+	/* insertion sort, there are at most 4 flits from other routers, and
+	 * the flit from the PE goes last */
+	for (dir = N ; dir <= W ; dir++) {
+		if (router->incoming[dir] == NULL || router->incoming[dir]->flit == NULL) { continue; }
+
+		for (i = count ; i > 0 && nocsim_flit_older(
+					router->incoming[dir]->flit,
+					router->incoming[order[i - 1]]->flit) ; i--) {
+			order[i] = order[i - 1];
+		}
+		order[i] = dir;
+		count++;
+	}
+
+	if (router->incoming[P] != NULL && router->incoming[P]->flit != NULL) {
+		order[count++] = P;
+	}
+
+	for (i = 0 ; i < count ; i++) {
+		nocsim_native_route_one(state, router, table, order[i]);
+	}
+}
+
+/* CHIPPER chooses one source PE at a time whose flits are golden, and
+ * rotates through every PE. Each PE is golden for long enough that it's
+ * flits can cross the network several times. */
+static inline unsigned char nocsim_native_golden(nocsim_state* state, nocsim_flit* flit) {
+	unsigned long epoch = 4 * ((unsigned long) state->max_row + state->max_col + 2);
+
+	return flit->from->type_number == (state->tick / epoch) % state->num_PE;
+}
+
+/* set of directions containing only dir, or no directions if dir is not one
+ * of N, S, E, or W */
+#define nocsim_native_mask(dir) ((dir) <= W ? 1u << (dir) : 0u)
+
+/* 1 if a flit with the given candidates would rather leave a 2x2 arbiter
+ * block by it's second output, which leads to the directions in mask1, than
+ * by it's first, which leads to those in mask0 */
+static inline unsigned char nocsim_native_prefers(nocsim_hop hop, unsigned int mask0, unsigned int mask1) {
+	unsigned int first = nocsim_native_mask(NOCSIM_HOP_FIRST(hop));
+	unsigned int second = nocsim_native_mask(NOCSIM_HOP_SECOND(hop));
+
+	return (first & mask1) || (!(first & mask0) && (second & mask1));
+}
+
+/* a 2x2 arbiter block of the CHIPPER permutation network, *a and *b are the
+ * flits on it's inputs, as indices into flits and hops, or -1 if empty, and
+ * are replaced by the flits on it's first and second output respectively. The
+ * golden flit, or otherwise the flit on the first input, chooses it's output,
+ * and the other flit takes whichever is left. */
+static inline void nocsim_native_block(nocsim_state* state, nocsim_flit** flits, nocsim_hop* hops, int* a, int* b, unsigned int mask0, unsigned int mask1) {
+	int winner = *a;
+	int loser = *b;
+
+	if (winner < 0 || (loser >= 0 &&
+			!nocsim_native_golden(state, flits[winner]) &&
+			nocsim_native_golden(state, flits[loser]))) {
+		winner = *b;
+		loser = *a;
+	}
+
+	if (winner >= 0 && nocsim_native_prefers(hops[winner], mask0, mask1)) {
+		*a = loser;
+		*b = winner;
+	} else {
+		*a = winner;
+		*b = loser;
+	}
+}
+
+/* CHIPPER, one flit destined for the PE is ejected, golden flits first, and
+ * the rest pass through a two stage permutation network of 2x2 arbiter
+ * blocks, which decides every output in a fixed number of steps rather than
+ * sorting. A golden flit always wins it's blocks, so it always moves closer
+ * to it's destination, which guarantees livelock freedom. */
+void nocsim_behavior_CHIPPER(nocsim_state* state, nocsim_node* router) {
+	/* inputs and outputs of the permutation network, in order */
+	static const nocsim_direction ports[] = {N, E, S, W};
+	nocsim_route_table* table = nocsim_routing_table(state, ALGORITHM_ADOR);
+	nocsim_flit* flits[4];
+	nocsim_hop hops[4];
+	nocsim_direction from[4];
+	int slots[4];
+	int eject = -1;
+	unsigned int count = 0;
+	unsigned int outputs = 0;
+	unsigned int i;
+
+	nocsim_native_drain(state, router, table);
+
+	for (i = 0 ; i < 4 ; i++) {
+		slots[i] = -1;
+		from[i] = ports[i];
+		if (nocsim_native_avail(router, ports[i])) { outputs++; }
+		if (router->incoming[ports[i]] == NULL || (flits[i] = router->incoming[ports[i]]->flit) == NULL) { continue; }
+
+		hops[i] = nocsim_routing_lookup(state, table, router, ports[i], flits[i]->to);
+		slots[i] = (int) i;
+		count++;
+
+		if (NOCSIM_HOP_FIRST(hops[i]) == P && (eject < 0 ||
+				(!nocsim_native_golden(state, flits[eject]) &&
+				 nocsim_native_golden(state, flits[i])))) {
+			eject = (int) i;
+		}
+	}
+
+	if (eject >= 0 && nocsim_native_avail(router, P)) {
+		nocsim_route(state, router, from[eject], P);
+		slots[eject] = -1;
+		count--;
+	}
+
+	/* inject into the first empty slot, if there will be a link for it */
+	if (router->incoming[P] != NULL && router->incoming[P]->flit != NULL) {
+		if (count < outputs) {
+			for (i = 0 ; slots[i] >= 0 ; i++) { }
+			flits[i] = router->incoming[P]->flit;
+			hops[i] = nocsim_routing_lookup(state, table, router, P, flits[i]->to);
+			from[i] = P;
+			slots[i] = (int) i;
+		} else {
+			nocsim_route(state, router, P, nocsim_native_avail(router, P) ? P : BACKLOG);
+		}
+	}
+
+	/* first stage, pairs of inputs choose between the N/S and E/W halves
+	 * of the second stage, which then choose the output */
+	nocsim_native_block(state, flits, hops, &slots[0], &slots[1],
+		nocsim_native_mask(N) | nocsim_native_mask(S),
+		nocsim_native_mask(E) | nocsim_native_mask(W));
+	nocsim_native_block(state, flits, hops, &slots[2], &slots[3],
+		nocsim_native_mask(N) | nocsim_native_mask(S),
+		nocsim_native_mask(E) | nocsim_native_mask(W));
+	nocsim_native_block(state, flits, hops, &slots[0], &slots[2],
+		nocsim_native_mask(N), nocsim_native_mask(S));
+	nocsim_native_block(state, flits, hops, &slots[1], &slots[3],
+		nocsim_native_mask(E), nocsim_native_mask(W));
+
+	/* slots now hold the flit assigned to each port, a flit assigned to a
+	 * port which does not exist (at the edge of a mesh) takes any left
+	 * over */
+	for (i = 0 ; i < 4 ; i++) {
+		if (slots[i] < 0 || !nocsim_native_avail(router, ports[i])) { continue; }
+		nocsim_route(state, router, from[slots[i]], ports[i]);
+		slots[i] = -1;
+	}
+
+	for (i = 0 ; i < 4 ; i++) {
+		if (slots[i] < 0) { continue; }
+		nocsim_route(state, router, from[slots[i]], nocsim_native_select(router, hops[slots[i]], from[slots[i]]));
+	}
+}
+
+/* inject with probability P_inject to a uniformly random PE */
+void nocsim_behavior_uniform(nocsim_state* state, nocsim_node* node) {
+	nocsim_routing* routing;
+	nocsim_node* to;
+
+	if (node->P_inject <= 0 || state->num_PE < 2) { return; }
+	if (!with_P(node->P_inject)) { return; }
+
+	routing = nocsim_routing_get(state);
+	do {
+		to = routing->PEs[randrange(0, state->num_PE) % state->num_PE];
+	} while (to == node);
+
+	nocsim_spawn(state, node, to);
+}
+
+static const nocsim_native nocsim_natives[] = {
+	{"native:DOR", node_router, nocsim_behavior_DOR},
+	{"native:ADOR", node_router, nocsim_behavior_ADOR},
+	{"native:table", node_router, nocsim_behavior_table},
+	{"native:updown", node_router, nocsim_behavior_updown},
+	{"native:escape", node_router, nocsim_behavior_escape},
+	{"native:BLESS", node_router, nocsim_behavior_BLESS},
+	{"native:CHIPPER", node_router, nocsim_behavior_CHIPPER},
+	{"native:uniform", node_PE, nocsim_behavior_uniform},
+	{NULL, type_undefined, NULL},
+};
+
+/**
+ * @brief Look up a native behavior by name.
+ *
+ * @param behavior
+ *
+ * @return the native behavior, or NULL if behavior does not name one
+ */
+const nocsim_native* nocsim_native_by_name(const char* behavior) {
+	for (int i = 0 ; nocsim_natives[i].name != NULL ; i++) {
+		if (!strncasecmp(behavior, nocsim_natives[i].name, NOCSIM_GRID_LINELEN)) {
+			return &(nocsim_natives[i]);
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief Retrieve the algorithm whose routing table a native behavior uses.
+ *
+ * @param behavior
+ *
+ * @return the algorithm, or ENUMSIZE_ALGORITHM if the behavior does not use
+ * a routing table
+ */
+nocsim_algorithm nocsim_native_algorithm(nocsim_behavior behavior) {
+	if (behavior == nocsim_behavior_DOR)     { return ALGORITHM_DOR; }
+	if (behavior == nocsim_behavior_ADOR)    { return ALGORITHM_ADOR; }
+	if (behavior == nocsim_behavior_table)   { return ALGORITHM_TABLE; }
+	if (behavior == nocsim_behavior_updown)  { return ALGORITHM_UPDOWN; }
+	if (behavior == nocsim_behavior_escape)  { return ALGORITHM_ESCAPE; }
+	if (behavior == nocsim_behavior_BLESS)   { return ALGORITHM_ADOR; }
+	if (behavior == nocsim_behavior_CHIPPER) { return ALGORITHM_ADOR; }
+	return ENUMSIZE_ALGORITHM;
+}
+
+/**
+ * @brief Resolve the native behavior, if any, named by a behavior string.
+ *
+ * @param state
+ * @param type type of node the behavior will be used for
+ * @param behavior
+ * @param native will be set to the native behavior, or to NULL if behavior
+ * is not native (i.e. it is TCL code)
+ *
+ * @return
+ */
+nocsim_result nocsim_resolve_behavior(nocsim_state* state, nocsim_node_type type, char* behavior, nocsim_behavior* native) {
+	const nocsim_native* found;
+
+	*native = NULL;
+
+	if (strncasecmp(behavior, NOCSIM_NATIVE_PREFIX, strlen(NOCSIM_NATIVE_PREFIX))) {
+		if (state->interp == NULL) {
+			nocsim_return_error(state,
+				"behavior '%s' is not native, and there is no TCL interpreter to evaluate it",
+				behavior);
+		}
+		return NOCSIM_RESULT_OK;
+	}
+
+	found = nocsim_native_by_name(behavior);
+
+	if (found == NULL) {
+		nocsim_return_error(state, "unknown native behavior '%s'", behavior);
+	}
+
+	if (found->type != type) {
+		nocsim_return_error(state, "native behavior '%s' may not be used for %s nodes",
+			behavior, NOCSIM_NODE_TYPE_TO_STR(type));
+	}
+
+	*native = found->fn;
+
+	return NOCSIM_RESULT_OK;
+}
+
+/**
+ * @brief Change the behavior of an existing node.
+ *
+ * @param state
+ * @param node
+ * @param behavior
+ *
+ * @return
+ */
+nocsim_result nocsim_bind_behavior(nocsim_state* state, nocsim_node* node, char* behavior) {
+	nocsim_behavior native;
+
+	if (nocsim_resolve_behavior(state, node->type, behavior, &native) != NOCSIM_RESULT_OK) {
+		return NOCSIM_RESULT_ERROR;
+	}
+
+	node->behavior = behavior;
+	node->native = native;
+#ifdef NOCSIM_PROFILE
+	node->profile = NULL;
+#endif
+
+	return NOCSIM_RESULT_OK;
+}
+
+/**
+ * @brief Set the injection rate used by native:uniform.
+ *
+ * @param state
+ * @param node PE to set the rate for, or NULL to set the rate for every PE,
+ * including any created later
+ * @param P_inject
+ */
+void nocsim_set_injectrate(nocsim_state* state, nocsim_node* node, float P_inject) {
+	nocsim_node* cursor;
+	unsigned int i;
+
+	if (node != NULL) {
+		node->P_inject = P_inject;
+		return;
+	}
+
+	state->default_P_inject = P_inject;
+	vec_foreach(state->nodes, cursor, i) {
+		if (cursor->type == node_PE) { cursor->P_inject = P_inject; }
+	}
+}
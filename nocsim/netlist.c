@@ -0,0 +1,354 @@
+#include "nocsim.h"
+
+#include <sys/stat.h>
+
+/* This file contains methods relating to netlists, which are a compact
+ * description of a topology that can be loaded much faster than the
+ * equivalent script, see doc/nocsim.md.
+ *
+ * A netlist consists of a header, which gives the number of nodes, links, and
+ * distinct behaviors in the file, so that everything can be allocated up
+ * front, followed by the behaviors, nodes, and links, in that order. Nodes
+ * and behaviors are referred to by their position in the file, starting from
+ * 0, and directions are numbered as by dir2int.
+ *
+ *	nocsim-netlist 1 NODES LINKS BEHAVIORS
+ *	b LENGTH
+ *	BEHAVIOR
+ *	n r|p ROW COL BEHAVIOR ID
+ *	l FROM TO FROM_DIR TO_DIR
+ *
+ * Behaviors are written as LENGTH bytes following their b line, so that they
+ * may contain any character. The node ID is the rest of its line.
+ * */
+
+#define NOCSIM_NETLIST_MAGIC "nocsim-netlist"
+#define NOCSIM_NETLIST_VERSION 1
+
+/* The shortest possible record of each kind, in bytes, such as "l0 0 0 0".
+ * The counts in the header are checked against the size of the file before
+ * anything is allocated for them, so that a corrupt header cannot ask for
+ * more memory than the file could possibly describe. */
+#define NOCSIM_NETLIST_MIN_NODE 10
+#define NOCSIM_NETLIST_MIN_LINK 8
+#define NOCSIM_NETLIST_MIN_BEHAVIOR 4
+
+/* the size assumed for files whose size is not known, such as pipes */
+#define NOCSIM_NETLIST_MAX_SIZE (1UL << 28)
+
+KHASH_MAP_INIT_STR(netlist_behavior, unsigned int)
+
+/* fail while loading, prefixing the error with the location in the file --
+ * the arguments may point into line, so the error is formatted first */
+#define netlist_error(fmt, ...) do { \
+		char* __ne_buf = alloc_printf("%s:%u: " fmt, path, lineno, __VA_ARGS__); \
+		fclose(stream); \
+		free(line); \
+		free(nodes); \
+		for (unsigned long __ne_i = 0 ; __ne_i < num_behavior ; __ne_i++) { \
+			if (!used[__ne_i]) { free(behaviors[__ne_i]); } \
+		} \
+		free(behaviors); \
+		free(used); \
+		free(state->errstr); \
+		state->errstr = __ne_buf; \
+		return NOCSIM_RESULT_ERROR; \
+	} while (0)
+
+/* parse the next unsigned integer from *s, advancing *s past it */
+static int nocsim_netlist_uint(char** s, unsigned long* value) {
+	char* end;
+
+	*s += strspn(*s, " \t");
+	if (**s < '0' || **s > '9') { return 0; }
+
+	errno = 0;
+	*value = strtoul(*s, &end, 10);
+	if (errno != 0 || *value > UINT_MAX || (*end != ' ' && *end != '\t' && *end != '\0')) {
+		return 0;
+	}
+
+	*s = end;
+	return 1;
+}
+
+/**
+ * @brief Read a netlist, adding the nodes and links it describes to the
+ * topology.
+ *
+ * The nodes in the netlist must not have the same ID as any existing node. If
+ * an error occurs, nodes and links read before it are not removed.
+ *
+ * @param state
+ * @param path
+ *
+ * @return
+ */
+nocsim_result nocsim_netlist_load(nocsim_state* state, const char* path) {
+	FILE* stream;
+	char* line = NULL;
+	size_t linecap = 0;
+	char* cursor;
+	unsigned int lineno = 1;
+	unsigned long header[3];
+	unsigned long fields[4];
+	unsigned long version;
+	unsigned long num_node = 0;
+	unsigned long num_link = 0;
+	unsigned long num_behavior = 0;
+	unsigned long long size;
+	struct stat st;
+	nocsim_node** nodes = NULL;
+	char** behaviors = NULL;
+	unsigned char* used = NULL;
+	nocsim_node_type type;
+	nocsim_result result;
+	char* id;
+
+	if ((stream = fopen(path, "r")) == NULL) {
+		nocsim_return_error(state, "could not open netlist '%s': %s", path, strerror(errno));
+	}
+
+	if (getline(&line, &linecap, stream) == -1 ||
+			strncmp(line, NOCSIM_NETLIST_MAGIC " ", strlen(NOCSIM_NETLIST_MAGIC " "))) {
+		netlist_error("%s", "not a nocsim netlist");
+	}
+
+	cursor = line + strlen(NOCSIM_NETLIST_MAGIC);
+	line[strcspn(line, "\r\n")] = '\0';
+	if (!nocsim_netlist_uint(&cursor, &version) || version != NOCSIM_NETLIST_VERSION) {
+		netlist_error("unsupported netlist version, expected %d", NOCSIM_NETLIST_VERSION);
+	}
+
+	for (int i = 0 ; i < 3 ; i++) {
+		if (!nocsim_netlist_uint(&cursor, &(header[i]))) {
+			netlist_error("%s", "usage: " NOCSIM_NETLIST_MAGIC " VERSION NODES LINKS BEHAVIORS");
+		}
+	}
+
+	size = NOCSIM_NETLIST_MAX_SIZE;
+	if (fstat(fileno(stream), &st) == 0 && S_ISREG(st.st_mode)) {
+		size = (unsigned long long) st.st_size;
+	}
+	if ((unsigned long long) header[0] * NOCSIM_NETLIST_MIN_NODE +
+			(unsigned long long) header[1] * NOCSIM_NETLIST_MIN_LINK +
+			(unsigned long long) header[2] * NOCSIM_NETLIST_MIN_BEHAVIOR > size) {
+		netlist_error("header gives %lu nodes, %lu links, and %lu behaviors, "
+			"which cannot fit in %llu bytes", header[0], header[1], header[2], size);
+	}
+
+	alloc(sizeof(nocsim_node*) * (header[0] + 1), nodes);
+	alloc(sizeof(char*) * (header[2] + 1), behaviors);
+	alloc(sizeof(unsigned char) * (header[2] + 1), used);
+	if (nocsim_grid_reserve(state, header[0], header[1]) != NOCSIM_RESULT_OK) {
+		netlist_error("%s", state->errstr);
+	}
+
+	while (getline(&line, &linecap, stream) != -1) {
+		lineno++;
+		line[strcspn(line, "\r\n")] = '\0';
+		cursor = line + 1;
+
+		switch (line[0]) {
+		case 'b':
+			if (num_behavior == header[2]) {
+				netlist_error("more than the %lu behaviors given by the header", header[2]);
+			}
+			if (!nocsim_netlist_uint(&cursor, &(fields[0])) || *cursor != '\0') {
+				netlist_error("%s", "usage: b LENGTH");
+			}
+			if (fields[0] > size) {
+				netlist_error("behavior of %lu bytes cannot fit in %llu bytes", fields[0], size);
+			}
+
+			alloc(fields[0] + 1, behaviors[num_behavior]);
+			used[num_behavior] = 0;
+			num_behavior++;
+			if (fread(behaviors[num_behavior - 1], 1, fields[0], stream) != fields[0] ||
+					fgetc(stream) != '\n') {
+				netlist_error("%s", "behavior is shorter than its length");
+			}
+			behaviors[num_behavior - 1][fields[0]] = '\0';
+
+			/* keep line numbers in step with the file */
+			for (char* c = behaviors[num_behavior - 1] ; (c = strchr(c, '\n')) != NULL ; c++) {
+				lineno++;
+			}
+			lineno++;
+			break;
+
+		case 'n':
+			if (num_node == header[0]) {
+				netlist_error("more than the %lu nodes given by the header", header[0]);
+			}
+
+			cursor += strspn(cursor, " \t");
+			if ((*cursor != 'r' && *cursor != 'p') || (cursor[1] != ' ' && cursor[1] != '\t')) {
+				netlist_error("%s", "usage: n r|p ROW COL BEHAVIOR ID");
+			}
+			type = (*cursor == 'r') ? node_router : node_PE;
+			cursor++;
+
+			for (int i = 0 ; i < 3 ; i++) {
+				if (!nocsim_netlist_uint(&cursor, &(fields[i]))) {
+					netlist_error("%s", "usage: n r|p ROW COL BEHAVIOR ID");
+				}
+			}
+			cursor += strspn(cursor, " \t");
+
+			if (fields[2] >= num_behavior) {
+				netlist_error("no behavior %lu", fields[2]);
+			}
+			if (*cursor == '\0') {
+				netlist_error("%s", "node has no ID");
+			}
+			if (nocsim_node_by_id(state, cursor) != NULL) {
+				netlist_error("a node with the ID %s exists already", cursor);
+			}
+
+			/* node IDs are owned by the nodes, and behaviors are shared
+			 * between them */
+			id = strdup(cursor);
+			result = (type == node_router) ?
+				nocsim_grid_create_router(state, id, fields[0], fields[1], behaviors[fields[2]]) :
+				nocsim_grid_create_PE(state, id, fields[0], fields[1], behaviors[fields[2]]);
+			if (result != NOCSIM_RESULT_OK) {
+				free(id);
+				netlist_error("%s", state->errstr);
+			}
+
+			used[fields[2]] = 1;
+			nodes[num_node++] = vec_last(state->nodes);
+			break;
+
+		case 'l':
+			if (num_link == header[1]) {
+				netlist_error("more than the %lu links given by the header", header[1]);
+			}
+
+			for (int i = 0 ; i < 4 ; i++) {
+				if (!nocsim_netlist_uint(&cursor, &(fields[i]))) {
+					netlist_error("%s", "usage: l FROM TO FROM_DIR TO_DIR");
+				}
+			}
+			if (*cursor != '\0') {
+				netlist_error("%s", "usage: l FROM TO FROM_DIR TO_DIR");
+			}
+
+			if (fields[0] >= num_node || fields[1] >= num_node) {
+				netlist_error("no node %lu", fields[0] >= num_node ? fields[0] : fields[1]);
+			}
+			if (fields[2] > P || fields[3] > P) {
+				netlist_error("invalid direction %lu", fields[2] > P ? fields[2] : fields[3]);
+			}
+
+			if (nocsim_grid_connect(state, nodes[fields[0]], nodes[fields[1]],
+						(nocsim_direction) fields[2], (nocsim_direction) fields[3])
+					!= NOCSIM_RESULT_OK) {
+				netlist_error("%s", state->errstr);
+			}
+			num_link++;
+			break;
+
+		case '\0':
+			break;
+
+		default:
+			netlist_error("unknown record '%c'", line[0]);
+		}
+	}
+
+	if (num_node != header[0] || num_link != header[1] || num_behavior != header[2]) {
+		netlist_error("expected %lu nodes, %lu links, and %lu behaviors, but found %lu, %lu, and %lu",
+			header[0], header[1], header[2], num_node, num_link, num_behavior);
+	}
+
+	fclose(stream);
+	free(line);
+	free(nodes);
+	for (unsigned long i = 0 ; i < num_behavior ; i++) {
+		if (!used[i]) { free(behaviors[i]); }
+	}
+	free(behaviors);
+	free(used);
+
+	return NOCSIM_RESULT_OK;
+}
+
+#undef netlist_error
+
+/**
+ * @brief Write the topology as a netlist which can be read by
+ * nocsim_netlist_load().
+ *
+ * @param state
+ * @param path
+ *
+ * @return
+ */
+nocsim_result nocsim_netlist_save(nocsim_state* state, const char* path) {
+	khash_t(netlist_behavior)* index;
+	khint_t k;
+	FILE* stream;
+	char** behaviors;
+	nocsim_node* node;
+	nocsim_link* link;
+	nocsim_direction from_dir;
+	nocsim_direction to_dir;
+	unsigned int i;
+	unsigned int num_behavior = 0;
+	int status;
+
+	vec_foreach(state->nodes, node, i) {
+		if (node->id[0] == '\0' || node->id[strcspn(node->id, "\r\n")] != '\0' ||
+				node->id[0] == ' ' || node->id[0] == '\t') {
+			nocsim_return_error(state, "node ID '%s' cannot be written to a netlist", node->id);
+		}
+	}
+
+	if ((stream = fopen(path, "w")) == NULL) {
+		nocsim_return_error(state, "could not open netlist '%s': %s", path, strerror(errno));
+	}
+
+	/* number the distinct behaviors in the order they are first used */
+	index = kh_init(netlist_behavior);
+	alloc(sizeof(char*) * (state->nodes->length + 1), behaviors);
+	vec_foreach(state->nodes, node, i) {
+		k = kh_put(netlist_behavior, index, node->behavior, &status);
+		if (status == -1) { err(1, "could not allocate memory"); }
+		if (status != 0) {
+			kh_value(index, k) = num_behavior;
+			behaviors[num_behavior++] = node->behavior;
+		}
+	}
+
+	fprintf(stream, "%s %d %u %u %u\n", NOCSIM_NETLIST_MAGIC, NOCSIM_NETLIST_VERSION,
+		state->nodes->length, state->links->length, num_behavior);
+
+	for (unsigned int b = 0 ; b < num_behavior ; b++) {
+		fprintf(stream, "b %zu\n%s\n", strlen(behaviors[b]), behaviors[b]);
+	}
+	free(behaviors);
+
+	vec_foreach(state->nodes, node, i) {
+		k = kh_get(netlist_behavior, index, node->behavior);
+		fprintf(stream, "n %c %u %u %u %s\n",
+			node->type == node_router ? 'r' : 'p',
+			node->row, node->col, kh_value(index, k), node->id);
+	}
+
+	kh_destroy(netlist_behavior, index);
+
+	vec_foreach(state->links, link, i) {
+		for (from_dir = N ; link->from->outgoing[from_dir] != link ; from_dir++) {}
+		for (to_dir = N ; link->to->incoming[to_dir] != link ; to_dir++) {}
+		fprintf(stream, "l %u %u %d %d\n",
+			link->from->node_number, link->to->node_number, from_dir, to_dir);
+	}
+
+	if (ferror(stream) | fclose(stream)) {
+		nocsim_return_error(state, "could not write netlist '%s': %s", path, strerror(errno));
+	}
+
+	return NOCSIM_RESULT_OK;
+}
@@ -3,52 +3,8 @@
 /* this is required to ensure the namespace and backing datastore is properly
  * cleaned up when the interpreter exits */
 void nocsim_namespace_delete(ClientData cdata) {
-	nocsim_state* s = cdata;
-	nocsim_link* l;
-	nocsim_node* n;
-	unsigned int i;
-	unsigned int j;
-	nocsim_flit* f;
-
 	dbprintf("deallocating nocsim namespace\n");
-
-	/* destroy all links */
-	vec_foreach(s->links, l, i) {
-		if (l->flit != NULL) {
-			free(l->flit);
-		}
-		free(l);
-	}
-
-	/* destroy all nodes */
-	vec_foreach(s->nodes, n, i) {
-		if (n->type == node_PE || n->type == node_router) {
-			vec_foreach(n->pending, f, j) {
-				free(f);
-			}
-			vec_deinit(n->pending);
-			free(n->pending);
-		}
-		free(n);
-	}
-
-	/* free node map */
-	kh_destroy(nnptr, s->node_map);
-
-	/* free node list */
-	vec_deinit(s->nodes);
-	free(s->nodes);
-
-	/* free link list */
-	vec_deinit(s->links);
-	free(s->links);
-
-	/* free error string */
-	if (s->errstr != NULL) {
-		free(s->errstr);
-	}
-
-	free(s);
+	nocsim_free_state((nocsim_state*) cdata);
 }
 
 int DLLEXPORT
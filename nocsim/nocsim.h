@@ -27,6 +27,10 @@
 #include <sys/time.h>
 #include <tcl.h>
 
+#if defined(NOCSIM_PROFILE) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#endif
+
 /* maximum length of a line in a grid definition */
 #define NOCSIM_GRID_LINELEN 256
 
@@ -96,14 +100,20 @@
 	int __evf_res = Tcl_Eval(interp, __evf_buf); \
 	free(__evf_buf); __evf_res; })
 
+/* write to the console via conswrite / errwrite, or to standard output /
+ * standard error if there is no interpreter (i.e. nocsim-run) */
 #define conswritef(interp, fmt, ...) __extension__ ({ \
 	char* __cw_buf = alloc_printf(fmt, __VA_ARGS__); \
-	int __cw_res = Tcl_Evalf(interp, "conswrite {%s}", __cw_buf); \
+	int __cw_res = TCL_OK; \
+	if ((interp) == NULL) { fprintf(stdout, "%s\n", __cw_buf); } \
+	else { __cw_res = Tcl_Evalf(interp, "conswrite {%s}", __cw_buf); } \
 	free(__cw_buf); __cw_res; })
 
 #define errwritef(interp, fmt, ...) __extension__ ({ \
 	char* __ew_buf = alloc_printf(fmt, __VA_ARGS__); \
-	int __ew_res = Tcl_Evalf(interp, "errwrite {%s}", __ew_buf); \
+	int __ew_res = TCL_OK; \
+	if ((interp) == NULL) { fprintf(stderr, "%s\n", __ew_buf); } \
+	else { __ew_res = Tcl_Evalf(interp, "errwrite {%s}", __ew_buf); } \
 	free(__ew_buf); __ew_res; })
 
 #define nocsim_return_error(__state, fmt, ...) do { \
@@ -132,9 +142,12 @@
 
 int main(int argc, char** argv);
 
-void nocsim_grid_create_router(nocsim_state* state, char* id, unsigned int row, unsigned int col, char* behavior);
-void nocsim_grid_create_PE(nocsim_state* state, char* id, unsigned int row, unsigned int col, char* behavior);
+nocsim_result nocsim_grid_reserve(nocsim_state* state, unsigned int nodes, unsigned int links);
+nocsim_result nocsim_grid_create_router(nocsim_state* state, char* id, unsigned int row, unsigned int col, char* behavior);
+nocsim_result nocsim_grid_create_PE(nocsim_state* state, char* id, unsigned int row, unsigned int col, char* behavior);
 nocsim_result nocsim_grid_create_link(nocsim_state* state, char* from_id, char* to_id, nocsim_direction from_dir, nocsim_direction to_dir);
+nocsim_result nocsim_grid_connect(nocsim_state* state, nocsim_node* from, nocsim_node* to, nocsim_direction from_dir, nocsim_direction to_dir);
+nocsim_result nocsim_grid_create_mesh(nocsim_state* state, unsigned int rows, unsigned int cols, char* inject, char* route);
 
 void nocsim_init_node(nocsim_node* n, nocsim_node_type type, unsigned int row, unsigned int col, char* id);
 char* nocsim_fmt_node(nocsim_node* node);
@@ -152,11 +165,124 @@ nocsim_direction invert_direction(nocsim_direction d);
 void nocsim_console_writelines(AG_Console* console, const char* lines, AG_Color* c);
 #endif
 
-void nocsim_behavior_DOR(nocsim_node* node);
-void nocsim_behavior_ADOR(nocsim_node* node);
-void nocsim_DOR_one(nocsim_node* node, nocsim_flit* flit);
+void nocsim_behavior_DOR(nocsim_state* state, nocsim_node* node);
+void nocsim_behavior_ADOR(nocsim_state* state, nocsim_node* node);
+void nocsim_behavior_table(nocsim_state* state, nocsim_node* node);
+void nocsim_behavior_updown(nocsim_state* state, nocsim_node* node);
+void nocsim_behavior_escape(nocsim_state* state, nocsim_node* node);
+void nocsim_behavior_BLESS(nocsim_state* state, nocsim_node* node);
+void nocsim_behavior_CHIPPER(nocsim_state* state, nocsim_node* node);
+void nocsim_behavior_uniform(nocsim_state* state, nocsim_node* node);
+const nocsim_native* nocsim_native_by_name(const char* behavior);
+nocsim_algorithm nocsim_native_algorithm(nocsim_behavior behavior);
+nocsim_result nocsim_resolve_behavior(nocsim_state* state, nocsim_node_type type, char* behavior, nocsim_behavior* native);
+nocsim_result nocsim_bind_behavior(nocsim_state* state, nocsim_node* node, char* behavior);
+void nocsim_set_injectrate(nocsim_state* state, nocsim_node* node, float P_inject);
+
+nocsim_routing* nocsim_routing_get(nocsim_state* state);
+nocsim_route_table* nocsim_routing_table(nocsim_state* state, nocsim_algorithm algorithm);
+nocsim_hop nocsim_routing_lookup(nocsim_state* state, nocsim_route_table* table, nocsim_node* router, nocsim_direction from, nocsim_node* dest);
+void nocsim_routing_invalidate(nocsim_state* state);
+unsigned long nocsim_routing_distance(nocsim_state* state, nocsim_node* from, nocsim_node* to);
+void nocsim_routing_fault(nocsim_state* state, nocsim_link* link);
+nocsim_result nocsim_finalize(nocsim_state* state);
+
+nocsim_instrument_filter* nocsim_instrument_filter_create(unsigned int seed);
+void nocsim_instrument_filter_free(nocsim_instrument_filter* filter);
+void nocsim_instrument_filter_flits(nocsim_instrument_filter* filter, unsigned long* flits, unsigned int num_flits);
+void nocsim_instrument_set_filter(nocsim_state* state, nocsim_instrument instrument, nocsim_instrument_filter* filter);
+unsigned char nocsim_instrument_sample(nocsim_state* state, nocsim_instrument_filter* filter, nocsim_flit* flit);
+
+/* 1 if the instrument is registered, and should be called for an event
+ * concerning flit (which may be NULL) */
+static inline unsigned char nocsim_instrument_enabled(nocsim_state* state, nocsim_instrument instrument, nocsim_flit* flit) {
+	if (state->instruments[instrument] == NULL) { return 0; }
+	if (state->filters[instrument] == NULL) { return 1; }
+	return nocsim_instrument_sample(state, state->filters[instrument], flit);
+}
+
+/* When built with -DNOCSIM_PROFILE (configure --enable-profile), these
+ * accumulate the time spent between nocsim_profile_begin() and
+ * nocsim_profile_end() into a nocsim_profile_counter. Otherwise, they expand
+ * to nothing. */
+#ifdef NOCSIM_PROFILE
+#if defined(__x86_64__) || defined(__i386__)
+static inline unsigned long long nocsim_profile_now(void) {
+	return __rdtsc();
+}
+#else
+static inline unsigned long long nocsim_profile_now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+#endif
+
+#define nocsim_profile_begin(__var) \
+	unsigned long long __var = nocsim_profile_now()
+
+#define nocsim_profile_end(__var, __counter) do { \
+	(__counter).cycles += nocsim_profile_now() - __var; \
+	(__counter).calls ++; } while (0)
+
+void nocsim_profile_reset(nocsim_state* state);
+nocsim_profile_counter* nocsim_profile_behavior(nocsim_state* state, nocsim_node* node);
+char* nocsim_profile_report(nocsim_state* state);
+#else
+#define nocsim_profile_begin(__var)
+#define nocsim_profile_end(__var, __counter)
+#endif
+
+void nocsim_heatmap_route(nocsim_node* router, nocsim_flit* flit, nocsim_node* to);
+void nocsim_heatmap_collect(nocsim_state* state, long* grids, unsigned int rows, unsigned int cols);
+void nocsim_heatmap_reset(nocsim_state* state);
+void nocsim_heatmap_set_window(nocsim_state* state, unsigned long window);
+void nocsim_heatmap_tick(nocsim_state* state);
+
+void nocsim_histogram_arrive(nocsim_state* state, nocsim_flit* flit);
+unsigned long nocsim_histogram_length(nocsim_state* state, nocsim_histogram_metric metric);
+void nocsim_histogram_reset(nocsim_state* state);
+void nocsim_histogram_free(nocsim_state* state);
+
+void nocsim_energy_default_model(nocsim_state* state);
+nocsim_result nocsim_energy_load_model(nocsim_state* state, const char* path);
+void nocsim_energy_reset(nocsim_state* state);
+unsigned int nocsim_energy_link_length(nocsim_link* link);
+void nocsim_energy_node(nocsim_state* state, nocsim_node* node, double* energy);
+void nocsim_energy_total(nocsim_state* state, double* energy);
+
+nocsim_result nocsim_fault_schedule(nocsim_state* state, nocsim_node* from, nocsim_node* to, unsigned char failed, unsigned long at);
+void nocsim_fault_repair_all(nocsim_state* state);
+void nocsim_fault_tick(nocsim_state* state);
+
+nocsim_result nocsim_scenario_load(nocsim_state* state, const char* path, nocsim_scenario** scenario);
+nocsim_result nocsim_scenario_run(nocsim_state* state, nocsim_scenario* scenario);
+void nocsim_scenario_free(nocsim_scenario* scenario);
+
+nocsim_result nocsim_netlist_load(nocsim_state* state, const char* path);
+nocsim_result nocsim_netlist_save(nocsim_state* state, const char* path);
+
+void nocsim_arbitration_reset(nocsim_state* state);
+nocsim_result nocsim_set_arbitration(nocsim_state* state, nocsim_arbitration arbitration, nocsim_direction* priority);
+void nocsim_arbitrate(nocsim_state* state, nocsim_node* router);
+
+/* 1 if flit a is older than flit b, by when it was spawned, and then by flit
+ * number, used by oldest first arbitration and by BLESS */
+static inline unsigned char nocsim_flit_older(nocsim_flit* a, nocsim_flit* b) {
+	return (a->spawned_at < b->spawned_at) ||
+		(a->spawned_at == b->spawned_at && a->flit_no < b->flit_no);
+}
+
+void nocsim_layout_build(nocsim_state* state);
+void nocsim_layout_invalidate(nocsim_state* state);
+unsigned char nocsim_link_in_slab(nocsim_state* state, nocsim_link* link);
 
+void nocsim_init_state(nocsim_state* state);
+void nocsim_free_state(nocsim_state* state);
+void next_state(nocsim_state* state, Tcl_Interp* interp);
+void flip_state(nocsim_state* state);
 void nocsim_step(nocsim_state* state, Tcl_Interp* interp);
+void nocsim_route(nocsim_state* state, nocsim_node* router, nocsim_direction from, nocsim_direction to);
 void nocsim_spawn(nocsim_state* state, nocsim_node* from, nocsim_node* to);
 void nocsim_handle_arrival(nocsim_state* state, nocsim_node* cursor, nocsim_direction dir);
 
@@ -38,6 +38,17 @@ namespace eval ::nocsim {
 	namespace export lshift
 	namespace export lremove
 	namespace export create_mesh
+	namespace export reserve
+	namespace export arbitration
+	namespace export finalize
+	namespace export nexthop
+	namespace export heatmap
+	namespace export histogram
+	namespace export energy
+	namespace export fail
+	namespace export repair
+	namespace export injectrate
+	namespace export profile
 
 	namespace export nocsim_RNG_seed
 	namespace export nocsim_num_PE
@@ -51,8 +62,10 @@ namespace eval ::nocsim {
 	namespace export nocsim_backrouted
 	namespace export nocsim_routed
 	namespace export nocsim_arrived
+	namespace export nocsim_retried
 	namespace export nocsim_title
 	namespace export nocsim_version
+	namespace export nocsim_finalized
 
 }
 
@@ -14,6 +14,13 @@ proc ::nocsim::all_adjacent {id} {
 proc ::nocsim::create_mesh {width height inject_behavior route_behavior} {
 	set routers {}
 	set PEs {}
+
+	# each router has a PE, and a pair of links to it and to each neighbor
+	if {$width > 0 && $height > 0} {
+		reserve [expr {2 * $width * $height}] \
+			[expr {2 * $width * $height + 2 * (($width - 1) * $height + $width * ($height - 1))}]
+	}
+
 	for {set row 0} {$row < $height} {incr row} {
 		for {set col 0} {$col < $width} {incr col} {
 			set router_id "R.$row.$col"
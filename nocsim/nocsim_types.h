@@ -123,11 +123,42 @@ typedef enum nocsim_result_t {
 struct nocsim_node_t;
 struct nocsim_link_t;
 struct nocsim_flit_t;
+struct nocsim_state_t;
 
 typedef vec_t(struct nocsim_flit_t*) flitlist;
 
+/* Events which consume energy, see energy.c. Routers count the events up to
+ * ENERGY_LINK themselves, links count traversals, and static energy is
+ * accounted for by time. */
+typedef enum nocsim_energy_event_t {
+	ENERGY_BUFFER_READ = 0,
+	ENERGY_BUFFER_WRITE,
+	ENERGY_CROSSBAR,
+	ENERGY_ARBITRATION,
+	ENERGY_LINK,
+	ENERGY_STATIC,
+	ENUMSIZE_ENERGY
+} nocsim_energy_event;
+
+#define NOCSIM_ENERGY_EVENT_TO_STR(e) \
+	(e == ENERGY_BUFFER_READ) ? "buffer_read" : \
+	(e == ENERGY_BUFFER_WRITE) ? "buffer_write" : \
+	(e == ENERGY_CROSSBAR) ? "crossbar" : \
+	(e == ENERGY_ARBITRATION) ? "arbitration" : \
+	(e == ENERGY_LINK) ? "link" : \
+	(e == ENERGY_STATIC) ? "static" : "EVENT UNDEFINED"
+
+#define NOCSIM_STR_TO_ENERGY_EVENT(s) \
+	(!strncmp(s, "buffer_read", 32)) ? ENERGY_BUFFER_READ : \
+	(!strncmp(s, "buffer_write", 32)) ? ENERGY_BUFFER_WRITE : \
+	(!strncmp(s, "crossbar", 32)) ? ENERGY_CROSSBAR : \
+	(!strncmp(s, "arbitration", 32)) ? ENERGY_ARBITRATION : \
+	(!strncmp(s, "link", 32)) ? ENERGY_LINK : \
+	(!strncmp(s, "static", 32)) ? ENERGY_STATIC : \
+	ENUMSIZE_ENERGY
+
 /* function pointer which we will call to perform routing for each node */
-typedef void (*nocsim_behavior)(struct nocsim_node_t* node);
+typedef void (*nocsim_behavior)(struct nocsim_state_t* state, struct nocsim_node_t* node);
 
 typedef struct nocsim_node_t {
 	nocsim_node_type type;
@@ -141,10 +172,43 @@ typedef struct nocsim_node_t {
 	long routed;
 	long backrouted;
 
+	/* heatmap accumulators, see heatmap.c -- routes which moved a flit
+	 * closer to it's destination, routes which did not, routes into the
+	 * backlog, and the sum over every tick of the number of flits in the
+	 * backlog (or injection FIFO for PEs) */
+	long productive;
+	long deflected;
+	long buffered;
+	long occupancy;
+
+	/* energy model activity counts, see energy.c -- indexed by event, only
+	 * the events before ENERGY_LINK are counted */
+	long activity[(int) ENERGY_LINK];
+
 	/* used to define either routing behavior or injection behavior
 	 * according to node type */
 	char* behavior;
 
+	/* if behavior names a native behavior (i.e. "native:DOR"), this
+	 * is called instead of evaluating behavior as TCL code */
+	nocsim_behavior native;
+
+#ifdef NOCSIM_PROFILE
+	/* time spent in behavior, shared by every node with the same
+	 * behavior, or NULL until the node is first stepped, see profile.c */
+	struct nocsim_profile_counter_t* profile;
+#endif
+
+	/**** only used for router type **************************************/
+	/* directions with an incoming flit this tick, in the order they
+	 * should be routed, see arbitration.c */
+	nocsim_direction arbitrated[NOCSIM_NUM_LINKS];
+	unsigned char num_arbitrated;
+
+	/* position in state->priority which has the highest priority next,
+	 * for round-robin arbitration */
+	unsigned char arbiter;
+
 	/**** only used for PE type ******************************************/
 	flitlist* pending;
 	float P_inject;
@@ -156,6 +220,16 @@ typedef struct nocsim_node_t {
 } nocsim_node;
 
 typedef vec_t(nocsim_node*) nodelist;
+
+/* behavior strings with this prefix name native behaviors, see native.c */
+#define NOCSIM_NATIVE_PREFIX "native:"
+
+typedef struct nocsim_native_t {
+	const char* name;
+	/* type of node the behavior is applicable to */
+	nocsim_node_type type;
+	nocsim_behavior fn;
+} nocsim_native;
 typedef vec_t(struct nocsim_link_t*) linklist;
 
 typedef struct nocsim_flit_t{
@@ -164,6 +238,16 @@ typedef struct nocsim_flit_t{
 	unsigned long spawned_at;
 	unsigned long injected_at;
 	unsigned long hops;
+	/* routes which moved the flit along a link that does not bring it
+	 * closer to it's destination */
+	unsigned long deflections;
+	/* ticks spent in router backlogs, and the tick at which the flit
+	 * last entered one */
+	unsigned long backlog;
+	unsigned long backlog_since;
+	/* fewest hops in which the flit could reach it's destination, see
+	 * nocsim_routing_distance() */
+	unsigned long distance;
 	unsigned long flit_no;
 } nocsim_flit;
 
@@ -173,8 +257,355 @@ typedef struct nocsim_link_t {
 	nocsim_flit* flit;
 	nocsim_flit* flit_next;
 	long load;
+
+	/* heatmap accumulators, see heatmap.c -- ticks during which a flit
+	 * was in flight on the link, and flits sent over the link */
+	long busy;
+	long carried;
+
+	/* energy model activity count, see energy.c -- flits sent over the
+	 * link */
+	long traversals;
+
+	/* asserted while the link has failed, in which case no flit may be
+	 * routed over it, see fault.c */
+	unsigned char failed;
 } nocsim_link;
 
+/* A link failure or repair scheduled for a later tick, see fault.c. Links
+ * are identified by their endpoints rather than by pointer, since building
+ * the layout moves them. */
+typedef struct nocsim_fault_t {
+	unsigned long at;
+	nocsim_node* from;
+	/* if NULL, every link to or from the router from is affected */
+	nocsim_node* to;
+	unsigned char failed;
+} nocsim_fault;
+
+typedef vec_t(nocsim_fault) faultlist;
+
+/* marks an empty slot in nocsim_layout.slots */
+#define NOCSIM_LAYOUT_NO_LINK ((unsigned int) -1)
+
+/* Compacted view of the topology used by the step loop, see layout.c. All
+ * per-node arrays are parallel, and are indexed by the position of the node
+ * in order */
+typedef struct nocsim_layout_t {
+	unsigned int num_node;
+	unsigned int num_link;
+
+	/* nodes sorted in row-major order */
+	nocsim_node** order;
+	nocsim_node_type* type;
+	flitlist** pending;
+
+	/* num_node * NOCSIM_NUM_LINKS entries, slots[i*NOCSIM_NUM_LINKS+dir]
+	 * is the index into the link slab of the incoming link of order[i]
+	 * from direction dir, or NOCSIM_LAYOUT_NO_LINK */
+	unsigned int* slots;
+} nocsim_layout;
+
+/* Native routing algorithms, for which next-hop tables are computed, see
+ * routing.c */
+typedef enum nocsim_algorithm_t {
+	ALGORITHM_DOR = 0,
+	ALGORITHM_ADOR,
+	ALGORITHM_TABLE,
+	ALGORITHM_UPDOWN,
+	ALGORITHM_ESCAPE,
+	ENUMSIZE_ALGORITHM
+} nocsim_algorithm;
+
+#define NOCSIM_ALGORITHM_TO_STR(alg) \
+	(alg == ALGORITHM_DOR) ? "DOR" : \
+	(alg == ALGORITHM_ADOR) ? "ADOR" : \
+	(alg == ALGORITHM_TABLE) ? "table" : \
+	(alg == ALGORITHM_UPDOWN) ? "updown" : \
+	(alg == ALGORITHM_ESCAPE) ? "escape" : "ALGORITHM UNDEFINED"
+
+#define NOCSIM_STR_TO_ALGORITHM(s) \
+	(!strncasecmp(s, "DOR", 32)) ? ALGORITHM_DOR : \
+	(!strncasecmp(s, "ADOR", 32)) ? ALGORITHM_ADOR : \
+	(!strncasecmp(s, "table", 32)) ? ALGORITHM_TABLE : \
+	(!strncasecmp(s, "updown", 32)) ? ALGORITHM_UPDOWN : \
+	(!strncasecmp(s, "escape", 32)) ? ALGORITHM_ESCAPE : \
+	ENUMSIZE_ALGORITHM
+
+/* Policies deciding the order in which a router considers it's incoming
+ * flits, and so which of them win when they contend for the same outgoing
+ * link, see arbitration.c */
+typedef enum nocsim_arbitration_t {
+	ARBITRATION_FIXED = 0,
+	ARBITRATION_OLDEST,
+	ARBITRATION_ROUNDROBIN,
+	ARBITRATION_RANDOM,
+	ENUMSIZE_ARBITRATION
+} nocsim_arbitration;
+
+#define NOCSIM_ARBITRATION_TO_STR(arb) \
+	(arb == ARBITRATION_FIXED) ? "fixed" : \
+	(arb == ARBITRATION_OLDEST) ? "oldest" : \
+	(arb == ARBITRATION_ROUNDROBIN) ? "roundrobin" : \
+	(arb == ARBITRATION_RANDOM) ? "random" : "ARBITRATION UNDEFINED"
+
+#define NOCSIM_STR_TO_ARBITRATION(s) \
+	(!strncasecmp(s, "fixed", 32)) ? ARBITRATION_FIXED : \
+	(!strncasecmp(s, "oldest", 32)) ? ARBITRATION_OLDEST : \
+	(!strncasecmp(s, "roundrobin", 32)) ? ARBITRATION_ROUNDROBIN : \
+	(!strncasecmp(s, "random", 32)) ? ARBITRATION_RANDOM : \
+	ENUMSIZE_ARBITRATION
+
+/* A next-hop table entry holds up to two candidate outgoing directions, in
+ * order of preference. The first candidate is stored in the low nibble, and
+ * the second in the high nibble. Missing candidates are DIR_UNDEF. */
+typedef unsigned char nocsim_hop;
+
+#define NOCSIM_HOP(first, second) ((nocsim_hop) ((first) | ((second) << 4)))
+#define NOCSIM_HOP_FIRST(hop) ((nocsim_direction) ((hop) & 0x0f))
+#define NOCSIM_HOP_SECOND(hop) ((nocsim_direction) ((hop) >> 4))
+#define NOCSIM_HOP_NONE NOCSIM_HOP(DIR_UNDEF, DIR_UNDEF)
+
+typedef struct nocsim_route_table_t {
+	nocsim_algorithm algorithm;
+
+	/* If the topology is a regular mesh, every router shares one table
+	 * indexed by the row and column offset to the destination, which
+	 * has (2*rows-1)*(2*cols-1) entries. Otherwise, there are phases
+	 * rows of num_PE entries per router, indexed by router type_number,
+	 * phase, and PE type_number. */
+	unsigned char shared;
+	unsigned int rows;
+	unsigned int cols;
+	unsigned int num_dest;
+
+	/* up* / down* routing uses a separate row for flits which may only
+	 * travel down, and so has 2 phases, other algorithms have 1 */
+	unsigned int phases;
+
+	nocsim_hop* entries;
+} nocsim_route_table;
+
+typedef struct nocsim_routing_t {
+	/* routers and PEs, indexed by type_number */
+	nocsim_node** routers;
+	nocsim_node** PEs;
+
+	/* router which delivers flits to each PE, indexed by PE type_number,
+	 * NULL if the PE cannot receive flits */
+	nocsim_node** attach;
+
+	/* routers form a fully connected rows x cols mesh, with one PE per
+	 * router */
+	unsigned char regular;
+	unsigned int rows;
+	unsigned int cols;
+
+	/* unless the topology is regular, the fewest hops from each router to
+	 * each PE, indexed by router type_number * num_PE + PE type_number,
+	 * built the first time a flit is spawned */
+	unsigned int* distance;
+
+	/* for up* / down* routing, bit dir of down_in[i] is set if the
+	 * incoming link to router i from direction dir is a down link,
+	 * indexed by router type_number */
+	unsigned char* down_in;
+
+	/* tables are built the first time an algorithm is used */
+	nocsim_route_table* tables[(int) ENUMSIZE_ALGORITHM];
+} nocsim_routing;
+
+/* Quantities accumulated for each row and column by the heatmap, see
+ * heatmap.c */
+typedef enum nocsim_heatmap_metric_t {
+	HEATMAP_CARRIED = 0,
+	HEATMAP_BUSY,
+	HEATMAP_BUSY_N,
+	HEATMAP_BUSY_S,
+	HEATMAP_BUSY_E,
+	HEATMAP_BUSY_W,
+	HEATMAP_BUSY_P,
+	HEATMAP_PRODUCTIVE,
+	HEATMAP_DEFLECTED,
+	HEATMAP_BUFFERED,
+	HEATMAP_OCCUPANCY,
+	ENUMSIZE_HEATMAP
+} nocsim_heatmap_metric;
+
+#define NOCSIM_HEATMAP_METRIC_TO_STR(m) \
+	(m == HEATMAP_CARRIED) ? "carried" : \
+	(m == HEATMAP_BUSY) ? "busy" : \
+	(m == HEATMAP_BUSY_N) ? "busy_N" : \
+	(m == HEATMAP_BUSY_S) ? "busy_S" : \
+	(m == HEATMAP_BUSY_E) ? "busy_E" : \
+	(m == HEATMAP_BUSY_W) ? "busy_W" : \
+	(m == HEATMAP_BUSY_P) ? "busy_P" : \
+	(m == HEATMAP_PRODUCTIVE) ? "productive" : \
+	(m == HEATMAP_DEFLECTED) ? "deflected" : \
+	(m == HEATMAP_BUFFERED) ? "buffered" : \
+	(m == HEATMAP_OCCUPANCY) ? "occupancy" : "METRIC UNDEFINED"
+
+typedef struct nocsim_heatmap_t {
+	/* number of ticks after which the accumulators are reset, or 0 if
+	 * they are never reset */
+	unsigned long window;
+
+	/* tick at which the accumulators were last reset */
+	unsigned long start;
+
+	/* the most recently completed window, grids holds ENUMSIZE_HEATMAP
+	 * grids of rows * cols values, or is NULL if no window has been
+	 * completed yet */
+	unsigned long ticks;
+	unsigned int rows;
+	unsigned int cols;
+	long* grids;
+} nocsim_heatmap;
+
+typedef struct nocsim_energy_t {
+	/* energy in pJ of each event, links are per flit per unit of length,
+	 * and static energy is per router per tick */
+	double cost[(int) ENUMSIZE_ENERGY];
+
+	/* tick at which the activity counts were last reset */
+	unsigned long start;
+} nocsim_energy;
+
+/* Quantities counted for every flit which arrives, see histogram.c */
+typedef enum nocsim_histogram_metric_t {
+	HISTOGRAM_LATENCY = 0,
+	HISTOGRAM_HOPS,
+	HISTOGRAM_DEFLECTIONS,
+	HISTOGRAM_BACKLOG,
+	HISTOGRAM_INFLATION,
+	ENUMSIZE_HISTOGRAM
+} nocsim_histogram_metric;
+
+#define NOCSIM_HISTOGRAM_METRIC_TO_STR(m) \
+	(m == HISTOGRAM_LATENCY) ? "latency" : \
+	(m == HISTOGRAM_HOPS) ? "hops" : \
+	(m == HISTOGRAM_DEFLECTIONS) ? "deflections" : \
+	(m == HISTOGRAM_BACKLOG) ? "backlog" : \
+	(m == HISTOGRAM_INFLATION) ? "inflation" : "METRIC UNDEFINED"
+
+typedef struct nocsim_histogram_t {
+	/* counts[m][v] is the number of flits for which metric m was v, and
+	 * has size[m] entries, grown as larger values are seen */
+	unsigned long* counts[(int) ENUMSIZE_HISTOGRAM];
+	unsigned long size[(int) ENUMSIZE_HISTOGRAM];
+} nocsim_histogram;
+
+/* Restricts which events an instrument is called for, see instrument.c */
+typedef struct nocsim_instrument_filter_t {
+	/* only events for which every set condition holds are considered */
+	unsigned char has_tick_range;
+	unsigned long tick_first;
+	unsigned long tick_last;
+
+	/* flit numbers in ascending order, or NULL for any flit */
+	unsigned long* flits;
+	unsigned int num_flits;
+
+	/* IDs of the origin and destination nodes of the flit, or NULL for
+	 * any node -- the nodes are looked up the first time they are needed,
+	 * so they need not exist when the instrument is registered */
+	char* src_id;
+	char* dst_id;
+	nocsim_node* src;
+	nocsim_node* dst;
+
+	/* of the events which satisfy the conditions above, only every Nth
+	 * one is considered */
+	unsigned long every;
+	unsigned long count;
+
+	/* each event which remains is then sampled with this probability,
+	 * using it's own random number generator so that the simulation is
+	 * not affected */
+	float probability;
+	unsigned int seed;
+} nocsim_instrument_filter;
+
+/* A number of ticks simulated by nocsim-run, whose results are reported
+ * separately, see scenario.c */
+typedef struct nocsim_phase_t {
+	char* name;
+	unsigned long ticks;
+
+	/* injection rate set for every PE at the start of the phase, or
+	 * negative to leave it unchanged */
+	float P_inject;
+} nocsim_phase;
+
+typedef vec_t(nocsim_phase) phaselist;
+
+typedef struct nocsim_scenario_t {
+	char* title;
+
+	/* file results are written to, or NULL for standard output */
+	char* output;
+
+	/* asserted if a heatmap should be reported for each phase */
+	unsigned char heatmap;
+
+	/* asserted if histograms should be reported for each phase */
+	unsigned char histogram;
+
+	/* asserted if energy should be reported for each phase */
+	unsigned char energy;
+
+	phaselist phases;
+} nocsim_scenario;
+
+/* Parts of nocsim_step() which are timed separately by the profiler, see
+ * profile.c */
+typedef enum nocsim_profile_phase_t {
+	PROFILE_STEP = 0,
+	PROFILE_LAYOUT,
+	PROFILE_BEHAVIOR,
+	PROFILE_DEQUEUE,
+	PROFILE_FLIP,
+	PROFILE_ARRIVAL,
+	PROFILE_HEATMAP,
+	ENUMSIZE_PROFILE
+} nocsim_profile_phase;
+
+#define NOCSIM_PROFILE_PHASE_TO_STR(p) \
+	(p == PROFILE_STEP) ? "step" : \
+	(p == PROFILE_LAYOUT) ? "layout" : \
+	(p == PROFILE_BEHAVIOR) ? "behaviors" : \
+	(p == PROFILE_DEQUEUE) ? "dequeue" : \
+	(p == PROFILE_FLIP) ? "flip" : \
+	(p == PROFILE_ARRIVAL) ? "arrival" : \
+	(p == PROFILE_HEATMAP) ? "heatmap" : "ERROR"
+
+#ifdef NOCSIM_PROFILE
+typedef struct nocsim_profile_counter_t {
+	/* timer ticks (cycles where rdtsc is available, nanoseconds
+	 * otherwise) spent, and number of times the counter was entered */
+	unsigned long long cycles;
+	unsigned long calls;
+
+	/* for behaviors only, asserted if the behavior is evaluated as TCL */
+	unsigned char tcl;
+} nocsim_profile_counter;
+
+KHASH_MAP_INIT_STR(prof, nocsim_profile_counter*)
+
+typedef struct nocsim_profile_t {
+	nocsim_profile_counter phases[(int) ENUMSIZE_PROFILE];
+	nocsim_profile_counter instruments[(int) ENUMSIZE_INSTRUMENT];
+
+	/* behavior string -> counter */
+	khash_t(prof)* behaviors;
+
+	/* wall clock time and timer value as of the last reset, used to
+	 * convert timer ticks into seconds */
+	double start_time;
+	unsigned long long start_cycles;
+} nocsim_profile;
+#endif
+
 /* hash table struct name will have "kh_nnptr" in it */
 KHASH_MAP_INIT_STR(nnptr, nocsim_node*)
 typedef khash_t(nnptr) nodemap;
@@ -199,6 +630,41 @@ typedef struct nocsim_state_t {
 	linklist* links;
 	/* used for quick node lookups by ID */
 	nodemap* node_map;
+
+	/* contiguous storage for links, ordered by destination node, see
+	 * layout.c -- links created after the layout was last built are
+	 * allocated individually until it is rebuilt */
+	nocsim_link* link_slab;
+	unsigned int link_slab_len;
+
+	/* NULL if the topology has changed since the layout was last built */
+	nocsim_layout* layout;
+
+	/* NULL if the topology has changed since routing tables were last
+	 * built, see routing.c */
+	nocsim_routing* routing;
+
+	/* asserted by nocsim_finalize(), after which the topology may no
+	 * longer be modified */
+	int finalized;
+
+	nocsim_heatmap heatmap;
+	nocsim_histogram histogram;
+	nocsim_energy energy;
+
+	/* scheduled link failures and repairs, in the order they were
+	 * scheduled, see fault.c */
+	faultlist faults;
+
+	/* arbitration policy used by every router, and the order of
+	 * directions it uses to break ties, see arbitration.c */
+	nocsim_arbitration arbitration;
+	nocsim_direction priority[NOCSIM_NUM_LINKS];
+
+#ifdef NOCSIM_PROFILE
+	nocsim_profile profile;
+#endif
+
 	unsigned int max_row;
 	unsigned int max_col;
 	long spawned;
@@ -207,6 +673,7 @@ typedef struct nocsim_state_t {
 	long backrouted;
 	long routed;
 	long arrived;
+	long retried;
 	
 	/* used by some functions to return an error string */
 	char* errstr;
@@ -218,6 +685,9 @@ typedef struct nocsim_state_t {
 
 	char* instruments[(int) ENUMSIZE_INSTRUMENT];
 
+	/* NULL if the corresponding instrument is called for every event */
+	nocsim_instrument_filter* filters[(int) ENUMSIZE_INSTRUMENT];
+
 } nocsim_state;
 
 #endif
@@ -0,0 +1,178 @@
+#include "nocsim.h"
+
+/* This file contains the built-in profiler, which breaks down the time spent
+ * in nocsim_step() by phase, by behavior, and by instrument.
+ *
+ * It is only compiled in when NOCSIM_PROFILE is defined (configure
+ * --enable-profile). Otherwise, nocsim_profile_begin() and
+ * nocsim_profile_end() expand to nothing, and the step loop is unchanged.
+ *
+ * Counters are timed with rdtsc where it is available, and converted to
+ * seconds using the wall clock time which elapsed since the last reset, so
+ * that the conversion does not depend on knowing the clock rate.
+ * */
+
+#ifdef NOCSIM_PROFILE
+
+static double nocsim_profile_wall(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * @brief Zero every counter, and start a new profile.
+ *
+ * Behavior counters are zeroed rather than freed, as nodes keep pointers to
+ * them.
+ *
+ * @param state
+ */
+void nocsim_profile_reset(nocsim_state* state) {
+	nocsim_profile* profile = &(state->profile);
+	nocsim_profile_counter* counter;
+
+	memset(profile->phases, 0, sizeof(profile->phases));
+	memset(profile->instruments, 0, sizeof(profile->instruments));
+
+	if (profile->behaviors == NULL) {
+		profile->behaviors = kh_init(prof);
+	}
+
+	kh_foreach_value(profile->behaviors, counter, {
+		counter->cycles = 0;
+		counter->calls = 0;
+	});
+
+	profile->start_time = nocsim_profile_wall();
+	profile->start_cycles = nocsim_profile_now();
+}
+
+/**
+ * @brief Retrieve the counter for a node's behavior.
+ *
+ * Nodes with the same behavior share a counter. The counter is cached on the
+ * node, and looked up again if the node's behavior changes.
+ *
+ * @param state
+ * @param node
+ *
+ * @return
+ */
+nocsim_profile_counter* nocsim_profile_behavior(nocsim_state* state, nocsim_node* node) {
+	khash_t(prof)* behaviors = state->profile.behaviors;
+	nocsim_profile_counter* counter;
+	khint_t iter;
+	int status;
+
+	if (node->profile != NULL) { return node->profile; }
+
+	iter = kh_get(prof, behaviors, node->behavior);
+	if (iter != kh_end(behaviors)) {
+		node->profile = kh_value(behaviors, iter);
+		return node->profile;
+	}
+
+	alloc(sizeof(nocsim_profile_counter), counter);
+	counter->cycles = 0;
+	counter->calls = 0;
+	counter->tcl = (node->native == NULL);
+
+	iter = kh_put(prof, behaviors, strdup(node->behavior), &status);
+	if (status == -1) { err(1, "could not add behavior %s to profile", node->behavior); }
+	kh_value(behaviors, iter) = counter;
+
+	node->profile = counter;
+	return counter;
+}
+
+/* append line to report, freeing both */
+static char* nocsim_profile_append(char* report, char* line) {
+	char* result = ezcat(report, line);
+	free(report);
+	free(line);
+	return result;
+}
+
+/* append one line of the report, time is given as a percentage of the total
+ * time spent in nocsim_step() */
+static char* nocsim_profile_line(char* report, const char* indent, const char* name,
+		nocsim_profile_counter* counter, double seconds_per_cycle, unsigned long long step) {
+	char* line;
+	double seconds = counter->cycles * seconds_per_cycle;
+
+	line = alloc_printf("%s%-*s %12lu %12.3f %8.1f %12.1f\n",
+		indent, (int) (32 - strlen(indent)), name, counter->calls,
+		seconds * 1e3,
+		step == 0 ? 0.0 : 100.0 * counter->cycles / step,
+		counter->calls == 0 ? 0.0 : 1e9 * seconds / counter->calls);
+
+	return nocsim_profile_append(report, line);
+}
+
+/**
+ * @brief Format the profile as a human-readable table.
+ *
+ * The caller is responsible for freeing the returned string.
+ *
+ * @param state
+ *
+ * @return
+ */
+char* nocsim_profile_report(nocsim_state* state) {
+	nocsim_profile* profile = &(state->profile);
+	nocsim_profile_counter* counter;
+	const char* name;
+	char* report;
+	double seconds_per_cycle = 0;
+	unsigned long long elapsed = nocsim_profile_now() - profile->start_cycles;
+	unsigned long long step = profile->phases[PROFILE_STEP].cycles;
+	unsigned long ticks = profile->phases[PROFILE_STEP].calls;
+	unsigned long evals = 0;
+
+	if (elapsed > 0) {
+		seconds_per_cycle = (nocsim_profile_wall() - profile->start_time) / elapsed;
+	}
+
+	/* every instrument call and TCL behavior is one Tcl_Eval() */
+	for (int i = 0 ; i < (int) ENUMSIZE_INSTRUMENT ; i++) {
+		evals += profile->instruments[i].calls;
+	}
+	kh_foreach_value(profile->behaviors, counter, {
+		if (counter->tcl) { evals += counter->calls; }
+	});
+
+	report = alloc_printf("%lu ticks, %.3f ms in step, %.2f TCL evals per tick\n\n"
+		"%-32s %12s %12s %8s %12s\n",
+		ticks, step * seconds_per_cycle * 1e3,
+		ticks == 0 ? 0.0 : (double) evals / ticks,
+		"", "calls", "total ms", "% step", "ns/call");
+
+	for (int p = 0 ; p < (int) ENUMSIZE_PROFILE ; p++) {
+		report = nocsim_profile_line(report, p == PROFILE_STEP ? "" : "  ",
+			NOCSIM_PROFILE_PHASE_TO_STR((nocsim_profile_phase) p),
+			&(profile->phases[p]), seconds_per_cycle, step);
+
+		/* behaviors are broken down below the phase that runs them */
+		if (p != PROFILE_BEHAVIOR) { continue; }
+		kh_foreach(profile->behaviors, name, counter, {
+			if (counter->calls == 0) { continue; }
+			report = nocsim_profile_line(report, "    ", name,
+				counter, seconds_per_cycle, step);
+		});
+	}
+
+	report = nocsim_profile_append(report,
+		strdup("\ninstruments (included in the phase that calls them)\n"));
+
+	for (int i = 0 ; i < (int) ENUMSIZE_INSTRUMENT ; i++) {
+		if (profile->instruments[i].calls == 0) { continue; }
+		report = nocsim_profile_line(report, "  ",
+			NOCSIM_INSTRUMENT_TO_STR((nocsim_instrument) i),
+			&(profile->instruments[i]), seconds_per_cycle, step);
+	}
+
+	return report;
+}
+
+#endif
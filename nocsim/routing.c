@@ -0,0 +1,994 @@
+#include "nocsim.h"
+
+#include <pthread.h>
+
+/* This file contains methods relating to native routing tables.
+ *
+ * For each native routing algorithm, a next-hop table is computed giving the
+ * candidate outgoing directions for every (router, destination PE) pair, so
+ * that routing a flit natively is a single table lookup.
+ *
+ * Where the routers form a regular mesh, the decision made by a DOR or ADOR
+ * router depends only on the offset to the destination, so all routers share
+ * one small table indexed by that offset rather than each having their own.
+ *
+ * The remaining algorithms work on arbitrary topologies, and are computed
+ * from shortest paths found by a breadth first search backwards from each
+ * destination PE. Searches for different destinations are independent, so
+ * they are spread across several threads.
+ *
+ * For up* / down* routing, routers are assigned levels by a breadth first
+ * search from router 0, and each link between routers is "up" if it leads to
+ * a lower level (or to a lower numbered router on the same level), and "down"
+ * otherwise. Links to PEs are always down. A legal route takes any number of
+ * up links followed by any number of down links, which can never form a
+ * cycle of channel dependencies. Whether a flit may still travel up is
+ * inferred from the link it arrived on.
+ *
+ * Like the layout, routing tables are discarded any time the topology
+ * changes, and rebuilt the next time they are needed.
+ *
+ * Failed links (see fault.c) are left out when tables are built, but not
+ * when up* / down* levels are assigned, so that a failure does not change
+ * the direction of any other link. When a link fails or is repaired, only
+ * the destinations whose routes may have changed are searched again, see
+ * nocsim_routing_fault(). Shared tables do not depend on the links at all,
+ * so flits routed by them are deflected around failed links instead.
+ * */
+
+/* marks an unreachable node during breadth first search */
+#define NOCSIM_ROUTING_UNREACHABLE UINT_MAX
+
+/* maximum number of threads used to build tables, and the minimum number of
+ * destinations each thread should be given */
+#define NOCSIM_ROUTING_MAX_THREADS 16
+#define NOCSIM_ROUTING_DEST_PER_THREAD 32
+
+/* adjacency of the topology used while building BFS tables. Routers are
+ * numbered by type_number, and PEs follow them, so PE j is num_router+j. */
+typedef struct nocsim_routing_graph_t {
+	unsigned int num_router;
+	unsigned int num_node;
+
+	/* num_node * NOCSIM_NUM_LINKS entries, the node at the other end of
+	 * each outgoing and incoming link, or -1 */
+	int* out;
+	int* in;
+
+	/* bit dir is set if the outgoing or incoming link in direction dir
+	 * is a down link, indexed by node */
+	unsigned char* out_down;
+	unsigned char* in_down;
+} nocsim_routing_graph;
+
+typedef struct nocsim_routing_job_t {
+	nocsim_routing_graph* graph;
+	nocsim_route_table* table;
+	unsigned int first;
+	unsigned int stride;
+} nocsim_routing_job;
+
+/* dimension-ordered (rows first) candidate directions towards a destination
+ * drow rows and dcol columns away, adaptive routing also offers the other
+ * productive dimension as a second candidate */
+static nocsim_hop nocsim_routing_dor_hop(int drow, int dcol, unsigned char adaptive) {
+	nocsim_direction row_dir = DIR_UNDEF;
+	nocsim_direction col_dir = DIR_UNDEF;
+
+	if      (drow > 0) { row_dir = S; }
+	else if (drow < 0) { row_dir = N; }
+
+	if      (dcol > 0) { col_dir = E; }
+	else if (dcol < 0) { col_dir = W; }
+
+	if (row_dir == DIR_UNDEF && col_dir == DIR_UNDEF) {
+		return NOCSIM_HOP(P, DIR_UNDEF);
+	} else if (row_dir == DIR_UNDEF) {
+		return NOCSIM_HOP(col_dir, DIR_UNDEF);
+	} else if (adaptive) {
+		return NOCSIM_HOP(row_dir, col_dir);
+	} else {
+		return NOCSIM_HOP(row_dir, DIR_UNDEF);
+	}
+}
+
+/* 1 if the router has a working outgoing link in direction dir */
+static inline unsigned char nocsim_routing_has_link(nocsim_node* router, nocsim_direction dir) {
+	return router->outgoing[dir] != NULL && !router->outgoing[dir]->failed;
+}
+
+/* remove candidates for which the router has no working outgoing link */
+static nocsim_hop nocsim_routing_filter_hop(nocsim_node* router, nocsim_hop hop) {
+	nocsim_direction first = NOCSIM_HOP_FIRST(hop);
+	nocsim_direction second = NOCSIM_HOP_SECOND(hop);
+
+	if (second != DIR_UNDEF && !nocsim_routing_has_link(router, second)) {
+		second = DIR_UNDEF;
+	}
+
+	if (first != DIR_UNDEF && !nocsim_routing_has_link(router, first)) {
+		first = second;
+		second = DIR_UNDEF;
+	}
+
+	return NOCSIM_HOP(first, second);
+}
+
+static nocsim_hop nocsim_routing_compute(nocsim_routing* routing, nocsim_algorithm algorithm, nocsim_node* router, nocsim_node* dest) {
+	nocsim_node* attach = routing->attach[dest->type_number];
+
+	if (attach == NULL) { return NOCSIM_HOP_NONE; }
+
+	/* deliver directly to the destination over whichever link
+	 * connects to it */
+	if (attach == router) {
+		for (nocsim_direction dir = N ; dir <= P ; dir++) {
+			if (nocsim_routing_has_link(router, dir) && router->outgoing[dir]->to == dest) {
+				return NOCSIM_HOP(dir, DIR_UNDEF);
+			}
+		}
+		return NOCSIM_HOP_NONE;
+	}
+
+	return nocsim_routing_filter_hop(router,
+		nocsim_routing_dor_hop(
+			(int) attach->row - (int) router->row,
+			(int) attach->col - (int) router->col,
+			algorithm == ALGORITHM_ADOR));
+}
+
+/* check if routers form a full rows x cols mesh where every router is linked
+ * to each of it's neighbors in the expected direction, and has exactly one PE
+ * at the same row and column */
+static unsigned char nocsim_routing_is_regular(nocsim_state* state, nocsim_routing* routing) {
+	nocsim_node** cells;
+	nocsim_node* router;
+	nocsim_node* expect;
+	nocsim_node* PE;
+	unsigned int rows = 0;
+	unsigned int cols = 0;
+	unsigned int i;
+	unsigned char regular = 1;
+	int row;
+	int col;
+
+	if (state->num_router == 0 || state->num_router != state->num_PE) { return 0; }
+
+	for (i = 0 ; i < state->num_router ; i++) {
+		router = routing->routers[i];
+		if (router->row + 1 > rows) { rows = router->row + 1; }
+		if (router->col + 1 > cols) { cols = router->col + 1; }
+	}
+
+	if (rows * cols != state->num_router) { return 0; }
+
+	cells = calloc(rows * cols, sizeof(nocsim_node*));
+	if (cells == NULL) { err(1, "could not allocate memory"); }
+
+	for (i = 0 ; i < state->num_router && regular ; i++) {
+		router = routing->routers[i];
+		if (cells[router->row * cols + router->col] != NULL) { regular = 0; }
+		cells[router->row * cols + router->col] = router;
+	}
+
+	for (i = 0 ; i < state->num_router && regular ; i++) {
+		router = routing->routers[i];
+
+		for (nocsim_direction dir = N ; dir <= W ; dir++) {
+			row = (int) router->row + ((dir == S) ? 1 : (dir == N) ? -1 : 0);
+			col = (int) router->col + ((dir == E) ? 1 : (dir == W) ? -1 : 0);
+
+			expect = NULL;
+			if (row >= 0 && col >= 0 && row < (int) rows && col < (int) cols) {
+				expect = cells[row * cols + col];
+			}
+
+			if (expect == NULL && router->outgoing[dir] != NULL) { regular = 0; }
+			if (expect != NULL && (router->outgoing[dir] == NULL ||
+					router->outgoing[dir]->to != expect)) { regular = 0; }
+		}
+	}
+
+	for (i = 0 ; i < state->num_PE && regular ; i++) {
+		PE = routing->PEs[i];
+		router = routing->attach[i];
+
+		if ((router == NULL) ||
+			(router->row != PE->row) || (router->col != PE->col) ||
+			(router->outgoing[P] == NULL) || (router->outgoing[P]->to != PE)) {
+			regular = 0;
+		}
+	}
+
+	free(cells);
+
+	routing->rows = rows;
+	routing->cols = cols;
+
+	return regular;
+}
+
+static nocsim_routing* nocsim_routing_create(nocsim_state* state) {
+	nocsim_routing* routing;
+	nocsim_node* cursor;
+	unsigned int i;
+
+	alloc(sizeof(nocsim_routing), routing);
+	alloc(sizeof(nocsim_node*) * (state->num_router + 1), routing->routers);
+	alloc(sizeof(nocsim_node*) * (state->num_PE + 1), routing->PEs);
+	alloc(sizeof(nocsim_node*) * (state->num_PE + 1), routing->attach);
+
+	vec_foreach(state->nodes, cursor, i) {
+		if (cursor->type == node_router) {
+			routing->routers[cursor->type_number] = cursor;
+		} else {
+			routing->PEs[cursor->type_number] = cursor;
+			routing->attach[cursor->type_number] = NULL;
+			if (cursor->incoming[P] != NULL &&
+				cursor->incoming[P]->from->type == node_router) {
+				routing->attach[cursor->type_number] = cursor->incoming[P]->from;
+			}
+		}
+	}
+
+	for (i = 0 ; i < (unsigned int) ENUMSIZE_ALGORITHM ; i++) {
+		routing->tables[i] = NULL;
+	}
+
+	routing->rows = 0;
+	routing->cols = 0;
+	routing->regular = nocsim_routing_is_regular(state, routing);
+	routing->down_in = NULL;
+	routing->distance = NULL;
+
+	return routing;
+}
+
+static inline int nocsim_routing_index(nocsim_routing_graph* graph, nocsim_node* node) {
+	if (node->type == node_router) { return (int) node->type_number; }
+	return (int) (graph->num_router + node->type_number);
+}
+
+/* assign up* / down* levels, and classify every link as up or down */
+static void nocsim_routing_classify(nocsim_state* state, nocsim_routing* routing, nocsim_routing_graph* graph) {
+	unsigned int* level;
+	unsigned int* queue;
+	unsigned int head = 0;
+	unsigned int tail = 0;
+	unsigned int u;
+	int v;
+
+	alloc(sizeof(unsigned int) * (state->num_router + 1), level);
+	alloc(sizeof(unsigned int) * (state->num_router + 1), queue);
+
+	for (u = 0 ; u < state->num_router ; u++) {
+		level[u] = NOCSIM_ROUTING_UNREACHABLE;
+	}
+
+	/* links are treated as undirected when assigning levels */
+	if (state->num_router > 0) {
+		level[0] = 0;
+		queue[tail++] = 0;
+	}
+
+	while (head < tail) {
+		u = queue[head++];
+		for (nocsim_direction dir = N ; dir <= P ; dir++) {
+			for (int k = 0 ; k < 2 ; k++) {
+				v = k ? graph->in[u * NOCSIM_NUM_LINKS + dir] : graph->out[u * NOCSIM_NUM_LINKS + dir];
+				if (v < 0 || (unsigned int) v >= graph->num_router) { continue; }
+				if (level[v] != NOCSIM_ROUTING_UNREACHABLE) { continue; }
+				level[v] = level[u] + 1;
+				queue[tail++] = (unsigned int) v;
+			}
+		}
+	}
+
+#define nocsim_routing_is_down(from, to) \
+	(((unsigned int) (to) >= graph->num_router) || \
+	 (level[to] > level[from]) || \
+	 (level[to] == level[from] && (unsigned int) (to) > (unsigned int) (from)))
+
+	for (u = 0 ; u < graph->num_node ; u++) {
+		graph->out_down[u] = 0;
+		graph->in_down[u] = 0;
+
+		for (nocsim_direction dir = N ; dir <= P ; dir++) {
+			v = graph->out[u * NOCSIM_NUM_LINKS + dir];
+			if (u < graph->num_router && v >= 0 && nocsim_routing_is_down(u, v)) {
+				graph->out_down[u] |= 1 << dir;
+			}
+
+			v = graph->in[u * NOCSIM_NUM_LINKS + dir];
+			if (v >= 0 && (unsigned int) v < graph->num_router && nocsim_routing_is_down(v, u)) {
+				graph->in_down[u] |= 1 << dir;
+			}
+		}
+	}
+
+#undef nocsim_routing_is_down
+
+	if (routing->down_in == NULL) {
+		alloc(sizeof(unsigned char) * (state->num_router + 1), routing->down_in);
+		memcpy(routing->down_in, graph->in_down, sizeof(unsigned char) * state->num_router);
+	}
+
+	free(level);
+	free(queue);
+}
+
+/* if faults is asserted, failed links are left out of the graph once links
+ * have been classified */
+static nocsim_routing_graph* nocsim_routing_graph_create(nocsim_state* state, nocsim_routing* routing, unsigned char faults) {
+	nocsim_routing_graph* graph;
+	nocsim_node* node;
+	nocsim_link* link;
+	unsigned int i;
+
+	alloc(sizeof(nocsim_routing_graph), graph);
+	graph->num_router = state->num_router;
+	graph->num_node = state->num_router + state->num_PE;
+	alloc(sizeof(int) * (graph->num_node * NOCSIM_NUM_LINKS + 1), graph->out);
+	alloc(sizeof(int) * (graph->num_node * NOCSIM_NUM_LINKS + 1), graph->in);
+	alloc(sizeof(unsigned char) * (graph->num_node + 1), graph->out_down);
+	alloc(sizeof(unsigned char) * (graph->num_node + 1), graph->in_down);
+
+	for (i = 0 ; i < graph->num_node ; i++) {
+		node = (i < state->num_router) ?
+			routing->routers[i] : routing->PEs[i - state->num_router];
+
+		for (nocsim_direction dir = N ; dir <= P ; dir++) {
+			link = node->outgoing[dir];
+			graph->out[i * NOCSIM_NUM_LINKS + dir] = \
+				(link == NULL) ? -1 : nocsim_routing_index(graph, link->to);
+			link = node->incoming[dir];
+			graph->in[i * NOCSIM_NUM_LINKS + dir] = \
+				(link == NULL) ? -1 : nocsim_routing_index(graph, link->from);
+		}
+	}
+
+	nocsim_routing_classify(state, routing, graph);
+
+	for (i = 0 ; i < graph->num_node && faults ; i++) {
+		node = (i < state->num_router) ?
+			routing->routers[i] : routing->PEs[i - state->num_router];
+
+		for (nocsim_direction dir = N ; dir <= P ; dir++) {
+			if (node->outgoing[dir] != NULL && node->outgoing[dir]->failed) {
+				graph->out[i * NOCSIM_NUM_LINKS + dir] = -1;
+			}
+			if (node->incoming[dir] != NULL && node->incoming[dir]->failed) {
+				graph->in[i * NOCSIM_NUM_LINKS + dir] = -1;
+			}
+		}
+	}
+
+	return graph;
+}
+
+static void nocsim_routing_graph_free(nocsim_routing_graph* graph) {
+	free(graph->out);
+	free(graph->in);
+	free(graph->out_down);
+	free(graph->in_down);
+	free(graph);
+}
+
+/* unrestricted shortest paths to dest, only passing through routers */
+static void nocsim_routing_bfs(nocsim_routing_graph* graph, unsigned int dest, unsigned int* dist, unsigned int* queue) {
+	unsigned int head = 0;
+	unsigned int tail = 0;
+	unsigned int x;
+	int u;
+
+	for (x = 0 ; x < graph->num_node ; x++) { dist[x] = NOCSIM_ROUTING_UNREACHABLE; }
+
+	dist[dest] = 0;
+	queue[tail++] = dest;
+
+	while (head < tail) {
+		x = queue[head++];
+		for (nocsim_direction dir = N ; dir <= P ; dir++) {
+			u = graph->in[x * NOCSIM_NUM_LINKS + dir];
+			if (u < 0 || (unsigned int) u >= graph->num_router) { continue; }
+			if (dist[u] != NOCSIM_ROUTING_UNREACHABLE) { continue; }
+			dist[u] = dist[x] + 1;
+			queue[tail++] = (unsigned int) u;
+		}
+	}
+}
+
+/* unrestricted shortest paths from the router src to every node, only
+ * passing through routers */
+static void nocsim_routing_bfs_from(nocsim_routing_graph* graph, unsigned int src, unsigned int* dist, unsigned int* queue) {
+	unsigned int head = 0;
+	unsigned int tail = 0;
+	unsigned int x;
+	int v;
+
+	for (x = 0 ; x < graph->num_node ; x++) { dist[x] = NOCSIM_ROUTING_UNREACHABLE; }
+
+	dist[src] = 0;
+	queue[tail++] = src;
+
+	while (head < tail) {
+		x = queue[head++];
+		if (x >= graph->num_router) { continue; }
+		for (nocsim_direction dir = N ; dir <= P ; dir++) {
+			v = graph->out[x * NOCSIM_NUM_LINKS + dir];
+			if (v < 0 || dist[v] != NOCSIM_ROUTING_UNREACHABLE) { continue; }
+			dist[v] = dist[x] + 1;
+			queue[tail++] = (unsigned int) v;
+		}
+	}
+}
+
+/* shortest legal up* / down* paths to dest -- dist[2*x] is the distance from
+ * x if the flit may still travel up, and dist[2*x+1] if it may only travel
+ * down */
+static void nocsim_routing_bfs_updown(nocsim_routing_graph* graph, unsigned int dest, unsigned int* dist, unsigned int* queue) {
+	unsigned int head = 0;
+	unsigned int tail = 0;
+	unsigned int x;
+	unsigned int phase;
+	unsigned char down;
+	int u;
+
+	for (x = 0 ; x < 2 * graph->num_node ; x++) { dist[x] = NOCSIM_ROUTING_UNREACHABLE; }
+
+	dist[2 * dest] = 0;
+	dist[2 * dest + 1] = 0;
+	queue[tail++] = 2 * dest;
+	queue[tail++] = 2 * dest + 1;
+
+	while (head < tail) {
+		x = queue[head] / 2;
+		phase = queue[head++] % 2;
+
+		for (nocsim_direction dir = N ; dir <= P ; dir++) {
+			u = graph->in[x * NOCSIM_NUM_LINKS + dir];
+			if (u < 0 || (unsigned int) u >= graph->num_router) { continue; }
+			down = (graph->in_down[x] >> dir) & 1;
+
+			/* a down link leaves the flit only able to travel
+			 * down, while an up link requires that it could still
+			 * travel up */
+			for (unsigned int from = 0 ; from < 2 ; from++) {
+				if (down && phase != 1) { continue; }
+				if (!down && (phase != 0 || from != 0)) { continue; }
+				if (dist[2 * u + from] != NOCSIM_ROUTING_UNREACHABLE) { continue; }
+				dist[2 * u + from] = dist[2 * x + phase] + 1;
+				queue[tail++] = 2 * u + from;
+			}
+		}
+	}
+}
+
+/* up to two outgoing directions of router r which make progress towards the
+ * destination, in direction order -- if updown is asserted, dist is as
+ * computed by nocsim_routing_bfs_updown() and phase selects which distance
+ * to use */
+static nocsim_hop nocsim_routing_bfs_hop(nocsim_routing_graph* graph, unsigned int* dist, unsigned int r, unsigned char updown, unsigned int phase) {
+	nocsim_direction first = DIR_UNDEF;
+	nocsim_direction second = DIR_UNDEF;
+	unsigned int here;
+	unsigned int there;
+	unsigned char down;
+	int v;
+
+	here = updown ? dist[2 * r + phase] : dist[r];
+	if (here == NOCSIM_ROUTING_UNREACHABLE || here == 0) { return NOCSIM_HOP_NONE; }
+
+	for (nocsim_direction dir = N ; dir <= P && second == DIR_UNDEF ; dir++) {
+		v = graph->out[r * NOCSIM_NUM_LINKS + dir];
+		if (v < 0) { continue; }
+
+		if (updown) {
+			down = (graph->out_down[r] >> dir) & 1;
+			if (!down && phase == 1) { continue; }
+			there = dist[2 * v + (down ? 1 : 0)];
+		} else {
+			there = dist[v];
+		}
+
+		if (there != here - 1) { continue; }
+
+		if (first == DIR_UNDEF) { first = dir; }
+		else { second = dir; }
+	}
+
+	return NOCSIM_HOP(first, second);
+}
+
+/* compute the entries of table for destination PE j, dist and dist_updown
+ * are scratch space as used by the searches */
+static void nocsim_routing_build_dest(nocsim_routing_graph* graph, nocsim_route_table* table, unsigned int j, unsigned int* dist, unsigned int* dist_updown, unsigned int* queue) {
+	unsigned int dest = graph->num_router + j;
+	unsigned int phase;
+	nocsim_hop minimal;
+	nocsim_hop legal;
+	nocsim_hop hop;
+	nocsim_hop* entry;
+
+	if (table->algorithm != ALGORITHM_UPDOWN) {
+		nocsim_routing_bfs(graph, dest, dist, queue);
+	}
+
+	if (table->algorithm != ALGORITHM_TABLE) {
+		nocsim_routing_bfs_updown(graph, dest, dist_updown, queue);
+	}
+
+	for (unsigned int r = 0 ; r < graph->num_router ; r++) {
+		for (phase = 0 ; phase < table->phases ; phase++) {
+			entry = &(table->entries[((size_t) r * table->phases + phase) * table->num_dest + j]);
+
+			if (table->algorithm == ALGORITHM_TABLE) {
+				*entry = nocsim_routing_bfs_hop(graph, dist, r, 0, 0);
+				continue;
+			}
+
+			legal = nocsim_routing_bfs_hop(graph, dist_updown, r, 1, phase);
+
+			/* a flit deflected onto a down link may have no legal
+			 * route left, in which case it starts over as if it had
+			 * just been injected */
+			if (legal == NOCSIM_HOP_NONE && phase == 1) {
+				legal = nocsim_routing_bfs_hop(graph, dist_updown, r, 1, 0);
+			}
+
+			if (table->algorithm == ALGORITHM_UPDOWN) {
+				*entry = legal;
+				continue;
+			}
+
+			/* escape: prefer a minimal path, and fall back to the
+			 * up* / down* path */
+			minimal = nocsim_routing_bfs_hop(graph, dist, r, 0, 0);
+			hop = NOCSIM_HOP(NOCSIM_HOP_FIRST(minimal), NOCSIM_HOP_FIRST(legal));
+			if (NOCSIM_HOP_FIRST(minimal) == DIR_UNDEF) {
+				hop = legal;
+			} else if (NOCSIM_HOP_FIRST(legal) == NOCSIM_HOP_FIRST(minimal) ||
+					NOCSIM_HOP_FIRST(legal) == DIR_UNDEF) {
+				hop = minimal;
+			}
+			*entry = hop;
+		}
+	}
+}
+
+static void* nocsim_routing_worker(void* arg) {
+	nocsim_routing_job* job = (nocsim_routing_job*) arg;
+	nocsim_routing_graph* graph = job->graph;
+	nocsim_route_table* table = job->table;
+	unsigned int* dist;
+	unsigned int* dist_updown;
+	unsigned int* queue;
+
+	alloc(sizeof(unsigned int) * (graph->num_node + 1), dist);
+	alloc(sizeof(unsigned int) * (2 * graph->num_node + 1), dist_updown);
+	alloc(sizeof(unsigned int) * (2 * graph->num_node + 1), queue);
+
+	for (unsigned int j = job->first ; j < table->num_dest ; j += job->stride) {
+		nocsim_routing_build_dest(graph, table, j, dist, dist_updown, queue);
+	}
+
+	free(dist);
+	free(dist_updown);
+	free(queue);
+
+	return NULL;
+}
+
+/* run one BFS per destination PE, split across threads */
+static void nocsim_routing_build_bfs(nocsim_state* state, nocsim_routing* routing, nocsim_route_table* table) {
+	nocsim_routing_graph* graph;
+	nocsim_routing_job jobs[NOCSIM_ROUTING_MAX_THREADS];
+	pthread_t threads[NOCSIM_ROUTING_MAX_THREADS];
+	unsigned char started[NOCSIM_ROUTING_MAX_THREADS];
+	long nthreads;
+
+	graph = nocsim_routing_graph_create(state, routing, 1);
+
+	nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nthreads > NOCSIM_ROUTING_MAX_THREADS) { nthreads = NOCSIM_ROUTING_MAX_THREADS; }
+	if (nthreads > (long) (table->num_dest / NOCSIM_ROUTING_DEST_PER_THREAD)) {
+		nthreads = table->num_dest / NOCSIM_ROUTING_DEST_PER_THREAD;
+	}
+	if (nthreads < 1) { nthreads = 1; }
+
+	for (long t = 0 ; t < nthreads ; t++) {
+		jobs[t].graph = graph;
+		jobs[t].table = table;
+		jobs[t].first = (unsigned int) t;
+		jobs[t].stride = (unsigned int) nthreads;
+	}
+
+	/* the calling thread takes the first share of the work, if a thread
+	 * cannot be started, it's share is done afterwards instead */
+	for (long t = 1 ; t < nthreads ; t++) {
+		started[t] = pthread_create(&threads[t], NULL, nocsim_routing_worker, &jobs[t]) == 0;
+	}
+
+	nocsim_routing_worker(&jobs[0]);
+
+	for (long t = 1 ; t < nthreads ; t++) {
+		if (started[t]) {
+			pthread_join(threads[t], NULL);
+		} else {
+			nocsim_routing_worker(&jobs[t]);
+		}
+	}
+
+	nocsim_routing_graph_free(graph);
+}
+
+/* fewest hops from every router to every PE, by one breadth first search
+ * backwards from each PE */
+static void nocsim_routing_build_distance(nocsim_state* state, nocsim_routing* routing) {
+	nocsim_routing_graph* graph;
+	unsigned int* dist;
+	unsigned int* queue;
+
+	/* distances are those of the topology without any failures, so
+	 * that detours around failed links show up as path inflation */
+	graph = nocsim_routing_graph_create(state, routing, 0);
+	alloc(sizeof(unsigned int) * (graph->num_node + 1), dist);
+	alloc(sizeof(unsigned int) * (graph->num_node + 1), queue);
+	alloc(sizeof(unsigned int) * ((size_t) state->num_router * state->num_PE + 1), routing->distance);
+
+	for (unsigned int j = 0 ; j < state->num_PE ; j++) {
+		nocsim_routing_bfs(graph, state->num_router + j, dist, queue);
+		for (unsigned int i = 0 ; i < state->num_router ; i++) {
+			routing->distance[(size_t) i * state->num_PE + j] = dist[i];
+		}
+	}
+
+	free(dist);
+	free(queue);
+	nocsim_routing_graph_free(graph);
+}
+
+static nocsim_route_table* nocsim_route_table_create(nocsim_state* state, nocsim_routing* routing, nocsim_algorithm algorithm) {
+	nocsim_route_table* table;
+	unsigned int i;
+	unsigned int j;
+	int drow;
+	int dcol;
+
+	alloc(sizeof(nocsim_route_table), table);
+	table->algorithm = algorithm;
+	table->shared = routing->regular &&
+		(algorithm == ALGORITHM_DOR || algorithm == ALGORITHM_ADOR);
+	table->rows = routing->rows;
+	table->cols = routing->cols;
+	table->num_dest = state->num_PE;
+	table->phases = (algorithm == ALGORITHM_UPDOWN || algorithm == ALGORITHM_ESCAPE) ? 2 : 1;
+
+	if (algorithm == ALGORITHM_TABLE || table->phases > 1) {
+		alloc(sizeof(nocsim_hop) * ((size_t) state->num_router * table->phases * state->num_PE + 1), table->entries);
+		nocsim_routing_build_bfs(state, routing, table);
+
+	} else if (table->shared) {
+		alloc(sizeof(nocsim_hop) * (2 * table->rows - 1) * (2 * table->cols - 1), table->entries);
+
+		for (drow = 1 - (int) table->rows ; drow < (int) table->rows ; drow++) {
+			for (dcol = 1 - (int) table->cols ; dcol < (int) table->cols ; dcol++) {
+				table->entries[
+					(drow + table->rows - 1) * (2 * table->cols - 1) +
+					(dcol + table->cols - 1)] =
+					nocsim_routing_dor_hop(drow, dcol, algorithm == ALGORITHM_ADOR);
+			}
+		}
+
+	} else {
+		alloc(sizeof(nocsim_hop) * ((size_t) state->num_router * state->num_PE + 1), table->entries);
+
+		for (i = 0 ; i < state->num_router ; i++) {
+			for (j = 0 ; j < state->num_PE ; j++) {
+				table->entries[(size_t) i * table->num_dest + j] =
+					nocsim_routing_compute(routing, algorithm,
+						routing->routers[i], routing->PEs[j]);
+			}
+		}
+	}
+
+	return table;
+}
+
+/**
+ * @brief Discard routing tables, for example because the topology has
+ * changed.
+ *
+ * @param state
+ */
+void nocsim_routing_invalidate(nocsim_state* state) {
+	nocsim_routing* routing = state->routing;
+
+	if (routing == NULL) { return; }
+
+	for (int i = 0 ; i < (int) ENUMSIZE_ALGORITHM ; i++) {
+		if (routing->tables[i] == NULL) { continue; }
+		free(routing->tables[i]->entries);
+		free(routing->tables[i]);
+	}
+
+	free(routing->routers);
+	free(routing->PEs);
+	free(routing->attach);
+	free(routing->down_in);
+	free(routing->distance);
+	free(routing);
+
+	state->routing = NULL;
+}
+
+/**
+ * @brief Bring the routing tables up to date after a link has failed or been
+ * repaired.
+ *
+ * Per-router DOR and ADOR tables are recomputed for the router the link
+ * leaves from. For BFS tables, only destinations whose routes may have
+ * changed are searched again. When a link fails, those are the destinations
+ * for which it is one of the router's candidates, since otherwise it is not
+ * the only way onward along any shortest path. When a link is repaired,
+ * those are the destinations it is now on a shortest path to. Legal
+ * up* / down* distances are not kept, so up* / down* and escape tables are
+ * instead discarded when a link is repaired, and rebuilt when next needed.
+ *
+ * @param state
+ * @param link
+ */
+void nocsim_routing_fault(nocsim_state* state, nocsim_link* link) {
+	nocsim_routing* routing = state->routing;
+	nocsim_routing_graph* graph = NULL;
+	nocsim_route_table* table;
+	nocsim_node* router = link->from;
+	nocsim_direction dir = DIR_UNDEF;
+	nocsim_hop hop;
+	unsigned char* affected = NULL;
+	unsigned int* dist = NULL;
+	unsigned int* dist_updown = NULL;
+	unsigned int* queue = NULL;
+	unsigned int* near = NULL;
+	unsigned int* far = NULL;
+	unsigned int r;
+	unsigned int j;
+
+	/* tables only ever route flits out of routers */
+	if (routing == NULL || router->type != node_router) { return; }
+
+	for (nocsim_direction d = N ; d <= P ; d++) {
+		if (router->outgoing[d] == link) { dir = d; }
+	}
+
+	r = router->type_number;
+
+	for (int a = 0 ; a < (int) ENUMSIZE_ALGORITHM ; a++) {
+		table = routing->tables[a];
+		if (table == NULL || table->shared) { continue; }
+
+		if (a == ALGORITHM_DOR || a == ALGORITHM_ADOR) {
+			for (j = 0 ; j < table->num_dest ; j++) {
+				table->entries[(size_t) r * table->num_dest + j] =
+					nocsim_routing_compute(routing, (nocsim_algorithm) a,
+						router, routing->PEs[j]);
+			}
+			continue;
+		}
+
+		if (!link->failed && table->phases > 1) {
+			free(table->entries);
+			free(table);
+			routing->tables[a] = NULL;
+			continue;
+		}
+
+		if (graph == NULL) {
+			graph = nocsim_routing_graph_create(state, routing, 1);
+			alloc(sizeof(unsigned char) * (table->num_dest + 1), affected);
+			alloc(sizeof(unsigned int) * (graph->num_node + 1), dist);
+			alloc(sizeof(unsigned int) * (2 * graph->num_node + 1), dist_updown);
+			alloc(sizeof(unsigned int) * (2 * graph->num_node + 1), queue);
+		}
+
+		for (j = 0 ; j < table->num_dest ; j++) { affected[j] = 0; }
+
+		if (link->failed) {
+			for (j = 0 ; j < table->num_dest ; j++) {
+				for (unsigned int phase = 0 ; phase < table->phases ; phase++) {
+					hop = table->entries[((size_t) r * table->phases + phase) * table->num_dest + j];
+					if (NOCSIM_HOP_FIRST(hop) == dir || NOCSIM_HOP_SECOND(hop) == dir) {
+						affected[j] = 1;
+					}
+				}
+			}
+
+		} else if (link->to->type == node_PE) {
+			affected[link->to->type_number] = 1;
+
+		} else {
+			if (near == NULL) {
+				alloc(sizeof(unsigned int) * (graph->num_node + 1), near);
+				alloc(sizeof(unsigned int) * (graph->num_node + 1), far);
+				nocsim_routing_bfs_from(graph, r, near, queue);
+				nocsim_routing_bfs_from(graph, link->to->type_number, far, queue);
+			}
+
+			for (j = 0 ; j < table->num_dest ; j++) {
+				if (far[graph->num_router + j] == NOCSIM_ROUTING_UNREACHABLE) { continue; }
+				if (far[graph->num_router + j] + 1 <= near[graph->num_router + j]) {
+					affected[j] = 1;
+				}
+			}
+		}
+
+		for (j = 0 ; j < table->num_dest ; j++) {
+			if (affected[j]) {
+				nocsim_routing_build_dest(graph, table, j, dist, dist_updown, queue);
+			}
+		}
+	}
+
+	if (graph != NULL) {
+		nocsim_routing_graph_free(graph);
+	}
+
+	free(affected);
+	free(dist);
+	free(dist_updown);
+	free(queue);
+	free(near);
+	free(far);
+}
+
+/**
+ * @brief Retrieve the routing information for the topology, such as the
+ * routers and PEs indexed by type_number, building it if needed.
+ *
+ * @param state
+ *
+ * @return
+ */
+nocsim_routing* nocsim_routing_get(nocsim_state* state) {
+	if (state->routing == NULL) {
+		state->routing = nocsim_routing_create(state);
+	}
+
+	return state->routing;
+}
+
+/**
+ * @brief Compute the fewest hops in which a flit could travel between two
+ * PEs.
+ *
+ * Hops are counted in the same way as nocsim_flit.hops, so the link from the
+ * PE to it's router is not counted, but the link from the last router to the
+ * destination is. In a regular mesh, this is the distance between the rows
+ * and columns of the PEs, plus one.
+ *
+ * @param state
+ * @param from PE the flit is spawned at
+ * @param to PE the flit is destined for
+ *
+ * @return the distance, or 0 if there is no path
+ */
+unsigned long nocsim_routing_distance(nocsim_state* state, nocsim_node* from, nocsim_node* to) {
+	nocsim_routing* routing;
+	nocsim_node* router;
+	nocsim_node* attach;
+	unsigned int dist;
+
+	if (from->outgoing[P] == NULL || from->outgoing[P]->to->type != node_router) { return 0; }
+	if (to->type != node_PE) { return 0; }
+
+	router = from->outgoing[P]->to;
+	routing = nocsim_routing_get(state);
+
+	if (routing->regular) {
+		attach = routing->attach[to->type_number];
+		return abs((int) attach->row - (int) router->row) +
+			abs((int) attach->col - (int) router->col) + 1;
+	}
+
+	if (routing->distance == NULL) {
+		nocsim_routing_build_distance(state, routing);
+	}
+
+	dist = routing->distance[(size_t) router->type_number * state->num_PE + to->type_number];
+	return (dist == NOCSIM_ROUTING_UNREACHABLE) ? 0 : dist;
+}
+
+/**
+ * @brief Retrieve the next-hop table for an algorithm, building it if needed.
+ *
+ * @param state
+ * @param algorithm
+ *
+ * @return
+ */
+nocsim_route_table* nocsim_routing_table(nocsim_state* state, nocsim_algorithm algorithm) {
+	nocsim_routing_get(state);
+
+	if (state->routing->tables[algorithm] == NULL) {
+		state->routing->tables[algorithm] = \
+			nocsim_route_table_create(state, state->routing, algorithm);
+	}
+
+	return state->routing->tables[algorithm];
+}
+
+/**
+ * @brief Look up the candidate outgoing directions for a flit.
+ *
+ * @param state
+ * @param table
+ * @param router router making the routing decision
+ * @param from direction the flit arrived from, or BACKLOG
+ * @param dest destination PE of the flit
+ *
+ * @return
+ */
+nocsim_hop nocsim_routing_lookup(nocsim_state* state, nocsim_route_table* table, nocsim_node* router, nocsim_direction from, nocsim_node* dest) {
+	nocsim_node* attach;
+	unsigned int phase = 0;
+
+	if (table->shared) {
+		attach = state->routing->attach[dest->type_number];
+		return table->entries[
+			((int) attach->row - (int) router->row + table->rows - 1) * (2 * table->cols - 1) +
+			((int) attach->col - (int) router->col + table->cols - 1)];
+	}
+
+	/* flits leaving the backlog may travel up again */
+	if (table->phases > 1 && from < NOCSIM_NUM_LINKS) {
+		phase = (state->routing->down_in[router->type_number] >> from) & 1;
+	}
+
+	return table->entries[((size_t) router->type_number * table->phases + phase) * table->num_dest + dest->type_number];
+}
+
+/**
+ * @brief Lock the topology, and precompute everything the simulation needs.
+ *
+ * Verifies that every PE is attached to a router, builds the layout, and
+ * builds next-hop tables for each native algorithm used by a router. After
+ * this, no further nodes or links may be created.
+ *
+ * @param state
+ *
+ * @return
+ */
+nocsim_result nocsim_finalize(nocsim_state* state) {
+	nocsim_node* cursor;
+	unsigned int i;
+
+	if (state->finalized) { return NOCSIM_RESULT_OK; }
+
+	vec_foreach(state->nodes, cursor, i) {
+		if (cursor->type != node_PE) { continue; }
+
+		if (cursor->outgoing[P] == NULL || cursor->outgoing[P]->to->type != node_router) {
+			nocsim_return_error(state, "PE %s has no outgoing link to a router", cursor->id);
+		}
+
+		if (cursor->incoming[P] == NULL || cursor->incoming[P]->from->type != node_router) {
+			nocsim_return_error(state, "PE %s has no incoming link from a router", cursor->id);
+		}
+	}
+
+	if (state->layout == NULL) {
+		nocsim_layout_build(state);
+	}
+
+	vec_foreach(state->nodes, cursor, i) {
+		if (cursor->type != node_router || cursor->native == NULL) { continue; }
+
+		if (nocsim_native_algorithm(cursor->native) != ENUMSIZE_ALGORITHM) {
+			nocsim_routing_table(state, nocsim_native_algorithm(cursor->native));
+		}
+	}
+
+	state->finalized = 1;
+
+	return NOCSIM_RESULT_OK;
+}
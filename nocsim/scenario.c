@@ -0,0 +1,503 @@
+#include "nocsim.h"
+
+/* This file contains methods relating to scenarios, which describe a complete
+ * simulation declaratively, so that it can be run by nocsim-run without a TCL
+ * interpreter.
+ *
+ * A scenario file consists of one statement per line. Blank lines, and
+ * anything following a #, are ignored. Topology statements are applied as
+ * they are read, and phases are run in order once the whole file has been
+ * read, see doc/nocsim-run.md.
+ *
+ *	title TEXT
+ *	seed N
+ *	mesh ROWS COLS INJECT_BEHAVIOR ROUTE_BEHAVIOR
+ *	router ID ROW COL BEHAVIOR
+ *	PE ID ROW COL BEHAVIOR
+ *	link FROM TO ?FROM_DIR? ?TO_DIR?
+ *	load NETLIST
+ *	injectrate P / injectrate ID P
+ *	arbitration POLICY ?DIR DIR DIR DIR DIR?
+ *	phase NAME TICKS ?P?
+ *	heatmap
+ *	histogram
+ *	energy ?MODEL?
+ *	output FILE
+ *
+ * Results are written as JSON, with one object per phase.
+ * */
+
+#define NOCSIM_SCENARIO_MAX_ARGS 8
+
+/* fail while loading, prefixing the error with the location in the file --
+ * the arguments may point into line, so the error is formatted first */
+#define scenario_error(fmt, ...) do { \
+		char* __se_buf = alloc_printf("%s:%u: " fmt, path, lineno, __VA_ARGS__); \
+		fclose(stream); \
+		free(line); \
+		nocsim_scenario_free(result); \
+		free(state->errstr); \
+		state->errstr = __se_buf; \
+		return NOCSIM_RESULT_ERROR; \
+	} while (0)
+
+#define scenario_args(n, usage) do { \
+		if (argc != n) { scenario_error("usage: %s", usage); } \
+	} while (0)
+
+static int nocsim_scenario_uint(const char* s, unsigned long* value) {
+	char* end;
+
+	if (*s == '-') { return 0; }
+
+	errno = 0;
+	*value = strtoul(s, &end, 10);
+	return (errno == 0 && *end == '\0');
+}
+
+static int nocsim_scenario_P(const char* s, float* value) {
+	char* end;
+
+	errno = 0;
+	*value = strtof(s, &end);
+	return (errno == 0 && *end == '\0' && *value >= 0 && *value <= 1);
+}
+
+/* resolve a path given in a scenario, relative paths are relative to the
+ * scenario itself */
+static char* nocsim_scenario_path(const char* scenario, const char* path) {
+	if (path[0] == '/' || strrchr(scenario, '/') == NULL) {
+		return strdup(path);
+	}
+
+	return alloc_printf("%.*s/%s",
+		(int) (strrchr(scenario, '/') - scenario), scenario, path);
+}
+
+/**
+ * @brief Read a scenario file, creating the topology it describes.
+ *
+ * On success, the caller is responsible for freeing the scenario with
+ * nocsim_scenario_free().
+ *
+ * @param state
+ * @param path
+ * @param scenario will be set to the scenario read from the file
+ *
+ * @return
+ */
+nocsim_result nocsim_scenario_load(nocsim_state* state, const char* path, nocsim_scenario** scenario) {
+	nocsim_scenario* result;
+	nocsim_phase phase;
+	nocsim_node* node;
+	FILE* stream;
+	char* line = NULL;
+	size_t linecap = 0;
+	char* argv[NOCSIM_SCENARIO_MAX_ARGS];
+	char* saveptr;
+	char* token;
+	unsigned int argc;
+	unsigned int lineno = 0;
+	unsigned long rows;
+	unsigned long cols;
+	unsigned long seed;
+	float P_inject;
+	nocsim_direction from_dir;
+	nocsim_direction to_dir;
+	char* netlist;
+	char* model;
+	nocsim_direction priority[NOCSIM_NUM_LINKS];
+
+	if ((stream = fopen(path, "r")) == NULL) {
+		nocsim_return_error(state, "could not open scenario '%s': %s", path, strerror(errno));
+	}
+
+	alloc(sizeof(nocsim_scenario), result);
+	result->title = NULL;
+	result->output = NULL;
+	result->heatmap = 0;
+	result->histogram = 0;
+	result->energy = 0;
+	vec_init(&(result->phases));
+
+	while (getline(&line, &linecap, stream) != -1) {
+		lineno++;
+
+		if ((token = strchr(line, '#')) != NULL) { *token = '\0'; }
+		line[strcspn(line, "\r\n")] = '\0';
+
+		argc = 0;
+		for (token = strtok_r(line, " \t", &saveptr) ;
+				token != NULL ;
+				token = strtok_r(NULL, " \t", &saveptr)) {
+			if (argc == NOCSIM_SCENARIO_MAX_ARGS) {
+				scenario_error("%s", "too many arguments");
+			}
+			argv[argc++] = token;
+
+			/* the title is the rest of the line, as is */
+			if (argc == 1 && !strcmp(token, "title")) {
+				token = saveptr + strspn(saveptr, " \t");
+				for (size_t n = strlen(token) ; n > 0 && (token[n - 1] == ' ' || token[n - 1] == '\t') ; n--) {
+					token[n - 1] = '\0';
+				}
+				if (*token != '\0') { argv[argc++] = token; }
+				break;
+			}
+		}
+
+		if (argc == 0) { continue; }
+
+		if (!strcmp(argv[0], "title")) {
+			scenario_args(2, "title TEXT");
+			free(result->title);
+			result->title = strdup(argv[1]);
+
+		} else if (!strcmp(argv[0], "seed")) {
+			scenario_args(2, "seed N");
+			if (!nocsim_scenario_uint(argv[1], &seed)) {
+				scenario_error("invalid seed '%s'", argv[1]);
+			}
+			state->RNG_seed = (unsigned int) seed;
+			srand(state->RNG_seed);
+
+		} else if (!strcmp(argv[0], "mesh")) {
+			scenario_args(5, "mesh ROWS COLS INJECT_BEHAVIOR ROUTE_BEHAVIOR");
+			if (!nocsim_scenario_uint(argv[1], &rows) || !nocsim_scenario_uint(argv[2], &cols)) {
+				scenario_error("invalid mesh size '%s' by '%s'", argv[1], argv[2]);
+			}
+			if (nocsim_grid_create_mesh(state, rows, cols, strdup(argv[3]), strdup(argv[4])) != NOCSIM_RESULT_OK) {
+				scenario_error("%s", state->errstr);
+			}
+
+		} else if (!strcmp(argv[0], "router") || !strcmp(argv[0], "PE")) {
+			scenario_args(5, "router|PE ID ROW COL BEHAVIOR");
+			if (!nocsim_scenario_uint(argv[2], &rows) || !nocsim_scenario_uint(argv[3], &cols)) {
+				scenario_error("invalid row '%s' or column '%s'", argv[2], argv[3]);
+			}
+			if (nocsim_node_by_id(state, argv[1]) != NULL) {
+				scenario_error("a node with the ID %s exists already", argv[1]);
+			}
+
+			/* node IDs and behaviors are owned by the nodes */
+			if ((!strcmp(argv[0], "router") ?
+				nocsim_grid_create_router(state, strdup(argv[1]), rows, cols, strdup(argv[4])) :
+				nocsim_grid_create_PE(state, strdup(argv[1]), rows, cols, strdup(argv[4])))
+					!= NOCSIM_RESULT_OK) {
+				scenario_error("%s", state->errstr);
+			}
+
+		} else if (!strcmp(argv[0], "link")) {
+			if (argc < 3 || argc > 5) {
+				scenario_error("usage: %s", "link FROM TO ?FROM_DIR? ?TO_DIR?");
+			}
+
+			from_dir = (argc > 3) ? NOCSIM_STR_TO_DIRECTION(argv[3]) : DIR_UNDEF;
+			to_dir = (argc > 4) ? NOCSIM_STR_TO_DIRECTION(argv[4]) : DIR_UNDEF;
+			if ((argc > 3 && from_dir == DIR_UNDEF) || (argc > 4 && to_dir == DIR_UNDEF)) {
+				scenario_error("invalid direction '%s'", argv[argc - 1]);
+			}
+
+			if (nocsim_grid_create_link(state, argv[1], argv[2], from_dir, to_dir) != NOCSIM_RESULT_OK) {
+				scenario_error("%s", state->errstr);
+			}
+
+		} else if (!strcmp(argv[0], "load")) {
+			scenario_args(2, "load NETLIST");
+
+			netlist = nocsim_scenario_path(path, argv[1]);
+			if (nocsim_netlist_load(state, netlist) != NOCSIM_RESULT_OK) {
+				free(netlist);
+				scenario_error("%s", state->errstr);
+			}
+			free(netlist);
+
+		} else if (!strcmp(argv[0], "injectrate")) {
+			if (argc != 2 && argc != 3) {
+				scenario_error("usage: %s", "injectrate P / injectrate ID P");
+			}
+			if (!nocsim_scenario_P(argv[argc - 1], &P_inject)) {
+				scenario_error("%s", "P must be between 0 and 1");
+			}
+
+			node = NULL;
+			if (argc == 3 && (node = nocsim_node_by_id(state, argv[1])) == NULL) {
+				scenario_error("no node with the ID %s", argv[1]);
+			}
+
+			nocsim_set_injectrate(state, node, P_inject);
+
+		} else if (!strcmp(argv[0], "arbitration")) {
+			if (argc != 2 && argc != 2 + NOCSIM_NUM_LINKS) {
+				scenario_error("usage: %s", "arbitration POLICY ?DIR DIR DIR DIR DIR?");
+			}
+
+			for (unsigned int i = 2 ; i < argc ; i++) {
+				if ((priority[i - 2] = NOCSIM_STR_TO_DIRECTION(argv[i])) == DIR_UNDEF) {
+					scenario_error("invalid direction '%s'", argv[i]);
+				}
+			}
+
+			if (nocsim_set_arbitration(state, NOCSIM_STR_TO_ARBITRATION(argv[1]),
+						(argc > 2) ? priority : NULL) != NOCSIM_RESULT_OK) {
+				scenario_error("%s", state->errstr);
+			}
+
+		} else if (!strcmp(argv[0], "phase")) {
+			if (argc != 3 && argc != 4) {
+				scenario_error("usage: %s", "phase NAME TICKS ?P?");
+			}
+			if (!nocsim_scenario_uint(argv[2], &(phase.ticks))) {
+				scenario_error("invalid number of ticks '%s'", argv[2]);
+			}
+
+			phase.P_inject = -1;
+			if (argc == 4 && !nocsim_scenario_P(argv[3], &(phase.P_inject))) {
+				scenario_error("%s", "P must be between 0 and 1");
+			}
+
+			phase.name = strdup(argv[1]);
+			vec_push(&(result->phases), phase);
+
+		} else if (!strcmp(argv[0], "heatmap")) {
+			scenario_args(1, "heatmap");
+			result->heatmap = 1;
+
+		} else if (!strcmp(argv[0], "histogram")) {
+			scenario_args(1, "histogram");
+			result->histogram = 1;
+
+		} else if (!strcmp(argv[0], "energy")) {
+			if (argc != 1 && argc != 2) {
+				scenario_error("usage: %s", "energy ?MODEL?");
+			}
+
+			if (argc == 2) {
+				model = nocsim_scenario_path(path, argv[1]);
+				if (nocsim_energy_load_model(state, model) != NOCSIM_RESULT_OK) {
+					free(model);
+					scenario_error("%s", state->errstr);
+				}
+				free(model);
+			}
+
+			result->energy = 1;
+
+		} else if (!strcmp(argv[0], "output")) {
+			scenario_args(2, "output FILE");
+			free(result->output);
+			result->output = strdup(argv[1]);
+
+		} else {
+			scenario_error("unknown statement '%s'", argv[0]);
+		}
+	}
+
+	fclose(stream);
+	free(line);
+
+	if (result->phases.length == 0) {
+		nocsim_scenario_free(result);
+		nocsim_return_error(state, "%s: scenario has no phases", path);
+	}
+
+	*scenario = result;
+	return NOCSIM_RESULT_OK;
+}
+
+#undef scenario_args
+#undef scenario_error
+
+/* write a string as a JSON string literal */
+static void nocsim_scenario_json_string(FILE* stream, const char* s) {
+	fputc('"', stream);
+	for ( ; *s != '\0' ; s++) {
+		if (*s == '"' || *s == '\\') {
+			fprintf(stream, "\\%c", *s);
+		} else if ((unsigned char) *s < 0x20) {
+			fprintf(stream, "\\u%04x", (unsigned char) *s);
+		} else {
+			fputc(*s, stream);
+		}
+	}
+	fputc('"', stream);
+}
+
+static double nocsim_scenario_now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void nocsim_scenario_heatmap(FILE* stream, nocsim_state* state, unsigned long ticks) {
+	unsigned int rows = state->max_row + 1;
+	unsigned int cols = state->max_col + 1;
+	long* grids;
+
+	alloc(sizeof(long) * ENUMSIZE_HEATMAP * rows * cols, grids);
+	nocsim_heatmap_collect(state, grids, rows, cols);
+
+	fprintf(stream, ",\n\t\t\"heatmap\": {\"ticks\": %lu", ticks);
+	for (int m = 0 ; m < (int) ENUMSIZE_HEATMAP ; m++) {
+		fprintf(stream, ",\n\t\t\t\"%s\": [", (NOCSIM_HEATMAP_METRIC_TO_STR((nocsim_heatmap_metric) m)));
+		for (unsigned int row = 0 ; row < rows ; row++) {
+			fprintf(stream, "%s[", row == 0 ? "" : ", ");
+			for (unsigned int col = 0 ; col < cols ; col++) {
+				fprintf(stream, "%s%ld", col == 0 ? "" : ", ",
+					grids[((size_t) m * rows + row) * cols + col]);
+			}
+			fprintf(stream, "]");
+		}
+		fprintf(stream, "]");
+	}
+	fprintf(stream, "}");
+
+	free(grids);
+}
+
+static void nocsim_scenario_histogram(FILE* stream, nocsim_state* state) {
+	unsigned long length;
+
+	fprintf(stream, ",\n\t\t\"histogram\": {");
+	for (int m = 0 ; m < (int) ENUMSIZE_HISTOGRAM ; m++) {
+		length = nocsim_histogram_length(state, (nocsim_histogram_metric) m);
+		fprintf(stream, "%s\n\t\t\t\"%s\": [", m == 0 ? "" : ",",
+			(NOCSIM_HISTOGRAM_METRIC_TO_STR((nocsim_histogram_metric) m)));
+		for (unsigned long v = 0 ; v < length ; v++) {
+			fprintf(stream, "%s%lu", v == 0 ? "" : ", ", state->histogram.counts[m][v]);
+		}
+		fprintf(stream, "]");
+	}
+	fprintf(stream, "}");
+}
+
+static void nocsim_scenario_energy(FILE* stream, nocsim_state* state) {
+	double energy[(int) ENUMSIZE_ENERGY];
+	double total = 0;
+
+	nocsim_energy_total(state, energy);
+	for (int e = 0 ; e < (int) ENUMSIZE_ENERGY ; e++) {
+		total += energy[e];
+	}
+
+	fprintf(stream, ",\n\t\t\"energy\": {\"total\": %.6f", total);
+	for (int e = 0 ; e < (int) ENUMSIZE_ENERGY ; e++) {
+		fprintf(stream, ", \"%s\": %.6f",
+			(NOCSIM_ENERGY_EVENT_TO_STR((nocsim_energy_event) e)), energy[e]);
+	}
+	fprintf(stream, "}");
+}
+
+/**
+ * @brief Finalize the topology, and run each phase of a scenario, writing
+ * the results to the scenario's output.
+ *
+ * @param state
+ * @param scenario
+ *
+ * @return
+ */
+nocsim_result nocsim_scenario_run(nocsim_state* state, nocsim_scenario* scenario) {
+	FILE* stream = stdout;
+	nocsim_phase* phase;
+	unsigned int i;
+	unsigned long start;
+	long spawned;
+	long injected;
+	long dequeued;
+	long routed;
+	long backrouted;
+	long arrived;
+	double time;
+
+	if (nocsim_finalize(state) != NOCSIM_RESULT_OK) {
+		return NOCSIM_RESULT_ERROR;
+	}
+
+	if (scenario->output != NULL && (stream = fopen(scenario->output, "w")) == NULL) {
+		nocsim_return_error(state, "could not open output '%s': %s",
+			scenario->output, strerror(errno));
+	}
+
+	fprintf(stream, "{\n\t\"version\": \"%s\",\n\t\"title\": ", NOC_TOOLS_VERSION);
+	nocsim_scenario_json_string(stream, scenario->title == NULL ? "unspecified" : scenario->title);
+	fprintf(stream, ",\n\t\"seed\": %u,\n\t\"routers\": %u,\n\t\"PEs\": %u,\n\t\"links\": %u,\n\t\"phases\": [",
+		state->RNG_seed, state->num_router, state->num_PE, state->links->length);
+
+	vec_foreach_ptr(&(scenario->phases), phase, i) {
+		if (phase->P_inject >= 0) {
+			nocsim_set_injectrate(state, NULL, phase->P_inject);
+		}
+
+		if (scenario->heatmap) { nocsim_heatmap_reset(state); }
+		if (scenario->histogram) { nocsim_histogram_reset(state); }
+		if (scenario->energy) { nocsim_energy_reset(state); }
+
+		start = state->tick;
+		spawned = state->spawned;
+		injected = state->injected;
+		dequeued = state->dequeued;
+		routed = state->routed;
+		backrouted = state->backrouted;
+		arrived = state->arrived;
+		time = nocsim_scenario_now();
+
+		for (unsigned long t = 0 ; t < phase->ticks ; t++) {
+			nocsim_step(state, NULL);
+		}
+
+		time = nocsim_scenario_now() - time;
+
+		fprintf(stream, "%s\n\t{\n\t\t\"name\": ", i == 0 ? "" : ",");
+		nocsim_scenario_json_string(stream, phase->name);
+		fprintf(stream, ",\n\t\t\"start\": %lu,\n\t\t\"ticks\": %lu,\n\t\t\"seconds\": %.6f",
+			start, phase->ticks, time);
+		fprintf(stream, ",\n\t\t\"spawned\": %ld,\n\t\t\"injected\": %ld,\n\t\t\"dequeued\": %ld",
+			state->spawned - spawned, state->injected - injected, state->dequeued - dequeued);
+		fprintf(stream, ",\n\t\t\"routed\": %ld,\n\t\t\"backrouted\": %ld,\n\t\t\"arrived\": %ld",
+			state->routed - routed, state->backrouted - backrouted, state->arrived - arrived);
+		fprintf(stream, ",\n\t\t\"accepted\": %.6f",
+			(phase->ticks == 0 || state->num_PE == 0) ? 0.0 :
+			(double) (state->arrived - arrived) / ((double) phase->ticks * state->num_PE));
+
+		if (scenario->heatmap) {
+			nocsim_scenario_heatmap(stream, state, phase->ticks);
+		}
+
+		if (scenario->histogram) {
+			nocsim_scenario_histogram(stream, state);
+		}
+
+		if (scenario->energy) {
+			nocsim_scenario_energy(stream, state);
+		}
+
+		fprintf(stream, "\n\t}");
+	}
+
+	fprintf(stream, "\n\t]\n}\n");
+
+	if (stream != stdout) {
+		fclose(stream);
+	} else {
+		fflush(stream);
+	}
+
+	return NOCSIM_RESULT_OK;
+}
+
+void nocsim_scenario_free(nocsim_scenario* scenario) {
+	nocsim_phase* phase;
+	unsigned int i;
+
+	if (scenario == NULL) { return; }
+
+	vec_foreach_ptr(&(scenario->phases), phase, i) {
+		free(phase->name);
+	}
+	vec_deinit(&(scenario->phases));
+
+	free(scenario->title);
+	free(scenario->output);
+	free(scenario);
+}
@@ -1,92 +1,288 @@
 #include "nocsim.h"
 
+/**
+ * @brief Initialize a simulation state with an empty topology.
+ *
+ * This does not depend on TCL, and state->interp is left NULL, in which
+ * case only native behaviors may be used. nocsim_create_state() attaches the
+ * state to an interpreter.
+ *
+ * @param state
+ */
+void nocsim_init_state(nocsim_state* state) {
+	nodelist* l;
+	linklist* links;
+
+	alloc(sizeof(nodelist), l);
+	alloc(sizeof(linklist), links);
+
+	state->RNG_seed = (unsigned int) time(NULL);
+	state->num_PE = 0;
+	state->num_router = 0;
+	state->num_node = 0;
+	state->flit_no = 0;
+	state->tick = 0;
+	state->title = NULL; /* allocated as a linked var by nocsim_create_state() */
+	state->current = NULL;
+	state->max_row = 0;
+	state->max_col = 0;
+	state->injected = 0;
+	state->dequeued = 0;
+	state->spawned = 0;
+	state->backrouted = 0;
+	state->routed = 0;
+	state->arrived = 0;
+	state->retried = 0;
+	state->errstr = NULL;
+	state->interp = NULL;
+
+	for (int i = 0 ; i < (int) ENUMSIZE_INSTRUMENT ; i++) {
+		state->instruments[i] = NULL;
+		state->filters[i] = NULL;
+	}
+
+	vec_init(l);
+	state->nodes = l;
+	state->node_map = kh_init(nnptr);
+
+	vec_init(links);
+	state->links = links;
+	state->link_slab = NULL;
+	state->link_slab_len = 0;
+	state->layout = NULL;
+	state->routing = NULL;
+	state->finalized = 0;
+	state->default_P_inject = 0;
+	state->heatmap.window = 0;
+	state->heatmap.start = 0;
+	state->heatmap.ticks = 0;
+	state->heatmap.rows = 0;
+	state->heatmap.cols = 0;
+	state->heatmap.grids = NULL;
+	for (int i = 0 ; i < (int) ENUMSIZE_HISTOGRAM ; i++) {
+		state->histogram.counts[i] = NULL;
+		state->histogram.size[i] = 0;
+	}
+	nocsim_arbitration_reset(state);
+	nocsim_energy_default_model(state);
+	state->energy.start = 0;
+	vec_init(&(state->faults));
+
+#ifdef NOCSIM_PROFILE
+	state->profile.behaviors = NULL;
+	nocsim_profile_reset(state);
+#endif
+}
+
+/**
+ * @brief Free a simulation state, and everything it owns.
+ *
+ * Node IDs and behaviors are not freed, as they are owned by the caller that
+ * created the node.
+ *
+ * @param s
+ */
+void nocsim_free_state(nocsim_state* s) {
+	nocsim_link* l;
+	nocsim_node* n;
+	unsigned int i;
+	unsigned int j;
+	nocsim_flit* f;
+
+	/* destroy all links */
+	vec_foreach(s->links, l, i) {
+		if (l->flit != NULL) {
+			free(l->flit);
+		}
+		if (!nocsim_link_in_slab(s, l)) {
+			free(l);
+		}
+	}
+	free(s->link_slab);
+	nocsim_layout_invalidate(s);
+	nocsim_routing_invalidate(s);
+	free(s->heatmap.grids);
+	nocsim_histogram_free(s);
+	vec_deinit(&(s->faults));
+
+	for (int i = 0 ; i < (int) ENUMSIZE_INSTRUMENT ; i++) {
+		nocsim_instrument_filter_free(s->filters[i]);
+	}
+
+#ifdef NOCSIM_PROFILE
+	const char* behavior;
+	nocsim_profile_counter* counter;
+	kh_foreach(s->profile.behaviors, behavior, counter, {
+		free((char*) behavior);
+		free(counter);
+	});
+	kh_destroy(prof, s->profile.behaviors);
+#endif
+
+	/* destroy all nodes */
+	vec_foreach(s->nodes, n, i) {
+		if (n->type == node_PE || n->type == node_router) {
+			vec_foreach(n->pending, f, j) {
+				free(f);
+			}
+			vec_deinit(n->pending);
+			free(n->pending);
+		}
+		free(n);
+	}
+
+	/* free node map */
+	kh_destroy(nnptr, s->node_map);
+
+	/* free node list */
+	vec_deinit(s->nodes);
+	free(s->nodes);
+
+	/* free link list */
+	vec_deinit(s->links);
+	free(s->links);
+
+	/* free error string */
+	if (s->errstr != NULL) {
+		free(s->errstr);
+	}
+
+	free(s);
+}
+
 void next_state(nocsim_state* state, Tcl_Interp* interp) {
 	unsigned int i;
 	nocsim_node* cursor;
 
+	nocsim_profile_begin(behavior_start);
 	vec_foreach(state->nodes, state->current, i) {
-		if (Tcl_Eval(interp, state->current->behavior) != TCL_OK) {
+		nocsim_profile_begin(node_start);
+		if (state->current->type == node_router) {
+			nocsim_arbitrate(state, state->current);
+		}
+
+		if (state->current->native != NULL) {
+			state->current->native(state, state->current);
+		} else if (Tcl_Eval(interp, state->current->behavior) != TCL_OK) {
 			print_tcl_error(interp);
 			err(1, "unable to proceed, exiting with failure state");
 		}
+		nocsim_profile_end(node_start, *nocsim_profile_behavior(state, state->current));
 	}
+	nocsim_profile_end(behavior_start, state->profile.phases[PROFILE_BEHAVIOR]);
 
 	/* PEs send packets into links */
-	vec_foreach(state->nodes, cursor, i) {
-		if (cursor->type != node_PE) { continue; }
+	nocsim_profile_begin(dequeue_start);
+	for (i = 0 ; i < state->layout->num_node ; i++) {
+		state->layout->order[i]->occupancy += state->layout->pending[i]->length;
 
-		if (cursor->pending->length > 0) {
+		if (state->layout->type[i] != node_PE) { continue; }
+		if (state->layout->pending[i]->length == 0) { continue; }
 
-			if (cursor->outgoing[P] == NULL) {
-				err(1, "PE %s does not have an outgoing link", cursor->id);
-			}
+		cursor = state->layout->order[i];
 
-			cursor->outgoing[P]->flit_next = \
-				vec_dequeue(cursor->pending);
-
-			cursor->outgoing[P]->flit_next->injected_at = state->tick;
-
-			state->dequeued ++;
-			cursor->dequeued ++;
-			if (state->instruments[INSTRUMENT_DEQUEUE] != NULL) {
-				if (Tcl_Evalf(state->interp, "%s \"%s\" \"%s\" %lu",
-							state->instruments[INSTRUMENT_DEQUEUE],
-							cursor->id,
-							cursor->outgoing[P]->flit_next->to->id,
-							cursor->outgoing[P]->flit_next->flit_no)) {
-					print_tcl_error(state->interp);
-					err(1, "unable to proceed, exiting with failure state");
-				}
+		if (cursor->outgoing[P] == NULL) {
+			err(1, "PE %s does not have an outgoing link", cursor->id);
+		}
+
+		/* flits wait in the FIFO until the link is repaired */
+		if (cursor->outgoing[P]->failed) { continue; }
+
+		cursor->outgoing[P]->flit_next = \
+			vec_dequeue(cursor->pending);
+
+		cursor->outgoing[P]->flit_next->injected_at = state->tick;
+		cursor->outgoing[P]->carried ++;
+		cursor->outgoing[P]->traversals ++;
+
+		state->dequeued ++;
+		cursor->dequeued ++;
+		if (nocsim_instrument_enabled(state, INSTRUMENT_DEQUEUE, cursor->outgoing[P]->flit_next)) {
+			nocsim_profile_begin(instrument_start);
+			if (Tcl_Evalf(state->interp, "%s \"%s\" \"%s\" %lu",
+						state->instruments[INSTRUMENT_DEQUEUE],
+						cursor->id,
+						cursor->outgoing[P]->flit_next->to->id,
+						cursor->outgoing[P]->flit_next->flit_no)) {
+				print_tcl_error(state->interp);
+				err(1, "unable to proceed, exiting with failure state");
 			}
+			nocsim_profile_end(instrument_start, state->profile.instruments[INSTRUMENT_DEQUEUE]);
 		}
 	}
+	nocsim_profile_end(dequeue_start, state->profile.phases[PROFILE_DEQUEUE]);
 
 }
 
 void flip_state(nocsim_state* state) {
 	unsigned int i;
-	nocsim_node* cursor;
-
-	vec_foreach(state->nodes, cursor, i) {
-		for (nocsim_direction dir = N ; dir <= P ; dir++) {
-			if (cursor->incoming[dir] != NULL) {
-				if (cursor->incoming[dir]->flit != NULL) {
-					err(1, "invalid state: router %s has unhandled incoming flits after behavior execution",
-						cursor->id);
-				}
-
-				cursor->incoming[dir]->flit = \
-					cursor->incoming[dir]->flit_next;
-				cursor->incoming[dir]->flit_next = NULL;
-			}
+	nocsim_layout* layout = state->layout;
+	nocsim_link* link;
+	unsigned int* slots;
+
+	/* the links are contiguous, so they can be flipped without visiting
+	 * the nodes at all */
+	nocsim_profile_begin(flip_start);
+	for (i = 0 ; i < state->link_slab_len ; i++) {
+		link = &(state->link_slab[i]);
+
+		if (link->flit != NULL) {
+			err(1, "invalid state: router %s has unhandled incoming flits after behavior execution",
+				link->to->id);
 		}
+
+		link->flit = link->flit_next;
+		link->flit_next = NULL;
+		link->busy += (link->flit != NULL);
 	}
+	nocsim_profile_end(flip_start, state->profile.phases[PROFILE_FLIP]);
 
 	/* check if packet arrived */
-	vec_foreach(state->nodes, cursor, i) {
+	nocsim_profile_begin(arrival_start);
+	for (i = 0 ; i < layout->num_node ; i++) {
+		slots = &(layout->slots[i * NOCSIM_NUM_LINKS]);
 		for (nocsim_direction dir = N ; dir <= P ; dir++) {
-			if (cursor->incoming[dir] != NULL) {
-				nocsim_handle_arrival(state, cursor, dir);
-			}
-
+			if (slots[dir] == NOCSIM_LAYOUT_NO_LINK) { continue; }
+			if (state->link_slab[slots[dir]].flit == NULL) { continue; }
+			nocsim_handle_arrival(state, layout->order[i], dir);
 		}
 	}
+	nocsim_profile_end(arrival_start, state->profile.phases[PROFILE_ARRIVAL]);
 
 }
 
 void nocsim_step(nocsim_state* state, Tcl_Interp* interp) {
+	nocsim_profile_begin(step_start);
+
+	if (state->faults.length > 0) {
+		nocsim_fault_tick(state);
+	}
 
-	if (state->instruments[INSTRUMENT_TICK] != NULL) {
+	if (nocsim_instrument_enabled(state, INSTRUMENT_TICK, NULL)) {
+		nocsim_profile_begin(instrument_start);
 		if (Tcl_Eval(interp, state->instruments[INSTRUMENT_TICK]) != TCL_OK) {
 			print_tcl_error(interp);
 			err(1, "unable to proceed, exiting with failure state");
 		}
+		nocsim_profile_end(instrument_start, state->profile.instruments[INSTRUMENT_TICK]);
+	}
+
+	if (state->layout == NULL) {
+		nocsim_profile_begin(layout_start);
+		nocsim_layout_build(state);
+		nocsim_profile_end(layout_start, state->profile.phases[PROFILE_LAYOUT]);
 	}
 
 	next_state(state, interp);
 	flip_state(state);
 
 	state->tick++;
+
+	nocsim_profile_begin(heatmap_start);
+	nocsim_heatmap_tick(state);
+	nocsim_profile_end(heatmap_start, state->profile.phases[PROFILE_HEATMAP]);
+
+	nocsim_profile_end(step_start, state->profile.phases[PROFILE_STEP]);
 }
 
 /**
@@ -113,18 +309,23 @@ void nocsim_handle_arrival(nocsim_state* state, nocsim_node* cursor, nocsim_dire
 
 		state->arrived ++;
 		cursor->arrived ++;
+		nocsim_histogram_arrive(state, flit);
 
-		if (state->instruments[INSTRUMENT_ARRIVE] != NULL) {
-			if (Tcl_Evalf(state->interp, "%s \"%s\" \"%s\" %lu %lu %lu %lu",
+		if (nocsim_instrument_enabled(state, INSTRUMENT_ARRIVE, flit)) {
+			nocsim_profile_begin(instrument_start);
+			if (Tcl_Evalf(state->interp, "%s \"%s\" \"%s\" %lu %lu %lu %lu %lu %lu %lu",
 						state->instruments[INSTRUMENT_ARRIVE],
 						flit->from->id, flit->to->id,
 						flit->flit_no,
 						flit->hops, flit->spawned_at,
-						flit->injected_at
+						flit->injected_at,
+						flit->deflections, flit->backlog,
+						flit->distance
 						)) {
 				print_tcl_error(state->interp);
 				err(1, "unable to proceed, exiting with failure state");
 			}
+			nocsim_profile_end(instrument_start, state->profile.instruments[INSTRUMENT_ARRIVE]);
 		}
 
 		/* delete the flit */
@@ -148,7 +349,8 @@ void nocsim_handle_arrival(nocsim_state* state, nocsim_node* cursor, nocsim_dire
 		flit->from->backrouted ++;
 		cursor->incoming[P]->from->backrouted ++;
 
-		if (state->instruments[INSTRUMENT_BACKROUTE] != NULL) {
+		if (nocsim_instrument_enabled(state, INSTRUMENT_BACKROUTE, flit)) {
+			nocsim_profile_begin(instrument_start);
 			if (Tcl_Evalf(state->interp, "%s \"%s\" \"%s\" %lu %lu %lu %lu",
 						state->instruments[INSTRUMENT_BACKROUTE],
 						flit->from->id, flit->to->id,
@@ -159,6 +361,7 @@ void nocsim_handle_arrival(nocsim_state* state, nocsim_node* cursor, nocsim_dire
 				print_tcl_error(state->interp);
 				err(1, "unable to proceed, exiting with failure state");
 			}
+			nocsim_profile_end(instrument_start, state->profile.instruments[INSTRUMENT_BACKROUTE]);
 		}
 
 
@@ -168,6 +371,101 @@ void nocsim_handle_arrival(nocsim_state* state, nocsim_node* cursor, nocsim_dire
 	}
 }
 
+/**
+ * @brief Route a single flit through a router.
+ *
+ * Either of from or to may be BACKLOG, in which case the flit is taken from
+ * or placed into the router's internal FIFO. The caller is responsible for
+ * ensuring that the relevant links exist, that there is a flit to route, and
+ * that the outgoing link has not already been used this tick.
+ *
+ * @param state
+ * @param router
+ * @param from
+ * @param to
+ */
+void nocsim_route(nocsim_state* state, nocsim_node* router, nocsim_direction from, nocsim_direction to) {
+	nocsim_flit* flit = NULL;
+	nocsim_node* from_node = NULL;
+	nocsim_node* to_node = NULL;
+
+	if (from == BACKLOG) {
+		flit      = vec_dequeue(router->pending);
+		from_node = router;
+		flit->backlog += state->tick - flit->backlog_since;
+		router->activity[ENERGY_BUFFER_READ] ++;
+	} else {
+		flit      = router->incoming[from]->flit;
+		from_node = router->incoming[from]->from;
+		router->incoming[from]->flit = NULL;
+	}
+
+	if (to == BACKLOG) {
+		to_node   = router;
+		/* put flit at back of backlog FIFO queue */
+		vec_push(router->pending, flit);
+		flit->backlog_since = state->tick;
+		router->activity[ENERGY_BUFFER_WRITE] ++;
+	} else {
+		to_node   = router->outgoing[to]->to;
+		/* move flit to next state */
+		router->outgoing[to]->flit_next = flit;
+	}
+
+	/* route callback */
+	/* note: we do not distinguish between backlog and normal routing yet */
+	state->routed ++;
+	if (nocsim_instrument_enabled(state, INSTRUMENT_ROUTE, flit)) {
+		nocsim_profile_begin(instrument_start);
+		if (Tcl_Evalf(state->interp, "%s \"%s\" \"%s\" %lu %lu %lu %lu \"%s\" \"%s\"",
+					state->instruments[INSTRUMENT_ROUTE],
+					flit->from->id, flit->to->id,
+					flit->flit_no,
+					flit->spawned_at,
+					flit->injected_at,
+					flit->hops,
+					from_node->id, to_node->id
+					)) {
+			print_tcl_error(state->interp);
+			err(1, "unable to proceed, exiting with failure state");
+		}
+		nocsim_profile_end(instrument_start, state->profile.instruments[INSTRUMENT_ROUTE]);
+	}
+
+	/* if we are being routed somewhere that isn't our origin, then this
+	 * counts as an injection event */
+	if ((flit->from != to_node) && (flit->from == from_node)) {
+		if (nocsim_instrument_enabled(state, INSTRUMENT_INJECT, flit)) {
+			nocsim_profile_begin(instrument_start);
+			if (Tcl_Evalf(state->interp, "%s \"%s\" \"%s\" %lu",
+					state->instruments[INSTRUMENT_INJECT],
+					flit->from->id,
+					flit->to->id,
+					flit->flit_no)) {
+				print_tcl_error(state->interp);
+				err(1, "unable to proceed, exiting with failure state");
+			}
+			nocsim_profile_end(instrument_start, state->profile.instruments[INSTRUMENT_INJECT]);
+		}
+
+		state->injected ++;
+		flit->from->injected ++;
+	}
+
+	/* performance counters */
+	/* note: only bump counters when flit leaves on a link. */
+	if (to != BACKLOG) {
+		router->routed ++;
+		router->outgoing[to]->load ++;
+		router->outgoing[to]->carried ++;
+		router->outgoing[to]->traversals ++;
+		router->activity[ENERGY_CROSSBAR] ++;
+		flit->hops ++;
+	}
+
+	nocsim_heatmap_route(router, flit, (to == BACKLOG) ? NULL : to_node);
+}
+
 void nocsim_spawn(nocsim_state* state, nocsim_node* from, nocsim_node* to) {
 	nocsim_flit* flit;
 
@@ -183,6 +481,10 @@ void nocsim_spawn(nocsim_state* state, nocsim_node* from, nocsim_node* to) {
 	flit->injected_at = 0;
 	flit->flit_no = state->flit_no;
 	flit->hops = 0;
+	flit->deflections = 0;
+	flit->backlog = 0;
+	flit->backlog_since = 0;
+	flit->distance = nocsim_routing_distance(state, from, to);
 
 	state->spawned ++;
 	state->flit_no ++;
@@ -191,12 +493,14 @@ void nocsim_spawn(nocsim_state* state, nocsim_node* from, nocsim_node* to) {
 	/* insert into FIFO */
 	vec_push(from->pending, flit);
 
-	if (state->instruments[INSTRUMENT_SPAWN] != NULL) {
+	if (nocsim_instrument_enabled(state, INSTRUMENT_SPAWN, flit)) {
+		nocsim_profile_begin(instrument_start);
 		if (Tcl_Evalf(state->interp, "%s \"%s\" \"%s\" %lu",
 					state->instruments[INSTRUMENT_SPAWN],
 					from->id, to->id, flit->flit_no)) {
 			print_tcl_error(state->interp);
 			err(1, "unable to proceed, exiting with failure state");
 		}
+		nocsim_profile_end(instrument_start, state->profile.instruments[INSTRUMENT_SPAWN]);
 	}
 }
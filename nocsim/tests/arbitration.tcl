@@ -0,0 +1,106 @@
+# test arbitration between incoming flits
+
+package require tcltest
+
+source ../../scripts/noc_tools_load.tcl
+namespace import ::nocsim::*
+
+# record the order of incoming flits, and where they were spawned, then route
+# them towards their destination
+proc observe {} {
+	set order {}
+	foreach dir [allincoming] {
+		lappend order [list $dir [peek $dir spawned_at]]
+	}
+	if {[llength $order] > 1} {
+		lappend ::orders $order
+	}
+
+	foreach dir [allincoming] {
+		if {[route_priority $dir {*}[nexthop $dir] {*}[dir2list N S E W]] eq ""} {
+			route $dir [dir2int backlog]
+		}
+	}
+}
+
+# run a busy 3x3 mesh under the given arbitration policy, returning the
+# orders seen by the center router
+proc run_policy {args} {
+	set ::orders {}
+	arbitration {*}$args
+	step 150
+	return $::orders
+}
+
+create_mesh 3 3 native:uniform native:DOR
+behavior R.1.1 observe
+injectrate 0.6
+
+# position of each direction in an order
+proc positions {order priority} {
+	lmap entry $order {lsearch $priority [lindex $entry 0]}
+}
+
+tcltest::test 001 {arbitration should default to fixed} -body {
+	arbitration
+} -result {fixed}
+
+tcltest::test 002 {arbitration should validate its arguments} -body {
+	list \
+		[catch {arbitration bogus} msg] $msg \
+		[catch {arbitration fixed 0 1 2 3 3} msg] $msg \
+		[catch {arbitration fixed 0 1 2 3 7} msg] $msg \
+		[catch {arbitration fixed 0 1} msg] $msg \
+		[arbitration]
+} -result {1 {arbitration policy should be one of fixed, oldest, roundrobin, or random} 1 {priority must list each direction exactly once} 1 {priority must list each direction exactly once} 1 {wrong # args: should be "arbitration / arbitration POLICY / arbitration POLICY DIR DIR DIR DIR DIR"} fixed}
+
+tcltest::test 003 {fixed arbitration should follow the priority order} -body {
+	set bad 0
+	set priority [dir2list PE W E S N]
+	set orders [run_policy fixed {*}$priority]
+	foreach order $orders {
+		set p [positions $order $priority]
+		if {$p ne [lsort -integer $p]} { incr bad }
+	}
+	list [expr {[llength $orders] > 10}] $bad [arbitration]
+} -result {1 0 fixed}
+
+tcltest::test 004 {oldest first arbitration should order flits by age} -body {
+	set bad 0
+	set orders [run_policy oldest]
+	foreach order $orders {
+		set ages [lmap entry $order {lindex $entry 1}]
+		if {$ages ne [lsort -integer $ages]} { incr bad }
+	}
+	list [expr {[llength $orders] > 10}] $bad
+} -result {1 0}
+
+tcltest::test 005 {round-robin arbitration should rotate the priority order} -body {
+	set bad 0
+	set firsts {}
+	set priority [dir2list N S E W PE]
+	set orders [run_policy roundrobin {*}$priority]
+	foreach order $orders {
+		# the order must be increasing, starting from somewhere in the ring
+		set p [positions $order $priority]
+		set start [lindex $p 0]
+		set rotated [lmap i $p {expr {($i - $start + 5) % 5}}]
+		if {$rotated ne [lsort -integer $rotated]} { incr bad }
+		dict incr firsts [lindex $order 0 0]
+	}
+	list [expr {[llength $orders] > 10}] $bad [expr {[dict size $firsts] > 2}]
+} -result {1 0 1}
+
+tcltest::test 006 {random arbitration should shuffle the order} -body {
+	set unordered 0
+	set orders [run_policy random]
+	foreach order $orders {
+		set p [positions $order [dir2list N S E W PE]]
+		if {$p ne [lsort -integer $p]} { incr unordered }
+	}
+	list [expr {[llength $orders] > 10}] [expr {$unordered > 0}]
+} -result {1 1}
+
+namespace delete nocsim
+
+tcltest::cleanupTests
@@ -0,0 +1,140 @@
+# test the native BLESS and CHIPPER deflection routers
+
+package require tcltest
+
+source test_util.tcl
+
+# run a 4x4 mesh with the given router behavior in a fresh interpreter,
+# returning the total number of flits arrived, deflected, and buffered
+proc run_mesh {router rate ticks} {
+	fresh [list nocsim::create_mesh 4 4 native:uniform $router] \
+		[list nocsim::injectrate $rate] [list nocsim::step $ticks] {
+		set deflected 0
+		set buffered 0
+		foreach id [nocsim::allnodes] {
+			incr deflected [nocsim::nodeinfo $id deflected]
+			incr buffered [nocsim::nodeinfo $id buffered]
+		}
+		list $nocsim::nocsim_arrived $deflected $buffered
+	}
+}
+
+foreach router {BLESS CHIPPER} {
+	tcltest::test $router-001 "$router should deliver flits without buffering them" -body {
+		lassign [run_mesh native:$router 0.1 500] arrived deflected buffered
+		list [expr {$arrived > 500}] $buffered
+	} -result {1 0}
+
+	tcltest::test $router-002 "$router should deflect flits under heavy load" -body {
+		lassign [run_mesh native:$router 1.0 500] arrived deflected buffered
+		list [expr {$arrived > 1000}] [expr {$deflected > 0}] $buffered
+	} -result {1 1 0}
+}
+
+tcltest::test BLESS-003 {BLESS should give the productive port to the oldest flit} -body {
+	fresh {namespace import ::nocsim::*} {
+		# A.0 and A.1 carry a flit from PE.A east into M, and B carries a
+		# younger flit from PE.B north into M the same tick, both need M's
+		# only productive port, east to X. Fixed arbitration would route
+		# the flit from the south first.
+		router A.0 0 0 {foreach dir [allincoming] { route $dir [dir2int E] }}
+		router A.1 0 1 {foreach dir [allincoming] { route $dir [dir2int E] }}
+		router M 0 2 native:BLESS
+		router X 0 3 {foreach dir [allincoming] { route $dir [dir2int PE] }}
+		router B 1 2 {foreach dir [allincoming] { route $dir [dir2int N] }}
+		PE PE.A 0 0 {if {$::nocsim::nocsim_tick == 0} { spawn PE.X }}
+		PE PE.B 1 2 {if {$::nocsim::nocsim_tick == 1} { spawn PE.X }}
+		PE PE.X 0 3 {}
+		foreach {from to} {A.0 A.1 A.1 A.0 A.1 M M A.1 M X X M B M M B PE.A A.0 A.0 PE.A PE.B B B PE.B PE.X X X PE.X} {
+			link $from $to
+		}
+
+		proc on_route {origin dest flitno spawned injected hops routefrom routeto} {
+			if {[current] eq "M"} {
+				lappend ::routed [list $origin $spawned $routeto $::nocsim::nocsim_tick]
+			}
+		}
+		set ::routed {}
+		registerinstrument route on_route
+		step 4
+
+		list {*}[lsort $::routed] [nodeinfo M deflected]
+	}
+} -result {{PE.A 0 X 3} {PE.B 1 B 3} 1}
+
+tcltest::test CHIPPER-003 {CHIPPER should never deflect a golden flit} -body {
+	fresh {namespace import ::nocsim::*} {
+		# each PE is golden for an epoch in turn, and sends a single flit
+		# to the opposite corner as it's epoch begins. It is quiet for the
+		# epoch before, so that no other flit of it's is golden with it,
+		# and the others send to random PEs to make the network busy. A
+		# flit backrouted to it's PE while waiting to be injected counts
+		# as a deflection, but has not entered the network.
+		set ::epoch [expr {4 * (3 + 3 + 2)}]
+		proc probe {} {
+			set tick $::nocsim::nocsim_tick
+			set row [nodeinfo [current] row]
+			set col [nodeinfo [current] col]
+			set golden [expr {($tick / $::epoch) % 16}]
+			if {$golden == 4 * $row + $col} {
+				if {$tick % $::epoch == 0} { spawn PE.[expr {3 - $row}].[expr {3 - $col}] }
+			} elseif {($golden + 1) % 16 != 4 * $row + $col && rand() < 0.5} {
+				set to [current]
+				while {$to eq [current]} { set to PE.[expr {int(rand() * 4)}].[expr {int(rand() * 4)}] }
+				spawn $to
+			}
+		}
+
+		proc on_arrive {origin dest flitno hops spawned injected deflections backlog distance} {
+			set row [nodeinfo $origin row]
+			set col [nodeinfo $origin col]
+			if {$spawned % $::epoch == 0 && ($spawned / $::epoch) % 16 == 4 * $row + $col} {
+				lappend ::probes [list [expr {$deflections - [incr ::backrouted($flitno) 0]}] \
+					[expr {$::nocsim::nocsim_tick / $::epoch == $spawned / $::epoch}]]
+			}
+		}
+
+		proc on_backroute {origin dest flitno hops spawned injected} {
+			incr ::backrouted($flitno)
+		}
+		set ::probes {}
+		expr {srand(7)}
+		create_mesh 4 4 probe native:CHIPPER
+		registerinstrument arrive on_arrive
+		registerinstrument backroute on_backroute
+		step [expr {16 * $::epoch + 1}]
+
+		set deflected 0
+		foreach id [nocsim::allnodes] { incr deflected [nodeinfo $id deflected] }
+		list [llength $::probes] [lsort -unique $::probes] [expr {$deflected > 100}]
+	}
+} -result {16 {{0 1}} 1}
+
+source ../../scripts/noc_tools_load.tcl
+namespace import ::nocsim::*
+
+# record the largest number of times a flit passing through was deflected,
+# then route it to it's first available candidate
+proc observe {} {
+	foreach dir [allincoming] {
+		set ::most [expr {max($::most, [peek $dir deflections])}]
+		if {[peek $dir hops] < $::least} { set ::least [peek $dir hops] }
+		if {[route_priority $dir {*}[nexthop $dir] {*}[dir2list N S E W]] eq ""} {
+			route $dir [dir2int backlog]
+		}
+	}
+}
+
+tcltest::test 003 {flits should count the number of times they were deflected} -body {
+	set ::most 0
+	set ::least 1000
+	create_mesh 3 3 native:uniform native:CHIPPER
+	behavior R.1.1 observe
+	injectrate 0.8
+	step 300
+	list [expr {$::most > 0}] $::least
+} -result {1 0}
+
+namespace delete nocsim
+
+tcltest::cleanupTests
@@ -0,0 +1,102 @@
+# test the energy model
+
+package require tcltest
+
+source test_util.tcl
+
+source ../../scripts/noc_tools_load.tcl
+namespace import ::nocsim::*
+
+proc nop {} {
+
+}
+
+# write an energy model, returning it's path
+proc model {contents} {
+	return [tcltest::makeFile $contents model.txt]
+}
+
+tcltest::test 001 {energy should be zero before simulating} -body {
+	create_mesh 2 2 native:uniform native:DOR
+	set energy [energy]
+	list [dict get $energy ticks] [dict get $energy total] [dict get $energy components] \
+		[dict size [dict get $energy nodes]]
+} -result {0 0.0 {buffer_read 0.0 buffer_write 0.0 crossbar 0.0 arbitration 0.0 link 0.0 static 0.0} 8}
+
+tcltest::test 002 {energy should follow activity and the model} -body {
+	injectrate 0.3
+	step 200
+	set energy [energy -model [model "buffer_read 1\nbuffer_write 1\ncrossbar 1 # per flit\narbitration 1\n\nlink 1\nstatic 0.25\n"]]
+	tcltest::removeFile model.txt
+
+	set routed 0
+	foreach r {R.0.0 R.0.1 R.1.0 R.1.1} {
+		incr routed [nodeinfo $r routed]
+	}
+	set components [dict get $energy components]
+
+	# every node's breakdown should add up to the components
+	set sums {}
+	dict for {id node} [dict get $energy nodes] {
+		dict for {event value} $node {
+			if {![dict exists $sums $event]} { dict set sums $event 0 }
+			dict set sums $event [expr {[dict get $sums $event] + $value}]
+		}
+	}
+
+	list \
+		[expr {[dict get $components crossbar] == $routed}] \
+		[expr {[dict get $components link] == $routed + $nocsim::nocsim_dequeued}] \
+		[expr {[dict get $components arbitration] >= $routed}] \
+		[dict get $components static] \
+		[expr {abs([tcl::mathop::+ {*}[dict values $components]] - [dict get $energy total]) < 1e-6}] \
+		[expr {$sums eq $components}]
+} -result {1 1 1 200.0 1 1}
+
+tcltest::test 003 {energy reset should discard activity} -body {
+	energy reset
+	step 4
+	set components [dict get [energy] components]
+	list [dict get [energy] ticks] [dict get $components static]
+} -result {4 4.0}
+
+tcltest::test 004 {energy models should be validated} -body {
+	set before [dict get [energy] components]
+	set result {}
+	foreach contents {"crossbar" "bogus 1" "crossbar -1" "crossbar 1x" "link 2\ncrossbar 1 2"} {
+		set path [model $contents]
+		catch {energy -model $path} msg
+		lappend result [string map [list $path FILE] $msg]
+		tcltest::removeFile model.txt
+	}
+	lappend result [catch {energy -model /nonexistent/model} msg] $msg \
+		[catch {energy -bogus x} msg] $msg \
+		[catch {energy -model a b} msg] $msg \
+		[expr {$before eq [dict get [energy] components]}]
+} -result {{FILE:1: usage: EVENT ENERGY} {FILE:1: unknown event 'bogus', should be one of buffer_read, buffer_write, crossbar, arbitration, link, or static} {FILE:1: invalid energy '-1'} {FILE:1: invalid energy '1x'} {FILE:2: usage: EVENT ENERGY} 1 {could not open energy model '/nonexistent/model': No such file or directory} 1 {unknown option, should be -model} 1 {wrong # args: should be "energy / energy -model FILE / energy reset"} 1}
+
+namespace delete nocsim
+
+tcltest::test 005 {link energy should be weighted by length} -body {
+	fresh {
+		# spawn one flit to the given PE on the first tick
+		proc spawn_once {to} { if {$::nocsim::nocsim_tick == 0} { nocsim::spawn $to } }
+		nocsim::router A 0 0 native:table
+		nocsim::router B 0 3 native:table
+		nocsim::PE pA 0 0 {spawn_once pB}
+		nocsim::PE pB 0 3 {}
+		nocsim::link pA A
+		nocsim::link A pA
+		nocsim::link pB B
+		nocsim::link B pB
+		nocsim::link A B [nocsim::dir2int E] [nocsim::dir2int W]
+		nocsim::link B A [nocsim::dir2int W] [nocsim::dir2int E]
+		nocsim::step 10
+		set energy [nocsim::energy]
+		list $nocsim::nocsim_arrived {*}[lmap id {A pA B} {
+			format %.2f [dict get $energy nodes $id link]
+		}]
+	}
+} -result {1 3.60 1.20 1.20}
+
+tcltest::cleanupTests
@@ -0,0 +1,196 @@
+# test link and router failures, and repairs
+
+package require tcltest
+
+source test_util.tcl
+
+# procedures available to every test
+set common {
+	namespace import ::nocsim::*
+
+	proc nop {} {
+
+	}
+
+	proc on_arrive {origin dest flitno hops spawned injected deflections backlog distance} {
+		lappend ::arrivals [list $origin $dest $flitno $hops]
+	}
+
+	# spawn one flit per tick to a fixed PE for the first few ticks
+	proc burst {to} {
+		if {$::nocsim::nocsim_tick < 8} { nocsim::spawn $to }
+	}
+
+	# a 4x4 mesh where each PE sends to it's transpose
+	proc transpose_mesh {route} {
+		create_mesh 4 4 nop $route
+		for {set r 0} {$r < 4} {incr r} {
+			for {set c 0} {$c < 4} {incr c} {
+				if {$r != $c} { behavior PE.$r.$c [list burst PE.$c.$r] }
+			}
+		}
+	}
+
+	# the same, with an extra router and PE east of R.0.3, so that the
+	# routers no longer form a regular mesh, and no table is shared.
+	# PE.2.0 sends east along row 2 instead, through R.2.1, which records
+	# the candidates it's table gives for each flit, and routes by them.
+	proc transpose_irregular {route} {
+		transpose_mesh $route
+		router R.0.4 0 4 $route
+		PE PE.0.4 0 4 [list burst PE.3.0]
+		link R.0.3 R.0.4
+		link R.0.4 R.0.3
+		link R.0.4 PE.0.4
+		link PE.0.4 R.0.4
+		behavior PE.2.0 [list burst PE.2.3]
+		behavior R.2.1 [list observe [string map {native: {}} $route]]
+	}
+
+	proc observe {algorithm} {
+		foreach dir [allincoming] {
+			set hop [nexthop $dir $algorithm]
+			lappend ::candidates [list $::nocsim::nocsim_tick [peek $dir to] $hop]
+			if {[route_priority $dir {*}$hop {*}[dir2list N S E W]] eq ""} {
+				route $dir [dir2int backlog]
+			}
+		}
+	}
+
+	# carried count of every link
+	proc carried {} {
+		set result {}
+		foreach from [nocsim::allnodes] {
+			foreach to [nocsim::allnodes] {
+				if {![catch {linkinfo $from $to carried} n]} {
+					lappend result $from $to $n
+				}
+			}
+		}
+		return $result
+	}
+
+	set ::arrivals {}
+	set ::candidates {}
+	registerinstrument arrive on_arrive
+}
+
+tcltest::test 001 {fail and repair should validate their arguments} -body {
+	fresh $::common {
+		create_mesh 2 2 nop native:DOR
+		list \
+			[catch {fail bogus} msg] $msg \
+			[catch {repair bogus} msg] $msg \
+			[catch {fail link R.0.0} msg] $msg \
+			[catch {fail link R.0.0 R.1.1} msg] $msg \
+			[catch {fail link R.0.0 nowhere} msg] $msg \
+			[catch {fail router PE.0.0} msg] $msg \
+			[catch {fail router R.0.0 -when 3} msg] $msg \
+			[catch {fail router R.0.0 -at -3} msg] $msg \
+			[catch {repair all now} msg] $msg \
+			[fail]
+	}
+} -result {1 {unknown subcommand, should be link or router} 1 {unknown subcommand, should be all, link, or router} 1 {wrong # args: should be "fail / fail link FROM TO ?-at TICK? / fail router ID ?-at TICK?"} 1 {no link from R.0.0 to R.1.1} 1 {no node found with requested id} 1 {PE.0.0 is not a router} 1 {unknown option, should be -at} 1 {TICK must not be negative} 1 {wrong # args: should be "repair all / repair link FROM TO ?-at TICK? / repair router ID ?-at TICK?"} {}}
+
+tcltest::test 002 {failed links should be listed, and carry no flits} -body {
+	fresh $::common {
+		create_mesh 4 4 native:uniform native:table
+		injectrate 0.2
+		step 20
+		fail link R.1.1 R.1.2
+		fail link R.2.2 R.1.2
+		set before [linkinfo R.1.1 R.1.2 carried]
+		set arrived $::nocsim::nocsim_arrived
+		step 200
+		list [lsort [fail]] [linkinfo R.1.1 R.1.2 failed] [linkinfo R.1.2 R.1.1 failed] \
+			[expr {[linkinfo R.1.1 R.1.2 carried] - $before}] \
+			[expr {$::nocsim::nocsim_arrived > $arrived + 100}]
+	}
+} -result {{{R.1.1 R.1.2} {R.2.2 R.1.2}} 1 0 0 1}
+
+tcltest::test 003 {failures and repairs should be applied at the scheduled tick} -body {
+	fresh $::common {
+		create_mesh 3 3 nop native:DOR
+		fail router R.1.1 -at 5
+		repair link R.1.1 R.0.1 -at 8
+		step 4
+		set early [llength [fail]]
+		step 2
+		set failed [llength [fail]]
+		step 4
+		list $early $failed [llength [fail]] [linkinfo R.1.1 R.0.1 failed] [linkinfo R.0.1 R.1.1 failed]
+	}
+} -result {0 10 9 0 1}
+
+tcltest::test 004 {flits in flight on a failed link should be retried} -body {
+	fresh $::common {
+		create_mesh 3 1 nop native:DOR
+		behavior PE.0.0 {if {$::nocsim::nocsim_tick == 0} { nocsim::spawn PE.0.2 }}
+		step 2
+		set in_flight [linkinfo R.0.0 R.0.1 in_flight]
+		fail link R.0.0 R.0.1
+		set pending [nodeinfo PE.0.0 pending]
+		repair link R.0.0 R.0.1 -at 20
+		step 30
+		list $in_flight $::nocsim::nocsim_retried $pending [lmap a $::arrivals {lrange $a 0 2}]
+	}
+} -result {0 1 1 {{PE.0.0 PE.0.2 0}}}
+
+tcltest::test 005 {failing a router should retry the flits in it's backlog} -body {
+	fresh $::common {
+		create_mesh 3 1 nop native:DOR
+		behavior PE.0.0 {if {$::nocsim::nocsim_tick < 3} { nocsim::spawn PE.0.2 }}
+		behavior R.0.1 {foreach dir [allincoming] { route $dir [dir2int backlog] }}
+		step 6
+		set held [nodeinfo R.0.1 pending]
+		fail router R.0.1
+		list $held [nodeinfo R.0.1 pending] [nodeinfo PE.0.0 pending] $::nocsim::nocsim_retried
+	}
+} -result {3 0 3 3}
+
+# the same failures are applied to two meshes, one before the routing tables
+# are built and one after, so they should route identically. On a regular mesh
+# DOR and ADOR use a shared table which faults do not change, so they are
+# only compared on an irregular topology.
+foreach {topology route} {
+	transpose_mesh table
+	transpose_mesh updown
+	transpose_mesh escape
+	transpose_mesh ADOR
+	transpose_irregular table
+	transpose_irregular updown
+	transpose_irregular escape
+	transpose_irregular DOR
+	transpose_irregular ADOR
+} {
+	set name 006-$route
+	if {$topology eq "transpose_irregular"} { set name 006-irregular-$route }
+
+	tcltest::test $name "incremental $route table updates should match a rebuild" -body {
+		set faults {
+			fail link R.1.1 R.1.2
+			fail link R.2.1 R.2.2
+			fail router R.0.2
+			fail link R.3.0 PE.3.0
+			fail link R.1.2 R.1.1
+			repair link R.1.1 R.1.2
+			repair link R.0.2 R.0.3
+		}
+		set before [fresh $::common "$topology native:$route ; $faults ; finalize ; step 100 ; list \[lsort \$::arrivals\] \[carried\] \$::candidates"]
+		set after [fresh $::common "$topology native:$route ; finalize ; $faults ; step 100 ; list \[lsort \$::arrivals\] \[carried\] \$::candidates"]
+		list [expr {$before eq $after}] [expr {[llength [lindex $before 0]] > 40}]
+	} -result {1 1}
+}
+
+tcltest::test 007 {repair all should repair every link and cancel scheduled faults} -body {
+	fresh $::common {
+		create_mesh 3 3 nop native:DOR
+		fail router R.1.1
+		fail link R.0.0 R.0.1 -at 10
+		repair all
+		step 20
+		fail
+	}
+} -result {}
+
+tcltest::cleanupTests
@@ -0,0 +1,125 @@
+# test finalizing the topology, native routing behaviors, and next-hop tables
+
+package require tcltest
+
+source test_util.tcl
+
+source ../../scripts/noc_tools_load.tcl
+namespace import ::nocsim::*
+
+proc nop {} {
+
+}
+
+proc inject_until_20 {} {
+	if {$::nocsim::nocsim_tick < 20} { inject [randnode [current]] }
+}
+
+# tests 004 and 006 run for 220 ticks in total
+proc inject_once_at_200 {} {
+	if {$::nocsim::nocsim_tick == 200} { inject PE.2.3 }
+}
+
+proc inject_until_240 {} {
+	if {$::nocsim::nocsim_tick < 240} { inject [randnode [current]] }
+}
+
+# records the next-hop candidates for each flit leaving R.0.0, and then
+# routes it using the same logic as native:DOR
+proc record_nexthop {} {
+	foreach dir [dir2list N S E W PE] {
+		if {[incoming $dir] != 1} { continue }
+		if {[current] eq "R.0.0"} {
+			lappend ::hops [list [peek $dir to] [nexthop $dir] [nexthop $dir ADOR]]
+		}
+		route_priority $dir {*}[nexthop $dir] {*}[dir2list N S E W] [dir2int backlog]
+	}
+	if {[incoming [dir2int backlog]] == 1} {
+		route_priority [dir2int backlog] {*}[nexthop [dir2int backlog]]
+	}
+}
+
+tcltest::test 001 {finalize should fail if a PE is not attached to a router} -body {
+	fresh {
+		nocsim::router r 0 0 nop
+		nocsim::PE p 0 0 nop
+		nocsim::link p r
+		catch {nocsim::finalize} err
+		set err
+	}
+} -result {PE p has no incoming link from a router}
+
+tcltest::test 002 {unknown native behaviors should be rejected} -body {
+	catch {router bogus 0 0 native:bogus} err
+	return $err
+} -result {unknown native behavior 'native:bogus'}
+
+tcltest::test 003 {native routing behaviors should not be usable for PEs} -body {
+	catch {PE bogus 0 0 native:DOR} err
+	return $err
+} -result {native behavior 'native:DOR' may not be used for PE nodes}
+
+tcltest::test 004 {native DOR should deliver every flit} -body {
+	create_mesh 4 4 inject_until_20 native:DOR
+	finalize
+	step 200
+	return [list $::nocsim::nocsim_finalized \
+		[expr {$::nocsim::nocsim_spawned > 0}] \
+		[expr {$::nocsim::nocsim_arrived == $::nocsim::nocsim_spawned}]]
+} -result {1 1 1}
+
+tcltest::test 005 {the topology should be locked after finalizing} -body {
+	set errs {}
+	lappend errs [catch {router R.9.9 9 9 native:DOR}]
+	lappend errs [catch {PE PE.9.9 9 9 nop}]
+	lappend errs [catch {link R.0.0 R.2.2}]
+	return $errs
+} -result {1 1 1}
+
+tcltest::test 006 {nexthop should expose the DOR and ADOR candidates} -body {
+	set ::hops {}
+	foreach id [findnode] {
+		if {[nodeinfo $id type] == [type2int router]} {
+			behavior $id record_nexthop
+		} else {
+			behavior $id nop
+		}
+	}
+	behavior PE.0.0 inject_once_at_200
+	set arrived $::nocsim::nocsim_arrived
+	step 20
+	return [list [lindex $::hops 0] [expr {$::nocsim::nocsim_arrived - $arrived}]]
+} -result [list [list PE.2.3 [dir2int S] [dir2list S E]] 1]
+
+tcltest::test 007 {native ADOR should deliver every flit} -body {
+	foreach id [findnode] {
+		if {[nodeinfo $id type] == [type2int router]} {
+			behavior $id native:ADOR
+		} else {
+			behavior $id inject_until_240
+		}
+	}
+	step 200
+	return [expr {$::nocsim::nocsim_arrived == $::nocsim::nocsim_spawned}]
+} -result {1}
+
+tcltest::test 008 {native DOR should route on irregular topologies} -body {
+	fresh {
+		proc inject_p2 {} {
+			if {$::nocsim::nocsim_tick < 3} { nocsim::inject p2 }
+		}
+		proc nop {} {}
+		foreach col {0 1 2} { nocsim::router r$col 0 $col native:DOR }
+		nocsim::PE p0 0 0 inject_p2
+		nocsim::PE p2 0 2 nop
+		foreach {a b} {r0 r1 r1 r0 r1 r2 r2 r1 p0 r0 r0 p0 p2 r2 r2 p2} {
+			nocsim::link $a $b
+		}
+		nocsim::finalize
+		nocsim::step 10
+		list $::nocsim::nocsim_spawned $::nocsim::nocsim_arrived [nocsim::linkinfo r1 r2 load]
+	}
+} -result {3 3 3}
+
+namespace delete nocsim
+namespace delete nocviz
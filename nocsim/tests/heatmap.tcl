@@ -0,0 +1,94 @@
+# test heatmap accumulators
+
+package require tcltest
+
+source test_util.tcl
+
+source ../../scripts/noc_tools_load.tcl
+namespace import ::nocsim::*
+
+proc nop {} {
+
+}
+
+# PE.0.0 sends one flit to PE.0.2 on ticks 0 and 10
+proc inject_east {} {
+	if {$::nocsim::nocsim_tick % 10 == 0 && $::nocsim::nocsim_tick < 20} {
+		inject PE.0.2
+	}
+}
+
+# deflects the first flit it sees back west, and routes everything else
+# towards it's destination
+set deflected 0
+proc r_west {} {
+	foreach dir [dir2list N S E W PE] {
+		if {[incoming $dir] != 1} { continue }
+		if {!$::deflected} {
+			set ::deflected 1
+			route $dir [dir2int W]
+		} elseif {[peek $dir to] eq "PE.[nodeinfo [current] row].[nodeinfo [current] col]"} {
+			route $dir [dir2int PE]
+		} else {
+			route $dir [dir2int E]
+		}
+	}
+}
+
+tcltest::test 001 {the heatmap should accumulate link and router activity} -body {
+	create_mesh 3 1 nop native:DOR
+	behavior PE.0.0 inject_east
+	step 10
+	set h [heatmap]
+	return [list [dict get $h ticks] \
+		[dict get $h carried] [dict get $h busy_E] [dict get $h busy_P] \
+		[dict get $h productive] [dict get $h deflected] \
+		[linkinfo PE.0.0 R.0.0 carried] [linkinfo R.0.1 R.0.2 busy]]
+} -result {10 {{1 1 1}} {{1 1 0}} {{0 0 1}} {{1 1 1}} {{0 0 0}} 1 1}
+
+tcltest::test 002 {deflected routes should be counted} -body {
+	behavior R.0.1 r_west
+	step 10
+	set h [heatmap]
+	return [list [dict get $h productive] [dict get $h deflected] \
+		[nodeinfo R.0.1 deflected]]
+} -result {{{3 2 2}} {{0 1 0}} 1}
+
+tcltest::test 003 {the heatmap should be reset every window} -body {
+	set h1 [heatmap -window 5]
+	step 4
+	set h2 [heatmap]
+	step 1
+	set h3 [heatmap]
+	return [list [dict get $h1 ticks] [dict get $h2 ticks] [dict get $h3 ticks] \
+		[llength [dict get $h3 carried]] [llength [lindex [dict get $h3 busy] 0]] \
+		[nodeinfo R.0.0 productive]]
+} -result {0 0 5 1 3 0}
+
+tcltest::test 004 {the backlog depth should be integrated over time} -body {
+	fresh {
+		proc inject_3 {} {
+			if {$::nocsim::nocsim_tick == 0} {
+				nocsim::inject p2
+				nocsim::inject p2
+				nocsim::inject p2
+			}
+		}
+		proc buffer {} {
+			if {[nocsim::incoming [nocsim::dir2int PE]] == 1} {
+				nocsim::route [nocsim::dir2int PE] [nocsim::dir2int backlog]
+			}
+		}
+		nocsim::router r1 0 0 buffer
+		nocsim::PE p1 0 0 inject_3
+		nocsim::PE p2 0 1 {}
+		nocsim::link p1 r1
+		nocsim::link r1 p1
+		nocsim::step 4
+		set h [nocsim::heatmap]
+		list [dict get $h occupancy] [dict get $h buffered] [nocsim::nodeinfo p1 occupancy]
+	}
+} -result {{{6 0}} {{3 0}} 6}
+
+namespace delete nocsim
+namespace delete nocviz
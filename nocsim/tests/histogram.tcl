@@ -0,0 +1,114 @@
+# test per-flit accounting, and histograms of arrived flits
+
+package require tcltest
+
+source test_util.tcl
+
+# procedures available to every test
+set common {
+	namespace import ::nocsim::*
+
+	proc nop {} {
+
+	}
+
+	# record the per-flit quantities of every flit which arrives
+	proc on_arrive {origin dest flitno hops spawned injected deflections backlog distance} {
+		lappend ::arrivals [list $origin $dest $hops $deflections $backlog $distance]
+	}
+
+	# spawn one flit to each of the given PEs on the first tick
+	proc spawn_once {args} {
+		if {$::nocsim::nocsim_tick == 0} {
+			foreach to $args { spawn $to }
+		}
+	}
+
+	# place every incoming flit in the backlog, and route it out the
+	# next tick
+	proc hold {} {
+		while {[incoming [dir2int backlog]]} {
+			route [dir2int backlog] [lindex [nexthop [dir2int backlog]] 0]
+		}
+		foreach dir [allincoming] {
+			route $dir [dir2int backlog]
+		}
+	}
+
+	set ::arrivals {}
+	registerinstrument arrive on_arrive
+}
+
+tcltest::test 001 {flits should count ticks spent in the backlog} -body {
+	fresh $::common {
+		create_mesh 3 1 nop native:DOR
+		behavior PE.0.0 {spawn_once PE.0.2}
+		behavior R.0.1 hold
+		step 10
+		list $::arrivals [dict get [histogram] backlog] [dict get [histogram] inflation]
+	}
+} -result {{{PE.0.0 PE.0.2 3 0 1 3}} {0 1} 1}
+
+tcltest::test 002 {the distance should be the shortest path on arbitrary topologies} -body {
+	fresh $::common {
+		# a one way ring of three routers
+		foreach r {A B C} col {0 1 2} {
+			router $r 0 $col native:table
+			PE p$r 1 $col nop
+			link p$r $r
+			link $r p$r
+		}
+		link A B [dir2int E] [dir2int W]
+		link B C [dir2int E] [dir2int W]
+		link C A [dir2int S] [dir2int N]
+		behavior pA {spawn_once pC}
+		behavior pB {spawn_once pA}
+		behavior pC {spawn_once pB}
+		step 20
+		lsort [lmap arrival $::arrivals {
+			lassign $arrival origin dest hops - - distance
+			list $origin $dest $hops $distance
+		}]
+	}
+} -result {{pA pC 3 3} {pB pA 3 3} {pC pB 3 3}}
+
+tcltest::test 003 {histograms should count every arrived flit} -body {
+	fresh $::common {
+		create_mesh 4 4 native:uniform native:DOR
+		injectrate 0.5
+		step 300
+		set histogram [histogram]
+
+		# every flit should appear once in each histogram, and no flit
+		# should take fewer hops than the distance
+		set sums [lmap {metric counts} $histogram {tcl::mathop::+ {*}$counts}]
+		set bad 0
+		set inflation {}
+		foreach arrival $::arrivals {
+			lassign $arrival - - hops deflections - distance
+			if {$hops < $distance || $deflections > $hops} { incr bad }
+			dict incr inflation [expr {$hops - $distance}]
+		}
+		set counted [lrepeat [expr {[tcl::mathfunc::max 0 {*}[dict keys $inflation]] + 1}] 0]
+		dict for {v count} $inflation {
+			lset counted $v $count
+		}
+
+		histogram reset
+		list \
+			[expr {[lsort -unique $sums] == [llength $::arrivals]}] \
+			[expr {$nocsim::nocsim_arrived == [llength $::arrivals]}] \
+			$bad \
+			[expr {$counted eq [dict get $histogram inflation]}] \
+			[expr {[llength [dict get $histogram deflections]] > 1}] \
+			[histogram]
+	}
+} -result {1 1 0 1 1 {latency {} hops {} deflections {} backlog {} inflation {}}}
+
+tcltest::test 004 {histogram should validate its arguments} -body {
+	fresh $::common {
+		list [catch {histogram bogus} msg] $msg [catch {histogram reset now} msg] $msg
+	}
+} -result {1 {unknown subcommand, should be reset} 1 {wrong # args: should be "histogram / histogram reset"}}
+
+tcltest::cleanupTests
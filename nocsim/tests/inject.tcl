@@ -62,7 +62,7 @@ proc dequeue_instr {origin dest flitno} {
 	incr dequeued
 }
 
-proc arrive_instr {origin dest flitno nhops spawnedat injectedat} {
+proc arrive_instr {origin dest flitno nhops spawnedat injectedat deflections backlog distance} {
 	upvar #0 arrived arrived
 	conswrite "$flitno arrived at $dest after $nhops hops"
 	incr arrived
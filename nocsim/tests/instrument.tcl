@@ -0,0 +1,82 @@
+# test sampling options for registerinstrument
+
+package require tcltest
+
+source test_util.tcl
+
+source ../../scripts/noc_tools_load.tcl
+namespace import ::nocsim::*
+
+# run a 3x3 mesh where PE.0.0 sends a flit to PE.2.2 for each of the first 10
+# ticks, with the given instrument registered, and return the list of values
+# the instrument recorded
+proc run_mesh {args} {
+	fresh [list set register $args] {
+		set ::events {}
+		proc nop {} {}
+		proc inject {} {
+			if {$::nocsim::nocsim_tick < 10} { nocsim::inject PE.2.2 }
+		}
+		proc on_route {origin dest flitno spawned injected hops from to} {
+			lappend ::events $flitno
+		}
+		proc on_spawn {from to flitno} {
+			lappend ::events $flitno
+		}
+		proc on_tick {} {
+			lappend ::events $::nocsim::nocsim_tick
+		}
+		nocsim::registerinstrument {*}$register
+		nocsim::create_mesh 3 3 nop native:DOR
+		nocsim::behavior PE.0.0 inject
+		nocsim::step 20
+		set ::events
+	}
+}
+
+tcltest::test 001 {instruments without options should be called for every event} -body {
+	return [llength [run_mesh route on_route]]
+} -result {50}
+
+tcltest::test 002 {-flits should restrict events to the given flits} -body {
+	return [lsort -unique [run_mesh route on_route -flits {7 3}]]
+} -result {3 7}
+
+tcltest::test 003 {-every should sample one in every N events} -body {
+	return [run_mesh spawn on_spawn -every 3]
+} -result {0 3 6 9}
+
+tcltest::test 004 {-src and -dst should match nodes created after registering} -body {
+	return [list [llength [run_mesh spawn on_spawn -src PE.0.0 -dst PE.2.2]] \
+		[llength [run_mesh spawn on_spawn -dst PE.1.1]]]
+} -result {10 0}
+
+tcltest::test 005 {-tick-range should restrict events to the given ticks} -body {
+	return [run_mesh tick on_tick -tick-range 3 5]
+} -result {3 4 5}
+
+tcltest::test 006 {-probability should sample events} -body {
+	return [list [llength [run_mesh route on_route -probability 0]] \
+		[llength [run_mesh route on_route -probability 1]] \
+		[expr {[llength [run_mesh route on_route -probability 0.5]] < 50}]]
+} -result {0 50 1}
+
+tcltest::test 007 {options should be combined} -body {
+	return [run_mesh spawn on_spawn -tick-range 2 8 -flits {1 2 3 4 5} -every 2]
+} -result {2 4}
+
+tcltest::test 008 {invalid options should be rejected} -body {
+	set errs {}
+	catch {registerinstrument tick nop -flits {1}} err
+	lappend errs $err
+	catch {registerinstrument spawn nop -bogus 1} err
+	lappend errs $err
+	catch {registerinstrument spawn nop -every} err
+	lappend errs $err
+	catch {registerinstrument spawn nop -tick-range 5 1} err
+	lappend errs $err
+	return $errs
+} -result {{flit filters may only be used with instruments concerning a flit} {unknown option, should be one of -every, -probability, -flits, -src, -dst, or -tick-range} {option requires a value} {-tick-range must be two ticks A <= B}}
+
+namespace delete nocsim
+namespace delete nocviz
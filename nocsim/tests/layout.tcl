@@ -0,0 +1,69 @@
+# test that the compacted link layout is rebuilt correctly when the topology
+# changes between steps
+
+package require tcltest
+
+source ../../scripts/noc_tools_load.tcl
+namespace import ::nocsim::*
+
+proc nop {} {
+
+}
+
+proc inject_p2 {} {
+	if {$::nocsim::nocsim_tick == 0} { inject p2 }
+}
+
+proc inject_p3 {} {
+	if {$::nocsim::nocsim_tick == 2} { inject p3 }
+}
+
+proc r_east {} {
+	foreach dir [list [dir2int pe] [dir2int west]] {
+		if {[incoming $dir] == 1} {
+			if {[peek $dir to_col] > [nodeinfo [current] col]} {
+				route $dir [dir2int east]
+			} else {
+				route $dir [dir2int pe]
+			}
+		}
+	}
+}
+
+proc arr_instr {origin dest flitno hops spawned injected deflections backlog distance} {
+	upvar #0 arrived arrived
+	lappend arrived $dest
+}
+
+tcltest::test 001 {flits should be delivered across links added after stepping} -body {
+	set arrived {}
+	registerinstrument arrive arr_instr
+
+	router r1 0 0 r_east
+	router r2 0 1 r_east
+	PE p1 0 0 inject_p2
+	PE p2 0 1 nop
+	link p1 r1
+	link r1 r2
+	link r2 p2
+
+	step 2
+
+	# extend the chain while the first flit is still in flight
+	router r3 0 2 r_east
+	PE p3 0 2 nop
+	link r2 r3
+	link r3 p3
+	behavior p1 inject_p3
+
+	step 6
+
+	return $arrived
+} -result {p2 p3}
+
+tcltest::test 002 {link counters should survive relocation} -body {
+	return [list [linkinfo r1 r2 load] [linkinfo r2 r3 load] [linkinfo r2 p2 load]]
+} -result {2 1 1}
+
+namespace delete nocsim
+namespace delete nocviz
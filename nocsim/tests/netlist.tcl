@@ -0,0 +1,167 @@
+# test loading and saving netlists
+
+package require tcltest
+
+source test_util.tcl
+
+source ../../scripts/noc_tools_load.tcl
+namespace import ::nocsim::*
+
+proc nop {} {
+
+}
+
+# describe every node and link in the topology of an interpreter
+proc describe {interp} {
+	set result {}
+	set nodes [interp eval $interp {nocsim::allnodes}]
+	foreach id $nodes {
+		set info [list $id]
+		foreach attr {type row col behavior} {
+			lappend info [interp eval $interp [list nocsim::nodeinfo $id $attr]]
+		}
+		lappend result $info
+		foreach to $nodes {
+			if {![catch {interp eval $interp [list nocsim::linkinfo $id $to from_dir]} from_dir]} {
+				lappend result [list $id $to $from_dir [interp eval $interp [list nocsim::linkinfo $id $to to_dir]]]
+			}
+		}
+	}
+	return [lsort $result]
+}
+
+# load a netlist into a fresh interpreter, returning its description
+proc load_fresh {path} {
+	set child [child_interp]
+	$child eval {proc nop {} {}}
+	$child eval [list nocsim::load $path]
+	set result [describe $child]
+	interp delete $child
+	return $result
+}
+
+# load a netlist with the given contents, returning the error message
+proc load_error {contents} {
+	set path [tcltest::makeFile $contents bad.netlist]
+	catch {nocsim::load $path} msg
+	tcltest::removeFile bad.netlist
+	return [string map [list $path FILE] $msg]
+}
+
+tcltest::test 001 {a saved topology should load into an identical topology} -body {
+	create_mesh 3 2 nop native:DOR
+	router {odd router} 5 5 {nop ; # behavior
+with a newline}
+	link R.0.0 {odd router} [dir2int W] [dir2int E]
+	PE lone 7 7 nop
+	link lone {odd router} [dir2int PE] [dir2int PE]
+	link {odd router} lone [dir2int PE] [dir2int PE]
+	set path [tcltest::makeFile {} mesh.netlist]
+	nocsim::save $path
+
+	set same [expr {[load_fresh $path] eq [describe {}]}]
+	tcltest::removeFile mesh.netlist
+	set same
+} -result {1}
+
+tcltest::test 002 {save should write each distinct behavior once} -body {
+	set path [tcltest::makeFile {} mesh.netlist]
+	nocsim::save $path
+	set f [open $path r]
+	set contents [read $f]
+	close $f
+	tcltest::removeFile mesh.netlist
+	list \
+		[lindex [split $contents \n] 0] \
+		[llength [regexp -all -inline -line {^b } $contents]] \
+		[regexp -line {^n r 0 0 0 R.0.0$} $contents]
+} -result {{nocsim-netlist 1 14 29 3} 3 1}
+
+tcltest::test 003 {load should add to an existing topology} -body {
+	set path [tcltest::makeFile "nocsim-netlist 1 2 2 1\nb 10\nnative:DOR\nn r 9 9 0 X\nn r 9 10 0 Y\nl 0 1 2 3\nl 1 0 3 2\n" small.netlist]
+	set before [llength [nocsim::allnodes]]
+	nocsim::load $path
+	tcltest::removeFile small.netlist
+	list [expr {[llength [nocsim::allnodes]] - $before}] [linkinfo X Y from_dir] [linkinfo Y X to_dir] \
+		[nodeinfo Y col]
+} -result {2 2 2 10}
+
+tcltest::test 004 {load should report malformed netlists with their location} -body {
+	list \
+		[load_error "router A 0 0 nop\n"] \
+		[load_error "nocsim-netlist 2 0 0 0\n"] \
+		[load_error "nocsim-netlist 1 1 0 1\nb 3\nnop\nn q 0 0 0 A\n"] \
+		[load_error "nocsim-netlist 1 1 0 1\nb 3\nnop\nn r 0 0 1 A\n"] \
+		[load_error "nocsim-netlist 1 1 0 1\nb 3\nnop\nn r 0 0 0 X\n"] \
+		[load_error "nocsim-netlist 1 2 1 1\nb 3\nnop\nn r 0 0 0 C\nn r 0 1 0 D\nl 0 2 2 3\n"] \
+		[load_error "nocsim-netlist 1 2 1 1\nb 3\nnop\nn r 0 0 0 E\nn r 0 1 0 F\nl 0 1 7 3\n"] \
+		[load_error "nocsim-netlist 1 1 0 1\nb 30\nnop\n"] \
+		[load_error "nocsim-netlist 1 2 0 1\nb 3\nnop\nn r 0 0 0 G\n"]
+} -result {{FILE:1: not a nocsim netlist} {FILE:1: unsupported netlist version, expected 1} {FILE:4: usage: n r|p ROW COL BEHAVIOR ID} {FILE:4: no behavior 1} {FILE:4: a node with the ID X exists already} {FILE:6: no node 2} {FILE:6: invalid direction 7} {FILE:2: behavior is shorter than its length} {FILE:4: expected 2 nodes, 0 links, and 1 behaviors, but found 1, 0, and 1}}
+
+tcltest::test 005 {load and save should fail cleanly} -body {
+	list \
+		[catch {nocsim::load /nonexistent/netlist} msg] $msg \
+		[catch {nocsim::save /nonexistent/netlist} msg] $msg \
+		[catch {nocsim::load} msg] $msg
+} -result {1 {could not open netlist '/nonexistent/netlist': No such file or directory} 1 {could not open netlist '/nonexistent/netlist': No such file or directory} 1 {wrong # args: should be "load FILE"}}
+
+tcltest::test 006 {load should not be allowed after finalize} -body {
+	finalize
+	list [catch {nocsim::load /nonexistent/netlist} msg] $msg
+} -result {1 {the topology may not be modified after it has been finalized}}
+
+namespace delete nocsim
+
+tcltest::test 007 {large netlists should load} -body {
+	set rows 60
+	set cols 60
+	set path [tcltest::makeFile {} large.netlist]
+	set f [open $path w]
+	puts $f "nocsim-netlist 1 [expr {2 * $rows * $cols}] [expr {2 * $rows * $cols + 4 * $rows * ($cols - 1)}] 2"
+	puts $f "b 10\nnative:DOR\nb 14\nnative:uniform"
+	for {set r 0} {$r < $rows} {incr r} {
+		for {set c 0} {$c < $cols} {incr c} {
+			puts $f "n r $r $c 0 R.$r.$c\nn p $r $c 1 PE.$r.$c"
+		}
+	}
+	for {set r 0} {$r < $rows} {incr r} {
+		for {set c 0} {$c < $cols} {incr c} {
+			set n [expr {2 * ($r * $cols + $c)}]
+			puts $f "l $n [expr {$n + 1}] 4 4\nl [expr {$n + 1}] $n 4 4"
+			if {$c + 1 < $cols} {
+				puts $f "l $n [expr {$n + 2}] 2 3\nl [expr {$n + 2}] $n 3 2"
+			}
+			if {$r + 1 < $rows} {
+				puts $f "l $n [expr {$n + 2 * $cols}] 0 1\nl [expr {$n + 2 * $cols}] $n 1 0"
+			}
+		}
+	}
+	close $f
+
+	set result [fresh [list nocsim::load $path] {
+		nocsim::step 20
+		list $nocsim::nocsim_num_node [nocsim::linkinfo R.3.3 R.4.3 from_dir]
+	}]
+	tcltest::removeFile large.netlist
+	set result
+} -result {7200 0}
+
+tcltest::test 008 {load should refuse headers and behaviors larger than the file} -body {
+	set child [child_interp]
+	set result {}
+	foreach contents [list \
+			"nocsim-netlist 1 4000000000 4000000000 1\nb 3\nnop\n" \
+			"nocsim-netlist 1 0 0 4000000000\n" \
+			"nocsim-netlist 1 0 0 1\nb 4000000000\nnop\n"] {
+		set path [tcltest::makeFile $contents huge.netlist]
+		catch {$child eval [list nocsim::load $path]} msg
+		lappend result [string map [list $path FILE] $msg]
+		tcltest::removeFile huge.netlist
+	}
+	lappend result [$child eval {set nocsim::nocsim_num_node}]
+	interp delete $child
+	set result
+} -result {{FILE:1: header gives 4000000000 nodes, 4000000000 links, and 1 behaviors, which cannot fit in 49 bytes} {FILE:1: header gives 0 nodes, 0 links, and 4000000000 behaviors, which cannot fit in 32 bytes} {FILE:2: behavior of 4000000000 bytes cannot fit in 40 bytes} 0}
+
+tcltest::cleanupTests
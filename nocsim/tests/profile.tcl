@@ -0,0 +1,47 @@
+# test the built-in profiler, most of which only exists when nocsim is built
+# with --enable-profile
+
+package require tcltest
+
+source ../../scripts/noc_tools_load.tcl
+namespace import ::nocsim::*
+
+tcltest::testConstraint profile [nocsim::profile enabled]
+
+proc count_route {args} {
+	incr ::routes
+}
+
+tcltest::test 001 {profile report should fail unless profiling is enabled} -constraints !profile -body {
+	list [catch {profile report} msg] $msg
+} -result {1 {nocsim was built without profiling, reconfigure with --enable-profile}}
+
+tcltest::test 002 {profile should reject unknown subcommands} -body {
+	list [catch {profile bogus} msg] $msg
+} -result {1 {unknown subcommand, should be one of report, reset, or enabled}}
+
+tcltest::test 003 {profile report should break down time spent in step} -constraints profile -body {
+	set ::routes 0
+	create_mesh 4 4 native:uniform native:DOR
+	injectrate 0.1
+	registerinstrument route count_route
+	profile reset
+	step 50
+	set report [profile report]
+
+	list \
+		[regexp {^50 ticks} $report] \
+		[regexp {\nstep +50 } $report] \
+		[regexp {\n  flip +50 } $report] \
+		[regexp {\n  behaviors +50 } $report] \
+		[regexp {\n    native:DOR +800 } $report] \
+		[regexp {\n    native:uniform +800 } $report] \
+		[regexp "\n  route +$::routes " $report]
+} -result {1 1 1 1 1 1 1}
+
+tcltest::test 004 {profile reset should zero every counter} -constraints profile -body {
+	profile reset
+	regexp {^0 ticks, [0-9.]+ ms in step, 0.00 TCL evals per tick} [profile report]
+} -result {1}
+
+namespace delete nocsim
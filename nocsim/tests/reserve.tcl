@@ -0,0 +1,67 @@
+# test reserving space for nodes and links ahead of creating them
+
+package require tcltest
+
+source test_util.tcl
+
+source ../../scripts/noc_tools_load.tcl
+namespace import ::nocsim::*
+
+proc nop {} {
+
+}
+
+tcltest::test 001 {reserve should validate its arguments} -body {
+	list \
+		[catch {reserve 10} msg] $msg \
+		[catch {reserve -1 10} msg] $msg \
+		[catch {reserve 10 foo} msg] $msg
+} -result {1 {wrong # args: should be "reserve NODES LINKS"} 1 {NODES and LINKS may not be negative} 1 {expected integer but got "foo"}}
+
+tcltest::test 002 {nodes and links created after reserve should behave normally} -body {
+	reserve 20 10
+	reserve 0 0
+	create_mesh 4 4 nop native:DOR
+	router extra 9 9 nop
+	list [llength [nocsim::allnodes]] [nodeinfo extra row] [linkinfo R.1.1 R.1.2 from_dir] \
+		[nodeinfo R.3.3 behavior]
+} -result {33 9 2 native:DOR}
+
+tcltest::test 003 {reserve should not be allowed after finalize} -body {
+	PE extra_PE 9 9 nop
+	link extra extra_PE
+	link extra_PE extra
+	finalize
+	list [catch {reserve 10 10} msg] $msg
+} -result {1 {the topology may not be modified after it has been finalized}}
+
+namespace delete nocsim
+
+tcltest::test 004 {reserve should return the capacity, which it never shrinks} -body {
+	fresh {
+		proc nop {} {}
+		set result [list [nocsim::reserve 20 10] [nocsim::reserve 5 5]]
+		nocsim::router A 0 0 nop
+		nocsim::router B 0 1 nop
+		nocsim::link A B
+		lappend result [nocsim::reserve 20 0]
+	}
+} -result {{20 10} {20 10} {22 10}}
+
+tcltest::test 005 {reserve and create_mesh should report sizes which cannot be reserved} -body {
+	fresh {
+		proc nop {} {}
+		set result {}
+		foreach script {
+			{nocsim::reserve 2000000000 0}
+			{nocsim::reserve 0 2000000000}
+			{nocsim::reserve 4000000000 4000000000}
+			{nocsim::create_mesh 15000 15000 nop nop}
+		} {
+			lappend result [catch $script msg] $msg
+		}
+		lappend result [nocsim::reserve 0 0] [llength [nocsim::allnodes]]
+	}
+} -match glob -result {1 {cannot reserve 2000000000 nodes and 0 links in addition to the 0 nodes and 0 links which exist, at most * nodes and * links are allowed} 1 {cannot reserve 0 nodes and 2000000000 links *} 1 {NODES and LINKS may not be negative} 1 {cannot reserve 450000000 nodes and 1349940000 links *} {0 0} 0}
+
+tcltest::cleanupTests
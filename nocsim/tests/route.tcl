@@ -25,7 +25,7 @@ proc r2 {} {
 	}
 }
 
-proc arr_instr {origin dest flitno hops spawned injected} {
+proc arr_instr {origin dest flitno hops spawned injected deflections backlog distance} {
 	upvar #0 arrived arrived
 	set arrived 1
 }
@@ -79,7 +79,7 @@ proc route_to_p5 {} {
 }
 
 # Instruments
-proc arr_instr {origin dest flitno hops spawned injected} {
+proc arr_instr {origin dest flitno hops spawned injected deflections backlog distance} {
 	upvar #0 arrived arrived
 	set arrived 1
 }
@@ -0,0 +1,135 @@
+# test nocsim-run, which runs scenario files without an interpreter
+
+package require tcltest
+
+set nocsim_run [file normalize ../../nocsim-run/nocsim-run]
+tcltest::testConstraint nocsimrun [file executable $nocsim_run]
+
+# run a scenario, returning the exit status and output (or error message)
+proc run_scenario {contents args} {
+	set path [tcltest::makeFile $contents scenario.txt]
+	set status [catch {exec $::nocsim_run {*}$args $path 2>@1} output]
+	tcltest::removeFile scenario.txt
+	return [list $status $output]
+}
+
+# extract the value of a key from each phase of the output
+proc phase_values {output key} {
+	return [lmap {- v} [regexp -all -inline "\"$key\": (\[0-9.\]+)" $output] {set v}]
+}
+
+tcltest::test 001 {nocsim-run should run each phase of a mesh scenario} -constraints nocsimrun -body {
+	lassign [run_scenario {
+		title small mesh # ignored
+		seed 3
+		mesh 4 4 native:uniform native:DOR
+		phase warmup 100 0.1
+		phase measure 500
+	}] status output
+
+	list $status \
+		[regexp {"title": "small mesh"} $output] \
+		[regexp {"routers": 16,} $output] \
+		[phase_values $output ticks] \
+		[phase_values $output start] \
+		[expr {[lindex [phase_values $output arrived] 1] > 0}]
+} -result {0 1 1 {100 500} {0 100} 1}
+
+tcltest::test 002 {nocsim-run should be repeatable for a given seed} -constraints nocsimrun -body {
+	set scenario {
+		mesh 4 4 native:uniform native:ADOR
+		injectrate 0.3
+		phase a 200
+	}
+	lassign [run_scenario $scenario -s 7] - first
+	lassign [run_scenario $scenario -s 7] - second
+	lassign [run_scenario $scenario -s 8] - third
+	list \
+		[expr {[phase_values $first routed] == [phase_values $second routed]}] \
+		[expr {[phase_values $first routed] == [phase_values $third routed]}]
+} -result {1 0}
+
+tcltest::test 003 {nocsim-run should support arbitrary topologies} -constraints nocsimrun -body {
+	lassign [run_scenario {
+		router R.0 0 0 native:table
+		router R.1 0 1 native:table
+		PE PE.0 0 0 native:uniform
+		PE PE.1 0 1 native:uniform
+		link R.0 R.1 E W
+		link R.1 R.0 W E
+		link PE.0 R.0 PE PE
+		link R.0 PE.0 PE PE
+		link PE.1 R.1 PE PE
+		link R.1 PE.1 PE PE
+		injectrate PE.0 1
+		phase a 100
+		heatmap
+	}] status output
+
+	list $status [phase_values $output spawned] [phase_values $output arrived] \
+		[regexp {"carried": \[\[99, 98\]\]} $output]
+} -result {0 100 98 1}
+
+tcltest::test 004 {nocsim-run should reject TCL behaviors} -constraints nocsimrun -body {
+	run_scenario {
+		mesh 2 2 native:uniform my_routing_proc
+		phase a 10
+	}
+} -match glob -result {1 {*scenario.txt:2: behavior 'my_routing_proc' is not native, and there is no TCL interpreter to evaluate it*}}
+
+tcltest::test 005 {nocsim-run should report errors with their location} -constraints nocsimrun -body {
+	list \
+		[run_scenario "mesh 2 2 native:uniform native:DOR\nbogus 1 2\nphase a 1"] \
+		[run_scenario "mesh 2 2 native:uniform native:DOR\nphase a 1 1.5"] \
+		[run_scenario "mesh 2 2 native:uniform native:DOR"] \
+		[run_scenario "mesh 70000 70000 native:uniform native:DOR\nphase a 1"]
+} -match glob -result {{1 {*scenario.txt:2: unknown statement 'bogus'*}} {1 {*scenario.txt:2: P must be between 0 and 1*}} {1 {*scenario.txt: scenario has no phases*}} {1 {*scenario.txt:1: a 70000 by 70000 mesh has too many nodes and links*}}}
+
+tcltest::test 006 {nocsim-run should write results to the output file} -constraints nocsimrun -body {
+	set out [tcltest::makeFile {} results.json]
+	lassign [run_scenario "mesh 2 2 native:uniform native:DOR\nphase a 5\noutput /nonexistent/results.json" -o $out] status output
+	set f [open $out r]
+	set results [read $f]
+	close $f
+	tcltest::removeFile results.json
+	list $status $output [phase_values $results ticks]
+} -result {0 {} 5}
+
+tcltest::test 007 {nocsim-run should load netlists relative to the scenario} -constraints nocsimrun -body {
+	tcltest::makeFile "nocsim-netlist 1 4 4 2\nb 10\nnative:DOR\nb 14\nnative:uniform\nn r 0 0 0 R.0.0\nn p 0 0 1 PE.0.0\nn r 0 1 0 R.0.1\nn p 0 1 1 PE.0.1\nl 0 1 4 4\nl 1 0 4 4\nl 2 3 4 4\nl 3 2 4 4" pair.netlist
+	lassign [run_scenario "load pair.netlist\nphase a 1"] status output
+	lassign [run_scenario "load pair.netlist\nload pair.netlist\nphase a 1"] failed error
+	tcltest::removeFile pair.netlist
+	list $status [regexp {"routers": 2,} $output] $failed $error
+} -match glob -result {0 1 1 {*scenario.txt:2: *pair.netlist:6: a node with the ID R.0.0 exists already*}}
+
+tcltest::test 008 {nocsim-run should apply the arbitration policy} -constraints nocsimrun -body {
+	set scenario "mesh 4 4 native:uniform native:DOR\ninjectrate 0.5\nphase a 300"
+	lassign [run_scenario $scenario] - fixed
+	lassign [run_scenario "arbitration fixed N S E W PE\n$scenario"] - explicit
+	lassign [run_scenario "arbitration oldest\n$scenario"] - oldest
+	list \
+		[expr {[phase_values $fixed arrived] == [phase_values $explicit arrived]}] \
+		[expr {[phase_values $fixed arrived] == [phase_values $oldest arrived]}] \
+		[run_scenario "arbitration oldest N\nphase a 1"] \
+		[run_scenario "arbitration bogus\nphase a 1"]
+} -match glob -result {1 0 {1 {*scenario.txt:1: usage: arbitration POLICY ?DIR DIR DIR DIR DIR?*}} {1 {*scenario.txt:1: arbitration policy should be one of fixed, oldest, roundrobin, or random*}}}
+
+tcltest::test 009 {nocsim-run should report histograms for each phase} -constraints nocsimrun -body {
+	lassign [run_scenario "mesh 4 4 native:uniform native:DOR\ninjectrate 0.1\nhistogram\nphase a 200\nphase b 200"] status output
+	set hops [lmap {- v} [regexp -all -inline {"hops": \[([0-9, ]*)\]} $output] {
+		tcl::mathop::+ {*}[split [string map {" " ""} $v] ,]
+	}]
+	list $status [llength $hops] [expr {$hops eq [phase_values $output arrived]}] \
+		[regexp {"inflation": \[} $output]
+} -result {0 2 1 1}
+
+tcltest::test 010 {nocsim-run should report energy for each phase} -constraints nocsimrun -body {
+	tcltest::makeFile "static 1\ncrossbar 0" energy.model
+	lassign [run_scenario "mesh 2 2 native:uniform native:DOR\nenergy energy.model\nphase a 10\nphase b 5"] status output
+	lassign [run_scenario "mesh 2 2 native:uniform native:DOR\nenergy missing.model\nphase a 1"] failed error
+	tcltest::removeFile energy.model
+	list $status [phase_values $output static] [phase_values $output crossbar] $failed $error
+} -match glob -result {0 {40.000000 20.000000} {0.000000 0.000000} 1 {*scenario.txt:2: could not open energy model '*missing.model': No such file or directory*}}
+
+tcltest::cleanupTests
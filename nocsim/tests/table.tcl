@@ -0,0 +1,125 @@
+# test native routing from shortest paths on arbitrary topologies
+
+package require tcltest
+
+source test_util.tcl
+
+source ../../scripts/noc_tools_load.tcl
+namespace import ::nocsim::*
+
+# evaluate a script in a fresh interpreter with a ring of four routers, each
+# with one PE, which use the given behavior:
+#
+#     r0 -- r1
+#     |      |
+#     r3 -- r2
+#
+# p1 sends a flit to p3 every tick until tick 20
+proc ring {behavior script} {
+	fresh [list set behavior $behavior] {
+		proc nop {} {}
+		proc inject_p3 {} {
+			if {$::nocsim::nocsim_tick < 20} { nocsim::inject p3 }
+		}
+		proc record_nexthop {} {
+			if {[nocsim::current] eq "r1" && [nocsim::incoming [nocsim::dir2int PE]] == 1} {
+				foreach alg {table updown escape} {
+					lappend ::hops [nocsim::nexthop [nocsim::dir2int PE] $alg]
+				}
+			}
+			foreach dir [nocsim::dir2list N S E W PE] {
+				if {[nocsim::incoming $dir] != 1} { continue }
+				nocsim::route_priority $dir {*}[nocsim::nexthop $dir table]
+			}
+		}
+		foreach {id row col} {0 0 0 1 0 1 2 1 1 3 1 0} {
+			nocsim::router r$id $row $col $behavior
+			nocsim::PE p$id $row $col nop
+			nocsim::link p$id r$id
+			nocsim::link r$id p$id
+		}
+		foreach {a b} {r0 r1 r1 r2 r2 r3 r3 r0} {
+			nocsim::link $a $b
+			nocsim::link $b $a
+		}
+		nocsim::behavior p1 inject_p3
+		nocsim::finalize
+	} $script
+}
+
+tcltest::test 001 {nexthop should expose shortest path and up*/down* candidates} -body {
+	ring record_nexthop {
+		set ::hops {}
+		nocsim::step 3
+		lrange $::hops 0 2
+	}
+} -result [list [dir2list S W] [dir2list W] [dir2list S W]]
+
+tcltest::test 002 {native:table should deliver every flit along a shortest path} -body {
+	ring native:table {
+		nocsim::step 30
+		list $::nocsim::nocsim_spawned $::nocsim::nocsim_arrived \
+			[nocsim::linkinfo r1 r2 load] [nocsim::linkinfo r1 r0 load]
+	}
+} -result {20 20 20 0}
+
+tcltest::test 003 {native:updown should not turn from a down link to an up link} -body {
+	ring native:updown {
+		nocsim::step 30
+		list $::nocsim::nocsim_spawned $::nocsim::nocsim_arrived \
+			[nocsim::linkinfo r1 r2 load] [nocsim::linkinfo r1 r0 load] \
+			[nocsim::linkinfo r2 r3 load]
+	}
+} -result {20 20 0 20 0}
+
+tcltest::test 004 {native:escape should deliver every flit} -body {
+	ring native:escape {
+		nocsim::step 30
+		list $::nocsim::nocsim_spawned $::nocsim::nocsim_arrived
+	}
+} -result {20 20}
+
+tcltest::test 005 {native table routing should deliver every flit on a mesh with missing links} -body {
+	set results {}
+	foreach behavior {native:table native:updown native:escape} {
+		lappend results [fresh [list set behavior $behavior] {
+			proc inject {} {
+				if {$::nocsim::nocsim_tick < 5} {
+					nocsim::inject [nocsim::randnode [nocsim::current]]
+				}
+			}
+
+			# a 12x12 mesh, with a wall down the middle that can only
+			# be crossed in the first and last rows
+			for {set row 0} {$row < 12} {incr row} {
+				for {set col 0} {$col < 12} {incr col} {
+					nocsim::router R.$row.$col $row $col $behavior
+					nocsim::PE PE.$row.$col $row $col inject
+					nocsim::link PE.$row.$col R.$row.$col
+					nocsim::link R.$row.$col PE.$row.$col
+				}
+			}
+			for {set row 0} {$row < 12} {incr row} {
+				for {set col 0} {$col < 12} {incr col} {
+					if {$row < 11} {
+						nocsim::link R.$row.$col R.[expr {$row + 1}].$col
+						nocsim::link R.[expr {$row + 1}].$col R.$row.$col
+					}
+					if {$col < 11 && ($col != 5 || $row == 0 || $row == 11)} {
+						nocsim::link R.$row.$col R.$row.[expr {$col + 1}]
+						nocsim::link R.$row.[expr {$col + 1}] R.$row.$col
+					}
+				}
+			}
+
+			nocsim::finalize
+			nocsim::step 1000
+			expr {$::nocsim::nocsim_spawned > 0 &&
+				$::nocsim::nocsim_arrived == $::nocsim::nocsim_spawned}
+		}]
+	}
+	return $results
+} -result {1 1 1}
+
+namespace delete nocsim
+namespace delete nocviz
@@ -0,0 +1,28 @@
+# procedures shared by the test files, which source this file. It contains no
+# tests of it's own, so run_tests.sh skips it.
+
+namespace eval ::test_util {
+	variable load [file join [file dirname [file dirname [file dirname [file normalize [info script]]]]] scripts noc_tools_load.tcl]
+}
+
+# create an interpreter with the nocsim and nocviz packages loaded, which the
+# caller must delete
+proc child_interp {} {
+	set child [interp create]
+	$child eval [list source $::test_util::load]
+	return $child
+}
+
+# evaluate each script in order in a fresh interpreter, returning the result
+# of the last, the interpreter is deleted even if a script fails
+proc fresh {args} {
+	set child [child_interp]
+	set code [catch {
+		foreach script $args {
+			set result [$child eval $script]
+		}
+		set result
+	} result options]
+	interp delete $child
+	return -options $options $result
+}
@@ -0,0 +1,41 @@
+# test native uniform random injection and injectrate
+
+package require tcltest
+
+source ../../scripts/noc_tools_load.tcl
+namespace import ::nocsim::*
+
+tcltest::test 001 {PEs should not inject until an injection rate is set} -body {
+	create_mesh 4 4 native:uniform native:DOR
+	step 10
+	return [list $::nocsim::nocsim_spawned [nodeinfo PE.1.1 P_inject]]
+} -result {0 0.0}
+
+tcltest::test 002 {injectrate should set the rate for every PE} -body {
+	injectrate 1
+	step 10
+	return [list $::nocsim::nocsim_spawned [nodeinfo PE.1.1 P_inject]]
+} -result {160 1.0}
+
+tcltest::test 003 {injectrate should set the rate for a single PE} -body {
+	injectrate 0
+	injectrate PE.3.3 1
+	set before [nodeinfo PE.3.3 spawned]
+	set spawned $::nocsim::nocsim_spawned
+	step 10
+	return [list [expr {[nodeinfo PE.3.3 spawned] - $before}] \
+		[expr {$::nocsim::nocsim_spawned - $spawned}]]
+} -result {10 10}
+
+tcltest::test 004 {every flit injected by native:uniform should arrive} -body {
+	injectrate 0
+	step 500
+	return [expr {$::nocsim::nocsim_arrived == $::nocsim::nocsim_spawned}]
+} -result {1}
+
+tcltest::test 005 {injection rates out of bounds should be rejected} -body {
+	list [catch {injectrate 1.5}] [catch {injectrate PE.0.0 -1}] [catch {injectrate bogus 0.5}]
+} -result {1 1 1}
+
+namespace delete nocsim
+namespace delete nocviz
@@ -31,14 +31,28 @@ void nocsim_init_node(nocsim_node* n, nocsim_node_type type, unsigned int row, u
 	n->outgoing[E] = NULL;
 	n->outgoing[P] = NULL;
 
+	n->num_arbitrated = 0;
+	n->arbiter = 0;
+
 	n->P_inject = 0;
 	n->behavior = NULL;
+	n->native = NULL;
+#ifdef NOCSIM_PROFILE
+	n->profile = NULL;
+#endif
 
 	n->node_number = 0;
 	n->type_number = 0;
 
 	n->injected = 0;
 	n->routed = 0;
+	n->productive = 0;
+	n->deflected = 0;
+	n->buffered = 0;
+	n->occupancy = 0;
+	for (int e = 0 ; e < (int) ENERGY_LINK ; e++) {
+		n->activity[e] = 0;
+	}
 
 	n->spawned = 0;
 	n->injected = 0;
@@ -138,6 +152,11 @@ unsigned int randrange(unsigned int lower, unsigned int upper) {
 
 /* display an error traceback */
 void print_tcl_error(Tcl_Interp* interp) {
+	if (interp == NULL) {
+		errwritef(interp, "%s", "TCL error, but there is no interpreter");
+		return;
+	}
+
 	errwritef(interp,  "TCL error: %s", Tcl_GetStringResult(interp));
 	errwritef(interp,  "$errorInfo is: %s", Tcl_GetVar(interp, "errorInfo", 0));
 	Tcl_Eval(interp, "info errorstack");
@@ -1,5 +1,9 @@
 #include "commands.h"
 
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+
 /* https://wiki.tcl-lang.org/page/Tcl+Handles */
 
 int nocviz_command_node(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_Obj *const objv[]) {
@@ -42,6 +46,12 @@ int nocviz_command_node(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_Obj
 	} else if (string_equals(subcmd, "color")) {
 		return nocviz_subcmd_node_color(cdata, interp, objc, objv);
 
+	} else if (string_equals(subcmd, "index")) {
+		return nocviz_subcmd_node_index(cdata, interp, objc, objv);
+
+	} else if (string_equals(subcmd, "top")) {
+		return nocviz_subcmd_node_top(cdata, interp, objc, objv);
+
 	} else {
 		Tcl_SetResultf(interp, "no such subcommand: %s", subcmd);
 		return TCL_ERROR;
@@ -91,6 +101,12 @@ int nocviz_command_link(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_Obj
 	} else if (string_equals(subcmd, "color")) {
 		return nocviz_subcmd_link_color(cdata, interp, objc, objv);
 
+	} else if (string_equals(subcmd, "index")) {
+		return nocviz_subcmd_link_index(cdata, interp, objc, objv);
+
+	} else if (string_equals(subcmd, "top")) {
+		return nocviz_subcmd_link_top(cdata, interp, objc, objv);
+
 	} else if (string_equals(subcmd, "curve")) {
 		return nocviz_subcmd_link_curve(cdata, interp, objc, objv);
 
@@ -111,6 +127,116 @@ int nocviz_command_launch_gui(ClientData cdata, Tcl_Interp* interp, int objc, Tc
 
 }
 
+/* parse the value of a -width or -height option */
+static int nocviz_render_parse_size(Tcl_Interp* interp, Tcl_Obj* obj, int* size) {
+	if (Tcl_GetIntFromObj(interp, obj, size) != TCL_OK) { return TCL_ERROR; }
+	if (*size < 1 || *size > NOCVIZ_RENDER_MAX_SIZE) {
+		Tcl_SetResultf(interp, "size must be between 1 and %d, not %d",
+			NOCVIZ_RENDER_MAX_SIZE, *size);
+		return TCL_ERROR;
+	}
+	return TCL_OK;
+}
+
+int nocviz_command_render(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_Obj *const objv[]) {
+	nocviz_graph* g = cdata;
+	nocviz_render_opts opts;
+	char* pattern;
+	char* option;
+	char* value;
+	char* path;
+	bool have_format = false;
+	bool sequence;
+	int frame = -1;
+
+	if (objc < 2 || objc % 2 != 0) {
+		Tcl_WrongNumArgs(interp, 0, objv, "render FILE ?-width W? ?-height H? "
+			"?-format png|svg? ?-labels none|nodes|links|all? ?-frame N?");
+		return TCL_ERROR;
+	}
+
+	nocviz_render_opts_init(&opts);
+	pattern = Tcl_GetString(objv[1]);
+
+	for (int i = 2 ; i < objc ; i += 2) {
+		option = Tcl_GetString(objv[i]);
+		value = Tcl_GetString(objv[i + 1]);
+
+		if (string_equals(option, "-width")) {
+			if (nocviz_render_parse_size(interp, objv[i + 1], &opts.width) != TCL_OK) {
+				return TCL_ERROR;
+			}
+
+		} else if (string_equals(option, "-height")) {
+			if (nocviz_render_parse_size(interp, objv[i + 1], &opts.height) != TCL_OK) {
+				return TCL_ERROR;
+			}
+
+		} else if (string_equals(option, "-format")) {
+			if (string_equals(value, "png")) {
+				opts.format = NOCVIZ_RENDER_PNG;
+			} else if (string_equals(value, "svg")) {
+				opts.format = NOCVIZ_RENDER_SVG;
+			} else {
+				Tcl_SetResultf(interp, "no such format: %s", value);
+				return TCL_ERROR;
+			}
+			have_format = true;
+
+		} else if (string_equals(option, "-labels")) {
+			if (string_equals(value, "none")) {
+				opts.labels = 0;
+			} else if (string_equals(value, "nodes")) {
+				opts.labels = NOCVIZ_RENDER_NODE_LABELS;
+			} else if (string_equals(value, "links")) {
+				opts.labels = NOCVIZ_RENDER_LINK_LABELS;
+			} else if (string_equals(value, "all")) {
+				opts.labels = NOCVIZ_RENDER_NODE_LABELS | NOCVIZ_RENDER_LINK_LABELS;
+			} else {
+				Tcl_SetResultf(interp, "labels must be none, nodes, links, or all, not %s", value);
+				return TCL_ERROR;
+			}
+
+		} else if (string_equals(option, "-frame")) {
+			frame = get_int_from_obj(interp, objv[i + 1]);
+			if (frame < 0) {
+				Tcl_SetResultf(interp, "frame must not be negative, not %d", frame);
+				return TCL_ERROR;
+			}
+
+		} else {
+			Tcl_SetResultf(interp, "no such option: %s", option);
+			return TCL_ERROR;
+		}
+	}
+
+	if (!have_format && !nocviz_render_format_from_path(pattern, &opts.format)) {
+		Tcl_SetResultf(interp, "cannot tell the format of '%s', use -format png|svg", pattern);
+		return TCL_ERROR;
+	}
+
+	/* a pattern with a frame number writes the next frame of a sequence */
+	if (frame >= 0) { g->frame = frame; }
+	path = nocviz_render_frame_path(pattern, g->frame, &sequence);
+	if (path == NULL) {
+		Tcl_SetResultf(interp, "invalid filename pattern '%s', "
+			"which may contain one %%d, and %%%% for a literal %%", pattern);
+		return TCL_ERROR;
+	}
+
+	if (!nocviz_render(g, path, &opts)) {
+		Tcl_SetResultf(interp, "could not write '%s': %s", path, strerror(errno));
+		free(path);
+		return TCL_ERROR;
+	}
+	if (sequence) { g->frame++; }
+
+	Tcl_SetObjResult(interp, Tcl_NewStringObj(path, -1));
+	free(path);
+
+	return TCL_OK;
+}
+
 int nocviz_command_op(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_Obj *const objv[]) {
 	UNUSED(cdata);
 	char* subcmd;
@@ -203,6 +329,9 @@ int nocviz_command_data(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_Obj
 	} else if (string_equals(subcmd, "delete")) {
 		return nocviz_subcmd_data_delete(cdata, interp, objc, objv);
 
+	} else if (string_equals(subcmd, "batch")) {
+		return nocviz_subcmd_data_batch(cdata, interp, objc, objv);
+
 	} else {
 		Tcl_SetResultf(interp, "no such subcommand: %s", subcmd);
 		return TCL_ERROR;
@@ -210,38 +339,568 @@ int nocviz_command_data(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_Obj
 
 }
 
-int nocviz_subcmd_data_set(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_Obj *const objv[]) {
-	nocviz_graph* g = cdata;
-	char* key;
-	char* val;
+/**
+ * @brief Store the value given to one of the data set subcommands, while
+ * holding the datastore's mutex.
+ *
+ * If ds is NULL, the value is only checked, so that a batch of values can be
+ * validated before any of them are stored. Nothing is stored if the value is
+ * not of the given type.
+ *
+ * @param interp
+ * @param ds
+ * @param type one of -int, -double, -ints, or -doubles, or NULL to store the
+ * value as a string
+ * @param key
+ * @param obj
+ *
+ * @return TCL_OK, or TCL_ERROR if the value is not of the given type
+ */
+int __nocviz_data_set_value(Tcl_Interp* interp, nocviz_ds* ds, char* type, char* key, Tcl_Obj* obj) {
+	Tcl_WideInt i;
+	double d;
+	Tcl_Obj** elems;
+	int64_t* ints;
+	double* doubles;
+	int n;
+
+	if (type == NULL) {
+		if (ds == NULL) { return TCL_OK; }
+		__nocviz_ds_set_kvp(ds, key, strdup(Tcl_GetString(obj)));
+
+	} else if (string_equals(type, "-int")) {
+		if (Tcl_GetWideIntFromObj(interp, obj, &i) != TCL_OK) { return TCL_ERROR; }
+		if (ds == NULL) { return TCL_OK; }
+		__nocviz_ds_set_int(ds, key, i);
+
+	} else if (string_equals(type, "-double")) {
+		if (Tcl_GetDoubleFromObj(interp, obj, &d) != TCL_OK) { return TCL_ERROR; }
+		if (ds == NULL) { return TCL_OK; }
+		__nocviz_ds_set_double(ds, key, d);
+
+	} else if (string_equals(type, "-ints")) {
+		if (Tcl_ListObjGetElements(interp, obj, &n, &elems) != TCL_OK) { return TCL_ERROR; }
+		ints = noctools_malloc(sizeof(int64_t) * (n > 0 ? n : 1));
+		for (int j = 0 ; j < n ; j++) {
+			if (Tcl_GetWideIntFromObj(interp, elems[j], &i) != TCL_OK) {
+				free(ints);
+				return TCL_ERROR;
+			}
+			ints[j] = i;
+		}
+		if (ds != NULL) { __nocviz_ds_set_ints(ds, key, ints, n); }
+		free(ints);
+
+	} else if (string_equals(type, "-doubles")) {
+		if (Tcl_ListObjGetElements(interp, obj, &n, &elems) != TCL_OK) { return TCL_ERROR; }
+		doubles = noctools_malloc(sizeof(double) * (n > 0 ? n : 1));
+		for (int j = 0 ; j < n ; j++) {
+			if (Tcl_GetDoubleFromObj(interp, elems[j], &doubles[j]) != TCL_OK) {
+				free(doubles);
+				return TCL_ERROR;
+			}
+		}
+		if (ds != NULL) { __nocviz_ds_set_doubles(ds, key, doubles, n); }
+		free(doubles);
 
-	Tcl_RequireArgs(interp, 4, "data set KEY VAL");
+	} else {
+		Tcl_SetResultf(interp, "unknown type '%s', should be -int, -double, -ints, or -doubles", type);
+		return TCL_ERROR;
+	}
 
-	key = Tcl_GetString(objv[2]);
-	val = Tcl_GetString(objv[3]);
+	return TCL_OK;
+}
+
+/**
+ * @brief Store the value given to one of the data set subcommands.
+ *
+ * @param interp
+ * @param ds
+ * @param type as in __nocviz_data_set_value()
+ * @param key
+ * @param obj
+ *
+ * @return TCL_OK, or TCL_ERROR if the value is not of the given type
+ */
+int nocviz_data_set_value(Tcl_Interp* interp, nocviz_ds* ds, char* type, char* key, Tcl_Obj* obj) {
+	int status;
+
+	noctools_mutex_lock(ds->mutex);
+	status = __nocviz_data_set_value(interp, ds, type, key, obj);
+	noctools_mutex_unlock(ds->mutex);
+
+	return status;
+}
+
+/**
+ * @brief Retrieve a value for one of the data get subcommands.
+ *
+ * @param ds
+ * @param key
+ *
+ * @return a new TCL object of the same type as the value, or NULL if there
+ * is no such key
+ */
+Tcl_Obj* nocviz_data_get_value(nocviz_ds* ds, char* key) {
+	nocviz_val* val;
+	Tcl_Obj* obj = NULL;
+
+	noctools_mutex_lock(ds->mutex);
+
+	val = __nocviz_ds_get_val(ds, key);
+	if (val == NULL) {
+		noctools_mutex_unlock(ds->mutex);
+		return NULL;
+	}
+
+	switch (val->type) {
+	case NOCVIZ_VAL_INT:
+		obj = Tcl_NewWideIntObj(val->as.i);
+		break;
+
+	case NOCVIZ_VAL_DOUBLE:
+		obj = Tcl_NewDoubleObj(val->as.d);
+		break;
+
+	case NOCVIZ_VAL_INTS:
+		obj = Tcl_NewListObj(0, NULL);
+		for (size_t i = 0 ; i < val->len ; i++) {
+			Tcl_ListObjAppendElement(NULL, obj, Tcl_NewWideIntObj(val->as.ints[i]));
+		}
+		break;
+
+	case NOCVIZ_VAL_DOUBLES:
+		obj = Tcl_NewListObj(0, NULL);
+		for (size_t i = 0 ; i < val->len ; i++) {
+			Tcl_ListObjAppendElement(NULL, obj, Tcl_NewDoubleObj(val->as.doubles[i]));
+		}
+		break;
+
+	default:
+		obj = Tcl_NewStringObj(val->str, -1);
+		break;
+	}
+
+	noctools_mutex_unlock(ds->mutex);
+
+	return obj;
+}
+
+/**
+ * @brief Parse the condition given to one of the match subcommands, which is
+ * either a regular expression, a numeric comparison such as `-gt 100` or
+ * `-range 10 20`, or a string comparison `-is VALUE`.
+ *
+ * A regular expression is compiled once here, and cached by TCL in it's
+ * object, rather than every time it is tested.
+ *
+ * @param interp
+ * @param objc number of arguments following the key
+ * @param objv arguments following the key
+ * @param m set to the parsed condition
+ *
+ * @return TCL_OK, or TCL_ERROR if the condition is invalid
+ */
+int nocviz_match_parse(Tcl_Interp* interp, int objc, Tcl_Obj *const objv[], nocviz_match* m) {
+	static const char* ops[] = {"-gt", "-ge", "-lt", "-le", "-eq", "-range", "-is", NULL};
+	static const nocviz_match_op opcodes[] = {NOCVIZ_MATCH_GT,
+		NOCVIZ_MATCH_GE, NOCVIZ_MATCH_LT, NOCVIZ_MATCH_LE,
+		NOCVIZ_MATCH_EQ, NOCVIZ_MATCH_RANGE, NOCVIZ_MATCH_IS};
+	int index;
+
+	if (objc == 1) {
+		m->op = NOCVIZ_MATCH_REGEX;
+		m->re = Tcl_GetRegExpFromObj(interp, objv[0], TCL_REG_ADVANCED);
+		return m->re == NULL ? TCL_ERROR : TCL_OK;
+	}
+
+	if (objc < 2 || objc > 3) {
+		Tcl_SetResultf(interp, "wrong # args for condition, should be %s",
+				NOCVIZ_MATCH_ARGS);
+		return TCL_ERROR;
+	}
+
+	if (Tcl_GetIndexFromObj(interp, objv[0], ops, "comparison", 0, &index) != TCL_OK) {
+		return TCL_ERROR;
+	}
+	m->op = opcodes[index];
+	m->re = NULL;
+	m->str = NULL;
+
+	if ((m->op == NOCVIZ_MATCH_RANGE) != (objc == 3)) {
+		Tcl_SetResultf(interp, "wrong # args for condition, should be %s",
+				NOCVIZ_MATCH_ARGS);
+		return TCL_ERROR;
+	}
+
+	if (m->op == NOCVIZ_MATCH_IS) {
+		m->str = Tcl_GetString(objv[1]);
+		return TCL_OK;
+	}
+
+	if (Tcl_GetDoubleFromObj(interp, objv[1], &m->a) != TCL_OK) { return TCL_ERROR; }
+	if (objc == 3 && Tcl_GetDoubleFromObj(interp, objv[2], &m->b) != TCL_OK) {
+		return TCL_ERROR;
+	}
+
+	return TCL_OK;
+}
+
+/**
+ * @brief Test a match condition against the value of a key in a datastore.
+ *
+ * Numeric comparisons use typed values directly, and parse string values.
+ * Values which are not numbers, including arrays, never match them.
+ *
+ * @param interp
+ * @param m
+ * @param ds
+ * @param key
+ *
+ * @return 1 if the value matches, 0 if it does not or there is no such key,
+ * or -1 if matching a regular expression failed
+ */
+int nocviz_match_ds(Tcl_Interp* interp, nocviz_match* m, nocviz_ds* ds, char* key) {
+	nocviz_val* val;
+	char* str;
+	double d;
+	int result = 0;
+
+	noctools_mutex_lock(ds->mutex);
+
+	val = __nocviz_ds_get_val(ds, key);
+
+	if (val == NULL) {
+		result = 0;
+
+	} else if (m->op == NOCVIZ_MATCH_REGEX) {
+		str = nocviz_val_str(val);
+		dbprintf("checking match for key=%s val=%s\n", key, str);
+		result = Tcl_RegExpExec(interp, m->re, str, str);
+
+	} else if (m->op == NOCVIZ_MATCH_IS) {
+		result = string_equals(nocviz_val_str(val), m->str);
+
+	} else if (nocviz_val_double(val, &d)) {
+		switch (m->op) {
+		case NOCVIZ_MATCH_GT: result = d > m->a; break;
+		case NOCVIZ_MATCH_GE: result = d >= m->a; break;
+		case NOCVIZ_MATCH_LT: result = d < m->a; break;
+		case NOCVIZ_MATCH_LE: result = d <= m->a; break;
+		case NOCVIZ_MATCH_EQ: result = d == m->a; break;
+		case NOCVIZ_MATCH_RANGE: result = d >= m->a && d <= m->b; break;
+		default: break;
+		}
+	}
+
+	noctools_mutex_unlock(ds->mutex);
+
+	return result;
+}
+
+/* Collect the items matching a condition from an index, returns false if the
+ * index can't answer the condition. The index set's mutex must be held. */
+static bool nocviz_match_index(nocviz_match* m, nocviz_index* idx, ptrvec* items) {
+	khash_t(sptr)* found;
+	size_t lo = 0;
+	size_t hi;
+
+	if (m->op == NOCVIZ_MATCH_REGEX) { return false; }
+
+	if (m->op == NOCVIZ_MATCH_IS) {
+		if (idx->type != NOCVIZ_INDEX_STRING) { return false; }
+		found = nocviz_index_find(idx, m->str);
+		if (found == NULL) { return true; }
+		for (khint_t i = kh_begin(found) ; i != kh_end(found) ; i++) {
+			if (kh_exist(found, i)) {
+				vec_push(items, (void*) (uintptr_t) kh_key(found, i));
+			}
+		}
+		return true;
+	}
+
+	if (idx->type != NOCVIZ_INDEX_NUMERIC) { return false; }
+
+	/* nothing compares true to NaN */
+	if (isnan(m->a) || (m->op == NOCVIZ_MATCH_RANGE && isnan(m->b))) { return true; }
+
+	hi = idx->entries->length;
+	switch (m->op) {
+	case NOCVIZ_MATCH_GT: lo = nocviz_index_upper_bound(idx, m->a); break;
+	case NOCVIZ_MATCH_GE: lo = nocviz_index_lower_bound(idx, m->a); break;
+	case NOCVIZ_MATCH_LT: hi = nocviz_index_lower_bound(idx, m->a); break;
+	case NOCVIZ_MATCH_LE: hi = nocviz_index_upper_bound(idx, m->a); break;
+	case NOCVIZ_MATCH_EQ:
+		lo = nocviz_index_lower_bound(idx, m->a);
+		hi = nocviz_index_upper_bound(idx, m->a);
+		break;
+	case NOCVIZ_MATCH_RANGE:
+		lo = nocviz_index_lower_bound(idx, m->a);
+		hi = nocviz_index_upper_bound(idx, m->b);
+		break;
+	default: break;
+	}
+
+	for (size_t i = lo ; i < hi ; i++) {
+		vec_push(items, idx->entries->data[i].item);
+	}
+
+	return true;
+}
+
+/**
+ * @brief Find the nodes or links whose value of a key matches a condition.
+ *
+ * If the key is indexed, and the index can answer the condition, then only
+ * the matching items are visited, otherwise every node or link is.
+ *
+ * @param interp
+ * @param g
+ * @param links true to search links rather than nodes
+ * @param key
+ * @param m
+ * @param items the matching nodes or links are appended to this
+ *
+ * @return TCL_OK, or TCL_ERROR if matching a regular expression failed
+ */
+int nocviz_match_items(Tcl_Interp* interp, nocviz_graph* g, bool links, char* key, nocviz_match* m, ptrvec* items) {
+	nocviz_index_set* set = links ? g->link_indexes : g->node_indexes;
+	nocviz_index* idx;
+	nocviz_node* node;
+	nocviz_link* link;
+	bool indexed;
+	int matched;
+
+	noctools_mutex_lock(set->mutex);
+	idx = __nocviz_index_set_get(set, key);
+	indexed = idx != NULL && nocviz_match_index(m, idx, items);
+	noctools_mutex_unlock(set->mutex);
+
+	if (indexed) { return TCL_OK; }
+
+	if (links) {
+		nocviz_graph_foreach_link(g, link,
+			matched = nocviz_match_ds(interp, m, link->ds, key);
+			if (matched < 0) { return TCL_ERROR; }
+			if (matched) { vec_push(items, link); }
+		);
+	} else {
+		nocviz_graph_foreach_node(g, node,
+			matched = nocviz_match_ds(interp, m, node->ds, key);
+			if (matched < 0) { return TCL_ERROR; }
+			if (matched) { vec_push(items, node); }
+		);
+	}
+
+	return TCL_OK;
+}
+
+/**
+ * @brief Find the n nodes or links with the greatest numeric values of a key,
+ * in descending order.
+ *
+ * If the key has a numeric index, then only those items are visited,
+ * otherwise every node or link is, and the values are sorted.
+ *
+ * @param g
+ * @param links true to search links rather than nodes
+ * @param key
+ * @param n
+ * @param items the nodes or links found are appended to this
+ */
+void nocviz_top_items(nocviz_graph* g, bool links, char* key, int n, ptrvec* items) {
+	nocviz_index_set* set = links ? g->link_indexes : g->node_indexes;
+	nocviz_index* idx;
+	nocviz_node* node;
+	nocviz_link* link;
+	nocviz_index_entry e;
+	entryvec found;
+	size_t len;
+
+	noctools_mutex_lock(set->mutex);
+	idx = __nocviz_index_set_get(set, key);
+	if (idx != NULL && idx->type == NOCVIZ_INDEX_NUMERIC) {
+		len = idx->entries->length;
+		for (size_t i = len ; i > 0 && (int) (len - i) < n ; i--) {
+			vec_push(items, idx->entries->data[i - 1].item);
+		}
+		noctools_mutex_unlock(set->mutex);
+		return;
+	}
+	noctools_mutex_unlock(set->mutex);
+
+	vec_init(&found);
+
+	if (links) {
+		nocviz_graph_foreach_link(g, link,
+			if (nocviz_ds_get_double(link->ds, key, &e.v) && !isnan(e.v)) {
+				e.item = link;
+				vec_push(&found, e);
+			}
+		);
+	} else {
+		nocviz_graph_foreach_node(g, node,
+			if (nocviz_ds_get_double(node->ds, key, &e.v) && !isnan(e.v)) {
+				e.item = node;
+				vec_push(&found, e);
+			}
+		);
+	}
+
+	/* in the same order as a numeric index would give */
+	vec_sort(&found, nocviz_index_entry_compare);
+	len = found.length;
+	for (size_t i = len ; i > 0 && (int) (len - i) < n ; i--) {
+		vec_push(items, found.data[i - 1].item);
+	}
+
+	vec_deinit(&found);
+}
+
+/* the IDs of a list of nodes, or the IDs of the endpoints of a list of links */
+Tcl_Obj* nocviz_items_to_list(ptrvec* items, bool links) {
+	Tcl_Obj* listPtr;
+	nocviz_node* node;
+	nocviz_link* link;
+	void* item;
+	unsigned int i;
+
+	listPtr = Tcl_NewListObj(0, NULL);
+
+	vec_foreach(items, item, i) {
+		if (links) {
+			link = item;
+			Tcl_ListObjAppendElement(NULL, listPtr,
+				Tcl_NewStringObj(link->from->id, strlen(link->from->id)));
+			Tcl_ListObjAppendElement(NULL, listPtr,
+				Tcl_NewStringObj(link->to->id, strlen(link->to->id)));
+		} else {
+			node = item;
+			Tcl_ListObjAppendElement(NULL, listPtr,
+				Tcl_NewStringObj(node->id, strlen(node->id)));
+		}
+	}
+
+	return listPtr;
+}
+
+/**
+ * @brief Implementation of the node index and link index subcommands.
+ *
+ *	index create KEY ?-numeric|-string?
+ *	index delete KEY
+ *	index list
+ *
+ * @param interp
+ * @param g
+ * @param links true for link index, false for node index
+ * @param objc
+ * @param objv
+ *
+ * @return TCL_OK or TCL_ERROR
+ */
+int nocviz_index_subcmd(Tcl_Interp* interp, nocviz_graph* g, bool links, int objc, Tcl_Obj *const objv[]) {
+	static const char* types[] = {"-numeric", "-string", NULL};
+	nocviz_index_set* set = links ? g->link_indexes : g->node_indexes;
+	const char* kind = links ? "link" : "node";
+	nocviz_index_type type = NOCVIZ_INDEX_NUMERIC;
+	Tcl_Obj* listPtr;
+	nocviz_index* idx;
+	const char* key;
+	char* subcmd;
+	char* k;
+	bool ok;
+	int index;
+
+	if (objc < 3) {
+		Tcl_SetResultf(interp, "wrong # args: should be \"%s index create|delete|list ...\"", kind);
+		return TCL_ERROR;
+	}
+
+	subcmd = Tcl_GetString(objv[2]);
+
+	if (string_equals(subcmd, "create")) {
+		if (objc != 4 && objc != 5) {
+			Tcl_SetResultf(interp, "wrong # args: should be \"%s index create KEY ?-numeric|-string?\"", kind);
+			return TCL_ERROR;
+		}
+		if (objc == 5) {
+			if (Tcl_GetIndexFromObj(interp, objv[4], types, "index type", 0, &index) != TCL_OK) {
+				return TCL_ERROR;
+			}
+			type = index == 0 ? NOCVIZ_INDEX_NUMERIC : NOCVIZ_INDEX_STRING;
+		}
+
+		k = Tcl_GetString(objv[3]);
+		ok = links ? nocviz_graph_index_links(g, k, type) : nocviz_graph_index_nodes(g, k, type);
+		if (!ok) {
+			Tcl_SetResultf(interp, "%s key '%s' is already indexed", kind, k);
+			return TCL_ERROR;
+		}
+
+	} else if (string_equals(subcmd, "delete")) {
+		if (objc != 4) {
+			Tcl_SetResultf(interp, "wrong # args: should be \"%s index delete KEY\"", kind);
+			return TCL_ERROR;
+		}
+
+		k = Tcl_GetString(objv[3]);
+		if (!nocviz_index_set_del(set, k)) {
+			Tcl_SetResultf(interp, "%s key '%s' is not indexed", kind, k);
+			return TCL_ERROR;
+		}
+
+	} else if (string_equals(subcmd, "list")) {
+		if (objc != 3) {
+			Tcl_SetResultf(interp, "wrong # args: should be \"%s index list\"", kind);
+			return TCL_ERROR;
+		}
+
+		listPtr = Tcl_NewListObj(0, NULL);
+		noctools_mutex_lock(set->mutex);
+		kh_foreach(set->indexes, key, idx,
+			Tcl_ListObjAppendElement(NULL, listPtr, Tcl_NewStringObj(key, -1));
+			Tcl_ListObjAppendElement(NULL, listPtr, Tcl_NewStringObj(
+				idx->type == NOCVIZ_INDEX_NUMERIC ? "-numeric" : "-string", -1));
+		);
+		noctools_mutex_unlock(set->mutex);
+		Tcl_SetObjResult(interp, listPtr);
 
-	nocviz_ds_set_kvp(g->ds, key, strdup(val));
+	} else {
+		Tcl_SetResultf(interp, "no such %s index subcommand: %s", kind, subcmd);
+		return TCL_ERROR;
+	}
 
 	return TCL_OK;
 }
 
+int nocviz_subcmd_data_set(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_Obj *const objv[]) {
+	nocviz_graph* g = cdata;
+	char* type;
+	int first;
+
+	get_data_set_args(interp, 2, 2, "data set " NOCVIZ_DATA_TYPES " KEY VAL", type, first);
+
+	return nocviz_data_set_value(interp, g->ds, type, Tcl_GetString(objv[first]), objv[first + 1]);
+}
+
 int nocviz_subcmd_data_get(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_Obj *const objv[]) {
 	nocviz_graph* g = cdata;
 	char* key;
-	char* res;
+	Tcl_Obj* res;
 
 	Tcl_RequireArgs(interp, 3, "data get KEY");
 
 	key = Tcl_GetString(objv[2]);
 
-	res = nocviz_ds_get_kvp(g->ds, key);
+	res = nocviz_data_get_value(g->ds, key);
 
 	if (res == NULL) {
 		Tcl_SetResultf(interp, "no such key '%s'", key);
 		return TCL_ERROR;
 	}
 
-	Tcl_SetObjResult(interp, Tcl_NewStringObj(res, strlen(res)));
+	Tcl_SetObjResult(interp, res);
 
 	return TCL_OK;
 }
@@ -264,7 +923,7 @@ int nocviz_subcmd_data_fmt(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_O
 int nocviz_subcmd_data_keys(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_Obj *const objv[]) {
 	nocviz_graph* g = cdata;
 	const char* key;
-	char* val;
+	nocviz_val* val;
 	Tcl_Obj* listPtr;
 
 	Tcl_RequireArgs(interp, 2, "data keys");
@@ -326,3 +985,134 @@ int nocviz_subcmd_data_delete(ClientData cdata, Tcl_Interp* interp, int objc, Tc
 
 	return TCL_OK;
 }
+
+/* one update of a data batch, to the datastore of a node or link */
+typedef struct nocviz_data_update_t {
+	nocviz_ds* ds;
+	char* type;		/* as for data set, or NULL */
+	Tcl_Obj** elems;	/* KEY VAL ... */
+	int n;
+} nocviz_data_update;
+
+/**
+ * @brief Parse and validate one update given to data batch, which must be of
+ * the form `node ID ?TYPE? KEY VAL ...` or `link ID1 ID2 ?TYPE? KEY VAL ...`.
+ *
+ * The graph's mutex must be held.
+ *
+ * @param interp
+ * @param g
+ * @param obj
+ * @param update set to the parsed update
+ *
+ * @return TCL_OK, or TCL_ERROR if the update is invalid
+ */
+static int nocviz_data_parse_update(Tcl_Interp* interp, nocviz_graph* g, Tcl_Obj* obj, nocviz_data_update* update) {
+	Tcl_Obj** elems;
+	nocviz_node* n;
+	nocviz_link* l;
+	char* kind;
+	char* id1;
+	char* id2;
+	int len;
+	int first;
+
+	if (Tcl_ListObjGetElements(interp, obj, &len, &elems) != TCL_OK) { return TCL_ERROR; }
+
+	kind = len > 0 ? Tcl_GetString(elems[0]) : "";
+
+	if (string_equals(kind, "node") && len >= 2) {
+		id1 = Tcl_GetString(elems[1]);
+		n = __nocviz_graph_get_node(g, id1);
+		if (n == NULL) {
+			Tcl_SetResultf(interp, "no such node: %s", id1);
+			return TCL_ERROR;
+		}
+		update->ds = n->ds;
+		first = 2;
+
+	} else if (string_equals(kind, "link") && len >= 3) {
+		id1 = Tcl_GetString(elems[1]);
+		id2 = Tcl_GetString(elems[2]);
+		l = __nocviz_graph_get_link(g, id1, id2);
+		if (l == NULL) {
+			Tcl_SetResultf(interp, "could not find link '%s' <--> '%s'", id1, id2);
+			return TCL_ERROR;
+		}
+		update->ds = l->ds;
+		first = 3;
+
+	} else {
+		Tcl_SetResultf(interp, "malformed update '%s', should be "
+			"'node ID ?TYPE? KEY VAL ...' or 'link ID1 ID2 ?TYPE? KEY VAL ...'",
+			Tcl_GetString(obj));
+		return TCL_ERROR;
+	}
+
+	/* the keys and values come in pairs, so an odd one out is the type */
+	update->type = NULL;
+	if ((len - first) % 2 == 1) {
+		if (len - first == 1) {
+			Tcl_SetResultf(interp, "missing value in update '%s'", Tcl_GetString(obj));
+			return TCL_ERROR;
+		}
+		update->type = Tcl_GetString(elems[first]);
+		first++;
+	}
+	update->elems = elems + first;
+	update->n = len - first;
+
+	for (int i = 0 ; i < update->n ; i += 2) {
+		if (__nocviz_data_set_value(interp, NULL, update->type,
+				Tcl_GetString(update->elems[i]), update->elems[i + 1]) != TCL_OK) {
+			return TCL_ERROR;
+		}
+	}
+
+	return TCL_OK;
+}
+
+int nocviz_subcmd_data_batch(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_Obj *const objv[]) {
+	nocviz_graph* g = cdata;
+	nocviz_data_update* updates;
+	nocviz_data_update* u;
+
+	if (objc < 2) {
+		Tcl_WrongNumArgs(interp, 0, objv, "data batch UPDATE1 ... UPDATEn");
+		return TCL_ERROR;
+	}
+
+	updates = noctools_malloc(sizeof(nocviz_data_update) * (objc > 2 ? objc - 2 : 1));
+
+	/* Hold the graph's mutex throughout, rather than once per node or link
+	 * looked up. Every update is validated before any is applied, so that
+	 * a batch is either applied in full or not at all. */
+	noctools_mutex_lock(g->mutex);
+
+	for (int i = 2 ; i < objc ; i++) {
+		if (nocviz_data_parse_update(interp, g, objv[i], &updates[i - 2]) != TCL_OK) {
+			noctools_mutex_unlock(g->mutex);
+			free(updates);
+			return TCL_ERROR;
+		}
+	}
+
+	/* values were already checked, so they can all be stored */
+	for (int i = 0 ; i < objc - 2 ; i++) {
+		u = &updates[i];
+		noctools_mutex_lock(u->ds->mutex);
+		for (int j = 0 ; j < u->n ; j += 2) {
+			__nocviz_data_set_value(interp, u->ds, u->type,
+				Tcl_GetString(u->elems[j]), u->elems[j + 1]);
+		}
+		noctools_mutex_unlock(u->ds->mutex);
+	}
+
+	g->dirty = true;
+
+	noctools_mutex_unlock(g->mutex);
+
+	free(updates);
+
+	return TCL_OK;
+}
@@ -8,6 +8,7 @@
 #include "../common/util.h"
 #include "graph.h"
 #include "gui.h"
+#include "render.h"
 
 #include <tcl.h>
 #include <stdio.h>
@@ -38,6 +39,8 @@ int nocviz_subcmd_node_list(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_
 int nocviz_subcmd_node_match(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_Obj *const objv[]);
 int nocviz_subcmd_node_op(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_Obj *const objv[]);
 int nocviz_subcmd_node_color(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_Obj *const objv[]);
+int nocviz_subcmd_node_index(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_Obj *const objv[]);
+int nocviz_subcmd_node_top(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_Obj *const objv[]);
 
 /* link commands */
 int nocviz_command_link(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_Obj *const objv[]);
@@ -59,9 +62,12 @@ int nocviz_subcmd_link_data_show(ClientData cdata, Tcl_Interp* interp, int objc,
 int nocviz_subcmd_link_op(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_Obj *const objv[]);
 int nocviz_subcmd_link_title(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_Obj *const objv[]);
 int nocviz_subcmd_link_color(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_Obj *const objv[]);
+int nocviz_subcmd_link_index(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_Obj *const objv[]);
+int nocviz_subcmd_link_top(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_Obj *const objv[]);
 
 /* general commands */
 int nocviz_command_launch_gui(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_Obj *const objv[]);
+int nocviz_command_render(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_Obj *const objv[]);
 int nocviz_command_op(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_Obj *const objv[]);
 int nocviz_subcmd_op_register(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_Obj *const objv[]);
 int nocviz_subcmd_op_unregister(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_Obj *const objv[]);
@@ -72,9 +78,68 @@ int nocviz_subcmd_data_fmt(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_O
 int nocviz_subcmd_data_keys(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_Obj *const objv[]);
 int nocviz_subcmd_data_show(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_Obj *const objv[]);
 int nocviz_subcmd_data_delete(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_Obj *const objv[]);
+int nocviz_subcmd_data_batch(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_Obj *const objv[]);
+
+/* a condition for the node match and link match subcommands, which is
+ * parsed once and then tested against the value of every node or link */
+typedef enum nocviz_match_op_t {
+	NOCVIZ_MATCH_REGEX,
+	NOCVIZ_MATCH_GT,
+	NOCVIZ_MATCH_GE,
+	NOCVIZ_MATCH_LT,
+	NOCVIZ_MATCH_LE,
+	NOCVIZ_MATCH_EQ,
+	NOCVIZ_MATCH_RANGE,
+	NOCVIZ_MATCH_IS
+} nocviz_match_op;
+
+typedef struct nocviz_match_t {
+	nocviz_match_op op;
+	Tcl_RegExp re;	/* for NOCVIZ_MATCH_REGEX */
+	char* str;	/* for NOCVIZ_MATCH_IS */
+	double a;	/* operand, or lower bound of a range */
+	double b;	/* upper bound of a range */
+} nocviz_match;
+
+int nocviz_match_parse(Tcl_Interp* interp, int objc, Tcl_Obj *const objv[], nocviz_match* m);
+int nocviz_match_ds(Tcl_Interp* interp, nocviz_match* m, nocviz_ds* ds, char* key);
+
+/* shared by the match, top, and index subcommands of node and link, which
+ * find nodes, or links if links is true, using an index where possible */
+int nocviz_match_items(Tcl_Interp* interp, nocviz_graph* g, bool links, char* key, nocviz_match* m, ptrvec* items);
+void nocviz_top_items(nocviz_graph* g, bool links, char* key, int n, ptrvec* items);
+Tcl_Obj* nocviz_items_to_list(ptrvec* items, bool links);
+int nocviz_index_subcmd(Tcl_Interp* interp, nocviz_graph* g, bool links, int objc, Tcl_Obj *const objv[]);
+
+/* shared by the data set and data get subcommands of data, node, and link */
+int nocviz_data_set_value(Tcl_Interp* interp, nocviz_ds* ds, char* type, char* key, Tcl_Obj* obj);
+int __nocviz_data_set_value(Tcl_Interp* interp, nocviz_ds* ds, char* type, char* key, Tcl_Obj* obj);
+Tcl_Obj* nocviz_data_get_value(nocviz_ds* ds, char* key);
 
 /*** UTILITIES ***************************************************************/
 
+/* usage for the type option of the data set subcommands */
+#define NOCVIZ_DATA_TYPES "?-int|-double|-ints|-doubles?"
+
+/* usage for the condition of the match subcommands */
+#define NOCVIZ_MATCH_ARGS "KEY PATTERN|-gt N|-ge N|-lt N|-le N|-eq N|-range MIN MAX|-is VALUE"
+
+/* Parse the arguments to a data set subcommand, which takes nargs arguments
+ * starting at objv[start], optionally preceded by a type option. Sets __type
+ * to the option or NULL, and __first to the index of the first argument. */
+#define get_data_set_args(__interp, __start, __nargs, __usage, __type, __first) do { \
+		if (objc != (__start) + (__nargs) && objc != (__start) + (__nargs) + 1) { \
+			Tcl_WrongNumArgs(__interp, 0, objv, __usage); \
+			return TCL_ERROR; \
+		} \
+		__type = NULL; \
+		__first = (__start); \
+		if (objc == (__start) + (__nargs) + 1) { \
+			__type = Tcl_GetString(objv[__start]); \
+			__first = (__start) + 1; \
+		} \
+	} while(0)
+
 /* retrieve a nocviz_node* by an ID specified in a TCL string object, or return
  * TCL_ERROR */
 #define get_node_from_obj(__interp, __graph, __obj) __extension__ ({ \
@@ -103,32 +168,6 @@ int nocviz_subcmd_data_delete(ClientData cdata, Tcl_Interp* interp, int objc, Tc
 		__link;\
 	});
 
-/* either evaluate to true/false if the regex matches or does not, or throw
- * a TCL error if one occurs */
-#define tcl_regex_matches(__interp, __pattern, __str) __extension__ ({ \
-		Tcl_Obj* __obj_res; \
-		int __int_res; \
-		int __status; \
-		char* __str_res; \
-		bool __res; \
-		__status = Tcl_Evalf(__interp, "regexp {%s} {%s}", __pattern, __str); \
-		__obj_res = Tcl_GetObjResult(__interp); \
-		if (__status != TCL_OK) { \
-			__str_res = Tcl_GetString(__obj_res); \
-			Tcl_SetResultf(__interp, "error 001 processing regex: %s", __str_res); \
-			return TCL_ERROR; \
-		} \
-		__status = Tcl_GetIntFromObj(__interp, __obj_res, &__int_res); \
-		if (__status != TCL_OK) { \
-			__obj_res = Tcl_GetObjResult(__interp); \
-			__str_res = Tcl_GetString(__obj_res); \
-			Tcl_SetResultf(__interp, "error 002 processing regex: %s", __str_res); \
-			return TCL_ERROR; \
-		} \
-		__res = (__int_res == 1); \
-		__res; \
-	})
-
 /* get the int or fail with an error */
 #define get_int_from_obj(__interp, __obj) __extension__ ({ \
 		int __res; \
@@ -1,23 +1,24 @@
 #include "datastore.h"
 
 nocviz_ds* nocviz_ds_init(void) {
+	return nocviz_ds_init_with_formatter(NULL);
+}
+
+nocviz_ds* nocviz_ds_init_with_formatter(nocviz_formatter* formatter) {
 	nocviz_ds* ds;
 
 	ds = noctools_malloc(sizeof(nocviz_ds));
 
-	ds->kvp = kh_init(mstrstr);
+	ds->kvp = kh_init(mstrval);
 	ds->fmt = kh_init(mstrstr);
 	ds->fmtcache = kh_init(mstrstr);
+	ds->fmtspec = kh_init(mstrspec);
 	ds->sections = kh_init(mstrvec);
 	ds->ops = kh_init(mstrop);
 
-	/* not entirely clear if this is needed or not
-	 *
-	 * http://computer-programming-forum.com/57-tcl/7ca2e088c282c2c1.htm
-	 */
-	Tcl_FindExecutable(NULL);
-
-	ds->interp = Tcl_CreateInterp();
+	ds->formatter = formatter;
+	ds->indexes = NULL;
+	ds->owner = NULL;
 
 	ds->mutex = noctools_malloc(sizeof(AG_Mutex));
 	AG_MutexInit(ds->mutex);
@@ -30,18 +31,24 @@ void nocviz_ds_free(nocviz_ds* ds) {
 	char* str;
 	strvec* vec;
 	nocviz_op* oper;
+	nocviz_format_spec* spec;
+	nocviz_val* val;
 
 	noctools_mutex_lock(ds->mutex);
 
-	nocviz_ds_foreach_kvp(ds, key, str,
-		free(str);
+	if (ds->indexes != NULL) {
+		nocviz_index_set_remove_item(ds->indexes, ds->owner);
+	}
+
+	nocviz_ds_foreach_kvp(ds, key, val,
+		nocviz_val_free(val);
 
 		/* Unsafe cast of const char* to char*, since we can't free
 		 * it otherwise. This could cause problems if we tried to
 		 * access the table other than to destroy it later. */
 		free((char*) key);
 	);
-	kh_destroy(mstrstr, ds->kvp);
+	kh_destroy(mstrval, ds->kvp);
 
 	nocviz_ds_foreach_fmt(ds, key, str,
 		free(str);
@@ -55,6 +62,12 @@ void nocviz_ds_free(nocviz_ds* ds) {
 	);
 	kh_destroy(mstrstr, ds->fmtcache);
 
+	kh_foreach(ds->fmtspec, key, spec,
+		nocviz_format_spec_free(spec);
+		free((char*) key);
+	);
+	kh_destroy(mstrspec, ds->fmtspec);
+
 	nocviz_ds_foreach_op(ds, key, oper,
 		nocviz_op_free(oper);
 		free((char*) key);
@@ -68,8 +81,6 @@ void nocviz_ds_free(nocviz_ds* ds) {
 	);
 	kh_destroy(mstrvec, ds->sections);
 
-	Tcl_DeleteInterp(ds->interp);
-
 	noctools_mutex_unlock(ds->mutex);
 	AG_MutexDestroy(ds->mutex);
 	free(ds->mutex);
@@ -89,8 +100,14 @@ void nocviz_ds_free(nocviz_ds* ds) {
 		return __res; \
 	} while(0);
 
+nocviz_val* __nocviz_ds_get_val(nocviz_ds* ds, char* k) {
+	getter_logic(ds, k, mstrval, nocviz_val*, kvp);
+}
+
 char* __nocviz_ds_get_kvp(nocviz_ds* ds, char* k) {
-	getter_logic(ds, k, mstrstr, char*, kvp);
+	nocviz_val* val = __nocviz_ds_get_val(ds, k);
+	if (val == NULL) { return NULL; }
+	return nocviz_val_str(val);
 }
 
 char* __nocviz_ds_get_fmt(nocviz_ds* ds, char* k) {
@@ -109,6 +126,10 @@ strvec* __nocviz_ds_get_section(nocviz_ds* ds, char* k) {
 	getter_logic(ds, k, mstrvec, strvec*, sections);
 }
 
+nocviz_format_spec* __nocviz_ds_get_fmtspec(nocviz_ds* ds, char* k) {
+	getter_logic(ds, k, mstrspec, nocviz_format_spec*, fmtspec);
+}
+
 inline char* nocviz_ds_get_kvp(nocviz_ds* ds, char* k) {
 	char* result;
 	noctools_mutex_lock(ds->mutex);
@@ -117,6 +138,34 @@ inline char* nocviz_ds_get_kvp(nocviz_ds* ds, char* k) {
 	return result;
 }
 
+inline nocviz_val* nocviz_ds_get_val(nocviz_ds* ds, char* k) {
+	nocviz_val* result;
+	noctools_mutex_lock(ds->mutex);
+	result = __nocviz_ds_get_val(ds, k);
+	noctools_mutex_unlock(ds->mutex);
+	return result;
+}
+
+bool nocviz_ds_get_int(nocviz_ds* ds, char* k, int64_t* i) {
+	nocviz_val* val;
+	bool result = false;
+	noctools_mutex_lock(ds->mutex);
+	val = __nocviz_ds_get_val(ds, k);
+	if (val != NULL) { result = nocviz_val_int(val, i); }
+	noctools_mutex_unlock(ds->mutex);
+	return result;
+}
+
+bool nocviz_ds_get_double(nocviz_ds* ds, char* k, double* d) {
+	nocviz_val* val;
+	bool result = false;
+	noctools_mutex_lock(ds->mutex);
+	val = __nocviz_ds_get_val(ds, k);
+	if (val != NULL) { result = nocviz_val_double(val, d); }
+	noctools_mutex_unlock(ds->mutex);
+	return result;
+}
+
 inline char* nocviz_ds_get_fmt(nocviz_ds* ds, char* k) {
 	char* result;
 	noctools_mutex_lock(ds->mutex);
@@ -172,40 +221,39 @@ int __nocviz_ds_update_fmtcache(nocviz_ds* ds, char* k) {
 
 	dbprintf("update format cache for %s\n", k);
 
-	/* clear any existing value in the cache */
-	char* temp;
-	temp = __nocviz_ds_del_fmtcache(ds, k);
-	if (temp != NULL) { free(temp); }
-
-	char* val = __nocviz_ds_get_kvp(ds, k);
-	char* fmt = __nocviz_ds_get_fmt(ds, k);
+	nocviz_val* val = __nocviz_ds_get_val(ds, k);
+	nocviz_format_spec* spec = __nocviz_ds_get_fmtspec(ds, k);
+	khint_t iter = kh_get(mstrstr, ds->fmtcache, k);
+	char* result;
+	int status = TCL_OK;
 
+	/* the default format is %s */
 	if (val == NULL) {
-		return TCL_ERROR;
+		status = TCL_ERROR;
+	} else if (spec == NULL) {
+		result = strdup(nocviz_val_str(val));
+	} else {
+		status = nocviz_format_val(ds->formatter, spec, val, &result);
 	}
 
-	if (fmt == NULL) {
-		fmt = "%s";
+	if (status != TCL_OK) {
+		/* clear any existing value in the cache */
+		if (iter != kh_end(ds->fmtcache)) {
+			free(__nocviz_ds_del_fmtcache(ds, k));
+		}
+		return status;
 	}
 
-	char* tcl_cmd;
-	if (asprintf(&tcl_cmd, "format {%s} {%s}", fmt, val) < 0) {
-		return TCL_ERROR;
-	}
+	dbprintf("formatted result: %s\n", result);
 
-	dbprintf("generated TCL command: %s\n", tcl_cmd);
-
-	if (Tcl_Eval(ds->interp, tcl_cmd) != TCL_OK) {
-		dbprintf("TCL error: %s\n", Tcl_GetStringResult(ds->interp));
-		free(tcl_cmd);
-		return TCL_ERROR;
+	/* replace the cached value in place if there is one, since the key
+	 * is usually already present */
+	if (iter != kh_end(ds->fmtcache)) {
+		free(kh_val(ds->fmtcache, iter));
+		kh_val(ds->fmtcache, iter) = result;
+	} else {
+		__nocviz_ds_set_fmtcache(ds, k, result);
 	}
-	free(tcl_cmd);
-
-	char* result = strdup(Tcl_GetStringResult(ds->interp));
-	dbprintf("TCL result: %s\n", result);
-
-	__nocviz_ds_set_fmtcache(ds, k, result);
 
 	return TCL_OK;
 
@@ -231,13 +279,41 @@ inline int nocviz_ds_update_fmtcache(nocviz_ds* ds, char* k) {
 		kh_val(__ds->__memb, __iter) = __v; \
 	} while(0)
 
-void __nocviz_ds_set_kvp(nocviz_ds* ds, char* k, char* v) {
-	setter_logic(ds, k, v, mstrstr, kvp, free, __nocviz_ds_del_kvp);
+/* retrieve the value for a key, creating it if it does not exist yet, so
+ * that it can be updated in place */
+nocviz_val* __nocviz_ds_put_val(nocviz_ds* ds, char* k) {
+	khint_t iter;
+	int r;
+
+	iter = kh_get(mstrval, ds->kvp, k);
+	if (iter != kh_end(ds->kvp)) {
+		return kh_val(ds->kvp, iter);
+	}
+
+	iter = kh_put(mstrval, ds->kvp, strdup(k), &r);
+	kh_val(ds->kvp, iter) = nocviz_val_new();
+	return kh_val(ds->kvp, iter);
+}
+
+/* a value was set, so keep any index on it's key, and it's formatted version,
+ * up to date */
+static void __nocviz_ds_changed(nocviz_ds* ds, char* k, nocviz_val* val) {
+	if (ds->indexes != NULL) {
+		nocviz_index_set_update(ds->indexes, k, ds->owner, val);
+	}
 	__nocviz_ds_update_fmtcache(ds, k);
 }
 
+void __nocviz_ds_set_kvp(nocviz_ds* ds, char* k, char* v) {
+	nocviz_val* val = __nocviz_ds_put_val(ds, k);
+	nocviz_val_set_string(val, v);
+	__nocviz_ds_changed(ds, k, val);
+}
+
 void __nocviz_ds_set_fmt(nocviz_ds* ds, char* k, char* v) {
 	setter_logic(ds, k, v, mstrstr, fmt, free, __nocviz_ds_del_fmt);
+	setter_logic(ds, k, nocviz_format_compile(v), mstrspec, fmtspec,
+			nocviz_format_spec_free, __nocviz_ds_del_fmtspec);
 	__nocviz_ds_update_fmtcache(ds, k);
 }
 
@@ -256,6 +332,54 @@ inline void nocviz_ds_set_kvp(nocviz_ds* ds, char* k, char* v) {
 	noctools_mutex_unlock(ds->mutex);
 }
 
+void __nocviz_ds_set_int(nocviz_ds* ds, char* k, int64_t i) {
+	nocviz_val* val = __nocviz_ds_put_val(ds, k);
+	nocviz_val_set_int(val, i);
+	__nocviz_ds_changed(ds, k, val);
+}
+
+void __nocviz_ds_set_double(nocviz_ds* ds, char* k, double d) {
+	nocviz_val* val = __nocviz_ds_put_val(ds, k);
+	nocviz_val_set_double(val, d);
+	__nocviz_ds_changed(ds, k, val);
+}
+
+void __nocviz_ds_set_ints(nocviz_ds* ds, char* k, const int64_t* ints, size_t len) {
+	nocviz_val* val = __nocviz_ds_put_val(ds, k);
+	nocviz_val_set_ints(val, ints, len);
+	__nocviz_ds_changed(ds, k, val);
+}
+
+void __nocviz_ds_set_doubles(nocviz_ds* ds, char* k, const double* doubles, size_t len) {
+	nocviz_val* val = __nocviz_ds_put_val(ds, k);
+	nocviz_val_set_doubles(val, doubles, len);
+	__nocviz_ds_changed(ds, k, val);
+}
+
+inline void nocviz_ds_set_int(nocviz_ds* ds, char* k, int64_t i) {
+	noctools_mutex_lock(ds->mutex);
+	__nocviz_ds_set_int(ds, k, i);
+	noctools_mutex_unlock(ds->mutex);
+}
+
+inline void nocviz_ds_set_double(nocviz_ds* ds, char* k, double d) {
+	noctools_mutex_lock(ds->mutex);
+	__nocviz_ds_set_double(ds, k, d);
+	noctools_mutex_unlock(ds->mutex);
+}
+
+inline void nocviz_ds_set_ints(nocviz_ds* ds, char* k, const int64_t* ints, size_t len) {
+	noctools_mutex_lock(ds->mutex);
+	__nocviz_ds_set_ints(ds, k, ints, len);
+	noctools_mutex_unlock(ds->mutex);
+}
+
+inline void nocviz_ds_set_doubles(nocviz_ds* ds, char* k, const double* doubles, size_t len) {
+	noctools_mutex_lock(ds->mutex);
+	__nocviz_ds_set_doubles(ds, k, doubles, len);
+	noctools_mutex_unlock(ds->mutex);
+}
+
 inline void nocviz_ds_set_fmt(nocviz_ds* ds, char* k, char* v) {
 	noctools_mutex_lock(ds->mutex);
 	__nocviz_ds_set_fmt(ds, k, v);
@@ -313,11 +437,38 @@ strvec* nocviz_ds_new_section(nocviz_ds* ds, char* section_name) {
 		return __val; \
 	} while (0)
 
+static nocviz_val* __nocviz_ds_del_val(nocviz_ds* ds, char* k) {
+	del_logic(ds, k, mstrval, kvp, nocviz_val*);
+}
+
 char* __nocviz_ds_del_kvp(nocviz_ds* ds, char* k) {
-	del_logic(ds, k, mstrstr, kvp, char*);
+	nocviz_val* val;
+	char* str;
+
+	val = __nocviz_ds_del_val(ds, k);
+	if (val == NULL) { return NULL; }
+
+	if (ds->indexes != NULL) {
+		nocviz_index_set_update(ds->indexes, k, ds->owner, NULL);
+	}
+
+	/* strings are handed back as they are, numbers as a new string */
+	if (val->type == NOCVIZ_VAL_STRING) {
+		str = val->str;
+		val->str = NULL;
+	} else {
+		str = strdup(nocviz_val_str(val));
+	}
+
+	nocviz_val_free(val);
+	return str;
 }
 
 char* __nocviz_ds_del_fmt(nocviz_ds* ds, char* k) {
+	/* the compiled format goes with it */
+	nocviz_format_spec* spec = __nocviz_ds_del_fmtspec(ds, k);
+	if (spec != NULL) { nocviz_format_spec_free(spec); }
+
 	del_logic(ds, k, mstrstr, fmt, char*);
 }
 
@@ -325,6 +476,10 @@ char* __nocviz_ds_del_fmtcache(nocviz_ds* ds, char* k) {
 	del_logic(ds, k, mstrstr, fmtcache, char*);
 }
 
+nocviz_format_spec* __nocviz_ds_del_fmtspec(nocviz_ds* ds, char* k) {
+	del_logic(ds, k, mstrspec, fmtspec, nocviz_format_spec*);
+}
+
 nocviz_op* __nocviz_ds_del_op(nocviz_ds* ds, char* opid) {
 	del_logic(ds, opid, mstrop, ops, nocviz_op*);
 }
@@ -4,10 +4,15 @@
 #include "../3rdparty/khash.h"
 #include "../3rdparty/vec.h"
 #include "operations.h"
+#include "format.h"
+#include "index.h"
+#include "value.h"
 #include "../common/util.h"
 
 #include <tcl.h>
 
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 
 /* threading primitives */
@@ -28,6 +33,22 @@
  * or format string changes, so the formatted version of each values is cached
  * and updated as needed.
  *
+ * Values in the KVP store may be strings, or typed numbers which are updated
+ * in place and read back without parsing, see value.h. Whatever their type,
+ * nocviz_ds_get_kvp() returns their string representation.
+ *
+ * A datastore belonging to a node or link may be given the set of indexes of
+ * it's graph, see index.h, which it keeps up to date as values are set and
+ * deleted.
+ *
+ * Each format string is compiled when it is set, so that updating a value only
+ * needs to apply the compiled format to it.
+ *
+ * Values are formatted by the native formatter in format.h where possible. A
+ * datastore does not own a TCL interpreter; formats which need TCL use the
+ * one belonging to the formatter the datastore was created with, which is
+ * shared by every datastore in a graph.
+ *
  * NOTE: the fmtcache is not guarnteed to be up to date, nocviz_ds_format()
  * should always be used when retrieving values for display.
  *
@@ -47,31 +68,48 @@ KHASH_MAP_INIT_STR(mstrstr, char*)
 /* mapping of strings to vectors of strings */
 KHASH_MAP_INIT_STR(mstrvec, strvec*)
 
+/* mapping of strings to values */
+KHASH_MAP_INIT_STR(mstrval, nocviz_val*)
+
+/* mapping of strings to compiled format strings */
+KHASH_MAP_INIT_STR(mstrspec, nocviz_format_spec*)
+
 /* maping of strings to operations */
 KHASH_MAP_INIT_STR(mstrop, nocviz_op*)
 
 typedef struct nocviz_ds_t {
-	khash_t(mstrstr)* kvp;
+	khash_t(mstrval)* kvp;
 	khash_t(mstrstr)* fmt;
 	khash_t(mstrstr)* fmtcache;
+	khash_t(mstrspec)* fmtspec;	/* compiled versions of fmt */
 	khash_t(mstrvec)* sections;
 	khash_t(mstrop)* ops;
-	Tcl_Interp* interp;
+	nocviz_formatter* formatter;	/* not owned, may be NULL */
+	nocviz_index_set* indexes;	/* not owned, may be NULL */
+	void* owner;			/* node or link, as seen by indexes */
 	AG_Mutex* mutex;
 } nocviz_ds;
 
-/* initialization */
+/* initialization, a datastore created without a formatter can only use
+ * formats supported by the native formatter */
 nocviz_ds* nocviz_ds_init(void);
+nocviz_ds* nocviz_ds_init_with_formatter(nocviz_formatter* formatter);
 
 void nocviz_ds_free(nocviz_ds* ds);
 
 /* getters */
 char* nocviz_ds_get_kvp(nocviz_ds* ds, char* k);
+nocviz_val* nocviz_ds_get_val(nocviz_ds* ds, char* k);
 char* nocviz_ds_get_fmt(nocviz_ds* ds, char* k);
 char* nocviz_ds_get_fmtcache(nocviz_ds* ds, char* k);
 nocviz_op* nocviz_ds_get_op(nocviz_ds* ds, char* opid);
 strvec* nocviz_ds_get_section(nocviz_ds* ds, char* sect);
 
+/* Retrieve a value as a number, returns false if there is no such key, or
+ * it's value is not a number of the right kind. */
+bool nocviz_ds_get_int(nocviz_ds* ds, char* k, int64_t* i);
+bool nocviz_ds_get_double(nocviz_ds* ds, char* k, double* d);
+
 /* Retrieve a formatted value. If there is an error, then the unformatted value
  * will be used instead */
 char* nocviz_ds_format(nocviz_ds* ds, char* k);
@@ -81,13 +119,18 @@ int nocviz_ds_update_fmtcache(nocviz_ds*, char* k);
 
 /* setters */
 void nocviz_ds_set_kvp(nocviz_ds* ds, char* k, char* v);
+void nocviz_ds_set_int(nocviz_ds* ds, char* k, int64_t i);
+void nocviz_ds_set_double(nocviz_ds* ds, char* k, double d);
+void nocviz_ds_set_ints(nocviz_ds* ds, char* k, const int64_t* ints, size_t len);
+void nocviz_ds_set_doubles(nocviz_ds* ds, char* k, const double* doubles, size_t len);
 void nocviz_ds_set_fmt(nocviz_ds* ds, char* k, char* fmt);
 void nocviz_ds_set_fmtcache(nocviz_ds* ds, char* k, char* fmt);
 void nocviz_ds_set_op(nocviz_ds* ds, char* opid, nocviz_op* oper);
 
 strvec* nocviz_ds_new_section(nocviz_ds* ds, char* section_name);
 
-/* deleters -- don't free values, just return them */
+/* deleters -- don't free values, just return them; the KVP deleter returns
+ * a heap-allocated string representation of typed values */
 char* nocviz_ds_del_kvp(nocviz_ds* ds, char* k);
 char* nocviz_ds_del_fmt(nocviz_ds* ds, char* k);
 char* nocviz_ds_del_fmtcache(nocviz_ds* ds, char* k);
@@ -109,18 +152,26 @@ strvec* nocviz_ds_del_section(nocviz_ds* ds, char* section);
 
 /* internal (non-mutex protected) functions */
 char* __nocviz_ds_get_kvp(nocviz_ds* ds, char* k);
+nocviz_val* __nocviz_ds_get_val(nocviz_ds* ds, char* k);
 char* __nocviz_ds_get_fmt(nocviz_ds* ds, char* k);
 char* __nocviz_ds_get_fmtcache(nocviz_ds* ds, char* k);
 nocviz_op* __nocviz_ds_get_op(nocviz_ds* ds, char* k);
 strvec* __nocviz_ds_get_section(nocviz_ds* ds, char* k);
+nocviz_format_spec* __nocviz_ds_get_fmtspec(nocviz_ds* ds, char* k);
 int __nocviz_ds_update_fmtcache(nocviz_ds* ds, char* k);
 void __nocviz_ds_set_kvp(nocviz_ds* ds, char* k, char* v);
+void __nocviz_ds_set_int(nocviz_ds* ds, char* k, int64_t i);
+void __nocviz_ds_set_double(nocviz_ds* ds, char* k, double d);
+void __nocviz_ds_set_ints(nocviz_ds* ds, char* k, const int64_t* ints, size_t len);
+void __nocviz_ds_set_doubles(nocviz_ds* ds, char* k, const double* doubles, size_t len);
+nocviz_val* __nocviz_ds_put_val(nocviz_ds* ds, char* k);
 void __nocviz_ds_set_fmt(nocviz_ds* ds, char* k, char* v);
 void __nocviz_ds_set_fmtcache(nocviz_ds* ds, char* k, char* v);
 void __nocviz_ds_set_op(nocviz_ds* ds, char* k, nocviz_op* oper);
 char* __nocviz_ds_del_kvp(nocviz_ds* ds, char* k);
 char* __nocviz_ds_del_fmt(nocviz_ds* ds, char* k);
 char* __nocviz_ds_del_fmtcache(nocviz_ds* ds, char* k);
+nocviz_format_spec* __nocviz_ds_del_fmtspec(nocviz_ds* ds, char* k);
 nocviz_op* __nocviz_ds_del_op(nocviz_ds* ds, char* opid);
 strvec* __nocviz_ds_del_section(nocviz_ds* ds, char* section);
 
@@ -0,0 +1,603 @@
+#include "format.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+/* widths and precisions larger than this are left to TCL, which keeps the
+ * conversion specifiers we build below a fixed size */
+#define NOCVIZ_FORMAT_MAX_FIELD 9999
+
+/* a single conversion specifier, such as %-8.3f */
+typedef struct nocviz_format_conv_t {
+	char flags[8];
+	int width;
+	int precision;
+	char conv;
+} nocviz_format_conv;
+
+/* Split fmt into it's literal text, with %% collapsed, and at most one
+ * conversion. text must have room for strlen(fmt) + 1 characters, and *split
+ * is set to the offset within text at which the conversion belongs. If there
+ * is no conversion, conv->conv is set to '\0'. */
+static nocviz_format_result nocviz_format_parse(const char* fmt, char* text, size_t* split, nocviz_format_conv* conv) {
+	const char* p = fmt;
+	const char* q;
+	size_t len = 0;
+	size_t nflags;
+
+	conv->conv = '\0';
+	*split = 0;
+
+	while (*p != '\0') {
+		if (*p != '%') {
+			text[len++] = *p++;
+			continue;
+		}
+
+		p++;
+		if (*p == '%') {
+			text[len++] = *p++;
+			continue;
+		}
+
+		/* there is only one value to consume */
+		if (conv->conv != '\0') { return NOCVIZ_FORMAT_ERROR; }
+
+		/* XPG3 positional specifiers, such as %1$s */
+		for (q = p ; isdigit((unsigned char) *q) ; q++) { }
+		if (q != p && *q == '$') { return NOCVIZ_FORMAT_FALLBACK; }
+
+		nflags = 0;
+		while (*p != '\0' && strchr("-+ 0#", *p) != NULL) {
+			if (nflags >= sizeof(conv->flags) - 1) { return NOCVIZ_FORMAT_FALLBACK; }
+			conv->flags[nflags++] = *p++;
+		}
+		conv->flags[nflags] = '\0';
+
+		conv->width = -1;
+		if (*p == '*') { return NOCVIZ_FORMAT_FALLBACK; }
+		while (isdigit((unsigned char) *p)) {
+			if (conv->width < 0) { conv->width = 0; }
+			conv->width = conv->width * 10 + (*p++ - '0');
+			if (conv->width > NOCVIZ_FORMAT_MAX_FIELD) { return NOCVIZ_FORMAT_FALLBACK; }
+		}
+
+		conv->precision = -1;
+		if (*p == '.') {
+			p++;
+			conv->precision = 0;
+			if (*p == '*') { return NOCVIZ_FORMAT_FALLBACK; }
+			while (isdigit((unsigned char) *p)) {
+				conv->precision = conv->precision * 10 + (*p++ - '0');
+				if (conv->precision > NOCVIZ_FORMAT_MAX_FIELD) { return NOCVIZ_FORMAT_FALLBACK; }
+			}
+		}
+
+		/* size modifiers, %b, unterminated specifiers, and so on */
+		if (*p == '\0' || strchr("diuoxXcsfeEgG", *p) == NULL) {
+			return NOCVIZ_FORMAT_FALLBACK;
+		}
+
+		/* TCL formats integers itself, and differs from C in how it
+		 * applies precisions, prefixes, and padding to them */
+		if (strchr("diuoxXc", *p) != NULL && (conv->precision >= 0 ||
+				strchr(conv->flags, '#') != NULL ||
+				(strchr(conv->flags, '-') != NULL && strchr(conv->flags, '0') != NULL))) {
+			return NOCVIZ_FORMAT_FALLBACK;
+		}
+
+		/* flags which C leaves undefined for the conversion */
+		if (strchr(conv->flags, '#') != NULL && strchr("feEgG", *p) == NULL) {
+			return NOCVIZ_FORMAT_FALLBACK;
+		}
+		if (strchr(conv->flags, '0') != NULL && strchr("cs", *p) != NULL) {
+			return NOCVIZ_FORMAT_FALLBACK;
+		}
+		if (strpbrk(conv->flags, "+ ") != NULL && strchr("difeEgG", *p) == NULL) {
+			return NOCVIZ_FORMAT_FALLBACK;
+		}
+
+		conv->conv = *p++;
+		*split = len;
+	}
+
+	text[len] = '\0';
+	return NOCVIZ_FORMAT_OK;
+}
+
+/* Strip the whitespace TCL allows around a number. Returns a pointer to the
+ * first character of the number, and sets *len to it's length. */
+static const char* nocviz_format_trim(const char* val, size_t* len) {
+	size_t end;
+
+	while (isspace((unsigned char) *val)) { val++; }
+	end = strlen(val);
+	while (end > 0 && isspace((unsigned char) val[end - 1])) { end--; }
+
+	*len = end;
+	return val;
+}
+
+/* Decide what to do with a value which is not a plain decimal number, given
+ * the characters a number in any of the notations TCL understands may start
+ * with (after it's sign). If it can't be a number, it is an error, and
+ * otherwise TCL must decide. */
+static nocviz_format_result nocviz_format_not_decimal(const char* number, const char* first) {
+	if (*number == '\0' || strchr(first, *number) == NULL) { return NOCVIZ_FORMAT_ERROR; }
+	return NOCVIZ_FORMAT_FALLBACK;
+}
+
+static nocviz_format_result nocviz_format_parse_integer(const char* val, long* result) {
+	const char* start;
+	const char* digits;
+	char* end;
+	size_t len;
+
+	start = nocviz_format_trim(val, &len);
+	digits = start;
+	if (len > 0 && (*digits == '+' || *digits == '-')) { digits++; }
+
+	if (digits == start + len || strspn(digits, "0123456789") != (size_t) (start + len - digits)) {
+		return nocviz_format_not_decimal(digits, "0123456789");
+	}
+
+	/* a leading zero means octal to TCL, and values which don't fit in a
+	 * long are wide or big integers */
+	if (digits[0] == '0' && digits + 1 != start + len) { return NOCVIZ_FORMAT_FALLBACK; }
+
+	errno = 0;
+	*result = strtol(start, &end, 10);
+	if (errno == ERANGE) { return NOCVIZ_FORMAT_FALLBACK; }
+
+	return NOCVIZ_FORMAT_OK;
+}
+
+static nocviz_format_result nocviz_format_parse_double(const char* val, double* result) {
+	const char* start;
+	const char* mantissa;
+	char* end;
+	size_t len;
+
+	start = nocviz_format_trim(val, &len);
+	mantissa = start;
+	if (len > 0 && (*mantissa == '+' || *mantissa == '-')) { mantissa++; }
+
+	if (len == 0 || strspn(start, "0123456789+-.eE") < len) {
+		if (strncasecmp(mantissa, "inf", 3) == 0 || strncasecmp(mantissa, "nan", 3) == 0) {
+			return NOCVIZ_FORMAT_FALLBACK;
+		}
+		return nocviz_format_not_decimal(mantissa, "0123456789.");
+	}
+
+	/* integers with a leading zero are octal to TCL */
+	if (mantissa[0] == '0' && isdigit((unsigned char) mantissa[1])) {
+		return NOCVIZ_FORMAT_FALLBACK;
+	}
+
+	errno = 0;
+	*result = strtod(start, &end);
+	if (end != start + len || errno == ERANGE) { return NOCVIZ_FORMAT_FALLBACK; }
+
+	/* TCL reads integers such as -0 as integers first */
+	if (*result == 0 && strspn(mantissa, "0123456789") == (size_t) (start + len - mantissa)) {
+		*result = 0;
+	}
+
+	return NOCVIZ_FORMAT_OK;
+}
+
+/* 1 if the string contains only ASCII characters */
+static int nocviz_format_is_ascii(const char* s) {
+	for ( ; *s != '\0' ; s++) {
+		if ((unsigned char) *s > 127) { return 0; }
+	}
+	return 1;
+}
+
+/* Write the spec's literal text, with the value printed by it's C conversion
+ * specifier in between, to a new heap-allocated string. */
+static nocviz_format_result nocviz_format_emit(nocviz_format_spec* spec, char** result, ...) {
+	va_list ap;
+	va_list ap2;
+	size_t suffix;
+	char* buf;
+	int n;
+
+	va_start(ap, result);
+	va_copy(ap2, ap);
+	n = vsnprintf(NULL, 0, spec->cfmt, ap);
+	va_end(ap);
+
+	if (n < 0) {
+		va_end(ap2);
+		return NOCVIZ_FORMAT_ERROR;
+	}
+
+	suffix = strlen(spec->text + spec->split);
+	buf = noctools_malloc(spec->split + n + suffix + 1);
+	if (buf == NULL) {
+		va_end(ap2);
+		return NOCVIZ_FORMAT_ERROR;
+	}
+
+	memcpy(buf, spec->text, spec->split);
+	vsnprintf(buf + spec->split, n + 1, spec->cfmt, ap2);
+	va_end(ap2);
+	memcpy(buf + spec->split + n, spec->text + spec->split, suffix + 1);
+
+	*result = buf;
+	return NOCVIZ_FORMAT_OK;
+}
+
+/**
+ * @brief Parse a format string once, so that it can be applied to many values
+ * without parsing it again.
+ *
+ * @param fmt
+ *
+ * @return a spec which should be freed with nocviz_format_spec_free()
+ */
+nocviz_format_spec* nocviz_format_compile(const char* fmt) {
+	nocviz_format_spec* spec;
+	nocviz_format_conv conv;
+	char* s;
+
+	spec = noctools_malloc(sizeof(nocviz_format_spec));
+	spec->fmt = strdup(fmt);
+	spec->text = noctools_malloc(strlen(fmt) + 1);
+	spec->parsed = nocviz_format_parse(fmt, spec->text, &(spec->split), &conv);
+	spec->conv = conv.conv;
+	spec->sized = 0;
+	spec->cfmt[0] = '\0';
+
+	if (spec->parsed != NOCVIZ_FORMAT_OK || spec->conv == '\0') {
+		return spec;
+	}
+
+	spec->sized = conv.width >= 0 || conv.precision >= 0;
+
+	s = spec->cfmt;
+	s += sprintf(s, "%%%s", conv.flags);
+	if (conv.width >= 0) { s += sprintf(s, "%d", conv.width); }
+	if (conv.precision >= 0) { s += sprintf(s, ".%d", conv.precision); }
+
+	/* integers are parsed as longs, see nocviz_format_parse_integer() */
+	if (strchr("diuoxX", spec->conv) != NULL) { *s++ = 'l'; }
+	*s++ = spec->conv;
+	*s = '\0';
+
+	return spec;
+}
+
+void nocviz_format_spec_free(nocviz_format_spec* spec) {
+	free(spec->fmt);
+	free(spec->text);
+	free(spec);
+}
+
+/**
+ * @brief Apply a compiled format to a value as `format FMT VAL` would, without
+ * using TCL.
+ *
+ * @param spec
+ * @param val
+ * @param result on NOCVIZ_FORMAT_OK, set to a heap-allocated string
+ *
+ * @return NOCVIZ_FORMAT_FALLBACK if the format or value are not supported
+ * natively, and must be given to TCL instead
+ */
+nocviz_format_result nocviz_format_spec_native(nocviz_format_spec* spec, const char* val, char** result) {
+	nocviz_format_result res;
+	long i;
+	double d;
+
+	if (spec->parsed != NOCVIZ_FORMAT_OK) { return spec->parsed; }
+
+	switch (spec->conv) {
+	case '\0':
+		/* TCL ignores values there is no conversion for */
+		*result = strdup(spec->text);
+		return NOCVIZ_FORMAT_OK;
+
+	case 'd':
+	case 'i':
+		res = nocviz_format_parse_integer(val, &i);
+		if (res != NOCVIZ_FORMAT_OK) { return res; }
+		return nocviz_format_emit(spec, result, i);
+
+	/* TCL's treatment of negative unsigned values, and of characters,
+	 * depends on it's word size and encoding */
+	case 'u':
+	case 'o':
+	case 'x':
+	case 'X':
+		res = nocviz_format_parse_integer(val, &i);
+		if (res != NOCVIZ_FORMAT_OK) { return res; }
+		if (i < 0) { return NOCVIZ_FORMAT_FALLBACK; }
+		return nocviz_format_emit(spec, result, (unsigned long) i);
+
+	case 'c':
+		res = nocviz_format_parse_integer(val, &i);
+		if (res != NOCVIZ_FORMAT_OK) { return res; }
+		if (i < 1 || i > 127) { return NOCVIZ_FORMAT_FALLBACK; }
+		return nocviz_format_emit(spec, result, (int) i);
+
+	case 'f':
+	case 'e':
+	case 'E':
+	case 'g':
+	case 'G':
+		res = nocviz_format_parse_double(val, &d);
+		if (res != NOCVIZ_FORMAT_OK) { return res; }
+		return nocviz_format_emit(spec, result, d);
+
+	default:
+		/* TCL pads and truncates by characters rather than bytes */
+		if (spec->sized && !nocviz_format_is_ascii(val)) {
+			return NOCVIZ_FORMAT_FALLBACK;
+		}
+		return nocviz_format_emit(spec, result, val);
+	}
+}
+
+/* format an integer without parsing it from a string */
+static nocviz_format_result nocviz_format_spec_int(nocviz_format_spec* spec, int64_t i, char** result) {
+	if (spec->parsed != NOCVIZ_FORMAT_OK) { return spec->parsed; }
+
+	switch (spec->conv) {
+	case 'd':
+	case 'i':
+		if (i < LONG_MIN || i > LONG_MAX) { return NOCVIZ_FORMAT_FALLBACK; }
+		return nocviz_format_emit(spec, result, (long) i);
+
+	case 'u':
+	case 'o':
+	case 'x':
+	case 'X':
+		if (i < 0 || i > LONG_MAX) { return NOCVIZ_FORMAT_FALLBACK; }
+		return nocviz_format_emit(spec, result, (unsigned long) i);
+
+	case 'c':
+		if (i < 1 || i > 127) { return NOCVIZ_FORMAT_FALLBACK; }
+		return nocviz_format_emit(spec, result, (int) i);
+
+	case 'f':
+	case 'e':
+	case 'E':
+	case 'g':
+	case 'G':
+		return nocviz_format_emit(spec, result, (double) i);
+
+	default:
+		/* strings, and formats without a conversion */
+		return NOCVIZ_FORMAT_FALLBACK;
+	}
+}
+
+/* format a double without parsing it from a string */
+static nocviz_format_result nocviz_format_spec_double(nocviz_format_spec* spec, double d, char** result) {
+	if (spec->parsed != NOCVIZ_FORMAT_OK) { return spec->parsed; }
+
+	/* TCL spells infinities and NaNs differently than C */
+	if (!isfinite(d)) { return NOCVIZ_FORMAT_FALLBACK; }
+
+	switch (spec->conv) {
+	case 'f':
+	case 'e':
+	case 'E':
+	case 'g':
+	case 'G':
+		return nocviz_format_emit(spec, result, d);
+
+	default:
+		/* TCL will not format a double as an integer, so this is
+		 * either a string or an error */
+		return NOCVIZ_FORMAT_FALLBACK;
+	}
+}
+
+/* format each element of an array, joined by spaces */
+static nocviz_format_result nocviz_format_spec_array(nocviz_format_spec* spec, nocviz_val* val, char** result) {
+	nocviz_format_result res = NOCVIZ_FORMAT_OK;
+	size_t len = 0;
+	size_t cap = 1;
+	char* buf;
+	char* elem;
+	size_t n;
+
+	buf = noctools_malloc(cap);
+	buf[0] = '\0';
+
+	for (size_t i = 0 ; i < val->len && res == NOCVIZ_FORMAT_OK ; i++) {
+		if (val->type == NOCVIZ_VAL_INTS) {
+			res = nocviz_format_spec_int(spec, val->as.ints[i], &elem);
+		} else {
+			res = nocviz_format_spec_double(spec, val->as.doubles[i], &elem);
+		}
+		if (res != NOCVIZ_FORMAT_OK) { break; }
+
+		n = strlen(elem);
+		if (len + n + 2 > cap) {
+			cap = 2 * (len + n + 2);
+			buf = realloc(buf, cap);
+		}
+		if (i > 0) { buf[len++] = ' '; }
+		memcpy(buf + len, elem, n + 1);
+		len += n;
+		free(elem);
+	}
+
+	if (res != NOCVIZ_FORMAT_OK) {
+		free(buf);
+		return res;
+	}
+
+	*result = buf;
+	return NOCVIZ_FORMAT_OK;
+}
+
+/**
+ * @brief Format a value as `format FMT VAL` would, without using TCL.
+ *
+ * @param fmt
+ * @param val
+ * @param result on NOCVIZ_FORMAT_OK, set to a heap-allocated string
+ *
+ * @return NOCVIZ_FORMAT_FALLBACK if the format or value are not supported
+ * natively, and must be given to TCL instead
+ */
+nocviz_format_result nocviz_format_native(const char* fmt, const char* val, char** result) {
+	nocviz_format_spec* spec;
+	nocviz_format_result res;
+
+	spec = nocviz_format_compile(fmt);
+	res = nocviz_format_spec_native(spec, val, result);
+	nocviz_format_spec_free(spec);
+
+	return res;
+}
+
+nocviz_formatter* nocviz_formatter_init(void) {
+	nocviz_formatter* f;
+
+	f = noctools_malloc(sizeof(nocviz_formatter));
+	f->interp = NULL;
+	f->mutex = noctools_malloc(sizeof(AG_Mutex));
+	AG_MutexInit(f->mutex);
+
+	return f;
+}
+
+void nocviz_formatter_free(nocviz_formatter* f) {
+	if (f->interp != NULL) {
+		Tcl_DeleteInterp(f->interp);
+	}
+
+	AG_MutexDestroy(f->mutex);
+	free(f->mutex);
+	free(f);
+}
+
+/**
+ * @brief Apply a compiled format to a value as `format FMT VAL` would, using
+ * TCL only when the native formatter cannot.
+ *
+ * @param f formatter whose TCL interpreter should be used, or NULL
+ * @param spec
+ * @param val
+ * @param result on TCL_OK, set to a heap-allocated string
+ *
+ * @return TCL_OK or TCL_ERROR
+ */
+int nocviz_format_spec_apply(nocviz_formatter* f, nocviz_format_spec* spec, const char* val, char** result) {
+	Tcl_Obj* objv[3];
+	int code;
+
+	switch (nocviz_format_spec_native(spec, val, result)) {
+	case NOCVIZ_FORMAT_OK:
+		return TCL_OK;
+	case NOCVIZ_FORMAT_ERROR:
+		return TCL_ERROR;
+	default:
+		break;
+	}
+
+	if (f == NULL) { return TCL_ERROR; }
+
+	dbprintf("formatting '%s' with TCL\n", spec->fmt);
+
+	noctools_mutex_lock(f->mutex);
+
+	if (f->interp == NULL) {
+		/* not entirely clear if this is needed or not
+		 *
+		 * http://computer-programming-forum.com/57-tcl/7ca2e088c282c2c1.htm
+		 */
+		Tcl_FindExecutable(NULL);
+		f->interp = Tcl_CreateInterp();
+	}
+
+	/* passed as separate words, so the value is never parsed as a script */
+	objv[0] = Tcl_NewStringObj("format", -1);
+	objv[1] = Tcl_NewStringObj(spec->fmt, -1);
+	objv[2] = Tcl_NewStringObj(val, -1);
+	for (int i = 0 ; i < 3 ; i++) { Tcl_IncrRefCount(objv[i]); }
+
+	code = Tcl_EvalObjv(f->interp, 3, objv, 0);
+	if (code == TCL_OK) {
+		*result = strdup(Tcl_GetStringResult(f->interp));
+	} else {
+		dbprintf("TCL error: %s\n", Tcl_GetStringResult(f->interp));
+	}
+
+	for (int i = 0 ; i < 3 ; i++) { Tcl_DecrRefCount(objv[i]); }
+
+	noctools_mutex_unlock(f->mutex);
+
+	return code;
+}
+
+/**
+ * @brief Format a value as `format FMT VAL` would, using TCL only when the
+ * native formatter cannot.
+ *
+ * @param f formatter whose TCL interpreter should be used, or NULL
+ * @param fmt
+ * @param val
+ * @param result on TCL_OK, set to a heap-allocated string
+ *
+ * @return TCL_OK or TCL_ERROR
+ */
+int nocviz_format(nocviz_formatter* f, const char* fmt, const char* val, char** result) {
+	nocviz_format_spec* spec;
+	int code;
+
+	spec = nocviz_format_compile(fmt);
+	code = nocviz_format_spec_apply(f, spec, val, result);
+	nocviz_format_spec_free(spec);
+
+	return code;
+}
+
+/**
+ * @brief Apply a compiled format to a value, formatting numbers directly
+ * where possible.
+ *
+ * @param f formatter whose TCL interpreter should be used, or NULL
+ * @param spec
+ * @param val
+ * @param result on TCL_OK, set to a heap-allocated string
+ *
+ * @return TCL_OK or TCL_ERROR
+ */
+int nocviz_format_val(nocviz_formatter* f, nocviz_format_spec* spec, nocviz_val* val, char** result) {
+	nocviz_format_result res;
+
+	switch (val->type) {
+	case NOCVIZ_VAL_INT:
+		res = nocviz_format_spec_int(spec, val->as.i, result);
+		break;
+	case NOCVIZ_VAL_DOUBLE:
+		res = nocviz_format_spec_double(spec, val->as.d, result);
+		break;
+	case NOCVIZ_VAL_INTS:
+	case NOCVIZ_VAL_DOUBLES:
+		res = nocviz_format_spec_array(spec, val, result);
+		break;
+	default:
+		res = NOCVIZ_FORMAT_FALLBACK;
+		break;
+	}
+
+	if (res == NOCVIZ_FORMAT_OK) { return TCL_OK; }
+	if (res == NOCVIZ_FORMAT_ERROR) { return TCL_ERROR; }
+
+	/* anything else is formatted exactly as the string would be */
+	return nocviz_format_spec_apply(f, spec, nocviz_val_str(val), result);
+}
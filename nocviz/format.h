@@ -0,0 +1,90 @@
+#ifndef NOCVIZ_FORMAT_H
+#define NOCVIZ_FORMAT_H
+
+#include "../common/util.h"
+#include "value.h"
+
+#include <tcl.h>
+
+/* threading primitives */
+#include <agar/core.h>
+
+/******************************************************************************
+ *
+ * Formatting of datastore values for display, as if by the TCL command
+ * `format FMT VAL`.
+ *
+ * Format strings which consist of literal text and at most one printf-style
+ * conversion (%d, %i, %u, %o, %x, %X, %c, %s, %f, %e, %E, %g, %G, with the
+ * usual flags, width, and precision) are formatted natively. This covers
+ * nearly every format string used in practice, and needs no TCL interpreter.
+ * The native formatter keeps no state, so it may be called from any thread.
+ *
+ * Anything else -- positional (XPG3) specifiers, `*` widths, size modifiers,
+ * %b, values in a notation only TCL understands such as 0x10, and so on -- is
+ * handed to a TCL interpreter. One such interpreter is shared by every
+ * datastore of a graph, and is only created the first time it is needed. It
+ * belongs to the thread which created it, so values should only be formatted
+ * from the thread running the TCL commands which set them.
+ *
+ * Typed numeric values (see value.h) are formatted without being converted to
+ * a string and parsed back. An array is shown as each of it's elements
+ * formatted in turn, separated by spaces.
+ *
+ * A format string may be compiled once into a nocviz_format_spec, which can
+ * then be applied to any number of values without parsing it again.
+ *
+ *****************************************************************************/
+
+typedef enum nocviz_format_result_t {
+	NOCVIZ_FORMAT_OK,	/* the value was formatted */
+	NOCVIZ_FORMAT_ERROR,	/* the format or value is invalid */
+	NOCVIZ_FORMAT_FALLBACK	/* the format must be evaluated by TCL */
+} nocviz_format_result;
+
+typedef struct nocviz_formatter_t {
+	Tcl_Interp* interp;	/* NULL until a format needs it */
+	AG_Mutex* mutex;
+} nocviz_formatter;
+
+typedef struct nocviz_format_spec_t {
+	char* fmt;			/* the format string, as given */
+	nocviz_format_result parsed;	/* OK if it may be applied natively */
+	char* text;			/* literal text, with %% collapsed */
+	size_t split;			/* offset of the conversion in text */
+	char conv;			/* conversion, or '\0' if there is none */
+	unsigned char sized;		/* 1 if a width or precision was given */
+	char cfmt[32];			/* equivalent C conversion specifier */
+} nocviz_format_spec;
+
+/* create a formatter, which does not yet own a TCL interpreter */
+nocviz_formatter* nocviz_formatter_init(void);
+
+/* destroy a formatter, and it's TCL interpreter if it has one */
+void nocviz_formatter_free(nocviz_formatter* f);
+
+/* compile a format string, which never fails; formats which can't be applied
+ * natively are always handed to TCL */
+nocviz_format_spec* nocviz_format_compile(const char* fmt);
+
+void nocviz_format_spec_free(nocviz_format_spec* spec);
+
+/* as nocviz_format_native() and nocviz_format(), but with a compiled format */
+nocviz_format_result nocviz_format_spec_native(nocviz_format_spec* spec, const char* val, char** result);
+int nocviz_format_spec_apply(nocviz_formatter* f, nocviz_format_spec* spec, const char* val, char** result);
+
+/* as nocviz_format_spec_apply(), but numeric values are formatted directly
+ * rather than from their string representation, and each element of an array
+ * is formatted in turn */
+int nocviz_format_val(nocviz_formatter* f, nocviz_format_spec* spec, nocviz_val* val, char** result);
+
+/* Format a value natively. On NOCVIZ_FORMAT_OK, *result is set to a
+ * heap-allocated string which the caller must free. */
+nocviz_format_result nocviz_format_native(const char* fmt, const char* val, char** result);
+
+/* Format a value natively if possible, and otherwise using the formatter's TCL
+ * interpreter. f may be NULL, in which case formats that need TCL are errors.
+ * Returns TCL_OK or TCL_ERROR, on TCL_OK *result is set as above. */
+int nocviz_format(nocviz_formatter* f, const char* fmt, const char* val, char** result);
+
+#endif
@@ -6,7 +6,10 @@ nocviz_graph* nocviz_graph_init(void) {
 	g = noctools_malloc(sizeof(nocviz_graph));
 
 	g->nodes = kh_init(mstrnode);
-	g->ds = nocviz_ds_init();
+	g->formatter = nocviz_formatter_init();
+	g->ds = nocviz_ds_init_with_formatter(g->formatter);
+	g->node_indexes = nocviz_index_set_init();
+	g->link_indexes = nocviz_index_set_init();
 	g->mutex = noctools_malloc(sizeof(AG_Mutex));
 	AG_MutexInit(g->mutex);
 	g->dirty = true;
@@ -15,6 +18,18 @@ nocviz_graph* nocviz_graph_init(void) {
 	g->gw = NULL;
 	vec_init(g->links);
 
+	g->tracking = false;
+	g->changed_nodes = noctools_malloc(sizeof(nodevec));
+	g->changed_links = noctools_malloc(sizeof(linkvec));
+	g->removed_nodes = noctools_malloc(sizeof(ptrvec));
+	g->removed_links = noctools_malloc(sizeof(ptrvec));
+	vec_init(g->changed_nodes);
+	vec_init(g->changed_links);
+	vec_init(g->removed_nodes);
+	vec_init(g->removed_links);
+
+	g->frame = 0;
+
 	return g;
 }
 
@@ -28,12 +43,26 @@ void nocviz_graph_free(nocviz_graph* g) {
 	kh_destroy(mstrnode, g->nodes);
 
 	nocviz_ds_free(g->ds);
+	nocviz_formatter_free(g->formatter);
+
+	/* only once every datastore which might update them is gone */
+	nocviz_index_set_free(g->node_indexes);
+	nocviz_index_set_free(g->link_indexes);
 
 	noctools_mutex_unlock(g->mutex);
 	free(g->mutex);
 	vec_deinit(g->links);
 	free(g->links);
 
+	vec_deinit(g->changed_nodes);
+	vec_deinit(g->changed_links);
+	vec_deinit(g->removed_nodes);
+	vec_deinit(g->removed_links);
+	free(g->changed_nodes);
+	free(g->changed_links);
+	free(g->removed_nodes);
+	free(g->removed_links);
+
 	free(g);
 }
 
@@ -56,24 +85,22 @@ nocviz_node* __nocviz_graph_new_node(nocviz_graph* g, char* id) {
 	n = noctools_malloc(sizeof(nocviz_node));
 	n->adjacent = kh_init(mstrlink);
 	n->id = strdup(id);
-	n->ds = nocviz_ds_init();
+	n->ds = nocviz_ds_init_with_formatter(g->formatter);
+	n->ds->indexes = g->node_indexes;
+	n->ds->owner = n;
 	n->title = strdup(id);
 	n->row = 0;
 	n->col = 0;
-	n->x = 0;
-	n->y = 0;
 	n->h = 40;	/* XXX: should be macro-ed out */
 	n->w = 40;
-	n->flags = 0;
-	n->label_surface = -1;
-	n->surface_dirty = 1;
+	n->changes = 0;
 	AG_ColorRGBA_8(&n->c, 128,128,128, 255);
 
-	g->dirty = true;
-
 	iter = kh_put(mstrnode, g->nodes, n->id, &r);
 	kh_val(g->nodes, iter) = n;
 
+	__nocviz_graph_node_changed(g, n, NOCVIZ_CHANGE_ADDED);
+
 	return n;
 }
 
@@ -113,10 +140,11 @@ nocviz_link* __nocviz_graph_new_link(nocviz_graph* g, char* from, char* to, nocv
 	link->from = from_node;
 	link->to = to_node;
 	link->type = type;
-	link->ds = nocviz_ds_init();
+	link->ds = nocviz_ds_init_with_formatter(g->formatter);
+	link->ds->indexes = g->link_indexes;
+	link->ds->owner = link;
 	link->curve = 0;
-	link->label_surface = -1;
-	link->surface_dirty = 1;
+	link->changes = 0;
 	if (asprintf(&(link->title), "%s -> %s", from, to) < 0) {
 		warn("asprintf failure!");
 	}
@@ -126,6 +154,8 @@ nocviz_link* __nocviz_graph_new_link(nocviz_graph* g, char* from, char* to, nocv
 
 	vec_push(g->links, link);
 
+	__nocviz_graph_link_changed(g, link, NOCVIZ_CHANGE_ADDED);
+
 	return link;
 }
 
@@ -184,6 +214,23 @@ nocviz_link* __nocviz_graph_get_link(nocviz_graph* g, char* id1, char* id2) {
 	return NULL;
 }
 
+/* remove a changed item from it's list, by moving the last item into it's slot */
+static void nocviz_graph_forget_changed_node(nocviz_graph* g, nocviz_node* node) {
+	nocviz_node* last = vec_pop(g->changed_nodes);
+	if (last != node) {
+		g->changed_nodes->data[node->changed_at] = last;
+		last->changed_at = node->changed_at;
+	}
+}
+
+static void nocviz_graph_forget_changed_link(nocviz_graph* g, nocviz_link* link) {
+	nocviz_link* last = vec_pop(g->changed_links);
+	if (last != link) {
+		g->changed_links->data[link->changed_at] = last;
+		last->changed_at = link->changed_at;
+	}
+}
+
 inline void nocviz_graph_free_node(nocviz_graph* g, nocviz_node* node) {
 	noctools_mutex_lock(g->mutex);
 	__nocviz_graph_free_node(g, node);
@@ -216,6 +263,11 @@ void __nocviz_graph_free_node(nocviz_graph* g, nocviz_node* node) {
 		kh_del(mstrnode, g->nodes, iter);
 	}
 
+	if (g->tracking) {
+		if (node->changes != 0) { nocviz_graph_forget_changed_node(g, node); }
+		vec_push(g->removed_nodes, node);
+	}
+
 	/* clean up data structures */
 	nocviz_ds_free(node->ds);
 	free(node->id);
@@ -224,8 +276,6 @@ void __nocviz_graph_free_node(nocviz_graph* g, nocviz_node* node) {
 	free(node);
 
 	g->dirty = true;
-
-
 }
 
 inline void nocviz_graph_free_link(nocviz_graph* g, nocviz_link* link) {
@@ -256,8 +306,70 @@ void __nocviz_graph_free_link(nocviz_graph* g, nocviz_link* link) {
 		}
 	}
 
+	if (g->tracking) {
+		if (link->changes != 0) { nocviz_graph_forget_changed_link(g, link); }
+		vec_push(g->removed_links, link);
+	}
+
 	nocviz_ds_free(link->ds);
 	free(link);
+
+	g->dirty = true;
+}
+
+/* add the current value of an item to a newly created index */
+static void nocviz_graph_index_item(nocviz_index_set* set, char* key, void* item, nocviz_ds* ds) {
+	nocviz_index* idx;
+	nocviz_val* val;
+
+	/* a datastore's mutex must be taken before it's index set's */
+	noctools_mutex_lock(ds->mutex);
+	val = __nocviz_ds_get_val(ds, key);
+	if (val != NULL) {
+		noctools_mutex_lock(set->mutex);
+		idx = __nocviz_index_set_get(set, key);
+		if (idx != NULL) { __nocviz_index_update(idx, item, val); }
+		noctools_mutex_unlock(set->mutex);
+	}
+	noctools_mutex_unlock(ds->mutex);
+}
+
+bool nocviz_graph_index_nodes(nocviz_graph* g, char* key, nocviz_index_type type) {
+	nocviz_node* node;
+
+	noctools_mutex_lock(g->mutex);
+
+	if (nocviz_index_set_add(g->node_indexes, key, type) == NULL) {
+		noctools_mutex_unlock(g->mutex);
+		return false;
+	}
+
+	nocviz_graph_foreach_node(g, node,
+		nocviz_graph_index_item(g->node_indexes, key, node, node->ds);
+	);
+
+	noctools_mutex_unlock(g->mutex);
+
+	return true;
+}
+
+bool nocviz_graph_index_links(nocviz_graph* g, char* key, nocviz_index_type type) {
+	nocviz_link* link;
+
+	noctools_mutex_lock(g->mutex);
+
+	if (nocviz_index_set_add(g->link_indexes, key, type) == NULL) {
+		noctools_mutex_unlock(g->mutex);
+		return false;
+	}
+
+	nocviz_graph_foreach_link(g, link,
+		nocviz_graph_index_item(g->link_indexes, key, link, link->ds);
+	);
+
+	noctools_mutex_unlock(g->mutex);
+
+	return true;
 }
 
 bool nocviz_graph_is_dirty(nocviz_graph* g) {
@@ -287,6 +399,8 @@ void nocviz_graph_reverse_link(nocviz_graph* g, nocviz_link* link) {
 	/* make sure the adjacent tables are accurate */
 	__nocviz_graph_fix_link_adjacency(g, link);
 
+	__nocviz_graph_link_changed(g, link, NOCVIZ_CHANGE_MOVED);
+
 	noctools_mutex_unlock(g->mutex);
 }
 
@@ -335,3 +449,65 @@ void nocviz_graph_color_set_dirty(nocviz_graph* g, bool dirty) {
 	noctools_mutex_unlock(g->mutex);
 }
 
+
+inline void nocviz_graph_track_changes(nocviz_graph* g, bool track) {
+	noctools_mutex_lock(g->mutex);
+	__nocviz_graph_track_changes(g, track);
+	noctools_mutex_unlock(g->mutex);
+}
+
+void __nocviz_graph_track_changes(nocviz_graph* g, bool track) {
+	__nocviz_graph_clear_changes(g);
+	g->tracking = track;
+}
+
+inline void nocviz_graph_node_changed(nocviz_graph* g, nocviz_node* node, unsigned int changes) {
+	noctools_mutex_lock(g->mutex);
+	__nocviz_graph_node_changed(g, node, changes);
+	noctools_mutex_unlock(g->mutex);
+}
+
+void __nocviz_graph_node_changed(nocviz_graph* g, nocviz_node* node, unsigned int changes) {
+	g->dirty = true;
+	if (changes & NOCVIZ_CHANGE_COLOR) { g->color_dirty = true; }
+	if (!g->tracking) { return; }
+
+	/* each node is listed once, no matter how many times it changes */
+	if (node->changes == 0) {
+		node->changed_at = g->changed_nodes->length;
+		vec_push(g->changed_nodes, node);
+	}
+	node->changes |= changes;
+}
+
+inline void nocviz_graph_link_changed(nocviz_graph* g, nocviz_link* link, unsigned int changes) {
+	noctools_mutex_lock(g->mutex);
+	__nocviz_graph_link_changed(g, link, changes);
+	noctools_mutex_unlock(g->mutex);
+}
+
+void __nocviz_graph_link_changed(nocviz_graph* g, nocviz_link* link, unsigned int changes) {
+	g->dirty = true;
+	if (changes & NOCVIZ_CHANGE_COLOR) { g->color_dirty = true; }
+	if (!g->tracking) { return; }
+
+	if (link->changes == 0) {
+		link->changed_at = g->changed_links->length;
+		vec_push(g->changed_links, link);
+	}
+	link->changes |= changes;
+}
+
+void __nocviz_graph_clear_changes(nocviz_graph* g) {
+	nocviz_node* node;
+	nocviz_link* link;
+	unsigned int i;
+
+	vec_foreach(g->changed_nodes, node, i) { node->changes = 0; }
+	vec_foreach(g->changed_links, link, i) { link->changes = 0; }
+
+	vec_clear(g->changed_nodes);
+	vec_clear(g->changed_links);
+	vec_clear(g->removed_nodes);
+	vec_clear(g->removed_links);
+}
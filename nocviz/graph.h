@@ -32,15 +32,36 @@ KHASH_MAP_INIT_STR(mstrlink, struct nocviz_link_t*)
 /* list of links */
 typedef vec_t(struct nocviz_link_t*) linkvec;
 
+/* list of nodes */
+typedef vec_t(struct nocviz_node_t*) nodevec;
+
+/* kinds of change made to a node or link, see nocviz_graph_track_changes() */
+#define NOCVIZ_CHANGE_ADDED 0x1
+#define NOCVIZ_CHANGE_MOVED 0x2	/* row, col, curve, or endpoints */
+#define NOCVIZ_CHANGE_COLOR 0x4
+#define NOCVIZ_CHANGE_TITLE 0x8
+
 typedef struct nocviz_graph_t {
 	khash_t(mstrnode)* nodes;
 	nocviz_ds* ds;
+	nocviz_formatter* formatter;	/* shared by every datastore */
+	nocviz_index_set* node_indexes;	/* indexes of node and link datastores */
+	nocviz_index_set* link_indexes;
 	AG_Mutex* mutex;
 	bool dirty;
 	bool color_dirty;
 	linkvec* links;
 	struct nocviz_graph_widget* gw;
 
+	/* changes since they were last cleared, only recorded while tracking */
+	bool tracking;
+	nodevec* changed_nodes;
+	linkvec* changed_links;
+	ptrvec* removed_nodes;	/* freed, and must not be dereferenced */
+	ptrvec* removed_links;
+
+	int frame;	/* next frame of a nocviz::render sequence */
+
 } nocviz_graph;
 
 typedef enum nocviz_link_type_t {NOCVIZ_LINK_DIRECTED, NOCVIZ_LINK_UNDIRECTED} nocviz_link_type;
@@ -55,13 +76,8 @@ typedef struct nocviz_link_t {
 	/***** values used for GUI ******/
 	AG_Color c;
 	int curve;
-	int label_surface;
-	unsigned char surface_dirty;
-	int hx;		/* hover detection */
-	int hy;
-	unsigned int flags;
-#define NOCVIZ_LINK_SELECTED 0x1
-#define NOCVIZ_LINK_HOVER 0x2
+	unsigned int changes;	/* NOCVIZ_CHANGE_* */
+	int changed_at;	/* index in changed_links, if changes != 0 */
 } nocviz_link;
 
 typedef struct nocviz_node_t {
@@ -75,15 +91,10 @@ typedef struct nocviz_node_t {
 
 	/***** values used for GUI ******/
 	AG_Color c;
-	int x;
-	int y;
 	int h;
 	int w;
-	unsigned int flags;
-#define NOCVIZ_NODE_SELECTED 0x1
-#define NOCVIZ_NODE_HOVER 0x2
-	int label_surface;
-	unsigned char surface_dirty;
+	unsigned int changes;	/* NOCVIZ_CHANGE_* */
+	int changed_at;	/* index in changed_nodes, if changes != 0 */
 } nocviz_node;
 
 /* create a new graph */
@@ -123,6 +134,23 @@ bool nocviz_graph_color_is_dirty(nocviz_graph* g);
 
 void nocviz_graph_color_set_dirty(nocviz_graph* g, bool dirty);
 
+/* Start or stop recording which nodes and links are added, removed, or
+ * changed, discarding anything already recorded. This lets the GUI apply only
+ * what has changed since it last looked, rather than re-reading the whole
+ * graph. Nothing is recorded unless tracking, so that the lists of changes
+ * cannot grow without bound when there is no GUI to clear them. */
+void nocviz_graph_track_changes(nocviz_graph* g, bool track);
+
+/* record a change to the appearance of a node or link, which also marks the
+ * graph as dirty (and color dirty for NOCVIZ_CHANGE_COLOR) */
+void nocviz_graph_node_changed(nocviz_graph* g, nocviz_node* node, unsigned int changes);
+void nocviz_graph_link_changed(nocviz_graph* g, nocviz_link* link, unsigned int changes);
+
+/* Index a key of the datastores of every node, or every link, see index.h.
+ * Returns false if the key is already indexed. */
+bool nocviz_graph_index_nodes(nocviz_graph* g, char* key, nocviz_index_type type);
+bool nocviz_graph_index_links(nocviz_graph* g, char* key, nocviz_index_type type);
+
 /* ensure that the adjacency tables on either end of the link are setup
  * correctly */
 void nocviz_graph_fix_link_adjacency(nocviz_graph* g, nocviz_link* link);
@@ -174,5 +202,11 @@ nocviz_link* __nocviz_graph_get_link(nocviz_graph* g, char* id1, char* id2);
 void __nocviz_graph_free_node(nocviz_graph* g, nocviz_node* node);
 void __nocviz_graph_free_link(nocviz_graph* g, nocviz_link* link);
 void __nocviz_graph_fix_link_adjacency(nocviz_graph* g, nocviz_link* link);
+void __nocviz_graph_track_changes(nocviz_graph* g, bool track);
+void __nocviz_graph_node_changed(nocviz_graph* g, nocviz_node* node, unsigned int changes);
+void __nocviz_graph_link_changed(nocviz_graph* g, nocviz_link* link, unsigned int changes);
+
+/* forget the recorded changes, once they have been applied */
+void __nocviz_graph_clear_changes(nocviz_graph* g);
 
 #endif
@@ -31,6 +31,17 @@
 
 #include "graph_widget.h"
 
+#include <limits.h>
+#include <math.h>
+
+#define ptr_key(p) ((khint64_t) (uintptr_t) (p))
+
+/* convert between widget and graph coordinates */
+#define graph_x(gw, x) ((int) floor(((x) + (gw)->xOffs) / (gw)->scale))
+#define graph_y(gw, y) ((int) floor(((y) + (gw)->yOffs) / (gw)->scale))
+#define screen_x(gw, x) ((int) lround((x) * (gw)->scale) - (gw)->xOffs)
+#define screen_y(gw, y) ((int) lround((y) * (gw)->scale) - (gw)->yOffs)
+
 NV_GraphWidget* NV_GraphWidgetNew(void* parent, nocviz_graph* g) {
 	NV_GraphWidget* gw;
 
@@ -48,13 +59,412 @@ NV_GraphWidget* NV_GraphWidgetNew(void* parent, nocviz_graph* g) {
 	return gw;
 }
 
-static int MouseOverVertex(nocviz_node *vtx, NV_GraphWidget* gw, int x, int y) {
-	return (abs(x - vtx->x + gw->xOffs) <= (vtx->w >> 1) &&
-	        abs(y - vtx->y + gw->yOffs) <= (vtx->h >> 1));
+/*** SYNCHRONIZATION *********************************************************/
+
+static NV_GraphVertex* FindVertex(NV_GraphWidget* gw, void* node) {
+	khint_t iter;
+
+	iter = kh_get(mptrvtx, gw->vertices, ptr_key(node));
+	if (iter == kh_end(gw->vertices)) { return NULL; }
+	return kh_val(gw->vertices, iter);
+}
+
+static NV_GraphEdge* FindEdge(NV_GraphWidget* gw, void* link) {
+	khint_t iter;
+
+	iter = kh_get(mptredge, gw->edges, ptr_key(link));
+	if (iter == kh_end(gw->edges)) { return NULL; }
+	return kh_val(gw->edges, iter);
+}
+
+/* the cell containing a point, rounding towards negative infinity */
+static int CellCoord(int v) {
+	return (v >= 0) ? v / NV_GRAPH_CELL_SIZE : -((-v - 1) / NV_GRAPH_CELL_SIZE) - 1;
+}
+
+#define cell_key(cx, cy) ((khint64_t) (((uint64_t) (uint32_t) (cx) << 32) | (uint32_t) (cy)))
+
+static NV_GraphCell* FindCell(NV_GraphWidget* gw, int cx, int cy) {
+	khint_t iter;
+
+	iter = kh_get(mcell, gw->cells, cell_key(cx, cy));
+	if (iter == kh_end(gw->cells)) { return NULL; }
+	return kh_val(gw->cells, iter);
+}
+
+/* find a cell, creating it if it does not exist */
+static NV_GraphCell* GetCell(NV_GraphWidget* gw, int cx, int cy) {
+	NV_GraphCell* cell;
+	khint_t iter;
+	int r;
+
+	cell = FindCell(gw, cx, cy);
+	if (cell != NULL) { return cell; }
+
+	cell = noctools_malloc(sizeof(NV_GraphCell));
+	cell->cx = cx;
+	cell->cy = cy;
+	vec_init(&cell->vertices);
+	vec_init(&cell->edges);
+	iter = kh_put(mcell, gw->cells, cell_key(cx, cy), &r);
+	kh_val(gw->cells, iter) = cell;
+	return cell;
+}
+
+/* free a cell once nothing is left in it */
+static void ReleaseCell(NV_GraphWidget* gw, NV_GraphCell* cell) {
+	if (cell->vertices.length != 0 || cell->edges.length != 0) { return; }
+
+	kh_del(mcell, gw->cells, kh_get(mcell, gw->cells, cell_key(cell->cx, cell->cy)));
+	vec_deinit(&cell->vertices);
+	vec_deinit(&cell->edges);
+	free(cell);
+}
+
+/* take a vertex out of the spatial index */
+static void UnplaceVertex(NV_GraphWidget* gw, NV_GraphVertex* vtx) {
+	NV_GraphCell* cell = vtx->cell;
+
+	if (cell == NULL) { return; }
+	vtx->cell = NULL;
+
+	vec_remove(&cell->vertices, vtx);
+	cell->dirty = true;
+	ReleaseCell(gw, cell);
+}
+
+/* put a vertex in the cell containing it's center */
+static void PlaceVertex(NV_GraphWidget* gw, NV_GraphVertex* vtx) {
+	NV_GraphCell* cell;
+	int cx = CellCoord(vtx->x);
+	int cy = CellCoord(vtx->y);
+
+	if (vtx->cell != NULL && vtx->cell->cx == cx && vtx->cell->cy == cy) {
+		vtx->cell->dirty = true;
+		return;
+	}
+	UnplaceVertex(gw, vtx);
+
+	cell = GetCell(gw, cx, cy);
+	vec_push(&cell->vertices, vtx);
+	cell->dirty = true;
+	vtx->cell = cell;
+
+	/* vertices may overhang their cell by this much */
+	if ((vtx->r.w >> 1) > gw->margin) { gw->margin = vtx->r.w >> 1; }
+	if ((vtx->r.h >> 1) > gw->margin) { gw->margin = vtx->r.h >> 1; }
+}
+
+static void RemoveVertex(NV_GraphWidget* gw, void* node) {
+	NV_GraphVertex* vtx;
+	khint_t iter;
+
+	iter = kh_get(mptrvtx, gw->vertices, ptr_key(node));
+	if (iter == kh_end(gw->vertices)) { return; }
+	vtx = kh_val(gw->vertices, iter);
+	kh_del(mptrvtx, gw->vertices, iter);
+
+	UnplaceVertex(gw, vtx);
+	if (gw->hover == vtx) { gw->hover = NULL; }
+
+	free(vtx->title);
+	free(vtx);
+}
+
+/* take an edge out of every cell it is listed in */
+static void UnplaceEdge(NV_GraphWidget* gw, NV_GraphEdge* edge) {
+	NV_GraphCell* cell;
+
+	if (!edge->placed) { return; }
+	edge->placed = false;
+
+	for (int cx = edge->cx0 ; cx <= edge->cx1 ; cx++) {
+		for (int cy = edge->cy0 ; cy <= edge->cy1 ; cy++) {
+			cell = FindCell(gw, cx, cy);
+			if (cell == NULL) { continue; }
+			vec_remove(&cell->edges, edge);
+			ReleaseCell(gw, cell);
+		}
+	}
+}
+
+/* list an edge in every cell it's bounding box overlaps */
+static void IndexEdge(NV_GraphWidget* gw, NV_GraphEdge* edge) {
+	int cx0 = CellCoord(edge->bounds.x);
+	int cy0 = CellCoord(edge->bounds.y);
+	int cx1 = CellCoord(edge->bounds.x + edge->bounds.w - 1);
+	int cy1 = CellCoord(edge->bounds.y + edge->bounds.h - 1);
+
+	if (edge->placed && edge->cx0 == cx0 && edge->cy0 == cy0 &&
+	    edge->cx1 == cx1 && edge->cy1 == cy1) {
+		return;
+	}
+	UnplaceEdge(gw, edge);
+
+	for (int cx = cx0 ; cx <= cx1 ; cx++) {
+		for (int cy = cy0 ; cy <= cy1 ; cy++) {
+			vec_push(&GetCell(gw, cx, cy)->edges, edge);
+		}
+	}
+
+	edge->placed = true;
+	edge->cx0 = cx0;
+	edge->cy0 = cy0;
+	edge->cx1 = cx1;
+	edge->cy1 = cy1;
+}
+
+static void RemoveEdge(NV_GraphWidget* gw, void* link) {
+	NV_GraphEdge* edge;
+	khint_t iter;
+
+	iter = kh_get(mptredge, gw->edges, ptr_key(link));
+	if (iter == kh_end(gw->edges)) { return; }
+	edge = kh_val(gw->edges, iter);
+	kh_del(mptredge, gw->edges, iter);
+
+	UnplaceEdge(gw, edge);
+	if (gw->hover_edge == edge) { gw->hover_edge = NULL; }
+
+	free(edge->title);
+	free(edge);
+}
+
+/* the bounding box of an edge's points and label position */
+static void BoundEdge(NV_GraphEdge* edge) {
+	int x0 = edge->hx;
+	int y0 = edge->hy;
+	int x1 = edge->hx;
+	int y1 = edge->hy;
+
+	for (int i = 0 ; i < edge->npts ; i++) {
+		if (edge->px[i] < x0) { x0 = edge->px[i]; }
+		if (edge->px[i] > x1) { x1 = edge->px[i]; }
+		if (edge->py[i] < y0) { y0 = edge->py[i]; }
+		if (edge->py[i] > y1) { y1 = edge->py[i]; }
+	}
+
+	edge->bounds.x = x0;
+	edge->bounds.y = y0;
+	edge->bounds.w = x1 - x0 + 1;
+	edge->bounds.h = y1 - y0 + 1;
+}
+
+/* compute the points an edge is drawn through from it's endpoints, and list
+ * it in the cells they fall in */
+static void PlaceEdge(NV_GraphWidget* gw, NV_GraphEdge* edge) {
+	double x1 = edge->from->x;
+	double y1 = edge->from->y;
+	double x4 = edge->to->x;
+	double y4 = edge->to->y;
+	double xv = x1 - x4;
+	double yv = y1 - y4;
+	double v_length = sqrt(xv * xv + yv * yv);
+	double x2, y2, x3, y3;
+	double t, u;
+
+	if (edge->curve == 0 || v_length == 0) {
+		edge->npts = 2;
+		edge->px[0] = x1;
+		edge->py[0] = y1;
+		edge->px[1] = x4;
+		edge->py[1] = y4;
+		edge->hx = (x1 + x4) / 2;
+		edge->hy = (y1 + y4) / 2;
+		BoundEdge(edge);
+		IndexEdge(gw, edge);
+		return;
+	}
+
+	/* control points are offset perpendicular to the link by it's curve */
+	x2 = (int) ((yv / v_length) * edge->curve + x1);
+	y2 = (int) ((-xv / v_length) * edge->curve + y1);
+	x3 = (int) ((yv / v_length) * edge->curve + x4);
+	y3 = (int) ((-xv / v_length) * edge->curve + y4);
+
+	edge->npts = NV_GRAPH_CURVE_SEGMENTS + 1;
+	for (int i = 0 ; i <= NV_GRAPH_CURVE_SEGMENTS ; i++) {
+		t = (double) i / NV_GRAPH_CURVE_SEGMENTS;
+		u = 1 - t;
+		edge->px[i] = u*u*u*x1 + 3*u*u*t*x2 + 3*u*t*t*x3 + t*t*t*x4;
+		edge->py[i] = u*u*u*y1 + 3*u*u*t*y2 + 3*u*t*t*y3 + t*t*t*y4;
+	}
+
+	edge->hx = (x2 + x3) / 2;
+	edge->hy = (y2 + y3) / 2;
+	BoundEdge(edge);
+	IndexEdge(gw, edge);
+}
+
+/* copy whatever has changed about a node, must hold the graph's mutex */
+static void UpdateVertex(NV_GraphWidget* gw, nocviz_node* node) {
+	NV_GraphVertex* vtx;
+	unsigned int changes = node->changes;
+	khint_t iter;
+	int r;
+
+	vtx = FindVertex(gw, node);
+	if (vtx == NULL) {
+		vtx = noctools_malloc(sizeof(NV_GraphVertex));
+		vtx->node = node;
+		vtx->title = NULL;
+		vtx->cell = NULL;
+		vtx->flags = 0;
+		iter = kh_put(mptrvtx, gw->vertices, ptr_key(node), &r);
+		kh_val(gw->vertices, iter) = vtx;
+		changes = NOCVIZ_CHANGE_MOVED | NOCVIZ_CHANGE_COLOR | NOCVIZ_CHANGE_TITLE;
+	}
+
+	if (changes & NOCVIZ_CHANGE_MOVED) {
+		vtx->x = node->col * node->w * 2;
+		vtx->y = node->row * node->h * 2;
+		vtx->r.x = vtx->x - (node->w >> 1);
+		vtx->r.y = vtx->y - (node->h >> 1);
+		vtx->r.w = node->w;
+		vtx->r.h = node->h;
+		vtx->moved = true;
+		PlaceVertex(gw, vtx);
+	}
+
+	if (changes & NOCVIZ_CHANGE_COLOR) {
+		vtx->c = node->c;
+		vtx->cell->dirty = true;
+	}
+
+	if (changes & NOCVIZ_CHANGE_TITLE) {
+		free(vtx->title);
+		vtx->title = strdup(node->title);
+	}
+}
+
+/* copy whatever has changed about a link, must hold the graph's mutex */
+static void UpdateEdge(NV_GraphWidget* gw, nocviz_link* link) {
+	NV_GraphEdge* edge;
+	NV_GraphVertex* from;
+	NV_GraphVertex* to;
+	unsigned int changes = link->changes;
+	khint_t iter;
+	int r;
+
+	edge = FindEdge(gw, link);
+	if (edge == NULL) {
+		edge = noctools_malloc(sizeof(NV_GraphEdge));
+		edge->link = link;
+		edge->title = NULL;
+		edge->flags = 0;
+		edge->placed = false;
+		edge->stamp = 0;
+		iter = kh_put(mptredge, gw->edges, ptr_key(link), &r);
+		kh_val(gw->edges, iter) = edge;
+		changes = NOCVIZ_CHANGE_MOVED | NOCVIZ_CHANGE_COLOR | NOCVIZ_CHANGE_TITLE;
+	}
+
+	if (changes & NOCVIZ_CHANGE_MOVED) {
+		/* the endpoints are added before any of their links */
+		from = FindVertex(gw, link->from);
+		to = FindVertex(gw, link->to);
+		if (from == NULL || to == NULL) {
+			RemoveEdge(gw, link);
+			return;
+		}
+		edge->from = from;
+		edge->to = to;
+		edge->curve = link->curve;
+		PlaceEdge(gw, edge);
+	}
+
+	if (changes & NOCVIZ_CHANGE_COLOR) {
+		edge->c = link->c;
+	}
+
+	if (changes & NOCVIZ_CHANGE_TITLE) {
+		free(edge->title);
+		edge->title = strdup(link->title);
+	}
+}
+
+/**
+ * @brief Apply the changes recorded by the graph since this was last called
+ * to the widget's copy of it.
+ *
+ * This holds the graph's mutex only while copying what has changed, so that
+ * drawing does not hold up whatever is updating the graph. If nothing has
+ * changed, it does nothing.
+ *
+ * @param gw
+ */
+void NV_GraphWidgetSync(NV_GraphWidget* gw) {
+	nocviz_graph* g = gw->g;
+	NV_GraphVertex* vtx;
+	NV_GraphEdge* edge;
+	nocviz_node* node;
+	nocviz_link* link;
+	void* item;
+	bool moved = false;
+	unsigned int i;
+
+	noctools_mutex_lock(g->mutex);
+
+	if (!g->dirty) {
+		noctools_mutex_unlock(g->mutex);
+		return;
+	}
+
+	/* links go first, since a removed node's links are removed with it */
+	vec_foreach(g->removed_links, item, i) { RemoveEdge(gw, item); }
+	vec_foreach(g->removed_nodes, item, i) { RemoveVertex(gw, item); }
+
+	vec_foreach(g->changed_nodes, node, i) {
+		UpdateVertex(gw, node);
+		moved = moved || (node->changes & NOCVIZ_CHANGE_MOVED);
+	}
+	vec_foreach(g->changed_links, link, i) { UpdateEdge(gw, link); }
+
+	/* links follow the nodes at either end */
+	if (moved) {
+		kh_foreach_value(gw->edges, edge,
+			if (edge->from->moved || edge->to->moved) { PlaceEdge(gw, edge); }
+		);
+	}
+	vec_foreach(g->changed_nodes, node, i) {
+		vtx = FindVertex(gw, node);
+		if (vtx != NULL) { vtx->moved = false; }
+	}
+
+	__nocviz_graph_clear_changes(g);
+	g->dirty = false;
+	g->color_dirty = false;
+
+	noctools_mutex_unlock(g->mutex);
+}
+
+/*** EVENTS ******************************************************************/
+
+static int MouseOverVertex(NV_GraphVertex* vtx, NV_GraphWidget* gw, int x, int y) {
+	return (abs(graph_x(gw, x) - vtx->x) <= (vtx->r.w >> 1) &&
+	        abs(graph_y(gw, y) - vtx->y) <= (vtx->r.h >> 1));
 }
 
-static int MouseOverEdge(nocviz_link *edge, NV_GraphWidget* gw, int x, int y) {
-	return ((abs(x - edge->hx + gw->xOffs) < 20) && (abs(y - edge->hy + gw->yOffs) < 20));
+/* how near an edge's label position the pointer must be, in pixels */
+#define EDGE_HOVER_DIST 20
+
+static int MouseOverEdge(NV_GraphEdge* edge, NV_GraphWidget* gw, int x, int y) {
+	return ((abs(x - screen_x(gw, edge->hx)) < EDGE_HOVER_DIST) &&
+	        (abs(y - screen_y(gw, edge->hy)) < EDGE_HOVER_DIST));
+}
+
+/* zoom by factor, keeping the point under x, y where it is */
+static void Zoom(NV_GraphWidget* gw, double factor, int x, int y) {
+	double gx = (x + gw->xOffs) / gw->scale;
+	double gy = (y + gw->yOffs) / gw->scale;
+	double scale = gw->scale * factor;
+
+	if (scale < NV_GRAPH_MIN_SCALE) { scale = NV_GRAPH_MIN_SCALE; }
+	if (scale > NV_GRAPH_MAX_SCALE) { scale = NV_GRAPH_MAX_SCALE; }
+
+	gw->scale = scale;
+	gw->xOffs = (int) lround(gx * scale) - x;
+	gw->yOffs = (int) lround(gy * scale) - y;
 }
 
 static void KeyDown(AG_Event *event) {
@@ -75,35 +485,43 @@ static void KeyDown(AG_Event *event) {
 	case AG_KEY_DOWN:
 		gw->yOffs += scrollIncr;
 		break;
+	case AG_KEY_PLUS:
+	case AG_KEY_EQUALS:
+		Zoom(gw, 1.25, gw->r.w / 2, gw->r.h / 2);
+		break;
+	case AG_KEY_MINUS:
+		Zoom(gw, 0.8, gw->r.w / 2, gw->r.h / 2);
+		break;
 	case AG_KEY_0:
 		gw->xOffs = 0;
 		gw->yOffs = 0;
+		gw->scale = 1.0;
 		break;
 	}
 	AG_Redraw(gw);
 }
 
-static void SelectVertex(NV_GraphWidget *gw, nocviz_node* vtx) {
-	vtx->flags |= NOCVIZ_NODE_SELECTED;
-	AG_PostEvent(gw, "graph-vertex-selected", "%p", vtx);
+static void SelectVertex(NV_GraphWidget *gw, NV_GraphVertex* vtx) {
+	vtx->flags |= NV_GRAPH_SELECTED;
+	AG_PostEvent(gw, "graph-vertex-selected", "%p", vtx->node);
 	AG_Redraw(gw);
 }
 
-static void UnselectVertex(NV_GraphWidget *gw, nocviz_node* vtx) {
-	vtx->flags &= ~(NOCVIZ_NODE_SELECTED);
-	AG_PostEvent(gw, "graph-vertex-unselected", "%p", vtx);
+static void UnselectVertex(NV_GraphWidget *gw, NV_GraphVertex* vtx) {
+	vtx->flags &= ~(NV_GRAPH_SELECTED);
+	AG_PostEvent(gw, "graph-vertex-unselected", "%p", vtx->node);
 	AG_Redraw(gw);
 }
 
-static void SelectEdge(NV_GraphWidget *gw, nocviz_link* edge) {
-	edge->flags |= NOCVIZ_LINK_SELECTED;
-	AG_PostEvent(gw, "graph-edge-selected", "%p", edge);
+static void SelectEdge(NV_GraphWidget *gw, NV_GraphEdge* edge) {
+	edge->flags |= NV_GRAPH_SELECTED;
+	AG_PostEvent(gw, "graph-edge-selected", "%p", edge->link);
 	AG_Redraw(gw);
 }
 
-static void UnselectEdge(NV_GraphWidget *gw, nocviz_link* edge) {
-	edge->flags &= ~(NOCVIZ_LINK_SELECTED);
-	AG_PostEvent(gw, "graph-edge-unselected", "%p", edge);
+static void UnselectEdge(NV_GraphWidget *gw, NV_GraphEdge* edge) {
+	edge->flags &= ~(NV_GRAPH_SELECTED);
+	AG_PostEvent(gw, "graph-edge-unselected", "%p", edge->link);
 	AG_Redraw(gw);
 }
 
@@ -114,8 +532,8 @@ static void MouseButtonDown(AG_Event *event) {
 	const int x = AG_INT(2);
 	const int y = AG_INT(3);
 	const AG_KeyMod kmod = AG_GetModState(gw);
-	nocviz_node *vtx;
-	nocviz_link* edge;
+	NV_GraphVertex* vtx;
+	NV_GraphEdge* edge;
 
 	if (!AG_WidgetIsFocused(gw))
 		AG_WidgetFocus(gw);
@@ -124,27 +542,35 @@ static void MouseButtonDown(AG_Event *event) {
 	case AG_MOUSE_MIDDLE:
 		gw->flags |= NV_GRAPH_PANNING;
 		break;
+	case AG_MOUSE_WHEELUP:
+		Zoom(gw, 1.25, x, y);
+		AG_Redraw(gw);
+		break;
+	case AG_MOUSE_WHEELDOWN:
+		Zoom(gw, 0.8, x, y);
+		AG_Redraw(gw);
+		break;
 	case AG_MOUSE_LEFT:
 		if (kmod & (AG_KEYMOD_CTRL | AG_KEYMOD_SHIFT)) {
 
 			/* TODO: handle edge multi selection */
 
-			nocviz_graph_foreach_node(gw->g, vtx,
+			kh_foreach_value(gw->vertices, vtx,
 				if (!MouseOverVertex(vtx, gw, x,y)) {
 					continue;
 				}
-				if (vtx->flags & NOCVIZ_NODE_SELECTED) {
+				if (vtx->flags & NV_GRAPH_SELECTED) {
 					UnselectVertex(gw, vtx);
 				} else {
 					SelectVertex(gw, vtx);
 				}
 				);
 
-			nocviz_graph_foreach_link(gw->g, edge,
+			kh_foreach_value(gw->edges, edge,
 				if (!MouseOverEdge(edge, gw, x,y)) {
 					continue;
 				}
-				if (edge->flags & NOCVIZ_LINK_SELECTED) {
+				if (edge->flags & NV_GRAPH_SELECTED) {
 					UnselectEdge(gw, edge);
 				} else {
 					SelectEdge(gw, edge);
@@ -153,18 +579,20 @@ static void MouseButtonDown(AG_Event *event) {
 
 		} else {
 
-			nocviz_graph_foreach_node(gw->g, vtx,
+			/* only selected items need to be unselected, rather
+			 * than posting an event for every item in the graph */
+			kh_foreach_value(gw->vertices, vtx,
 				if (MouseOverVertex(vtx, gw, x, y)) {
 					SelectVertex(gw, vtx);
-				} else {
+				} else if (vtx->flags & NV_GRAPH_SELECTED) {
 					UnselectVertex(gw, vtx);
 				}
 			);
 
-			nocviz_graph_foreach_link(gw->g, edge,
+			kh_foreach_value(gw->edges, edge,
 				if (MouseOverEdge(edge, gw, x, y)) {
 					SelectEdge(gw, edge);
-				} else {
+				} else if (edge->flags & NV_GRAPH_SELECTED) {
 					UnselectEdge(gw, edge);
 				}
 			);
@@ -194,8 +622,15 @@ static void MouseMotion(AG_Event *event) {
 	const int dx = AG_INT(3);
 	const int dy = AG_INT(4);
 
-	nocviz_node* vtx;
-	nocviz_link* edge;
+	NV_GraphVertex* vtx;
+	NV_GraphVertex* hover = NULL;
+	NV_GraphEdge* edge;
+	NV_GraphEdge* hover_edge = NULL;
+	NV_GraphCell* cell;
+	int gx = graph_x(gw, x);
+	int gy = graph_y(gw, y);
+	int reach = (int) ceil(EDGE_HOVER_DIST / gw->scale) + 1;
+	unsigned int i;
 
 	if (gw->flags & NV_GRAPH_PANNING) {
 		gw->xOffs -= dx;
@@ -204,26 +639,50 @@ static void MouseMotion(AG_Event *event) {
 		return;
 	}
 
-	nocviz_graph_foreach_node(gw->g, vtx,
-		if (MouseOverVertex(vtx, gw, x, y)) {
-			vtx->flags |= NOCVIZ_NODE_HOVER;
-		} else {
-			vtx->flags &= ~(NOCVIZ_NODE_HOVER);
+	/* only vertices in the cells around the pointer can be under it */
+	for (int cx = CellCoord(gx - gw->margin) ; cx <= CellCoord(gx + gw->margin) ; cx++) {
+		for (int cy = CellCoord(gy - gw->margin) ; cy <= CellCoord(gy + gw->margin) ; cy++) {
+			cell = FindCell(gw, cx, cy);
+			if (cell == NULL) { continue; }
+			vec_foreach(&cell->vertices, vtx, i) {
+				if (MouseOverVertex(vtx, gw, x, y)) { hover = vtx; }
+			}
 		}
-	);
+	}
 
-	nocviz_graph_foreach_link(gw->g, edge,
-		if (MouseOverEdge(edge, gw, x, y)) {
-			edge->flags |= NOCVIZ_LINK_HOVER;
-		} else {
-			edge->flags &= ~(NOCVIZ_LINK_HOVER);
+	if (hover != gw->hover) {
+		if (gw->hover != NULL) { gw->hover->flags &= ~(NV_GRAPH_HOVER); }
+		if (hover != NULL) { hover->flags |= NV_GRAPH_HOVER; }
+		gw->hover = hover;
+	}
+
+	/* and only edges with their label position in the cells near it */
+	gw->stamp++;
+	for (int cx = CellCoord(gx - reach) ; cx <= CellCoord(gx + reach) ; cx++) {
+		for (int cy = CellCoord(gy - reach) ; cy <= CellCoord(gy + reach) ; cy++) {
+			cell = FindCell(gw, cx, cy);
+			if (cell == NULL) { continue; }
+			vec_foreach(&cell->edges, edge, i) {
+				if (edge->stamp == gw->stamp) { continue; }
+				edge->stamp = gw->stamp;
+				if (MouseOverEdge(edge, gw, x, y)) { hover_edge = edge; }
+			}
 		}
-	);
+	}
+
+	if (hover_edge != gw->hover_edge) {
+		if (gw->hover_edge != NULL) { gw->hover_edge->flags &= ~(NV_GRAPH_HOVER); }
+		if (hover_edge != NULL) { hover_edge->flags |= NV_GRAPH_HOVER; }
+		gw->hover_edge = hover_edge;
+	}
 
 }
 
 static void Init(void* obj) {
 	NV_GraphWidget* gw = obj;
+	nocviz_graph* g = gw->g;
+	nocviz_node* node;
+	nocviz_link* link;
 
 	AGWIDGET(gw)->flags |= AG_WIDGET_FOCUSABLE;
 
@@ -232,7 +691,30 @@ static void Init(void* obj) {
 	gw->hPre = 0;
 	gw->wPre = 0;
 	gw->flags = 0;
-	gw->g->gw = gw;
+	gw->vertices = kh_init(mptrvtx);
+	gw->edges = kh_init(mptredge);
+	gw->cells = kh_init(mcell);
+	gw->visible = noctools_malloc(sizeof(cellvec));
+	vec_init(gw->visible);
+	gw->margin = 0;
+	gw->hover = NULL;
+	gw->hover_edge = NULL;
+	gw->stamp = 0;
+	gw->labels = NV_LabelCacheNew(gw, NV_LABEL_CACHE_CAPACITY);
+	gw->scale = 1.0;
+
+	/* start from a copy of the whole graph, by treating everything already
+	 * in it as just added, and then follow the changes from there */
+	noctools_mutex_lock(g->mutex);
+	__nocviz_graph_track_changes(g, true);
+	nocviz_graph_foreach_node(g, node,
+		__nocviz_graph_node_changed(g, node, NOCVIZ_CHANGE_ADDED);
+	);
+	nocviz_graph_foreach_link(g, link,
+		__nocviz_graph_link_changed(g, link, NOCVIZ_CHANGE_ADDED);
+	);
+	g->gw = gw;
+	noctools_mutex_unlock(g->mutex);
 
 	AG_SetEvent(gw, "key-down", KeyDown, NULL);
 	AG_SetEvent(gw, "mouse-button-down", MouseButtonDown, NULL);
@@ -243,7 +725,36 @@ static void Init(void* obj) {
 
 static void Destroy(void *p) {
 	NV_GraphWidget* gw = p;
+	NV_GraphVertex* vtx;
+	NV_GraphEdge* edge;
+	NV_GraphCell* cell;
+
+	noctools_mutex_lock(gw->g->mutex);
+	__nocviz_graph_track_changes(gw->g, false);
 	gw->g->gw = NULL;
+	noctools_mutex_unlock(gw->g->mutex);
+
+	/* mapped surfaces are released along with the widget */
+	NV_LabelCacheFree(gw->labels, false);
+	kh_foreach_value(gw->edges, edge,
+		free(edge->title);
+		free(edge);
+	);
+	kh_foreach_value(gw->vertices, vtx,
+		free(vtx->title);
+		free(vtx);
+	);
+	kh_foreach_value(gw->cells, cell,
+		vec_deinit(&cell->vertices);
+		vec_deinit(&cell->edges);
+		free(cell);
+	);
+	kh_destroy(mptredge, gw->edges);
+	kh_destroy(mptrvtx, gw->vertices);
+	kh_destroy(mcell, gw->cells);
+	vec_deinit(gw->visible);
+	free(gw->visible);
+
 	free(gw);
 }
 
@@ -271,134 +782,200 @@ static int SizeAllocate(void* obj, const AG_SizeAlloc *a) {
 	return 0;
 }
 
-static void Draw(void* obj) {
-	NV_GraphWidget* gw = obj;
-	nocviz_node* vtx;
-	nocviz_link* edge;
-	AG_Rect r;
-	AG_Color c;
-	AG_Color outline_c;
-	int xOffs = gw->xOffs;
-	int yOffs = gw->yOffs;
-	AG_Driver* dri = AG_ObjectFindParent(gw, "agDrivers", NULL);
-	int* show_node_labels;
-	int* show_edge_labels;
+/*** DRAWING *****************************************************************/
 
-	AG_PushClipRect(gw, &gw->r);
+static bool Overlaps(const AG_Rect* a, const AG_Rect* b) {
+	return a->x < b->x + b->w && b->x < a->x + a->w &&
+	       a->y < b->y + b->h && b->y < a->y + a->h;
+}
 
-	/* Draw the bounding box */
-	AG_ColorRGB_8(&c, 128,128,128);
-	AG_DrawRectOutline(gw, &gw->r, &c);
+/* convert a rectangle from graph to widget coordinates */
+static void ToScreen(NV_GraphWidget* gw, const AG_Rect* in, AG_Rect* out) {
+	out->x = screen_x(gw, in->x);
+	out->y = screen_y(gw, in->y);
+	out->w = (int) lround(in->w * gw->scale);
+	out->h = (int) lround(in->h * gw->scale);
+	if (out->w < 1) { out->w = 1; }
+	if (out->h < 1) { out->h = 1; }
+}
 
-	AG_ColorBlack(&c);
-	AG_TextColor(&c);
+/* find the cells which might have vertices or edges within view, which is in
+ * graph coordinates */
+static void FindVisibleCells(NV_GraphWidget* gw, const AG_Rect* view) {
+	NV_GraphCell* cell;
+	int cx0 = CellCoord(view->x - gw->margin);
+	int cy0 = CellCoord(view->y - gw->margin);
+	int cx1 = CellCoord(view->x + view->w + gw->margin);
+	int cy1 = CellCoord(view->y + view->h + gw->margin);
+
+	vec_clear(gw->visible);
+
+	/* when zoomed far out, checking every cell is quicker than looking up
+	 * every cell in view */
+	if ((double) (cx1 - cx0 + 1) * (cy1 - cy0 + 1) > kh_size(gw->cells)) {
+		kh_foreach_value(gw->cells, cell,
+			if (cell->cx >= cx0 && cell->cx <= cx1 && cell->cy >= cy0 && cell->cy <= cy1) {
+				vec_push(gw->visible, cell);
+			}
+		);
+		return;
+	}
 
-	AG_ColorRGB_8(&outline_c, 128, 255, 128);
+	for (int cx = cx0 ; cx <= cx1 ; cx++) {
+		for (int cy = cy0 ; cy <= cy1 ; cy++) {
+			cell = FindCell(gw, cx, cy);
+			if (cell != NULL) { vec_push(gw->visible, cell); }
+		}
+	}
+}
 
-	show_node_labels = AG_GetPointer(dri, "show_node_labels");
-	show_edge_labels = AG_GetPointer(dri, "show_edge_labels");
+/* recompute the extent and average color of a cell's vertices */
+static void UpdateTile(NV_GraphCell* cell) {
+	NV_GraphVertex* vtx;
+	unsigned long r = 0, g = 0, b = 0, a = 0;
+	unsigned long n = cell->vertices.length;
+	int x0 = INT_MAX, y0 = INT_MAX, x1 = INT_MIN, y1 = INT_MIN;
+	unsigned int i;
+
+	vec_foreach(&cell->vertices, vtx, i) {
+		r += vtx->c.r;
+		g += vtx->c.g;
+		b += vtx->c.b;
+		a += vtx->c.a;
+		if (vtx->r.x < x0) { x0 = vtx->r.x; }
+		if (vtx->r.y < y0) { y0 = vtx->r.y; }
+		if (vtx->r.x + vtx->r.w > x1) { x1 = vtx->r.x + vtx->r.w; }
+		if (vtx->r.y + vtx->r.h > y1) { y1 = vtx->r.y + vtx->r.h; }
+	}
 
-	/* draw the links */
-	nocviz_graph_foreach_link(gw->g, edge,
+	cell->c.r = r / n;
+	cell->c.g = g / n;
+	cell->c.b = b / n;
+	cell->c.a = a / n;
+	cell->tile.x = x0;
+	cell->tile.y = y0;
+	cell->tile.w = x1 - x0;
+	cell->tile.h = y1 - y0;
+	cell->dirty = false;
+}
 
-		/* label coordinates */
-		int lx;
-		int ly;
-		AG_Color edgecolor;
+static void DrawEdges(NV_GraphWidget* gw, const AG_Rect* view, AG_Color* outline_c, bool labels) {
+	NV_GraphEdge* edge;
+	NV_GraphCell* cell;
+	AG_Color* edgecolor;
+	unsigned int i;
+	unsigned int j;
+
+	/* an edge spanning several visible cells is drawn once */
+	gw->stamp++;
+	vec_foreach(gw->visible, cell, i) {
+		vec_foreach(&cell->edges, edge, j) {
+			if (edge->stamp == gw->stamp) { continue; }
+			edge->stamp = gw->stamp;
+			if (!Overlaps(&edge->bounds, view)) { continue; }
+
+			if (edge->flags & NV_GRAPH_HOVER) {
+				edgecolor = outline_c;
+			} else {
+				edgecolor = &edge->c;
+			}
 
-		int curve = edge->curve;
+			for (int k = 1 ; k < edge->npts ; k++) {
+				AG_DrawLine(gw,
+					screen_x(gw, edge->px[k - 1]),
+					screen_y(gw, edge->py[k - 1]),
+					screen_x(gw, edge->px[k]),
+					screen_y(gw, edge->py[k]),
+					edgecolor);
+			}
 
-		if (edge->flags & NOCVIZ_NODE_HOVER) {
-			edgecolor = outline_c;
-		} else {
-			edgecolor = edge->c;
+			if (labels) {
+				NV_LabelCacheBlit(gw->labels, edge->title,
+					screen_x(gw, edge->hx), screen_y(gw, edge->hy));
+			}
 		}
+	}
+}
 
-		if (curve == 0) {
-			AG_DrawLine(gw,
-				edge->from->x - xOffs,
-				edge->from->y - yOffs,
-				edge->to->x - xOffs,
-				edge->to->y - yOffs,
-				&edgecolor);
-			lx = (edge->from->x + edge->to->x) / 2;
-			ly = (edge->from->y + edge->to->y) / 2;
-		} else {
-
-			double xv = edge->from->x - edge->to->x;
-			double yv = edge->from->y - edge->to->y;
-			double v_length = sqrt(xv * xv + yv * yv);
+static void DrawVertices(NV_GraphWidget* gw, const AG_Rect* view, AG_Color* outline_c, bool labels) {
+	NV_GraphVertex* vtx;
+	NV_GraphCell* cell;
+	AG_Rect r;
+	unsigned int i;
+	unsigned int j;
 
-			int xc1 = (int) ((yv / v_length) * (float) curve + (float) edge->from->x);
-			int yc1 = (int) ((-xv / v_length) * (float) curve + (float) edge->from->y);
-			int xc2 = (int) ((yv / v_length) * (float) curve + (float) edge->to->x);
-			int yc2 = (int) ((-xv / v_length) * (float) curve + (float) edge->to->y);
+	vec_foreach(gw->visible, cell, i) {
+		vec_foreach(&cell->vertices, vtx, j) {
+			if (!Overlaps(&vtx->r, view)) { continue; }
 
-			M_DrawBezier2(AGWIDGET(gw),
-				edge->from->x - xOffs, edge->from->y - yOffs,
-				xc1 - xOffs, yc1 - yOffs,
-				xc2 - xOffs, yc2 - yOffs,
-				edge->to->x - xOffs, edge->to->y - yOffs,
-				10, &edgecolor);
+			ToScreen(gw, &vtx->r, &r);
+			AG_DrawRect(gw, &r, &vtx->c);
+			if (vtx->flags & NV_GRAPH_HOVER) {
+				AG_DrawRectOutline(gw, &r, outline_c);
+			}
 
-			lx = (xc1 + xc2) / 2;
-			ly = (yc1 + yc2) / 2;
+			if (labels) {
+				NV_LabelCacheBlit(gw->labels, vtx->title, r.x, r.y);
+			}
 		}
+	}
+}
 
-		edge->hx = lx;
-		edge->hy = ly;
+/* when zoomed out, each cell is drawn as one tile */
+static void DrawTiles(NV_GraphWidget* gw) {
+	NV_GraphCell* cell;
+	AG_Rect r;
+	unsigned int i;
+
+	vec_foreach(gw->visible, cell, i) {
+		/* some cells only have edges passing through */
+		if (cell->vertices.length == 0) { continue; }
+		if (cell->dirty) { UpdateTile(cell); }
+		ToScreen(gw, &cell->tile, &r);
+		AG_DrawRect(gw, &r, &cell->c);
+	}
+}
 
-		lx -= xOffs;
-		ly -= yOffs;
+static void Draw(void* obj) {
+	NV_GraphWidget* gw = obj;
+	AG_Rect view;
+	AG_Color c;
+	AG_Color outline_c;
+	AG_Driver* dri = AG_ObjectFindParent(gw, "agDrivers", NULL);
+	int* show_node_labels;
+	int* show_edge_labels;
 
-		/* if the title text has changed or we don't have a surface
-		 * yet, update the surface */
-		if ((edge->surface_dirty != 0) || (edge->label_surface < 0)) {
-			if (edge->label_surface >= 0) {
-				AG_WidgetUnmapSurface(gw, edge->label_surface);
-				edge->label_surface = -1;
-			}
-			edge->label_surface = AG_WidgetMapSurface(gw,
-				AG_TextRender(edge->title));
-			edge->surface_dirty = 0;
-		}
+	NV_GraphWidgetSync(gw);
+	NV_LabelCacheNextFrame(gw->labels);
 
-		if ((edge->label_surface >= 0) && (*show_edge_labels == 1)) {
-			AG_WidgetBlitSurface(gw, edge->label_surface, lx, ly);
-		}
+	AG_PushClipRect(gw, &gw->r);
 
-	);
+	/* Draw the bounding box */
+	AG_ColorRGB_8(&c, 128,128,128);
+	AG_DrawRectOutline(gw, &gw->r, &c);
 
-	/* draw the nodes */
-	nocviz_graph_foreach_node(gw->g, vtx,
-		vtx->x = vtx->col * vtx->w * 2;
-		vtx->y = vtx->row * vtx->h * 2;
-		r.x = vtx->x - xOffs - (vtx->w >> 1);
-		r.y = vtx->y - yOffs - (vtx->h >> 1);
-		r.h = vtx->h;
-		r.w = vtx->w;
-		AG_DrawRect(gw, &r, &vtx->c);
-		if (vtx->flags & NOCVIZ_NODE_HOVER) {
-			AG_DrawRectOutline(gw, &r, &outline_c);
+	AG_ColorBlack(&c);
+	AG_TextColor(&c);
 
-		}
+	AG_ColorRGB_8(&outline_c, 128, 255, 128);
 
-		/* if the title text has changed or we don't have a surface
-		 * yet, update the surface */
-		if ((vtx->surface_dirty != 0) || (vtx->label_surface < 0)) {
-			if (vtx->label_surface >= 0) {
-				AG_WidgetUnmapSurface(gw, vtx->label_surface);
-				vtx->label_surface = -1;
-			}
-			vtx->label_surface = AG_WidgetMapSurface(gw,
-				AG_TextRender(vtx->title));
-			vtx->surface_dirty = 0;
-		}
+	show_node_labels = AG_GetPointer(dri, "show_node_labels");
+	show_edge_labels = AG_GetPointer(dri, "show_edge_labels");
 
-		if ((vtx->label_surface >= 0) && (*show_node_labels == 1)) {
-			AG_WidgetBlitSurface(gw, vtx->label_surface, r.x, r.y);
-		}
-	);
+	/* the part of the graph in view, in graph coordinates */
+	view.x = graph_x(gw, 0);
+	view.y = graph_y(gw, 0);
+	view.w = (int) ceil(gw->r.w / gw->scale) + 1;
+	view.h = (int) ceil(gw->r.h / gw->scale) + 1;
+
+	FindVisibleCells(gw, &view);
+
+	if (gw->scale < NV_GRAPH_LOD_SCALE) {
+		DrawTiles(gw);
+	} else {
+		DrawEdges(gw, &view, &outline_c, *show_edge_labels == 1);
+		DrawVertices(gw, &view, &outline_c, *show_node_labels == 1);
+	}
 
 	AG_PopClipRect(gw);
 
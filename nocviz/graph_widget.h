@@ -3,14 +3,135 @@
 
 #include "graph.h"
 #include "datastore.h"
+#include "label_cache.h"
+#include "../3rdparty/khash.h"
 
 #include <agar/core.h>
 #include <agar/gui.h>
 #include <agar/math.h>
 
+#include <stdbool.h>
+
+/******************************************************************************
+ *
+ * The graph widget draws from it's own copy of the appearance of each node
+ * and link, rather than from the nocviz_graph itself. The graph records which
+ * nodes and links have been added, removed, or changed (see
+ * nocviz_graph_track_changes()), and before each frame the widget applies only
+ * those changes to it's copy, holding the graph's mutex just long enough to
+ * do so. The geometry of each node and link is computed when it moves, rather
+ * than on every frame.
+ *
+ * Vertices and edges are identified by the address of the node or link they
+ * copy, which is only ever dereferenced while holding the graph's mutex.
+ *
+ * Vertices are also kept in a grid of NV_GRAPH_CELL_SIZE square cells, by
+ * their center, and edges in every cell their bounding box overlaps, so that
+ * only the cells in view need to be visited when drawing, and only those
+ * around the pointer when finding what is under it. An edge may be listed in
+ * several cells, so each is stamped as it is visited to skip it the next
+ * time. When zoomed out past NV_GRAPH_LOD_SCALE, each cell is drawn as a
+ * single tile of the average color of it's vertices, without links or
+ * labels.
+ *
+ * Labels are drawn from a cache shared by every vertex and edge, see
+ * label_cache.h.
+ *
+ *****************************************************************************/
+
+/* number of line segments used to draw a curved link */
+#define NV_GRAPH_CURVE_SEGMENTS 10
+
+/* size of the cells of the spatial index, in graph coordinates */
+#define NV_GRAPH_CELL_SIZE 256
+
+/* range of zoom, and the scale below which cells are drawn as tiles */
+#define NV_GRAPH_MIN_SCALE 0.0625
+#define NV_GRAPH_MAX_SCALE 4.0
+#define NV_GRAPH_LOD_SCALE 0.3
+
+typedef struct nv_graph_vertex_t {
+	nocviz_node* node;
+	AG_Rect r;	/* in graph coordinates */
+	int x;		/* center */
+	int y;
+	AG_Color c;
+	char* title;
+	bool moved;	/* since the edges were last placed */
+	struct nv_graph_cell_t* cell;
+	unsigned int flags;
+#define NV_GRAPH_SELECTED 0x1
+#define NV_GRAPH_HOVER 0x2
+} NV_GraphVertex;
+
+typedef vec_t(NV_GraphVertex*) vtxvec;
+
+typedef vec_t(struct nv_graph_edge_t*) edgevec;
+
+typedef struct nv_graph_cell_t {
+	int cx;
+	int cy;
+	vtxvec vertices;
+	edgevec edges;
+
+	/* the tile drawn in place of the vertices when zoomed out, which is
+	 * recomputed once one of them moves or changes color */
+	AG_Rect tile;
+	AG_Color c;
+	bool dirty;
+} NV_GraphCell;
+
+typedef vec_t(NV_GraphCell*) cellvec;
+
+typedef struct nv_graph_edge_t {
+	nocviz_link* link;
+	NV_GraphVertex* from;
+	NV_GraphVertex* to;
+	int curve;
+	AG_Color c;
+	char* title;
+	unsigned int flags;
+
+	/* the points the link is drawn through, and it's label position,
+	 * which is also used for hover detection */
+	int npts;
+	int px[NV_GRAPH_CURVE_SEGMENTS + 1];
+	int py[NV_GRAPH_CURVE_SEGMENTS + 1];
+	int hx;
+	int hy;
+	AG_Rect bounds;	/* of the points and label position */
+
+	/* the range of cells the edge is listed in, if placed */
+	bool placed;
+	int cx0;
+	int cy0;
+	int cx1;
+	int cy1;
+	unsigned long stamp;	/* when last visited */
+} NV_GraphEdge;
+
+/* mapping of nodes to vertices */
+KHASH_MAP_INIT_INT64(mptrvtx, NV_GraphVertex*)
+
+/* mapping of links to edges */
+KHASH_MAP_INIT_INT64(mptredge, NV_GraphEdge*)
+
+/* mapping of cell coordinates to cells */
+KHASH_MAP_INIT_INT64(mcell, NV_GraphCell*)
+
 typedef struct nocviz_graph_widget {
 	struct ag_widget _inherit;
 	nocviz_graph* g;
+	khash_t(mptrvtx)* vertices;
+	khash_t(mptredge)* edges;
+	khash_t(mcell)* cells;
+	cellvec* visible;	/* scratch space for drawing */
+	int margin;		/* largest half width or height of any vertex */
+	NV_GraphVertex* hover;
+	NV_GraphEdge* hover_edge;
+	unsigned long stamp;	/* for skipping edges already visited */
+	NV_LabelCache* labels;
+	double scale;
 	int xOffs;
 	int yOffs;
 	int wPre;
@@ -34,4 +155,8 @@ extern AG_WidgetClass NV_GraphWidgetClass;
 NV_GraphWidget* NV_GraphWidgetNew(void* parent, nocviz_graph* g);
 void NV_GraphSizeHint(NV_GraphWidget* gw, int w, int h);
 
+/* apply any changes made to the graph since the last call, this is done
+ * automatically before each frame is drawn */
+void NV_GraphWidgetSync(NV_GraphWidget* gw);
+
 #endif
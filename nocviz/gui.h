@@ -38,11 +38,11 @@
  * infobox_p  . . . . . Pointer to the top-level AG_Box of the info pane.
  *
  *
- * The main graph widget updates in the background every
- * NOCVIZ_GUI_GRAPH_UPDATE_INTERVAL many (Agar) ticks. At such times, if the
- * nocviz_graph* has it's dirty flag set, then graph_update() deletes and
- * re-generates the graph widget. This can also happens when a vertex is
- * selected, and when toggling edge/node labels.
+ * The main graph widget redraws every NOCVIZ_GUI_GRAPH_UPDATE_INTERVAL many
+ * (Agar) ticks. Before drawing, if the nocviz_graph* has it's dirty flag set,
+ * the widget applies the nodes and links which have been added, removed, or
+ * changed since the last frame to it's own copy of the graph, rather than
+ * re-reading all of it (see graph_widget.h).
  *
  * The "info panel" contains all information about the currently selected graph
  * node, edge, or the simulation (if no node or edge is selected). This updates
@@ -87,12 +87,6 @@ void gui_init(nocviz_gui_handle* h, Tcl_Interp* interp, nocviz_graph* graph);
 /* GUI main thread */
 void* gui_main(void* arg);
 
-unsigned int graph_update_handler(AG_Timer* to, AG_Event* event);
-
-void graph_update(AG_Driver* dri, nocviz_graph* g_data);
-
-void graph_color_update(AG_Driver* dri, nocviz_graph* g_data);
-
 size_t PrintFmtHandle(AG_FmtString* fs, char* dst, size_t dstSize);
 
 void handle_vertex_selection(AG_Event* event);
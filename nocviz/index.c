@@ -0,0 +1,324 @@
+#include "index.h"
+
+#include <math.h>
+#include <string.h>
+
+#define item_key(item) ((khint64_t) (uintptr_t) (item))
+#define key_item(key) ((void*) (uintptr_t) (key))
+
+static nocviz_index* nocviz_index_init(nocviz_index_type type) {
+	nocviz_index* idx;
+
+	idx = noctools_malloc(sizeof(nocviz_index));
+	idx->type = type;
+
+	idx->entries = noctools_malloc(sizeof(entryvec));
+	vec_init(idx->entries);
+	idx->numbers = kh_init(mptrdbl);
+
+	idx->items = kh_init(mstrsptr);
+	idx->strings = kh_init(mptrstr);
+
+	return idx;
+}
+
+static void nocviz_index_free(nocviz_index* idx) {
+	const char* str;
+	khash_t(sptr)* items;
+
+	vec_deinit(idx->entries);
+	free(idx->entries);
+	kh_destroy(mptrdbl, idx->numbers);
+
+	kh_foreach(idx->items, str, items,
+		kh_destroy(sptr, items);
+		free((char*) str);
+	);
+	kh_destroy(mstrsptr, idx->items);
+	kh_destroy(mptrstr, idx->strings);
+
+	free(idx);
+}
+
+nocviz_index_set* nocviz_index_set_init(void) {
+	nocviz_index_set* set;
+
+	set = noctools_malloc(sizeof(nocviz_index_set));
+	set->indexes = kh_init(mstridx);
+	set->mutex = noctools_malloc(sizeof(AG_Mutex));
+	AG_MutexInit(set->mutex);
+
+	return set;
+}
+
+void nocviz_index_set_free(nocviz_index_set* set) {
+	const char* key;
+	nocviz_index* idx;
+
+	kh_foreach(set->indexes, key, idx,
+		nocviz_index_free(idx);
+		free((char*) key);
+	);
+	kh_destroy(mstridx, set->indexes);
+
+	AG_MutexDestroy(set->mutex);
+	free(set->mutex);
+	free(set);
+}
+
+nocviz_index* __nocviz_index_set_get(nocviz_index_set* set, char* key) {
+	khint_t iter;
+
+	iter = kh_get(mstridx, set->indexes, key);
+	if (iter == kh_end(set->indexes)) { return NULL; }
+	return kh_val(set->indexes, iter);
+}
+
+nocviz_index* nocviz_index_set_add(nocviz_index_set* set, char* key, nocviz_index_type type) {
+	nocviz_index* idx = NULL;
+	khint_t iter;
+	int r;
+
+	noctools_mutex_lock(set->mutex);
+	if (__nocviz_index_set_get(set, key) == NULL) {
+		idx = nocviz_index_init(type);
+		iter = kh_put(mstridx, set->indexes, strdup(key), &r);
+		kh_val(set->indexes, iter) = idx;
+	}
+	noctools_mutex_unlock(set->mutex);
+
+	return idx;
+}
+
+bool nocviz_index_set_del(nocviz_index_set* set, char* key) {
+	khint_t iter;
+
+	noctools_mutex_lock(set->mutex);
+	iter = kh_get(mstridx, set->indexes, key);
+	if (iter == kh_end(set->indexes)) {
+		noctools_mutex_unlock(set->mutex);
+		return false;
+	}
+	nocviz_index_free(kh_val(set->indexes, iter));
+	free((char*) kh_key(set->indexes, iter));
+	kh_del(mstridx, set->indexes, iter);
+	noctools_mutex_unlock(set->mutex);
+
+	return true;
+}
+
+/*** NUMERIC INDEXES *********************************************************/
+
+int nocviz_index_entry_compare(const void* a, const void* b) {
+	const nocviz_index_entry* ea = a;
+	const nocviz_index_entry* eb = b;
+
+	if (ea->v < eb->v) { return -1; }
+	if (ea->v > eb->v) { return 1; }
+
+	/* ties are broken by the item, so every entry has a unique position,
+	 * and can be found again by binary search */
+	if ((uintptr_t) ea->item < (uintptr_t) eb->item) { return -1; }
+	if ((uintptr_t) ea->item > (uintptr_t) eb->item) { return 1; }
+	return 0;
+}
+
+/* position of the first entry which is not less than e */
+static size_t nocviz_index_search(nocviz_index* idx, nocviz_index_entry* e) {
+	size_t lo = 0;
+	size_t hi = idx->entries->length;
+	size_t mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (nocviz_index_entry_compare(&idx->entries->data[mid], e) < 0) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	return lo;
+}
+
+size_t nocviz_index_lower_bound(nocviz_index* idx, double v) {
+	size_t lo = 0;
+	size_t hi = idx->entries->length;
+	size_t mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (idx->entries->data[mid].v < v) { lo = mid + 1; } else { hi = mid; }
+	}
+
+	return lo;
+}
+
+size_t nocviz_index_upper_bound(nocviz_index* idx, double v) {
+	size_t lo = 0;
+	size_t hi = idx->entries->length;
+	size_t mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (idx->entries->data[mid].v <= v) { lo = mid + 1; } else { hi = mid; }
+	}
+
+	return lo;
+}
+
+static void nocviz_index_remove_number(nocviz_index* idx, void* item) {
+	nocviz_index_entry old;
+	khint_t iter;
+	size_t i;
+
+	iter = kh_get(mptrdbl, idx->numbers, item_key(item));
+	if (iter == kh_end(idx->numbers)) { return; }
+
+	old.v = kh_val(idx->numbers, iter);
+	old.item = item;
+	kh_del(mptrdbl, idx->numbers, iter);
+
+	i = nocviz_index_search(idx, &old);
+	vec_splice(idx->entries, i, 1);
+}
+
+static void nocviz_index_set_number(nocviz_index* idx, void* item, double v) {
+	nocviz_index_entry old;
+	nocviz_index_entry new;
+	nocviz_index_entry* data;
+	khint_t iter;
+	size_t i;
+	size_t j;
+	int r;
+
+	new.v = v;
+	new.item = item;
+
+	iter = kh_put(mptrdbl, idx->numbers, item_key(item), &r);
+	if (r != 0) {
+		/* not indexed yet */
+		kh_val(idx->numbers, iter) = v;
+		vec_insert(idx->entries, nocviz_index_search(idx, &new), new);
+		return;
+	}
+
+	old.v = kh_val(idx->numbers, iter);
+	old.item = item;
+	if (old.v == v) { return; }
+	kh_val(idx->numbers, iter) = v;
+
+	/* Move the entry from it's old position to it's new one, shifting only
+	 * the entries in between. The new position is found with the old entry
+	 * still in place, so it is one too far if the entry moves up. */
+	i = nocviz_index_search(idx, &old);
+	j = nocviz_index_search(idx, &new);
+	data = idx->entries->data;
+	if (j > i) {
+		j--;
+		memmove(&data[i], &data[i + 1], (j - i) * sizeof(nocviz_index_entry));
+	} else {
+		memmove(&data[j + 1], &data[j], (i - j) * sizeof(nocviz_index_entry));
+	}
+	data[j] = new;
+}
+
+/*** STRING INDEXES **********************************************************/
+
+khash_t(sptr)* nocviz_index_find(nocviz_index* idx, const char* str) {
+	khint_t iter;
+
+	iter = kh_get(mstrsptr, idx->items, str);
+	if (iter == kh_end(idx->items)) { return NULL; }
+	return kh_val(idx->items, iter);
+}
+
+static void nocviz_index_remove_string(nocviz_index* idx, void* item) {
+	khash_t(sptr)* items;
+	khint_t iter;
+	char* str;
+
+	iter = kh_get(mptrstr, idx->strings, item_key(item));
+	if (iter == kh_end(idx->strings)) { return; }
+	str = kh_val(idx->strings, iter);
+	kh_del(mptrstr, idx->strings, iter);
+
+	iter = kh_get(mstrsptr, idx->items, str);
+	items = kh_val(idx->items, iter);
+	kh_del(sptr, items, kh_get(sptr, items, item_key(item)));
+
+	/* the last item with this value */
+	if (kh_size(items) == 0) {
+		kh_destroy(sptr, items);
+		kh_del(mstrsptr, idx->items, iter);
+		free(str);
+	}
+}
+
+static void nocviz_index_set_string(nocviz_index* idx, void* item, char* str) {
+	khash_t(sptr)* items;
+	khint_t iter;
+	int r;
+
+	iter = kh_get(mptrstr, idx->strings, item_key(item));
+	if (iter != kh_end(idx->strings)) {
+		if (string_equals(kh_val(idx->strings, iter), str)) { return; }
+		nocviz_index_remove_string(idx, item);
+	}
+
+	iter = kh_get(mstrsptr, idx->items, str);
+	if (iter == kh_end(idx->items)) {
+		iter = kh_put(mstrsptr, idx->items, strdup(str), &r);
+		kh_val(idx->items, iter) = kh_init(sptr);
+	}
+	items = kh_val(idx->items, iter);
+	kh_put(sptr, items, item_key(item), &r);
+
+	/* the string is owned by the items table */
+	str = (char*) kh_key(idx->items, iter);
+	iter = kh_put(mptrstr, idx->strings, item_key(item), &r);
+	kh_val(idx->strings, iter) = str;
+}
+
+/*** UPDATES *****************************************************************/
+
+void __nocviz_index_update(nocviz_index* idx, void* item, nocviz_val* val) {
+	double d;
+
+	if (idx->type == NOCVIZ_INDEX_STRING) {
+		if (val == NULL) {
+			nocviz_index_remove_string(idx, item);
+		} else {
+			nocviz_index_set_string(idx, item, nocviz_val_str(val));
+		}
+		return;
+	}
+
+	/* values which are not numbers are not in numeric indexes */
+	if (val == NULL || !nocviz_val_double(val, &d) || isnan(d)) {
+		nocviz_index_remove_number(idx, item);
+	} else {
+		nocviz_index_set_number(idx, item, d);
+	}
+}
+
+void nocviz_index_set_update(nocviz_index_set* set, char* key, void* item, nocviz_val* val) {
+	nocviz_index* idx;
+
+	noctools_mutex_lock(set->mutex);
+	idx = __nocviz_index_set_get(set, key);
+	if (idx != NULL) { __nocviz_index_update(idx, item, val); }
+	noctools_mutex_unlock(set->mutex);
+}
+
+void nocviz_index_set_remove_item(nocviz_index_set* set, void* item) {
+	const char* key;
+	nocviz_index* idx;
+
+	noctools_mutex_lock(set->mutex);
+	kh_foreach(set->indexes, key, idx,
+		UNUSED(key);
+		__nocviz_index_update(idx, item, NULL);
+	);
+	noctools_mutex_unlock(set->mutex);
+}
@@ -0,0 +1,115 @@
+#ifndef NOCVIZ_INDEX_H
+#define NOCVIZ_INDEX_H
+
+#include "../3rdparty/khash.h"
+#include "../3rdparty/vec.h"
+#include "../common/util.h"
+#include "value.h"
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* threading primitives */
+#include <agar/core.h>
+
+/******************************************************************************
+ *
+ * Secondary indexes over the values of one key in the datastores of every
+ * node, or every link, of a graph. An index is created on request, and then
+ * kept up to date as the indexed key is set or deleted, so that queries on the
+ * key need not visit every datastore.
+ *
+ * A numeric index keeps the items whose value is a number sorted by value,
+ * which answers comparisons, ranges, and top-K queries with a binary search.
+ * Updating an item moves it only as far as it's value's new position, which
+ * is usually not far for values which change a little at a time.
+ *
+ * A string index hashes the string representation of each value, which
+ * answers equality queries with a single lookup.
+ *
+ * Items are opaque pointers, to the node or link which owns the datastore.
+ *
+ * All of the indexes of a graph's nodes (or links) belong to one
+ * nocviz_index_set, which is protected by it's own mutex. Datastores update
+ * the set while holding their own mutex, so a datastore's mutex must never be
+ * taken while holding a set's mutex.
+ *
+ *****************************************************************************/
+
+typedef enum nocviz_index_type_t {
+	NOCVIZ_INDEX_NUMERIC,
+	NOCVIZ_INDEX_STRING
+} nocviz_index_type;
+
+typedef struct nocviz_index_entry_t {
+	double v;
+	void* item;
+} nocviz_index_entry;
+
+typedef vec_t(nocviz_index_entry) entryvec;
+typedef vec_t(void*) ptrvec;
+
+/* mapping of items to their indexed numbers */
+KHASH_MAP_INIT_INT64(mptrdbl, double)
+
+/* mapping of items to their indexed strings */
+KHASH_MAP_INIT_INT64(mptrstr, char*)
+
+/* set of items */
+KHASH_SET_INIT_INT64(sptr)
+
+/* mapping of strings to the set of items with that value */
+KHASH_MAP_INIT_STR(mstrsptr, khash_t(sptr)*)
+
+typedef struct nocviz_index_t {
+	nocviz_index_type type;
+
+	/* numeric indexes */
+	entryvec* entries;		/* sorted by value, then item */
+	khash_t(mptrdbl)* numbers;
+
+	/* string indexes */
+	khash_t(mstrsptr)* items;
+	khash_t(mptrstr)* strings;	/* keys of items, not owned */
+} nocviz_index;
+
+/* mapping of keys to indexes */
+KHASH_MAP_INIT_STR(mstridx, nocviz_index*)
+
+typedef struct nocviz_index_set_t {
+	khash_t(mstridx)* indexes;
+	AG_Mutex* mutex;
+} nocviz_index_set;
+
+nocviz_index_set* nocviz_index_set_init(void);
+void nocviz_index_set_free(nocviz_index_set* set);
+
+/* create an empty index on a key, returns NULL if it already exists */
+nocviz_index* nocviz_index_set_add(nocviz_index_set* set, char* key, nocviz_index_type type);
+
+/* destroy the index on a key, returns false if there is none */
+bool nocviz_index_set_del(nocviz_index_set* set, char* key);
+
+/* Record that the value of key for item has changed, or was deleted if val
+ * is NULL. Does nothing if the key is not indexed. */
+void nocviz_index_set_update(nocviz_index_set* set, char* key, void* item, nocviz_val* val);
+
+/* remove an item from every index, when it is destroyed */
+void nocviz_index_set_remove_item(nocviz_index_set* set, void* item);
+
+/* internal (non-mutex protected) functions */
+nocviz_index* __nocviz_index_set_get(nocviz_index_set* set, char* key);
+void __nocviz_index_update(nocviz_index* idx, void* item, nocviz_val* val);
+
+/* Queries, which must be made while holding the set's mutex. For numeric
+ * indexes, the first entry whose value is at least v, or greater than v. */
+size_t nocviz_index_lower_bound(nocviz_index* idx, double v);
+size_t nocviz_index_upper_bound(nocviz_index* idx, double v);
+
+/* for string indexes, the set of items with the given value, or NULL */
+khash_t(sptr)* nocviz_index_find(nocviz_index* idx, const char* str);
+
+/* compare two nocviz_index_entry, in the order of a numeric index */
+int nocviz_index_entry_compare(const void* a, const void* b);
+
+#endif
@@ -0,0 +1,159 @@
+#include "label_cache.h"
+
+#include <ctype.h>
+#include <string.h>
+
+/* longest run of non-digits which is cached on it's own, longer runs are
+ * split into several */
+#define NV_LABEL_RUN_MAX 64
+
+#define DIGITS "0123456789"
+
+NV_LabelCache* NV_LabelCacheNew(void* widget, unsigned int capacity) {
+	NV_LabelCache* lc;
+
+	lc = noctools_malloc(sizeof(NV_LabelCache));
+	lc->widget = widget;
+	lc->entries = kh_init(mstrlabel);
+	lc->head = NULL;
+	lc->tail = NULL;
+	lc->capacity = capacity;
+	lc->frame = 0;
+
+	return lc;
+}
+
+static void FreeEntry(NV_LabelCache* lc, NV_LabelEntry* e, bool unmap) {
+	if (unmap) { AG_WidgetUnmapSurface(lc->widget, e->surface); }
+	free(e->text);
+	free(e);
+}
+
+void NV_LabelCacheFree(NV_LabelCache* lc, bool unmap) {
+	NV_LabelEntry* e;
+	NV_LabelEntry* next;
+
+	for (e = lc->head ; e != NULL ; e = next) {
+		next = e->next;
+		FreeEntry(lc, e, unmap);
+	}
+	kh_destroy(mstrlabel, lc->entries);
+	free(lc);
+}
+
+void NV_LabelCacheNextFrame(NV_LabelCache* lc) {
+	lc->frame++;
+}
+
+static void Unlink(NV_LabelCache* lc, NV_LabelEntry* e) {
+	if (e->prev != NULL) { e->prev->next = e->next; } else { lc->head = e->next; }
+	if (e->next != NULL) { e->next->prev = e->prev; } else { lc->tail = e->prev; }
+	e->prev = NULL;
+	e->next = NULL;
+}
+
+static void PushFront(NV_LabelCache* lc, NV_LabelEntry* e) {
+	e->prev = NULL;
+	e->next = lc->head;
+	if (lc->head != NULL) { lc->head->prev = e; } else { lc->tail = e; }
+	lc->head = e;
+}
+
+/* unmap the least recently used entries until there are few enough, or until
+ * everything left is in use by this frame */
+static void Evict(NV_LabelCache* lc) {
+	NV_LabelEntry* e;
+
+	while (kh_size(lc->entries) > lc->capacity) {
+		e = lc->tail;
+		if (e == NULL || e->frame == lc->frame) { return; }
+
+		Unlink(lc, e);
+		kh_del(mstrlabel, lc->entries, kh_get(mstrlabel, lc->entries, e->text));
+		FreeEntry(lc, e, true);
+	}
+}
+
+/* find the entry for some text, rendering it if it is not cached */
+static NV_LabelEntry* GetEntry(NV_LabelCache* lc, const char* text) {
+	NV_LabelEntry* e;
+	AG_Surface* s;
+	khint_t iter;
+	int r;
+
+	iter = kh_get(mstrlabel, lc->entries, text);
+	if (iter != kh_end(lc->entries)) {
+		e = kh_val(lc->entries, iter);
+		e->frame = lc->frame;
+		if (e != lc->head) {
+			Unlink(lc, e);
+			PushFront(lc, e);
+		}
+		return e;
+	}
+
+	s = AG_TextRender(text);
+
+	e = noctools_malloc(sizeof(NV_LabelEntry));
+	e->text = strdup(text);
+	e->w = s->w;
+	e->surface = AG_WidgetMapSurface(lc->widget, s);
+	e->frame = lc->frame;
+	PushFront(lc, e);
+
+	iter = kh_put(mstrlabel, lc->entries, e->text, &r);
+	kh_val(lc->entries, iter) = e;
+
+	Evict(lc);
+
+	return e;
+}
+
+/**
+ * @brief Draw some text, from cached surfaces where possible.
+ *
+ * Text without digits is drawn from a single surface. Otherwise, it is drawn
+ * one run at a time, from left to right, so that different numbers in the
+ * same label share the surfaces of their digits.
+ *
+ * @param lc
+ * @param text
+ * @param x left edge, in widget coordinates
+ * @param y top edge, in widget coordinates
+ */
+void NV_LabelCacheBlit(NV_LabelCache* lc, const char* text, int x, int y) {
+	char run[NV_LABEL_RUN_MAX + 1];
+	NV_LabelEntry* e;
+	size_t n;
+
+	/* runs can only be laid out on one line */
+	if (strpbrk(text, DIGITS) == NULL || strchr(text, '\n') != NULL) {
+		e = GetEntry(lc, text);
+		AG_WidgetBlitSurface(lc->widget, e->surface, x, y);
+		return;
+	}
+
+	while (*text != '\0') {
+		if (isdigit((unsigned char) *text)) {
+			n = 1;
+		} else {
+			n = strcspn(text, DIGITS);
+			if (n > NV_LABEL_RUN_MAX) {
+				/* back up to the start of a UTF-8 character, so
+				 * that none is split across runs, text which is
+				 * not UTF-8 is cut anywhere */
+				n = NV_LABEL_RUN_MAX;
+				while (n > 0 && ((unsigned char) text[n] & 0xC0) == 0x80) { n--; }
+				if (n == 0) { n = NV_LABEL_RUN_MAX; }
+			}
+		}
+
+		memcpy(run, text, n);
+		run[n] = '\0';
+		text += n;
+
+		e = GetEntry(lc, run);
+		AG_WidgetBlitSurface(lc->widget, e->surface, x, y);
+		x += e->w;
+	}
+}
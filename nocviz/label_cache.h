@@ -0,0 +1,68 @@
+#ifndef NOCVIZ_LABEL_CACHE_H
+#define NOCVIZ_LABEL_CACHE_H
+
+#include "../3rdparty/khash.h"
+#include "../common/util.h"
+
+#include <agar/core.h>
+#include <agar/gui.h>
+
+#include <stdbool.h>
+
+/******************************************************************************
+ *
+ * Cache of rendered label text, shared by every node and link drawn by one
+ * widget, so that labels with the same text share one surface rather than
+ * each mapping their own.
+ *
+ * Labels which contain digits, such as counters which change every tick, are
+ * composed from runs instead: each run of non-digits, and each digit, is
+ * rendered once and cached on it's own. A label whose numbers change then
+ * needs nothing new rendered, rather than a new surface for every value.
+ *
+ * The least recently used entries are unmapped once there are more than the
+ * cache's capacity, but never while they are still in use by the frame being
+ * drawn.
+ *
+ *****************************************************************************/
+
+/* default number of cached runs */
+#define NV_LABEL_CACHE_CAPACITY 4096
+
+typedef struct nv_label_entry_t {
+	char* text;
+	int surface;
+	int w;
+	unsigned long frame;	/* last frame which drew this entry */
+
+	/* least recently used order, most recent first */
+	struct nv_label_entry_t* prev;
+	struct nv_label_entry_t* next;
+} NV_LabelEntry;
+
+/* mapping of text to entries */
+KHASH_MAP_INIT_STR(mstrlabel, NV_LabelEntry*)
+
+typedef struct nv_label_cache_t {
+	void* widget;
+	khash_t(mstrlabel)* entries;
+	NV_LabelEntry* head;
+	NV_LabelEntry* tail;
+	unsigned int capacity;
+	unsigned long frame;
+} NV_LabelCache;
+
+/* create a cache of labels mapped to the given widget */
+NV_LabelCache* NV_LabelCacheNew(void* widget, unsigned int capacity);
+
+/* free the cache, unmapping it's surfaces only if unmap is true, since they
+ * are released along with the widget anyway */
+void NV_LabelCacheFree(NV_LabelCache* lc, bool unmap);
+
+/* start drawing a new frame */
+void NV_LabelCacheNextFrame(NV_LabelCache* lc);
+
+/* draw text with it's top left corner at x, y, rendering it if needed */
+void NV_LabelCacheBlit(NV_LabelCache* lc, const char* text, int x, int y);
+
+#endif
@@ -71,12 +71,17 @@ int nocviz_subcmd_link_directed(ClientData cdata, Tcl_Interp* interp, int objc,
 int nocviz_subcmd_link_curve(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_Obj *const objv[]) {
 	nocviz_graph* g = cdata;
 	nocviz_link* link;
+	int curve;
 
 	Tcl_RequireArgs(interp, 5, "link curve ID1 ID2 CURVE");
 
 	link = get_link_from_objs(interp, g, objv[2], objv[3]);
+	curve = get_int_from_obj(interp, objv[4]);
 
-	link->curve = get_int_from_obj(interp, objv[4]);
+	noctools_mutex_lock(g->mutex);
+	link->curve = curve;
+	__nocviz_graph_link_changed(g, link, NOCVIZ_CHANGE_MOVED);
+	noctools_mutex_unlock(g->mutex);
 
 	return TCL_OK;
 
@@ -166,39 +171,57 @@ int nocviz_subcmd_link_find(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_
 
 int nocviz_subcmd_link_match(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_Obj *const objv[]) {
 	nocviz_graph* g = cdata;
-	nocviz_link* link;
-	char* val;
+	nocviz_match m;
+	ptrvec items;
 	char* key;
-	char* pattern;
-	Tcl_Obj* listPtr;
 
-	Tcl_RequireArgs(interp, 4, "link direction KEY PATTERN");
+	if (objc < 4) {
+		Tcl_WrongNumArgs(interp, 0, objv, "link match " NOCVIZ_MATCH_ARGS);
+		return TCL_ERROR;
+	}
 
 	key = Tcl_GetString(objv[2]);
-	pattern = Tcl_GetString(objv[3]);
 
-	listPtr = Tcl_NewListObj(0, NULL);
+	if (nocviz_match_parse(interp, objc - 3, objv + 3, &m) != TCL_OK) {
+		return TCL_ERROR;
+	}
 
-	nocviz_graph_foreach_link(g, link,
-		val = nocviz_ds_get_kvp(link->ds, key);
-		if (val == NULL) { continue; }
-		dbprintf("checking match for key=%s val=%s\n", key, val);
-		if (tcl_regex_matches(interp, pattern, val)) {
-			dbprintf("\tmatched %s\n", pattern);
-			Tcl_ListObjAppendElement(interp, listPtr,
-				Tcl_NewStringObj(link->from->id, strlen(link->from->id)));
-			Tcl_ListObjAppendElement(interp, listPtr,
-				Tcl_NewStringObj(link->to->id, strlen(link->to->id)));
-		} else {
-			dbprintf("\tdid not match %s\n", pattern);
-		}
-	);
+	vec_init(&items);
 
-	Tcl_SetObjResult(interp, listPtr);
+	if (nocviz_match_items(interp, g, true, key, &m, &items) != TCL_OK) {
+		vec_deinit(&items);
+		return TCL_ERROR;
+	}
+
+	Tcl_SetObjResult(interp, nocviz_items_to_list(&items, true));
+	vec_deinit(&items);
 
 	return TCL_OK;
 }
 
+int nocviz_subcmd_link_top(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_Obj *const objv[]) {
+	nocviz_graph* g = cdata;
+	ptrvec items;
+	char* key;
+	int n;
+
+	Tcl_RequireArgs(interp, 4, "link top KEY N");
+
+	key = Tcl_GetString(objv[2]);
+	n = get_int_from_obj(interp, objv[3]);
+
+	vec_init(&items);
+	nocviz_top_items(g, true, key, n, &items);
+	Tcl_SetObjResult(interp, nocviz_items_to_list(&items, true));
+	vec_deinit(&items);
+
+	return TCL_OK;
+}
+
+int nocviz_subcmd_link_index(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_Obj *const objv[]) {
+	return nocviz_index_subcmd(interp, cdata, true, objc, objv);
+}
+
 int nocviz_subcmd_link_data(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_Obj *const objv[]) {
 	char* subcmd;
 
@@ -234,33 +257,28 @@ int nocviz_subcmd_link_data(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_
 int nocviz_subcmd_link_data_set(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_Obj *const objv[]) {
 	nocviz_graph* g = cdata;
 	nocviz_link* link;
-	char* key;
-	char* val;
-
-	Tcl_RequireArgs(interp, 7, "link data set ID1 ID2 KEY VAL");
+	char* type;
+	int first;
 
-	link = get_link_from_objs(interp, g, objv[3], objv[4]);
-
-	key = Tcl_GetString(objv[5]);
-	val = Tcl_GetString(objv[6]);
+	get_data_set_args(interp, 3, 4, "link data set " NOCVIZ_DATA_TYPES " ID1 ID2 KEY VAL", type, first);
 
-	nocviz_ds_set_kvp(link->ds, key, strdup(val));
+	link = get_link_from_objs(interp, g, objv[first], objv[first + 1]);
 
-	return TCL_OK;
+	return nocviz_data_set_value(interp, link->ds, type, Tcl_GetString(objv[first + 2]), objv[first + 3]);
 }
 
 int nocviz_subcmd_link_data_get(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_Obj *const objv[]) {
 	nocviz_graph* g = cdata;
 	nocviz_link* link;
 	char* key;
-	char* res;
+	Tcl_Obj* res;
 
 	Tcl_RequireArgs(interp, 6, "link data get ID1 ID2 KEY");
 
 	link = get_link_from_objs(interp, g, objv[3], objv[4]);
 	key = Tcl_GetString(objv[5]);
 
-	res = nocviz_ds_get_kvp(link->ds, key);
+	res = nocviz_data_get_value(link->ds, key);
 
 	if (res == NULL) {
 		Tcl_SetResultf(interp, "no such key '%s' for KVP of link '%s' <--> '%s'",
@@ -268,7 +286,7 @@ int nocviz_subcmd_link_data_get(ClientData cdata, Tcl_Interp* interp, int objc,
 		return TCL_ERROR;
 	}
 
-	Tcl_SetObjResult(interp, Tcl_NewStringObj(res, strlen(res)));
+	Tcl_SetObjResult(interp, res);
 
 	return TCL_OK;
 }
@@ -294,7 +312,7 @@ int nocviz_subcmd_link_data_keys(ClientData cdata, Tcl_Interp* interp, int objc,
 	nocviz_graph* g = cdata;
 	nocviz_link* link;
 	const char* key;
-	char* val;
+	nocviz_val* val;
 	Tcl_Obj* listPtr;
 
 	Tcl_RequireArgs(interp, 5, "node data keys ID1 ID2");
@@ -365,10 +383,12 @@ int nocviz_subcmd_link_title(ClientData cdata, Tcl_Interp* interp, int objc, Tcl
 	link = get_link_from_objs(interp, g, objv[2], objv[3]);
 	title = Tcl_GetString(objv[4]);
 
+	/* the GUI copies titles while holding the mutex */
+	noctools_mutex_lock(g->mutex);
 	free(link->title);
 	link->title = strdup(title);
-	link->surface_dirty = 1;
-	nocviz_graph_set_dirty(g, true);
+	__nocviz_graph_link_changed(g, link, NOCVIZ_CHANGE_TITLE);
+	noctools_mutex_unlock(g->mutex);
 
 	return TCL_OK;
 }
@@ -393,8 +413,10 @@ int nocviz_subcmd_link_color(ClientData cdata, Tcl_Interp* interp, int objc, Tcl
 		a = get_int_from_obj(interp, objv[7]);
 	}
 
+	noctools_mutex_lock(g->mutex);
 	AG_ColorRGBA_8(&l->c, r,gr,b, a);
-	nocviz_graph_color_set_dirty(g, true);
+	__nocviz_graph_link_changed(g, l, NOCVIZ_CHANGE_COLOR);
+	noctools_mutex_unlock(g->mutex);
 
 	return TCL_OK;
 }
@@ -42,6 +42,7 @@ Nocviz_Init(Tcl_Interp *interp)
 	Tcl_CreateObjCommand(interp, "nocviz::launch_gui", nocviz_command_launch_gui, h, NULL);
 	Tcl_CreateObjCommand(interp, "nocviz::op", nocviz_command_op, g, NULL);
 	Tcl_CreateObjCommand(interp, "nocviz::data", nocviz_command_data, g, NULL);
+	Tcl_CreateObjCommand(interp, "nocviz::render", nocviz_command_render, g, NULL);
 	Tcl_PkgProvide(interp, "nocviz", NOC_TOOLS_VERSION);
 	return TCL_OK;
 }
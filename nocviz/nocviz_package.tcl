@@ -10,6 +10,7 @@ namespace eval ::nocviz {
 	namespace export node
 	namespace export link
 	namespace export launch_gui
+	namespace export render
 	namespace export rgb_interp
 
 }
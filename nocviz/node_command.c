@@ -61,8 +61,10 @@ int nocviz_subcmd_node_row(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_O
 		return TCL_ERROR;
 	}
 
+	noctools_mutex_lock(g->mutex);
 	n->row = row;
-	nocviz_graph_set_dirty(g, true);
+	__nocviz_graph_node_changed(g, n, NOCVIZ_CHANGE_MOVED);
+	noctools_mutex_unlock(g->mutex);
 
 	return TCL_OK;
 }
@@ -85,8 +87,10 @@ int nocviz_subcmd_node_col(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_O
 		return TCL_ERROR;
 	}
 
+	noctools_mutex_lock(g->mutex);
 	n->col = col;
-	nocviz_graph_set_dirty(g, true);
+	__nocviz_graph_node_changed(g, n, NOCVIZ_CHANGE_MOVED);
+	noctools_mutex_unlock(g->mutex);
 
 	return TCL_OK;
 }
@@ -109,10 +113,12 @@ int nocviz_subcmd_node_title(ClientData cdata, Tcl_Interp* interp, int objc, Tcl
 		return TCL_ERROR;
 	}
 
+	/* the GUI copies titles while holding the mutex */
+	noctools_mutex_lock(g->mutex);
 	free(n->title);
 	n->title = strdup(title);
-	n->surface_dirty = 1;
-	nocviz_graph_set_dirty(g, true);
+	__nocviz_graph_node_changed(g, n, NOCVIZ_CHANGE_TITLE);
+	noctools_mutex_unlock(g->mutex);
 
 	return TCL_OK;
 }
@@ -153,14 +159,12 @@ int nocviz_subcmd_node_data_set(ClientData cdata, Tcl_Interp* interp, int objc,
 	nocviz_graph* g = cdata;
 	char* id;
 	nocviz_node* n;
-	char* key;
-	char* val;
+	char* type;
+	int first;
 
-	Tcl_RequireArgs(interp, 6, "node data set ID KEY VAL");
+	get_data_set_args(interp, 3, 3, "node data set " NOCVIZ_DATA_TYPES " ID KEY VAL", type, first);
 
-	id = Tcl_GetString(objv[3]);
-	key = Tcl_GetString(objv[4]);
-	val = Tcl_GetString(objv[5]);
+	id = Tcl_GetString(objv[first]);
 
 	n = nocviz_graph_get_node(g, id);
 
@@ -169,9 +173,7 @@ int nocviz_subcmd_node_data_set(ClientData cdata, Tcl_Interp* interp, int objc,
 		return TCL_ERROR;
 	}
 
-	nocviz_ds_set_kvp(n->ds, key, strdup(val));
-
-	return TCL_OK;
+	return nocviz_data_set_value(interp, n->ds, type, Tcl_GetString(objv[first + 1]), objv[first + 2]);
 }
 
 int nocviz_subcmd_node_data_get(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_Obj *const objv[]) {
@@ -179,7 +181,7 @@ int nocviz_subcmd_node_data_get(ClientData cdata, Tcl_Interp* interp, int objc,
 	char* id;
 	nocviz_node* n;
 	char* key;
-	char* res;
+	Tcl_Obj* res;
 
 	Tcl_RequireArgs(interp, 5, "node data get ID KEY");
 
@@ -193,15 +195,15 @@ int nocviz_subcmd_node_data_get(ClientData cdata, Tcl_Interp* interp, int objc,
 		return TCL_ERROR;
 	}
 
-	res = nocviz_ds_get_kvp(n->ds, key);
+	res = nocviz_data_get_value(n->ds, key);
 
 	if (res == NULL) {
 		Tcl_SetResultf(interp, "no such key '%s' for KVP of node '%s'", key, id);
 		return TCL_ERROR;
 	}
 
-	dbprintf("KVP of key %s at node %s is %s\n", key, id, res);
-	Tcl_SetObjResult(interp, Tcl_NewStringObj(res, strlen(res)));
+	dbprintf("KVP of key %s at node %s is %s\n", key, id, Tcl_GetString(res));
+	Tcl_SetObjResult(interp, res);
 
 	return TCL_OK;
 }
@@ -236,7 +238,7 @@ int nocviz_subcmd_node_data_keys(ClientData cdata, Tcl_Interp* interp, int objc,
 	char* id;
 	nocviz_node* n;
 	const char* key;
-	char* val;
+	nocviz_val* val;
 	Tcl_Obj* listPtr;
 
 	Tcl_RequireArgs(interp, 4, "node data keys ID");
@@ -321,34 +323,55 @@ int nocviz_subcmd_node_list(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_
 
 int nocviz_subcmd_node_match(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_Obj *const objv[]) {
 	nocviz_graph* g = cdata;
-	nocviz_node* node;
-	Tcl_Obj* listPtr;
-	char* val;
+	nocviz_match m;
+	ptrvec items;
 	char* key;
-	char* pattern;
 
-	Tcl_RequireArgs(interp, 4, "node match KEY PATTERN");
+	if (objc < 4) {
+		Tcl_WrongNumArgs(interp, 0, objv, "node match " NOCVIZ_MATCH_ARGS);
+		return TCL_ERROR;
+	}
 
 	key = Tcl_GetString(objv[2]);
-	pattern = Tcl_GetString(objv[3]);
 
-	listPtr = Tcl_NewListObj(0, NULL);
+	if (nocviz_match_parse(interp, objc - 3, objv + 3, &m) != TCL_OK) {
+		return TCL_ERROR;
+	}
 
-	nocviz_graph_foreach_node(g, node,
-		val = nocviz_ds_get_kvp(node->ds, key);
-		if (val == NULL) {continue;}
-		dbprintf("checking match for key=%s val=%s\n", key, val);
-		if (tcl_regex_matches(interp, pattern, val)) {
-			dbprintf("\tmatched %s\n", pattern);
-			Tcl_ListObjAppendElement(interp, listPtr,
-				Tcl_NewStringObj(node->id, strlen(node->id)));
-		}
-	);
+	vec_init(&items);
 
-	Tcl_SetObjResult(interp, listPtr);
+	if (nocviz_match_items(interp, g, false, key, &m, &items) != TCL_OK) {
+		vec_deinit(&items);
+		return TCL_ERROR;
+	}
+
+	Tcl_SetObjResult(interp, nocviz_items_to_list(&items, false));
+	vec_deinit(&items);
 
 	return TCL_OK;
+}
+
+int nocviz_subcmd_node_top(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_Obj *const objv[]) {
+	nocviz_graph* g = cdata;
+	ptrvec items;
+	char* key;
+	int n;
+
+	Tcl_RequireArgs(interp, 4, "node top KEY N");
+
+	key = Tcl_GetString(objv[2]);
+	n = get_int_from_obj(interp, objv[3]);
+
+	vec_init(&items);
+	nocviz_top_items(g, false, key, n, &items);
+	Tcl_SetObjResult(interp, nocviz_items_to_list(&items, false));
+	vec_deinit(&items);
+
+	return TCL_OK;
+}
 
+int nocviz_subcmd_node_index(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_Obj *const objv[]) {
+	return nocviz_index_subcmd(interp, cdata, false, objc, objv);
 }
 
 int nocviz_subcmd_node_op(ClientData cdata, Tcl_Interp* interp, int objc, Tcl_Obj *const objv[]) {
@@ -385,8 +408,10 @@ int nocviz_subcmd_node_color(ClientData cdata, Tcl_Interp* interp, int objc, Tcl
 		a = get_int_from_obj(interp, objv[6]);
 	}
 
+	noctools_mutex_lock(g->mutex);
 	AG_ColorRGBA_8(&n->c, r,gr,b, a);
-	nocviz_graph_color_set_dirty(g, true);
+	__nocviz_graph_node_changed(g, n, NOCVIZ_CHANGE_COLOR);
+	noctools_mutex_unlock(g->mutex);
 
 	return TCL_OK;
 }
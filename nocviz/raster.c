@@ -0,0 +1,575 @@
+#include "raster.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*** CANVAS ******************************************************************/
+
+nocviz_raster* nocviz_raster_init(int w, int h, nocviz_rgba bg) {
+	nocviz_raster* rs;
+	size_t n = (size_t) w * (size_t) h;
+
+	rs = noctools_malloc(sizeof(nocviz_raster));
+	if (rs == NULL) { return NULL; }
+	rs->w = w;
+	rs->h = h;
+	rs->px = noctools_malloc(n * 3);
+	if (rs->px == NULL) {
+		free(rs);
+		return NULL;
+	}
+
+	for (size_t i = 0 ; i < n ; i++) {
+		rs->px[i * 3] = bg.r;
+		rs->px[i * 3 + 1] = bg.g;
+		rs->px[i * 3 + 2] = bg.b;
+	}
+
+	return rs;
+}
+
+void nocviz_raster_free(nocviz_raster* rs) {
+	free(rs->px);
+	free(rs);
+}
+
+#define blend(dst, src, a) \
+	((uint8_t) (((src) * (a) + (dst) * (255 - (a)) + 127) / 255))
+
+/* blend a single pixel, which must be on the canvas */
+static inline void Plot(nocviz_raster* rs, int x, int y, nocviz_rgba c) {
+	uint8_t* p = &rs->px[((size_t) y * rs->w + x) * 3];
+
+	if (c.a == 255) {
+		p[0] = c.r;
+		p[1] = c.g;
+		p[2] = c.b;
+		return;
+	}
+	p[0] = blend(p[0], c.r, c.a);
+	p[1] = blend(p[1], c.g, c.a);
+	p[2] = blend(p[2], c.b, c.a);
+}
+
+void nocviz_raster_fill_rect(nocviz_raster* rs, int x, int y, int w, int h, nocviz_rgba c) {
+	int x1 = x + w;
+	int y1 = y + h;
+
+	if (x < 0) { x = 0; }
+	if (y < 0) { y = 0; }
+	if (x1 > rs->w) { x1 = rs->w; }
+	if (y1 > rs->h) { y1 = rs->h; }
+	if (c.a == 0) { return; }
+
+	for (int j = y ; j < y1 ; j++) {
+		for (int i = x ; i < x1 ; i++) {
+			Plot(rs, i, j, c);
+		}
+	}
+}
+
+/* Clip a line to the canvas (Liang-Barsky), so that lines which extend far
+ * past the edges do not cost anything to draw. Returns false if none of the
+ * line is on the canvas. */
+static bool ClipLine(nocviz_raster* rs, double* x0, double* y0, double* x1, double* y1) {
+	double dx = *x1 - *x0;
+	double dy = *y1 - *y0;
+	double p[4] = {-dx, dx, -dy, dy};
+	double q[4] = {*x0, rs->w - 1 - *x0, *y0, rs->h - 1 - *y0};
+	double t0 = 0;
+	double t1 = 1;
+	double t;
+
+	for (int i = 0 ; i < 4 ; i++) {
+		if (p[i] == 0) {
+			if (q[i] < 0) { return false; }
+			continue;
+		}
+		t = q[i] / p[i];
+		if (p[i] < 0) {
+			if (t > t1) { return false; }
+			if (t > t0) { t0 = t; }
+		} else {
+			if (t < t0) { return false; }
+			if (t < t1) { t1 = t; }
+		}
+	}
+
+	*x1 = *x0 + t1 * dx;
+	*y1 = *y0 + t1 * dy;
+	*x0 = *x0 + t0 * dx;
+	*y0 = *y0 + t0 * dy;
+	return true;
+}
+
+void nocviz_raster_line(nocviz_raster* rs, int x0, int y0, int x1, int y1, nocviz_rgba c) {
+	double cx0 = x0, cy0 = y0, cx1 = x1, cy1 = y1;
+	int dx, dy, sx, sy, err, e2;
+
+	if (c.a == 0 || !ClipLine(rs, &cx0, &cy0, &cx1, &cy1)) { return; }
+	x0 = (int) (cx0 + 0.5);
+	y0 = (int) (cy0 + 0.5);
+	x1 = (int) (cx1 + 0.5);
+	y1 = (int) (cy1 + 0.5);
+
+	dx = abs(x1 - x0);
+	dy = -abs(y1 - y0);
+	sx = x0 < x1 ? 1 : -1;
+	sy = y0 < y1 ? 1 : -1;
+	err = dx + dy;
+
+	for (;;) {
+		if (x0 >= 0 && x0 < rs->w && y0 >= 0 && y0 < rs->h) {
+			Plot(rs, x0, y0, c);
+		}
+		if (x0 == x1 && y0 == y1) { break; }
+		e2 = 2 * err;
+		if (e2 >= dy) { err += dy; x0 += sx; }
+		if (e2 <= dx) { err += dx; y0 += sy; }
+	}
+}
+
+/*** TEXT ********************************************************************/
+
+/* 5x7 glyphs for ' ' to '~', one byte per row, with the leftmost column in
+ * bit 4 */
+static const uint8_t font[95][7] = {
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00 },	/*   */
+	{ 0x04, 0x04, 0x04, 0x04, 0x04, 0x00, 0x04 },	/* ! */
+	{ 0x0a, 0x0a, 0x0a, 0x00, 0x00, 0x00, 0x00 },	/* " */
+	{ 0x0a, 0x0a, 0x1f, 0x0a, 0x1f, 0x0a, 0x0a },	/* # */
+	{ 0x04, 0x0f, 0x14, 0x0e, 0x05, 0x1e, 0x04 },	/* $ */
+	{ 0x18, 0x19, 0x02, 0x04, 0x08, 0x13, 0x03 },	/* % */
+	{ 0x0c, 0x12, 0x14, 0x08, 0x15, 0x12, 0x0d },	/* & */
+	{ 0x04, 0x04, 0x08, 0x00, 0x00, 0x00, 0x00 },	/* ' */
+	{ 0x02, 0x04, 0x08, 0x08, 0x08, 0x04, 0x02 },	/* ( */
+	{ 0x08, 0x04, 0x02, 0x02, 0x02, 0x04, 0x08 },	/* ) */
+	{ 0x00, 0x04, 0x15, 0x0e, 0x15, 0x04, 0x00 },	/* * */
+	{ 0x00, 0x04, 0x04, 0x1f, 0x04, 0x04, 0x00 },	/* + */
+	{ 0x00, 0x00, 0x00, 0x00, 0x0c, 0x04, 0x08 },	/* , */
+	{ 0x00, 0x00, 0x00, 0x1f, 0x00, 0x00, 0x00 },	/* - */
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x0c, 0x0c },	/* . */
+	{ 0x00, 0x01, 0x02, 0x04, 0x08, 0x10, 0x00 },	/* / */
+	{ 0x0e, 0x11, 0x13, 0x15, 0x19, 0x11, 0x0e },	/* 0 */
+	{ 0x04, 0x0c, 0x04, 0x04, 0x04, 0x04, 0x0e },	/* 1 */
+	{ 0x0e, 0x11, 0x01, 0x02, 0x04, 0x08, 0x1f },	/* 2 */
+	{ 0x1f, 0x02, 0x04, 0x02, 0x01, 0x11, 0x0e },	/* 3 */
+	{ 0x02, 0x06, 0x0a, 0x12, 0x1f, 0x02, 0x02 },	/* 4 */
+	{ 0x1f, 0x10, 0x1e, 0x01, 0x01, 0x11, 0x0e },	/* 5 */
+	{ 0x06, 0x08, 0x10, 0x1e, 0x11, 0x11, 0x0e },	/* 6 */
+	{ 0x1f, 0x01, 0x02, 0x04, 0x08, 0x08, 0x08 },	/* 7 */
+	{ 0x0e, 0x11, 0x11, 0x0e, 0x11, 0x11, 0x0e },	/* 8 */
+	{ 0x0e, 0x11, 0x11, 0x0f, 0x01, 0x02, 0x0c },	/* 9 */
+	{ 0x00, 0x0c, 0x0c, 0x00, 0x0c, 0x0c, 0x00 },	/* : */
+	{ 0x00, 0x0c, 0x0c, 0x00, 0x0c, 0x04, 0x08 },	/* ; */
+	{ 0x02, 0x04, 0x08, 0x10, 0x08, 0x04, 0x02 },	/* < */
+	{ 0x00, 0x00, 0x1f, 0x00, 0x1f, 0x00, 0x00 },	/* = */
+	{ 0x08, 0x04, 0x02, 0x01, 0x02, 0x04, 0x08 },	/* > */
+	{ 0x0e, 0x11, 0x01, 0x02, 0x04, 0x00, 0x04 },	/* ? */
+	{ 0x0e, 0x11, 0x01, 0x0d, 0x15, 0x15, 0x0e },	/* @ */
+	{ 0x0e, 0x11, 0x11, 0x11, 0x1f, 0x11, 0x11 },	/* A */
+	{ 0x1e, 0x11, 0x11, 0x1e, 0x11, 0x11, 0x1e },	/* B */
+	{ 0x0e, 0x11, 0x10, 0x10, 0x10, 0x11, 0x0e },	/* C */
+	{ 0x1c, 0x12, 0x11, 0x11, 0x11, 0x12, 0x1c },	/* D */
+	{ 0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x1f },	/* E */
+	{ 0x1f, 0x10, 0x10, 0x1e, 0x10, 0x10, 0x10 },	/* F */
+	{ 0x0e, 0x11, 0x10, 0x17, 0x11, 0x11, 0x0f },	/* G */
+	{ 0x11, 0x11, 0x11, 0x1f, 0x11, 0x11, 0x11 },	/* H */
+	{ 0x0e, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0e },	/* I */
+	{ 0x07, 0x02, 0x02, 0x02, 0x02, 0x12, 0x0c },	/* J */
+	{ 0x11, 0x12, 0x14, 0x18, 0x14, 0x12, 0x11 },	/* K */
+	{ 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x1f },	/* L */
+	{ 0x11, 0x1b, 0x15, 0x15, 0x11, 0x11, 0x11 },	/* M */
+	{ 0x11, 0x11, 0x19, 0x15, 0x13, 0x11, 0x11 },	/* N */
+	{ 0x0e, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0e },	/* O */
+	{ 0x1e, 0x11, 0x11, 0x1e, 0x10, 0x10, 0x10 },	/* P */
+	{ 0x0e, 0x11, 0x11, 0x11, 0x15, 0x12, 0x0d },	/* Q */
+	{ 0x1e, 0x11, 0x11, 0x1e, 0x14, 0x12, 0x11 },	/* R */
+	{ 0x0f, 0x10, 0x10, 0x0e, 0x01, 0x01, 0x1e },	/* S */
+	{ 0x1f, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 },	/* T */
+	{ 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x0e },	/* U */
+	{ 0x11, 0x11, 0x11, 0x11, 0x11, 0x0a, 0x04 },	/* V */
+	{ 0x11, 0x11, 0x11, 0x15, 0x15, 0x15, 0x0a },	/* W */
+	{ 0x11, 0x11, 0x0a, 0x04, 0x0a, 0x11, 0x11 },	/* X */
+	{ 0x11, 0x11, 0x11, 0x0a, 0x04, 0x04, 0x04 },	/* Y */
+	{ 0x1f, 0x01, 0x02, 0x04, 0x08, 0x10, 0x1f },	/* Z */
+	{ 0x0e, 0x08, 0x08, 0x08, 0x08, 0x08, 0x0e },	/* [ */
+	{ 0x00, 0x10, 0x08, 0x04, 0x02, 0x01, 0x00 },	/* backslash */
+	{ 0x0e, 0x02, 0x02, 0x02, 0x02, 0x02, 0x0e },	/* ] */
+	{ 0x04, 0x0a, 0x11, 0x00, 0x00, 0x00, 0x00 },	/* ^ */
+	{ 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1f },	/* _ */
+	{ 0x08, 0x04, 0x02, 0x00, 0x00, 0x00, 0x00 },	/* ` */
+	{ 0x00, 0x00, 0x0e, 0x01, 0x0f, 0x11, 0x0f },	/* a */
+	{ 0x10, 0x10, 0x16, 0x19, 0x11, 0x11, 0x1e },	/* b */
+	{ 0x00, 0x00, 0x0e, 0x10, 0x10, 0x11, 0x0e },	/* c */
+	{ 0x01, 0x01, 0x0d, 0x13, 0x11, 0x11, 0x0f },	/* d */
+	{ 0x00, 0x00, 0x0e, 0x11, 0x1f, 0x10, 0x0e },	/* e */
+	{ 0x06, 0x09, 0x08, 0x1c, 0x08, 0x08, 0x08 },	/* f */
+	{ 0x00, 0x0f, 0x11, 0x11, 0x0f, 0x01, 0x0e },	/* g */
+	{ 0x10, 0x10, 0x16, 0x19, 0x11, 0x11, 0x11 },	/* h */
+	{ 0x04, 0x00, 0x0c, 0x04, 0x04, 0x04, 0x0e },	/* i */
+	{ 0x02, 0x00, 0x06, 0x02, 0x02, 0x12, 0x0c },	/* j */
+	{ 0x10, 0x10, 0x12, 0x14, 0x18, 0x14, 0x12 },	/* k */
+	{ 0x0c, 0x04, 0x04, 0x04, 0x04, 0x04, 0x0e },	/* l */
+	{ 0x00, 0x00, 0x1a, 0x15, 0x15, 0x11, 0x11 },	/* m */
+	{ 0x00, 0x00, 0x16, 0x19, 0x11, 0x11, 0x11 },	/* n */
+	{ 0x00, 0x00, 0x0e, 0x11, 0x11, 0x11, 0x0e },	/* o */
+	{ 0x00, 0x00, 0x1e, 0x11, 0x1e, 0x10, 0x10 },	/* p */
+	{ 0x00, 0x00, 0x0d, 0x13, 0x0f, 0x01, 0x01 },	/* q */
+	{ 0x00, 0x00, 0x16, 0x19, 0x10, 0x10, 0x10 },	/* r */
+	{ 0x00, 0x00, 0x0e, 0x10, 0x0e, 0x01, 0x1e },	/* s */
+	{ 0x08, 0x08, 0x1c, 0x08, 0x08, 0x09, 0x06 },	/* t */
+	{ 0x00, 0x00, 0x11, 0x11, 0x11, 0x13, 0x0d },	/* u */
+	{ 0x00, 0x00, 0x11, 0x11, 0x11, 0x0a, 0x04 },	/* v */
+	{ 0x00, 0x00, 0x11, 0x11, 0x15, 0x15, 0x0a },	/* w */
+	{ 0x00, 0x00, 0x11, 0x0a, 0x04, 0x0a, 0x11 },	/* x */
+	{ 0x00, 0x00, 0x11, 0x11, 0x0f, 0x01, 0x0e },	/* y */
+	{ 0x00, 0x00, 0x1f, 0x02, 0x04, 0x08, 0x1f },	/* z */
+	{ 0x02, 0x04, 0x04, 0x08, 0x04, 0x04, 0x02 },	/* { */
+	{ 0x04, 0x04, 0x04, 0x04, 0x04, 0x04, 0x04 },	/* | */
+	{ 0x08, 0x04, 0x04, 0x02, 0x04, 0x04, 0x08 },	/* } */
+	{ 0x00, 0x00, 0x08, 0x15, 0x02, 0x00, 0x00 },	/* ~ */
+};
+
+void nocviz_raster_text(nocviz_raster* rs, int x, int y, const char* text, nocviz_rgba c) {
+	const uint8_t* glyph;
+	int x0 = x;
+	int ch;
+
+	for ( ; *text != '\0' ; text++) {
+		ch = (unsigned char) *text;
+		if (ch == '\n') {
+			x = x0;
+			y += NOCVIZ_RASTER_CHAR_H;
+			continue;
+		}
+		if (ch < ' ' || ch > '~') { ch = '?'; }
+
+		/* skip characters entirely off of the canvas */
+		if (x + 5 > 0 && x < rs->w && y + 7 > 0 && y < rs->h) {
+			glyph = font[ch - ' '];
+			for (int j = 0 ; j < 7 ; j++) {
+				for (int i = 0 ; i < 5 ; i++) {
+					if (!(glyph[j] & (0x10 >> i))) { continue; }
+					if (x + i < 0 || x + i >= rs->w) { continue; }
+					if (y + j < 0 || y + j >= rs->h) { continue; }
+					Plot(rs, x + i, y + j, c);
+				}
+			}
+		}
+		x += NOCVIZ_RASTER_CHAR_W;
+	}
+}
+
+/*** PNG ENCODING ************************************************************/
+
+/* deflate parameters */
+#define WINDOW_SIZE 32768
+#define HASH_BITS 15
+#define HASH_SIZE (1 << HASH_BITS)
+#define MAX_CHAIN 16
+#define MIN_MATCH 3
+#define MAX_MATCH 258
+
+static const uint16_t length_base[29] = {
+	3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+	35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+};
+static const uint8_t length_extra[29] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+	3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+};
+static const uint16_t dist_base[30] = {
+	1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+	257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289,
+	16385, 24577
+};
+static const uint8_t dist_extra[30] = {
+	0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+	7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+};
+
+typedef struct png_buf_t {
+	uint8_t* data;
+	size_t len;
+	size_t cap;
+	uint32_t bits;	/* pending bits, least significant first */
+	int nbits;
+	bool failed;	/* set once the buffer could not grow, later bytes are dropped */
+} png_buf;
+
+static void PutByte(png_buf* b, uint8_t v) {
+	uint8_t* data;
+
+	if (b->failed) { return; }
+	if (b->len == b->cap) {
+		data = realloc(b->data, b->cap * 2 + 256);
+		if (data == NULL) {
+			b->failed = true;
+			return;
+		}
+		b->data = data;
+		b->cap = b->cap * 2 + 256;
+	}
+	b->data[b->len++] = v;
+}
+
+static void PutU32(png_buf* b, uint32_t v) {
+	PutByte(b, v >> 24);
+	PutByte(b, v >> 16);
+	PutByte(b, v >> 8);
+	PutByte(b, v);
+}
+
+static void PutBits(png_buf* b, uint32_t v, int n) {
+	b->bits |= v << b->nbits;
+	b->nbits += n;
+	while (b->nbits >= 8) {
+		PutByte(b, b->bits & 0xff);
+		b->bits >>= 8;
+		b->nbits -= 8;
+	}
+}
+
+static void FlushBits(png_buf* b) {
+	if (b->nbits > 0) { PutByte(b, b->bits & 0xff); }
+	b->bits = 0;
+	b->nbits = 0;
+}
+
+/* Huffman codes are packed starting from their most significant bit */
+static void PutCode(png_buf* b, uint32_t code, int n) {
+	uint32_t r = 0;
+
+	for (int i = 0 ; i < n ; i++) {
+		r = (r << 1) | ((code >> i) & 1);
+	}
+	PutBits(b, r, n);
+}
+
+/* a literal or length symbol, from the fixed Huffman code */
+static void PutSymbol(png_buf* b, int v) {
+	if (v < 144) {
+		PutCode(b, 0x30 + v, 8);
+	} else if (v < 256) {
+		PutCode(b, 0x190 + v - 144, 9);
+	} else if (v < 280) {
+		PutCode(b, v - 256, 7);
+	} else {
+		PutCode(b, 0xc0 + v - 280, 8);
+	}
+}
+
+static void PutMatch(png_buf* b, int len, int dist) {
+	int i;
+
+	for (i = 28 ; length_base[i] > len ; i--) ;
+	PutSymbol(b, 257 + i);
+	PutBits(b, len - length_base[i], length_extra[i]);
+
+	for (i = 29 ; dist_base[i] > dist ; i--) ;
+	PutCode(b, i, 5);
+	PutBits(b, dist - dist_base[i], dist_extra[i]);
+}
+
+#define hash3(p) ((((p)[0] << 10) ^ ((p)[1] << 5) ^ (p)[2]) & (HASH_SIZE - 1))
+
+/* compress data as a zlib stream, in a single block of fixed Huffman codes,
+ * returning false if the match tables cannot be allocated */
+static bool Deflate(png_buf* b, const uint8_t* data, size_t n) {
+	int32_t* head;
+	int32_t* prev;
+	uint32_t s1 = 1;
+	uint32_t s2 = 0;
+	size_t i = 0;
+	size_t best;
+	size_t bestdist;
+	size_t max;
+	size_t len;
+	int32_t cand;
+	int chain;
+
+	head = noctools_malloc(HASH_SIZE * sizeof(int32_t));
+	prev = noctools_malloc(WINDOW_SIZE * sizeof(int32_t));
+	if (head == NULL || prev == NULL) {
+		free(head);
+		free(prev);
+		return false;
+	}
+	for (int k = 0 ; k < HASH_SIZE ; k++) { head[k] = -1; }
+
+	/* zlib header, 32K window and no dictionary */
+	PutByte(b, 0x78);
+	PutByte(b, 0x01);
+
+	/* final block, fixed codes */
+	PutBits(b, 1, 1);
+	PutBits(b, 1, 2);
+
+	while (i < n) {
+		best = 0;
+		bestdist = 0;
+
+		if (i + MIN_MATCH <= n) {
+			max = n - i < MAX_MATCH ? n - i : MAX_MATCH;
+			cand = head[hash3(&data[i])];
+			for (chain = 0 ; chain < MAX_CHAIN && cand >= 0 ; chain++) {
+				if (i - cand > WINDOW_SIZE) { break; }
+				for (len = 0 ; len < max && data[cand + len] == data[i + len] ; len++) ;
+				if (len > best) {
+					best = len;
+					bestdist = i - cand;
+					if (len == max) { break; }
+				}
+				cand = prev[cand & (WINDOW_SIZE - 1)];
+			}
+		}
+
+		if (best < MIN_MATCH) {
+			best = 1;
+			PutSymbol(b, data[i]);
+		} else {
+			PutMatch(b, best, bestdist);
+		}
+
+		for (size_t k = i ; k < i + best ; k++) {
+			if (k + MIN_MATCH <= n) {
+				prev[k & (WINDOW_SIZE - 1)] = head[hash3(&data[k])];
+				head[hash3(&data[k])] = k;
+			}
+		}
+		i += best;
+	}
+
+	PutSymbol(b, 256);
+	FlushBits(b);
+
+	/* adler32 of the uncompressed data */
+	for (i = 0 ; i < n ; i++) {
+		s1 = (s1 + data[i]) % 65521;
+		s2 = (s2 + s1) % 65521;
+	}
+	PutU32(b, (s2 << 16) | s1);
+
+	free(head);
+	free(prev);
+
+	return true;
+}
+
+static uint32_t Crc32(const uint32_t* table, uint32_t crc, const uint8_t* data, size_t n) {
+	for (size_t i = 0 ; i < n ; i++) {
+		crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+	}
+	return crc;
+}
+
+/* append a chunk whose data is already at the end of the buffer */
+static void EndChunk(png_buf* b, const uint32_t* table, size_t start) {
+	size_t n = b->len - start - 8;
+	uint32_t crc;
+
+	if (b->failed) { return; }
+
+	b->data[start] = n >> 24;
+	b->data[start + 1] = n >> 16;
+	b->data[start + 2] = n >> 8;
+	b->data[start + 3] = n;
+
+	/* covers the type and the data */
+	crc = Crc32(table, 0xffffffff, &b->data[start + 4], n + 4);
+	PutU32(b, crc ^ 0xffffffff);
+}
+
+static size_t BeginChunk(png_buf* b, const char* type) {
+	size_t start = b->len;
+
+	PutU32(b, 0);
+	for (int i = 0 ; i < 4 ; i++) { PutByte(b, type[i]); }
+	return start;
+}
+
+uint8_t* nocviz_raster_encode_png(nocviz_raster* rs, size_t* len) {
+	static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+	uint32_t table[256];
+	png_buf b = {NULL, 0, 0, 0, 0, false};
+	size_t stride = (size_t) rs->w * 3;
+	uint8_t* raw;
+	size_t start;
+	uint32_t c;
+
+	for (uint32_t i = 0 ; i < 256 ; i++) {
+		c = i;
+		for (int k = 0 ; k < 8 ; k++) {
+			c = (c & 1) ? 0xedb88320 ^ (c >> 1) : c >> 1;
+		}
+		table[i] = c;
+	}
+
+	for (int i = 0 ; i < 8 ; i++) { PutByte(&b, signature[i]); }
+
+	/* 8 bit RGB, not interlaced */
+	start = BeginChunk(&b, "IHDR");
+	PutU32(&b, rs->w);
+	PutU32(&b, rs->h);
+	PutByte(&b, 8);
+	PutByte(&b, 2);
+	PutByte(&b, 0);
+	PutByte(&b, 0);
+	PutByte(&b, 0);
+	EndChunk(&b, table, start);
+
+	/* every row is unfiltered, flat areas compress just as well without */
+	raw = noctools_malloc((stride + 1) * rs->h);
+	if (raw == NULL) {
+		free(b.data);
+		errno = ENOMEM;
+		return NULL;
+	}
+	for (int y = 0 ; y < rs->h ; y++) {
+		raw[y * (stride + 1)] = 0;
+		memcpy(&raw[y * (stride + 1) + 1], &rs->px[y * stride], stride);
+	}
+
+	start = BeginChunk(&b, "IDAT");
+	if (!Deflate(&b, raw, (stride + 1) * rs->h)) { b.failed = true; }
+	EndChunk(&b, table, start);
+	free(raw);
+
+	start = BeginChunk(&b, "IEND");
+	EndChunk(&b, table, start);
+
+	if (b.failed) {
+		free(b.data);
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	*len = b.len;
+	return b.data;
+}
+
+bool nocviz_raster_write_png(nocviz_raster* rs, const char* path) {
+	uint8_t* data;
+	size_t len;
+	FILE* f;
+	bool ok;
+
+	/* encoded first, so that a file is not left empty if it fails */
+	data = nocviz_raster_encode_png(rs, &len);
+	if (data == NULL) { return false; }
+
+	f = fopen(path, "wb");
+	if (f == NULL) {
+		free(data);
+		return false;
+	}
+
+	ok = fwrite(data, 1, len, f) == len;
+	ok = (fclose(f) == 0) && ok;
+	free(data);
+
+	return ok;
+}
@@ -0,0 +1,64 @@
+#ifndef NOCVIZ_RASTER_H
+#define NOCVIZ_RASTER_H
+
+#include "../common/util.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/******************************************************************************
+ *
+ * A minimal software rasterizer, used to draw the graph without a display
+ * (see render.h). It draws blended rectangles, one pixel wide lines, and text
+ * in a built in 5x7 bitmap font onto an opaque RGB canvas, which can then be
+ * encoded as a PNG.
+ *
+ * The PNG encoder is self contained, compressing with fixed Huffman codes and
+ * a small LZ77 matcher, which does well enough on the large flat areas of a
+ * rendered graph without needing zlib or libpng.
+ *
+ *****************************************************************************/
+
+/* size of a character cell of the font, including spacing */
+#define NOCVIZ_RASTER_CHAR_W 6
+#define NOCVIZ_RASTER_CHAR_H 9
+
+typedef struct nocviz_rgba_t {
+	uint8_t r;
+	uint8_t g;
+	uint8_t b;
+	uint8_t a;
+} nocviz_rgba;
+
+typedef struct nocviz_raster_t {
+	int w;
+	int h;
+	uint8_t* px;	/* 3 bytes per pixel, row major */
+} nocviz_raster;
+
+/* create a canvas filled with the given color, whose alpha is ignored, or
+ * NULL if it cannot be allocated */
+nocviz_raster* nocviz_raster_init(int w, int h, nocviz_rgba bg);
+
+void nocviz_raster_free(nocviz_raster* rs);
+
+/* blend a color over a rectangle, clipped to the canvas */
+void nocviz_raster_fill_rect(nocviz_raster* rs, int x, int y, int w, int h, nocviz_rgba c);
+
+/* blend a color over a line, clipped to the canvas */
+void nocviz_raster_line(nocviz_raster* rs, int x0, int y0, int x1, int y1, nocviz_rgba c);
+
+/* draw text with it's top left corner at x, y, characters outside of
+ * printable ASCII are drawn as '?' */
+void nocviz_raster_text(nocviz_raster* rs, int x, int y, const char* text, nocviz_rgba c);
+
+/* encode the canvas as a PNG in a newly allocated buffer, or return NULL
+ * with errno set to ENOMEM if memory cannot be allocated */
+uint8_t* nocviz_raster_encode_png(nocviz_raster* rs, size_t* len);
+
+/* write the canvas to a PNG file, returning false with errno set if it cannot
+ * be encoded or written */
+bool nocviz_raster_write_png(nocviz_raster* rs, const char* path);
+
+#endif
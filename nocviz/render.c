@@ -0,0 +1,460 @@
+#include "render.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+/* nodes are laid out as the graph widget lays them out */
+#define node_x(node) ((node)->col * (node)->w * 2)
+#define node_y(node) ((node)->row * (node)->h * 2)
+
+/* graph to image coordinates */
+#define view_x(v, gx) ((gx) * (v)->scale + (v)->ox)
+#define view_y(v, gy) ((gy) * (v)->scale + (v)->oy)
+
+typedef struct render_view_t {
+	double scale;
+	double ox;
+	double oy;
+	int w;
+	int h;
+} render_view;
+
+typedef struct render_bounds_t {
+	double x0;
+	double y0;
+	double x1;
+	double y1;
+	bool empty;
+} render_bounds;
+
+/* a link as a cubic bezier through it's endpoints, which is a straight line
+ * if it is not curved, and the position of it's label */
+typedef struct render_curve_t {
+	double x[4];
+	double y[4];
+	bool curved;
+	double hx;
+	double hy;
+} render_curve;
+
+void nocviz_render_opts_init(nocviz_render_opts* opts) {
+	opts->width = 0;
+	opts->height = 0;
+	opts->format = NOCVIZ_RENDER_PNG;
+	opts->labels = NOCVIZ_RENDER_NODE_LABELS;
+}
+
+/*** LAYOUT ******************************************************************/
+
+/* control points are offset perpendicular to the link by it's curve, as the
+ * graph widget places them */
+static void LinkCurve(nocviz_link* link, render_curve* c) {
+	double xv;
+	double yv;
+	double v_length;
+
+	c->x[0] = node_x(link->from);
+	c->y[0] = node_y(link->from);
+	c->x[3] = node_x(link->to);
+	c->y[3] = node_y(link->to);
+
+	xv = c->x[0] - c->x[3];
+	yv = c->y[0] - c->y[3];
+	v_length = sqrt(xv * xv + yv * yv);
+
+	if (link->curve == 0 || v_length == 0) {
+		c->curved = false;
+		c->x[1] = c->x[0];
+		c->y[1] = c->y[0];
+		c->x[2] = c->x[3];
+		c->y[2] = c->y[3];
+		c->hx = (c->x[0] + c->x[3]) / 2;
+		c->hy = (c->y[0] + c->y[3]) / 2;
+		return;
+	}
+
+	c->curved = true;
+	c->x[1] = (int) ((yv / v_length) * link->curve + c->x[0]);
+	c->y[1] = (int) ((-xv / v_length) * link->curve + c->y[0]);
+	c->x[2] = (int) ((yv / v_length) * link->curve + c->x[3]);
+	c->y[2] = (int) ((-xv / v_length) * link->curve + c->y[3]);
+	c->hx = (c->x[1] + c->x[2]) / 2;
+	c->hy = (c->y[1] + c->y[2]) / 2;
+}
+
+static void Bound(render_bounds* b, double x, double y) {
+	if (b->empty) {
+		b->x0 = b->x1 = x;
+		b->y0 = b->y1 = y;
+		b->empty = false;
+		return;
+	}
+	if (x < b->x0) { b->x0 = x; }
+	if (y < b->y0) { b->y0 = y; }
+	if (x > b->x1) { b->x1 = x; }
+	if (y > b->y1) { b->y1 = y; }
+}
+
+/* the extent of every node, and of every link's control points, which
+ * contain it's curve, must hold the graph's mutex */
+static void Measure(nocviz_graph* g, render_bounds* b) {
+	nocviz_node* node;
+	nocviz_link* link;
+	render_curve c;
+
+	b->empty = true;
+
+	nocviz_graph_foreach_node(g, node,
+		Bound(b, node_x(node) - (node->w >> 1), node_y(node) - (node->h >> 1));
+		Bound(b, node_x(node) - (node->w >> 1) + node->w,
+			node_y(node) - (node->h >> 1) + node->h);
+	);
+
+	nocviz_graph_foreach_link(g, link,
+		LinkCurve(link, &c);
+		for (int i = 0 ; i < 4 ; i++) { Bound(b, c.x[i], c.y[i]); }
+	);
+
+	if (b->empty) {
+		b->x0 = b->y0 = b->x1 = b->y1 = 0;
+	}
+}
+
+/* the scale at which an extent fits in some space, or infinity */
+static double Fit(int size, double extent) {
+	double avail = size - NOCVIZ_RENDER_MARGIN * 2;
+
+	if (avail < 1) { avail = 1; }
+	if (extent <= 0) { return INFINITY; }
+	return avail / extent;
+}
+
+static int ClampSize(double size) {
+	if (size < 1) { return 1; }
+	if (size > NOCVIZ_RENDER_MAX_SIZE) { return NOCVIZ_RENDER_MAX_SIZE; }
+	return (int) lround(size);
+}
+
+/* Size the image, taking any dimension which was not given from the aspect
+ * ratio of the graph, then scale the graph to fit, centered. */
+static void FitView(render_bounds* b, nocviz_render_opts* opts, render_view* v) {
+	double gw = b->x1 - b->x0;
+	double gh = b->y1 - b->y0;
+	double m = NOCVIZ_RENDER_MARGIN * 2;
+	double scale;
+
+	if (opts->width == 0 && opts->height == 0) {
+		v->w = ClampSize(gw + m);
+		v->h = ClampSize(gh + m);
+	} else if (opts->height == 0) {
+		v->w = ClampSize(opts->width);
+		scale = Fit(v->w, gw);
+		v->h = ClampSize(isinf(scale) ? gh + m : gh * scale + m);
+	} else if (opts->width == 0) {
+		v->h = ClampSize(opts->height);
+		scale = Fit(v->h, gh);
+		v->w = ClampSize(isinf(scale) ? gw + m : gw * scale + m);
+	} else {
+		v->w = ClampSize(opts->width);
+		v->h = ClampSize(opts->height);
+	}
+
+	scale = fmin(Fit(v->w, gw), Fit(v->h, gh));
+	if (isinf(scale)) { scale = 1; }
+
+	v->scale = scale;
+	v->ox = (v->w - gw * scale) / 2 - b->x0 * scale;
+	v->oy = (v->h - gh * scale) / 2 - b->y0 * scale;
+}
+
+static void Layout(nocviz_graph* g, nocviz_render_opts* opts, render_view* v) {
+	render_bounds b;
+
+	Measure(g, &b);
+	FitView(&b, opts, v);
+}
+
+/* the rectangle a node is drawn in, in image coordinates */
+static void NodeRect(render_view* v, nocviz_node* node, int* x, int* y, int* w, int* h) {
+	double gx = node_x(node) - (node->w >> 1);
+	double gy = node_y(node) - (node->h >> 1);
+
+	*x = (int) lround(view_x(v, gx));
+	*y = (int) lround(view_y(v, gy));
+	*w = (int) lround(view_x(v, gx + node->w)) - *x;
+	*h = (int) lround(view_y(v, gy + node->h)) - *y;
+	if (*w < 1) { *w = 1; }
+	if (*h < 1) { *h = 1; }
+}
+
+static nocviz_rgba ToRGBA(AG_Color* c) {
+	nocviz_rgba rgba;
+
+	rgba.r = AG_Hto8(c->r);
+	rgba.g = AG_Hto8(c->g);
+	rgba.b = AG_Hto8(c->b);
+	rgba.a = AG_Hto8(c->a);
+	return rgba;
+}
+
+/*** RASTER ******************************************************************/
+
+nocviz_raster* nocviz_render_raster(nocviz_graph* g, nocviz_render_opts* opts) {
+	nocviz_rgba white = {255, 255, 255, 255};
+	nocviz_rgba black = {0, 0, 0, 255};
+	nocviz_rgba c;
+	nocviz_raster* rs;
+	nocviz_node* node;
+	nocviz_link* link;
+	render_curve curve;
+	render_view v;
+	double t, u, x, y, px, py;
+	int rx, ry, rw, rh;
+	int segments;
+
+	noctools_mutex_lock(g->mutex);
+
+	Layout(g, opts, &v);
+	rs = nocviz_raster_init(v.w, v.h, white);
+	if (rs == NULL) {
+		noctools_mutex_unlock(g->mutex);
+		return NULL;
+	}
+
+	nocviz_graph_foreach_link(g, link,
+		LinkCurve(link, &curve);
+
+		/* links are drawn opaque, as the graph widget draws them, since
+		 * their default color is transparent black */
+		c = ToRGBA(&link->c);
+		c.a = 255;
+
+		/* straight links are drawn in one segment */
+		segments = curve.curved ? NOCVIZ_RENDER_CURVE_SEGMENTS : 1;
+		px = curve.x[0];
+		py = curve.y[0];
+		for (int i = 1 ; i <= segments ; i++) {
+			t = (double) i / segments;
+			u = 1 - t;
+			x = u*u*u*curve.x[0] + 3*u*u*t*curve.x[1] + 3*u*t*t*curve.x[2] + t*t*t*curve.x[3];
+			y = u*u*u*curve.y[0] + 3*u*u*t*curve.y[1] + 3*u*t*t*curve.y[2] + t*t*t*curve.y[3];
+			nocviz_raster_line(rs,
+				(int) lround(view_x(&v, px)), (int) lround(view_y(&v, py)),
+				(int) lround(view_x(&v, x)), (int) lround(view_y(&v, y)), c);
+			px = x;
+			py = y;
+		}
+
+		if ((opts->labels & NOCVIZ_RENDER_LINK_LABELS) && link->title != NULL) {
+			nocviz_raster_text(rs,
+				(int) lround(view_x(&v, curve.hx)),
+				(int) lround(view_y(&v, curve.hy)),
+				link->title, black);
+		}
+	);
+
+	nocviz_graph_foreach_node(g, node,
+		NodeRect(&v, node, &rx, &ry, &rw, &rh);
+		nocviz_raster_fill_rect(rs, rx, ry, rw, rh, ToRGBA(&node->c));
+
+		if ((opts->labels & NOCVIZ_RENDER_NODE_LABELS) && node->title != NULL) {
+			nocviz_raster_text(rs, rx, ry, node->title, black);
+		}
+	);
+
+	noctools_mutex_unlock(g->mutex);
+
+	return rs;
+}
+
+/*** SVG *********************************************************************/
+
+/* write text which is safe to include in an XML document */
+static void PutEscaped(FILE* f, const char* text, size_t n) {
+	for (size_t i = 0 ; i < n ; i++) {
+		switch (text[i]) {
+			case '&': fputs("&amp;", f); break;
+			case '<': fputs("&lt;", f); break;
+			case '>': fputs("&gt;", f); break;
+			case '"': fputs("&quot;", f); break;
+			default:
+				/* control characters are not allowed in XML */
+				if ((unsigned char) text[i] < ' ') {
+					fputc('?', f);
+				} else {
+					fputc(text[i], f);
+				}
+		}
+	}
+}
+
+/* each line of a label is it's own text element */
+static void PutLabel(FILE* f, double x, double y, const char* title) {
+	size_t n;
+
+	for (;;) {
+		n = strcspn(title, "\n");
+		fprintf(f, "<text x=\"%.1f\" y=\"%.1f\">", x, y);
+		PutEscaped(f, title, n);
+		fputs("</text>\n", f);
+
+		if (title[n] == '\0') { break; }
+		title += n + 1;
+		y += NOCVIZ_RASTER_CHAR_H;
+	}
+}
+
+bool nocviz_render_svg(nocviz_graph* g, FILE* f, nocviz_render_opts* opts) {
+	nocviz_node* node;
+	nocviz_link* link;
+	render_curve curve;
+	render_view v;
+	nocviz_rgba c;
+	int rx, ry, rw, rh;
+
+	noctools_mutex_lock(g->mutex);
+
+	Layout(g, opts, &v);
+
+	fprintf(f, "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+	fprintf(f, "<svg xmlns=\"http://www.w3.org/2000/svg\" "
+		"width=\"%d\" height=\"%d\" viewBox=\"0 0 %d %d\">\n",
+		v.w, v.h, v.w, v.h);
+	fprintf(f, "<rect width=\"100%%\" height=\"100%%\" fill=\"#ffffff\"/>\n");
+
+	/* labels hang from their top left corner, as they are in the GUI */
+	fprintf(f, "<g font-family=\"monospace\" font-size=\"%d\" "
+		"dominant-baseline=\"hanging\">\n", NOCVIZ_RASTER_CHAR_H);
+
+	nocviz_graph_foreach_link(g, link,
+		LinkCurve(link, &curve);
+		c = ToRGBA(&link->c);
+
+		fprintf(f, "<path d=\"M %.1f %.1f ",
+			view_x(&v, curve.x[0]), view_y(&v, curve.y[0]));
+		if (curve.curved) {
+			fprintf(f, "C %.1f %.1f %.1f %.1f ",
+				view_x(&v, curve.x[1]), view_y(&v, curve.y[1]),
+				view_x(&v, curve.x[2]), view_y(&v, curve.y[2]));
+		} else {
+			fprintf(f, "L ");
+		}
+		fprintf(f, "%.1f %.1f\" fill=\"none\" stroke=\"#%02x%02x%02x\"/>\n",
+			view_x(&v, curve.x[3]), view_y(&v, curve.y[3]), c.r, c.g, c.b);
+
+		if ((opts->labels & NOCVIZ_RENDER_LINK_LABELS) && link->title != NULL) {
+			PutLabel(f, view_x(&v, curve.hx), view_y(&v, curve.hy), link->title);
+		}
+	);
+
+	nocviz_graph_foreach_node(g, node,
+		NodeRect(&v, node, &rx, &ry, &rw, &rh);
+		c = ToRGBA(&node->c);
+
+		fprintf(f, "<rect x=\"%d\" y=\"%d\" width=\"%d\" height=\"%d\" "
+			"fill=\"#%02x%02x%02x\"", rx, ry, rw, rh, c.r, c.g, c.b);
+		if (c.a != 255) { fprintf(f, " fill-opacity=\"%.3f\"", c.a / 255.0); }
+		fprintf(f, "/>\n");
+
+		if ((opts->labels & NOCVIZ_RENDER_NODE_LABELS) && node->title != NULL) {
+			PutLabel(f, rx, ry, node->title);
+		}
+	);
+
+	noctools_mutex_unlock(g->mutex);
+
+	fprintf(f, "</g>\n</svg>\n");
+
+	return !ferror(f);
+}
+
+/*** FILES *******************************************************************/
+
+bool nocviz_render(nocviz_graph* g, const char* path, nocviz_render_opts* opts) {
+	nocviz_raster* rs;
+	FILE* f;
+	bool ok;
+
+	if (opts->format == NOCVIZ_RENDER_SVG) {
+		f = fopen(path, "w");
+		if (f == NULL) { return false; }
+		ok = nocviz_render_svg(g, f, opts);
+		ok = (fclose(f) == 0) && ok;
+		return ok;
+	}
+
+	rs = nocviz_render_raster(g, opts);
+	if (rs == NULL) {
+		errno = ENOMEM;
+		return false;
+	}
+	ok = nocviz_raster_write_png(rs, path);
+	nocviz_raster_free(rs);
+
+	return ok;
+}
+
+bool nocviz_render_format_from_path(const char* path, nocviz_render_format* format) {
+	const char* ext = strrchr(path, '.');
+
+	if (ext == NULL) { return false; }
+	if (strcasecmp(ext, ".png") == 0) {
+		*format = NOCVIZ_RENDER_PNG;
+	} else if (strcasecmp(ext, ".svg") == 0) {
+		*format = NOCVIZ_RENDER_SVG;
+	} else {
+		return false;
+	}
+	return true;
+}
+
+char* nocviz_render_frame_path(const char* pattern, int frame, bool* sequence) {
+	char* path;
+	size_t len = 0;
+	const char* p;
+	bool zero;
+	int width;
+
+	*sequence = false;
+
+	/* room for a frame number padded to 99 digits */
+	path = noctools_malloc(strlen(pattern) + 128);
+
+	for (p = pattern ; *p != '\0' ; p++) {
+		if (*p != '%') {
+			path[len++] = *p;
+			continue;
+		}
+
+		p++;
+		if (*p == '%') {
+			path[len++] = '%';
+			continue;
+		}
+
+		zero = false;
+		width = 0;
+		if (*p == '0') {
+			zero = true;
+			p++;
+		}
+		for (int i = 0 ; i < 2 && isdigit((unsigned char) *p) ; i++, p++) {
+			width = width * 10 + (*p - '0');
+		}
+
+		/* only one frame number, and nothing else */
+		if (*p != 'd' || *sequence) {
+			free(path);
+			return NULL;
+		}
+		*sequence = true;
+		len += sprintf(&path[len], zero ? "%0*d" : "%*d", width, frame);
+	}
+	path[len] = '\0';
+
+	return path;
+}
@@ -0,0 +1,69 @@
+#ifndef NOCVIZ_RENDER_H
+#define NOCVIZ_RENDER_H
+
+#include "graph.h"
+#include "raster.h"
+
+#include <stdbool.h>
+#include <stdio.h>
+
+/******************************************************************************
+ *
+ * Headless rendering of a graph to a PNG or SVG file, without a display, so
+ * that batch scripts can save frames of a simulation as it runs.
+ *
+ * Nodes and links are laid out as the graph widget lays them out, in the same
+ * colors, and labeled in the same places. The whole graph is drawn, scaled to
+ * fit the requested size, or at it's natural size if none is requested. PNGs
+ * are drawn by the rasterizer in raster.h, and labels in it's bitmap font.
+ *
+ *****************************************************************************/
+
+/* space left around the graph, in pixels */
+#define NOCVIZ_RENDER_MARGIN 16
+
+/* largest width or height of a rendered image */
+#define NOCVIZ_RENDER_MAX_SIZE 16384
+
+/* number of line segments used to draw a curved link */
+#define NOCVIZ_RENDER_CURVE_SEGMENTS 10
+
+typedef enum nocviz_render_format_t {
+	NOCVIZ_RENDER_PNG,
+	NOCVIZ_RENDER_SVG
+} nocviz_render_format;
+
+typedef struct nocviz_render_opts_t {
+	int width;	/* 0 to size the image to fit the graph */
+	int height;
+	nocviz_render_format format;
+	unsigned int labels;
+#define NOCVIZ_RENDER_NODE_LABELS 0x1
+#define NOCVIZ_RENDER_LINK_LABELS 0x2
+} nocviz_render_opts;
+
+/* set the defaults, which are a PNG of the natural size of the graph, with
+ * only node labels, as the GUI starts with */
+void nocviz_render_opts_init(nocviz_render_opts* opts);
+
+/* draw the graph onto a new canvas, or return NULL if it cannot be
+ * allocated, the format is ignored */
+nocviz_raster* nocviz_render_raster(nocviz_graph* g, nocviz_render_opts* opts);
+
+/* write the graph to a stream as an SVG document, the format is ignored */
+bool nocviz_render_svg(nocviz_graph* g, FILE* f, nocviz_render_opts* opts);
+
+/* write the graph to a file, returning false with errno set if it cannot be
+ * written */
+bool nocviz_render(nocviz_graph* g, const char* path, nocviz_render_opts* opts);
+
+/* guess the format of a file from it's extension */
+bool nocviz_render_format_from_path(const char* path, nocviz_render_format* format);
+
+/* Substitute a frame number into a filename pattern, which may contain a
+ * single %d conversion, optionally zero padded to a width of at most 2 digits
+ * such as %06d, and any number of %%. Sets sequence to whether the pattern
+ * contained a %d. Returns a new string, or NULL if the pattern is invalid. */
+char* nocviz_render_frame_path(const char* pattern, int frame, bool* sequence);
+
+#endif
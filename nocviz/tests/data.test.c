@@ -36,5 +36,60 @@ int main() {
 	tcl_str_result_should_equal(interp, "bar", "%s", "nocviz::data delete foo");
 	tcl_should_not_eval(interp, "%s", "nocviz::data get foo");
 
+	/* typed values should be stored as numbers */
+	int64_t i;
+	double d;
+	tcl_should_eval(interp, "%s", "nocviz::data set -int count 42");
+	should_be_true(nocviz_ds_get_int(g->ds, "count", &i));
+	should_equal(i, 42);
+	tcl_str_result_should_equal(interp, "42", "%s", "nocviz::data get count");
+	tcl_should_eval(interp, "%s", "nocviz::data set -double rate 0.5");
+	should_be_true(nocviz_ds_get_double(g->ds, "rate", &d));
+	should_equal(d, 0.5);
+	tcl_str_result_should_equal(interp, "0.5", "%s", "nocviz::data get rate");
+	tcl_should_eval(interp, "%s", "nocviz::data set -ints hist {1 2 3}");
+	tcl_str_result_should_equal(interp, "1 2 3", "%s", "nocviz::data get hist");
+	tcl_should_eval(interp, "%s", "nocviz::data set -doubles util {0.25 1}");
+	tcl_str_result_should_equal(interp, "0.25 1.0", "%s", "nocviz::data get util");
+	tcl_should_not_eval(interp, "%s", "nocviz::data set -int count abc");
+	tcl_should_not_eval(interp, "%s", "nocviz::data set -ints hist {1 x}");
+	tcl_should_not_eval(interp, "%s", "nocviz::data set -bogus count 1");
+	tcl_str_result_should_equal(interp, "42", "%s", "nocviz::data delete count");
+
+	/* and formatted without being converted to strings */
+	tcl_should_eval(interp, "%s", "nocviz::data fmt rate {%.2f}");
+	str_should_equal(nocviz_ds_format(g->ds, "rate"), "0.50");
+	tcl_should_eval(interp, "%s", "nocviz::data set -double rate 0.125");
+	str_should_equal(nocviz_ds_format(g->ds, "rate"), "0.12");
+
+	/* batches should update several nodes and links at once */
+	tcl_should_eval(interp, "%s", "nocviz::node create a");
+	tcl_should_eval(interp, "%s", "nocviz::node create b");
+	tcl_should_eval(interp, "%s", "nocviz::link create a b");
+	n1 = nocviz_graph_get_node(g, "a");
+	n2 = nocviz_graph_get_node(g, "b");
+	l = nocviz_graph_get_link(g, "a", "b");
+	tcl_should_eval(interp, "%s", "nocviz::node data fmt b load {%.1f}");
+	nocviz_graph_set_dirty(g, false);
+	tcl_should_eval(interp, "%s", "nocviz::data batch "
+			"{node a k1 v1 k2 v2} {node b -double load 0.25} "
+			"{link b a -ints hist {4 5}}");
+	should_be_true(nocviz_graph_is_dirty(g));
+	str_should_equal(nocviz_ds_get_kvp(n1->ds, "k1"), "v1");
+	str_should_equal(nocviz_ds_get_kvp(n1->ds, "k2"), "v2");
+	should_be_true(nocviz_ds_get_double(n2->ds, "load", &d));
+	should_equal(d, 0.25);
+	str_should_equal(nocviz_ds_format(n2->ds, "load"), "0.2");
+	str_should_equal(nocviz_ds_get_kvp(l->ds, "hist"), "4 5");
+
+	/* and apply nothing if any update is invalid */
+	tcl_should_not_eval(interp, "%s", "nocviz::data batch {node a k1 x} {node nope k v}");
+	tcl_should_not_eval(interp, "%s", "nocviz::data batch {node a k1 x} {node b -int load abc}");
+	tcl_should_not_eval(interp, "%s", "nocviz::data batch {node a k1 x} {link a nope k v}");
+	tcl_should_not_eval(interp, "%s", "nocviz::data batch {node a k1 x} {edge a b k v}");
+	tcl_should_not_eval(interp, "%s", "nocviz::data batch {node a k1 x} {node b load}");
+	str_should_equal(nocviz_ds_get_kvp(n1->ds, "k1"), "v1");
+	str_should_equal(nocviz_ds_format(n2->ds, "load"), "0.2");
+
 	Tcl_DeleteInterp(interp);
 }
@@ -131,5 +131,58 @@ int main() {
 	str_should_equal(nocviz_ds_format(ds, "key3"), "FORMAT ERROR");
 	nocviz_ds_free(ds);
 
+	/* typed values should be updated in place */
+	int64_t i;
+	double d;
+	ds = nocviz_ds_init();
+	nocviz_ds_set_int(ds, "count", 1);
+	nocviz_val* v = nocviz_ds_get_val(ds, "count");
+	nocviz_ds_set_int(ds, "count", 2);
+	should_be_true(nocviz_ds_get_val(ds, "count") == v);
+	should_be_true(nocviz_ds_get_int(ds, "count", &i));
+	should_equal(i, 2);
+	should_be_true(nocviz_ds_get_double(ds, "count", &d));
+	should_equal(d, 2.0);
+	str_should_equal(nocviz_ds_get_kvp(ds, "count"), "2");
+
+	/* and may change type */
+	nocviz_ds_set_double(ds, "count", 2.5);
+	should_be_true(nocviz_ds_get_double(ds, "count", &d));
+	should_equal(d, 2.5);
+	should_be_true(!nocviz_ds_get_int(ds, "count", &i));
+	str_should_equal(nocviz_ds_get_kvp(ds, "count"), "2.5");
+	nocviz_ds_set_kvp(ds, "count", strdup(" 17 "));
+	should_be_true(nocviz_ds_get_int(ds, "count", &i));
+	should_equal(i, 17);
+	nocviz_ds_set_kvp(ds, "count", strdup("many"));
+	should_be_true(!nocviz_ds_get_double(ds, "count", &d));
+
+	/* arrays of the same length reuse their storage */
+	int64_t ints[3] = {1, 2, 3};
+	nocviz_ds_set_ints(ds, "hist", ints, 3);
+	int64_t* storage = nocviz_ds_get_val(ds, "hist")->as.ints;
+	ints[1] = 20;
+	nocviz_ds_set_ints(ds, "hist", ints, 3);
+	should_be_true(nocviz_ds_get_val(ds, "hist")->as.ints == storage);
+	str_should_equal(nocviz_ds_get_kvp(ds, "hist"), "1 20 3");
+	double doubles[2] = {0.5, 1};
+	nocviz_ds_set_doubles(ds, "hist", doubles, 2);
+	str_should_equal(nocviz_ds_get_kvp(ds, "hist"), "0.5 1.0");
+
+	/* numbers are formatted directly, and arrays element-wise */
+	nocviz_ds_set_fmt(ds, "hist", strdup("%.2f"));
+	str_should_equal(nocviz_ds_format(ds, "hist"), "0.50 1.00");
+	nocviz_ds_set_fmt(ds, "count", strdup("%5.1f"));
+	nocviz_ds_set_int(ds, "count", 3);
+	str_should_equal(nocviz_ds_format(ds, "count"), "  3.0");
+	nocviz_ds_set_double(ds, "count", 2.25);
+	str_should_equal(nocviz_ds_format(ds, "count"), "  2.2");
+
+	/* deleting a typed value returns it's string representation */
+	char* deleted = nocviz_ds_del_kvp(ds, "count");
+	str_should_equal(deleted, "2.25");
+	free(deleted);
+	nocviz_ds_free(ds);
+
 	return 0;
 }
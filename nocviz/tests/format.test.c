@@ -0,0 +1,131 @@
+/* test suite for format */
+
+#include "../format.h"
+#include "../datastore.h"
+#include "test_util.h"
+#include "../../common/util.h"
+
+/* format a value with the given formatter, which must succeed */
+#define format_should_equal(f, fmt, val, expect) do { \
+		char* __res; \
+		if (nocviz_format(f, fmt, val, &__res) != TCL_OK) { \
+			fail("format '%s' '%s' should not have failed", fmt, val); \
+		} \
+		str_should_equal(__res, expect); \
+		free(__res); \
+	} while(0)
+
+/* the native formatter alone must produce the given result */
+#define native_should_equal(fmt, val, expect) do { \
+		char* __res; \
+		should_equal(nocviz_format_native(fmt, val, &__res), NOCVIZ_FORMAT_OK); \
+		str_should_equal(__res, expect); \
+		free(__res); \
+	} while(0)
+
+#define native_should_be(fmt, val, expect) do { \
+		char* __res; \
+		should_equal(nocviz_format_native(fmt, val, &__res), expect); \
+	} while(0)
+
+int main() {
+	nocviz_formatter* f;
+	nocviz_ds* ds;
+	char* res;
+
+	/* common formats should not need TCL at all */
+	native_should_equal("%s", "abc", "abc");
+	native_should_equal("%2.3f", "123.45678", "123.457");
+	native_should_equal("%5.2f", "3.14159", " 3.14");
+	native_should_equal("%08.3f", "-3.14159", "-003.142");
+	native_should_equal("%d", " 12 ", "12");
+	native_should_equal("%d", "+5", "5");
+	native_should_equal("%-8d|", "42", "42      |");
+	native_should_equal("%+d", "5", "+5");
+	native_should_equal("%x", "255", "ff");
+	native_should_equal("%e", "12345", "1.234500e+04");
+	native_should_equal("%g", "0.0001", "0.0001");
+	native_should_equal("%f", "1e3", "1000.000000");
+	native_should_equal("%c", "65", "A");
+	native_should_equal("%5s|", "ab", "   ab|");
+	native_should_equal("%.2s", "abcd", "ab");
+	native_should_equal("rate: %.1f%%", "0.25", "rate: 0.2%");
+	native_should_equal("100%%", "ignored", "100%");
+	native_should_equal("%s", "{unbalanced", "{unbalanced");
+
+	/* values which are clearly not numbers are errors */
+	native_should_be("%d", "abc", NOCVIZ_FORMAT_ERROR);
+	native_should_be("%f", "n/a", NOCVIZ_FORMAT_ERROR);
+	native_should_be("%d %d", "1", NOCVIZ_FORMAT_ERROR);
+
+	/* but anything TCL might understand differently is left to it */
+	native_should_be("%d", "010", NOCVIZ_FORMAT_FALLBACK);
+	native_should_be("%d", "0x10", NOCVIZ_FORMAT_FALLBACK);
+	native_should_be("%d", "1e3", NOCVIZ_FORMAT_FALLBACK);
+	native_should_be("%f", "010", NOCVIZ_FORMAT_FALLBACK);
+	native_should_be("%x", "-1", NOCVIZ_FORMAT_FALLBACK);
+	native_should_be("%#x", "255", NOCVIZ_FORMAT_FALLBACK);
+	native_should_be("%.3d", "7", NOCVIZ_FORMAT_FALLBACK);
+	native_should_be("%ld", "1", NOCVIZ_FORMAT_FALLBACK);
+	native_should_be("%*d", "1", NOCVIZ_FORMAT_FALLBACK);
+	native_should_be("%1$s", "1", NOCVIZ_FORMAT_FALLBACK);
+	native_should_be("%.2s", "h\xc3\xa9llo", NOCVIZ_FORMAT_FALLBACK);
+
+	/* the formatter should use TCL for those, and agree with the native
+	 * formatter otherwise */
+	f = nocviz_formatter_init();
+	should_be_null(f->interp);
+	format_should_equal(f, "%2.3f", "123.45678", "123.457");
+	should_be_null(f->interp);
+	format_should_equal(f, "%d", "010", "8");
+	format_should_equal(f, "%d", "0x10", "16");
+	format_should_equal(f, "%1$s-%1$s", "ab", "ab-ab");
+	format_should_equal(f, "%.2s", "h\xc3\xa9llo", "h\xc3\xa9");
+	should_not_be_null(f->interp);
+	should_equal(nocviz_format(f, "%d", "1e3", &res), TCL_ERROR);
+	should_equal(nocviz_format(f, "%d", "abc", &res), TCL_ERROR);
+
+	/* datastores sharing the formatter should use it */
+	ds = nocviz_ds_init_with_formatter(f);
+	nocviz_ds_set_kvp(ds, "key1", strdup("0x1f"));
+	nocviz_ds_set_fmt(ds, "key1", strdup("%d"));
+	str_should_equal(nocviz_ds_format(ds, "key1"), "31");
+	nocviz_ds_set_kvp(ds, "key2", strdup("a} [error x] {b"));
+	str_should_equal(nocviz_ds_format(ds, "key2"), "a} [error x] {b");
+	nocviz_ds_free(ds);
+	nocviz_formatter_free(f);
+
+	/* formats are compiled once, and applied to every value */
+	nocviz_format_spec* spec = nocviz_format_compile("%-6.2f|");
+	str_should_equal(spec->cfmt, "%-6.2f");
+	should_equal(nocviz_format_spec_native(spec, "1.234", &res), NOCVIZ_FORMAT_OK);
+	str_should_equal(res, "1.23  |");
+	free(res);
+	should_equal(nocviz_format_spec_native(spec, "-2", &res), NOCVIZ_FORMAT_OK);
+	str_should_equal(res, "-2.00 |");
+	free(res);
+	nocviz_format_spec_free(spec);
+
+	/* and replaced along with the format string */
+	ds = nocviz_ds_init();
+	nocviz_ds_set_fmt(ds, "key1", strdup("%.1f"));
+	nocviz_ds_set_kvp(ds, "key1", strdup("2.25"));
+	str_should_equal(nocviz_ds_format(ds, "key1"), "2.2");
+	nocviz_ds_set_fmt(ds, "key1", strdup("<%s>"));
+	str_should_equal(nocviz_ds_format(ds, "key1"), "<2.25>");
+	nocviz_ds_set_kvp(ds, "key1", strdup("3"));
+	str_should_equal(nocviz_ds_format(ds, "key1"), "<3>");
+	free(nocviz_ds_del_fmt(ds, "key1"));
+	nocviz_ds_update_fmtcache(ds, "key1");
+	str_should_equal(nocviz_ds_format(ds, "key1"), "3");
+	nocviz_ds_free(ds);
+
+	/* without one, formats needing TCL should show the unformatted value */
+	ds = nocviz_ds_init();
+	nocviz_ds_set_kvp(ds, "key1", strdup("0x1f"));
+	nocviz_ds_set_fmt(ds, "key1", strdup("%d"));
+	str_should_equal(nocviz_ds_format(ds, "key1"), "0x1f");
+	nocviz_ds_free(ds);
+
+	return 0;
+}
@@ -147,4 +147,65 @@ int main() {
 	should_equal(l->to, nocviz_graph_get_node(g, "node1"));
 	nocviz_graph_free(g);
 
+	/* nothing is recorded until changes are tracked */
+	g = nocviz_graph_init();
+	n = nocviz_graph_new_node(g, "node1");
+	should_equal(n->changes, 0);
+	should_equal(g->changed_nodes->length, 0);
+
+	/* each changed item is recorded once, with every kind of change */
+	nocviz_graph_track_changes(g, true);
+	n2 = nocviz_graph_new_node(g, "node2");
+	l = nocviz_graph_new_link(g, "node1", "node2", NOCVIZ_LINK_UNDIRECTED);
+	nocviz_graph_node_changed(g, n, NOCVIZ_CHANGE_MOVED);
+	nocviz_graph_node_changed(g, n, NOCVIZ_CHANGE_COLOR);
+	nocviz_graph_reverse_link(g, l);
+	should_equal(g->changed_nodes->length, 2);
+	should_equal(g->changed_links->length, 1);
+	should_equal(n->changes, NOCVIZ_CHANGE_MOVED | NOCVIZ_CHANGE_COLOR);
+	should_equal(n2->changes, NOCVIZ_CHANGE_ADDED);
+	should_equal(l->changes, NOCVIZ_CHANGE_ADDED | NOCVIZ_CHANGE_MOVED);
+	should_be_true(g->color_dirty);
+
+	/* clearing forgets them */
+	__nocviz_graph_clear_changes(g);
+	should_equal(g->changed_nodes->length, 0);
+	should_equal(g->changed_links->length, 0);
+	should_equal(n->changes, 0);
+	should_equal(l->changes, 0);
+
+	/* removed items are no longer listed as changed, and removing a node
+	 * removes it's links first */
+	nocviz_graph_node_changed(g, n2, NOCVIZ_CHANGE_TITLE);
+	nocviz_graph_free_node(g, n2);
+	should_equal(g->changed_nodes->length, 0);
+	should_equal(g->removed_links->length, 1);
+	should_equal(g->removed_links->data[0], l);
+	should_equal(g->removed_nodes->length, 1);
+	should_equal(g->removed_nodes->data[0], n2);
+
+	/* removing an item from the middle of the list keeps the others */
+	n2 = nocviz_graph_new_node(g, "node4");
+	nv = nocviz_graph_new_node(g, "node5");
+	nocviz_graph_node_changed(g, n, NOCVIZ_CHANGE_TITLE);
+	nocviz_graph_free_node(g, n2);
+	should_equal(g->changed_nodes->length, 2);
+	should_equal(g->changed_nodes->data[0], n);
+	should_equal(g->changed_nodes->data[1], nv);
+	nocviz_graph_free_node(g, n);
+	should_equal(g->changed_nodes->length, 1);
+	should_equal(g->changed_nodes->data[0], nv);
+	nocviz_graph_free_node(g, nv);
+	should_equal(g->changed_nodes->length, 0);
+	n = nocviz_graph_new_node(g, "node1");
+
+	/* and nothing is recorded after tracking stops */
+	nocviz_graph_track_changes(g, false);
+	should_equal(g->removed_nodes->length, 0);
+	nocviz_graph_new_node(g, "node3");
+	nocviz_graph_free_node(g, n);
+	should_equal(g->changed_nodes->length, 0);
+	should_equal(g->removed_nodes->length, 0);
+	nocviz_graph_free(g);
+
 }
@@ -0,0 +1,87 @@
+/* test suite for index */
+
+#include "../index.h"
+#include "test_util.h"
+#include "../../common/util.h"
+
+#include <stdio.h>
+#include <string.h>
+
+/* the entries of a numeric index must be in order */
+#define index_should_be_sorted(idx) do { \
+		for (unsigned int __i = 1 ; __i < (idx)->entries->length ; __i++) { \
+			should_be_true(nocviz_index_entry_compare( \
+				&(idx)->entries->data[__i - 1], \
+				&(idx)->entries->data[__i]) < 0); \
+		} \
+	} while(0)
+
+int main() {
+	nocviz_index_set* set;
+	nocviz_index* idx;
+	nocviz_val* val;
+	int items[100];
+
+	set = nocviz_index_set_init();
+	val = nocviz_val_new();
+
+	/* updates to keys which are not indexed are ignored */
+	nocviz_val_set_int(val, 1);
+	nocviz_index_set_update(set, "routed", &items[0], val);
+	should_be_null(__nocviz_index_set_get(set, "routed"));
+
+	idx = nocviz_index_set_add(set, "routed", NOCVIZ_INDEX_NUMERIC);
+	should_not_be_null(idx);
+	should_be_null(nocviz_index_set_add(set, "routed", NOCVIZ_INDEX_NUMERIC));
+
+	/* values should stay sorted as they move up and down */
+	for (int i = 0 ; i < 100 ; i++) {
+		nocviz_val_set_int(val, (i * 37) % 10);
+		nocviz_index_set_update(set, "routed", &items[i], val);
+	}
+	should_equal(idx->entries->length, 100);
+	index_should_be_sorted(idx);
+	for (int i = 0 ; i < 100 ; i += 3) {
+		nocviz_val_set_double(val, 10.5 - (i % 7) * 2);
+		nocviz_index_set_update(set, "routed", &items[i], val);
+		index_should_be_sorted(idx);
+	}
+	should_equal(idx->entries->length, 100);
+
+	/* each value of 0 to 9 is held by 10 items, less those moved */
+	should_equal(nocviz_index_upper_bound(idx, 0) - nocviz_index_lower_bound(idx, 0), 6);
+	should_equal(nocviz_index_lower_bound(idx, -100), 0);
+	should_equal(nocviz_index_upper_bound(idx, 100), 100);
+	should_equal(idx->entries->data[99].v, 10.5);
+
+	/* values which are not numbers, or are deleted, leave the index */
+	nocviz_val_set_string(val, strdup("idle"));
+	nocviz_index_set_update(set, "routed", &items[0], val);
+	nocviz_index_set_update(set, "routed", &items[1], NULL);
+	nocviz_index_set_remove_item(set, &items[2]);
+	should_equal(idx->entries->length, 97);
+	index_should_be_sorted(idx);
+
+	/* string indexes group items by value */
+	idx = nocviz_index_set_add(set, "state", NOCVIZ_INDEX_STRING);
+	nocviz_val_set_string(val, strdup("busy"));
+	nocviz_index_set_update(set, "state", &items[0], val);
+	nocviz_index_set_update(set, "state", &items[1], val);
+	nocviz_val_set_int(val, 3);
+	nocviz_index_set_update(set, "state", &items[2], val);
+	should_equal(kh_size(nocviz_index_find(idx, "busy")), 2);
+	should_equal(kh_size(nocviz_index_find(idx, "3")), 1);
+	nocviz_index_set_update(set, "state", &items[1], val);
+	should_equal(kh_size(nocviz_index_find(idx, "busy")), 1);
+	should_equal(kh_size(nocviz_index_find(idx, "3")), 2);
+	nocviz_index_set_remove_item(set, &items[0]);
+	should_be_null(nocviz_index_find(idx, "busy"));
+
+	should_be_true(nocviz_index_set_del(set, "state"));
+	should_be_true(!nocviz_index_set_del(set, "state"));
+
+	nocviz_val_free(val);
+	nocviz_index_set_free(set);
+
+	return 0;
+}
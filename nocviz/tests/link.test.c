@@ -120,6 +120,15 @@ int main() {
 	tcl_result_list_should_contain(interp, "node2", "%s", "nocviz::link match foo bar");
 	tcl_result_list_should_not_contain(interp, "node3", "%s", "nocviz::link match foo bar");
 	tcl_result_list_should_not_contain(interp, "node4", "%s", "nocviz::link match foo bar");
+	tcl_should_eval(interp, "%s", "nocviz::link data set -double node1 node2 util 0.75");
+	tcl_should_eval(interp, "%s", "nocviz::link data set -double node3 node4 util 0.25");
+	tcl_result_list_should_contain(interp, "node1", "%s", "nocviz::link match util -ge 0.5");
+	tcl_result_list_should_not_contain(interp, "node3", "%s", "nocviz::link match util -ge 0.5");
+	tcl_should_eval(interp, "%s", "nocviz::link index create util");
+	tcl_str_result_should_equal(interp, "node1 node2", "%s", "nocviz::link match util -ge 0.5");
+	tcl_str_result_should_equal(interp, "node1 node2 node3 node4", "%s", "nocviz::link top util 5");
+	tcl_should_eval(interp, "%s", "nocviz::link data set -double node1 node2 util 0.1");
+	tcl_str_result_should_equal(interp, "node3 node4", "%s", "nocviz::link top util 1");
 	tcl_should_eval(interp, "%s", "nocviz::node destroy node1");
 	tcl_should_eval(interp, "%s", "nocviz::node destroy node2");
 
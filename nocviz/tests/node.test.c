@@ -159,6 +159,52 @@ int main() {
 	tcl_result_list_should_contain(interp, "test1", "%s", "nocviz::node match foo ba.*");
 	tcl_result_list_should_contain(interp, "test2", "%s", "nocviz::node match foo ba.*");
 	tcl_result_list_should_not_contain(interp, "test3", "%s", "nocviz::node match foo ba.*");
+	tcl_result_list_should_contain(interp, "test1", "%s", "nocviz::node match foo {^b[a-r]+$}");
+	tcl_result_list_should_not_contain(interp, "test2", "%s", "nocviz::node match foo {^b[a-r]+$}");
+	tcl_should_not_eval(interp, "%s", "nocviz::node match foo {(}");
+
+	/* numeric conditions over typed and string values */
+	tcl_should_eval(interp, "%s", "nocviz::node data set -int test1 routed 150");
+	tcl_should_eval(interp, "%s", "nocviz::node data set -double test2 routed 99.5");
+	tcl_should_eval(interp, "%s", "nocviz::node data set test3 routed 100");
+	tcl_result_list_should_contain(interp, "test1", "%s", "nocviz::node match routed -gt 100");
+	tcl_result_list_should_not_contain(interp, "test2", "%s", "nocviz::node match routed -gt 100");
+	tcl_result_list_should_not_contain(interp, "test3", "%s", "nocviz::node match routed -gt 100");
+	tcl_result_list_should_contain(interp, "test3", "%s", "nocviz::node match routed -ge 100");
+	tcl_result_list_should_contain(interp, "test2", "%s", "nocviz::node match routed -lt 100");
+	tcl_result_list_should_contain(interp, "test3", "%s", "nocviz::node match routed -eq 100");
+	tcl_result_list_should_contain(interp, "test2", "%s", "nocviz::node match routed -range 99 100");
+	tcl_result_list_should_contain(interp, "test3", "%s", "nocviz::node match routed -range 99 100");
+	tcl_result_list_should_not_contain(interp, "test1", "%s", "nocviz::node match routed -range 99 100");
+	tcl_result_list_should_not_contain(interp, "test1", "%s", "nocviz::node match foo -gt 0");
+	tcl_should_not_eval(interp, "%s", "nocviz::node match routed -gt abc");
+	tcl_should_not_eval(interp, "%s", "nocviz::node match routed -range 1");
+	tcl_should_not_eval(interp, "%s", "nocviz::node match routed -between 1 2");
+
+	/* indexes should give the same answers as scanning every node, and
+	 * stay up to date as values change */
+	tcl_should_eval(interp, "%s", "nocviz::node index create routed");
+	tcl_should_not_eval(interp, "%s", "nocviz::node index create routed");
+	tcl_should_eval(interp, "%s", "nocviz::node index create foo -string");
+	tcl_result_list_should_contain(interp, "test1", "%s", "nocviz::node match routed -gt 100");
+	tcl_result_list_should_not_contain(interp, "test3", "%s", "nocviz::node match routed -gt 100");
+	tcl_result_list_should_contain(interp, "test3", "%s", "nocviz::node match routed -eq 100");
+	tcl_result_list_should_contain(interp, "test2", "%s", "nocviz::node match foo -is baz");
+	tcl_result_list_should_not_contain(interp, "test1", "%s", "nocviz::node match foo -is baz");
+	tcl_str_result_should_equal(interp, "test1 test3", "%s", "nocviz::node top routed 2");
+	tcl_should_eval(interp, "%s", "nocviz::node data set -int test2 routed 500");
+	tcl_should_eval(interp, "%s", "nocviz::node data set test1 foo baz");
+	tcl_str_result_should_equal(interp, "test2 test1", "%s", "nocviz::node top routed 2");
+	tcl_result_list_should_contain(interp, "test1", "%s", "nocviz::node match foo -is baz");
+	n = nocviz_graph_get_node(g, "test2");
+	free(nocviz_ds_del_kvp(n->ds, "routed"));
+	tcl_str_result_should_equal(interp, "test1 test3", "%s", "nocviz::node top routed 5");
+	tcl_should_eval(interp, "%s", "nocviz::node data set test1 routed idle");
+	tcl_str_result_should_equal(interp, "test3", "%s", "nocviz::node top routed 5");
+	tcl_str_result_should_equal(interp, "foo -string routed -numeric", "%s", "lsort -stride 2 [nocviz::node index list]");
+	tcl_should_eval(interp, "%s", "nocviz::node index delete routed");
+	tcl_should_not_eval(interp, "%s", "nocviz::node index delete routed");
+	tcl_str_result_should_equal(interp, "test3", "%s", "nocviz::node top routed 5");
 	tcl_should_eval(interp, "nocviz::node destroy %s", "test1");
 	tcl_should_eval(interp, "nocviz::node destroy %s", "test2");
 	tcl_should_eval(interp, "nocviz::node destroy %s", "test3");
@@ -0,0 +1,298 @@
+/* test suite for headless rendering */
+
+#include "../graph.h"
+#include "../render.h"
+#include "test_util.h"
+#include "../../common/util.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define pixel_should_equal(rs, x, y, R, G, B) do { \
+		uint8_t* __p = &(rs)->px[((y) * (rs)->w + (x)) * 3]; \
+		should_equal(__p[0], R); \
+		should_equal(__p[1], G); \
+		should_equal(__p[2], B); \
+	} while(0)
+
+#define frame_path_should_equal(pattern, frame, expect, expect_sequence) do { \
+		bool __sequence; \
+		char* __path = nocviz_render_frame_path(pattern, frame, &__sequence); \
+		should_not_be_null(__path); \
+		str_should_equal(__path, expect); \
+		should_equal(__sequence, expect_sequence); \
+		free(__path); \
+	} while(0)
+
+/* a minimal inflate for the stored and fixed Huffman blocks which the PNG
+ * encoder writes, so that the test does not need zlib */
+typedef struct bit_reader_t {
+	const uint8_t* data;
+	size_t len;
+	size_t pos;	/* in bits */
+} bit_reader;
+
+static int ReadBits(bit_reader* r, int n) {
+	int v = 0;
+
+	for (int i = 0 ; i < n ; i++, r->pos++) {
+		if (r->pos / 8 >= r->len) { return -1; }
+		v |= ((r->data[r->pos / 8] >> (r->pos % 8)) & 1) << i;
+	}
+	return v;
+}
+
+/* Huffman codes are packed starting from their most significant bit */
+static int ReadCode(bit_reader* r, int n) {
+	int v = 0;
+	int bit;
+
+	for (int i = 0 ; i < n ; i++) {
+		if ((bit = ReadBits(r, 1)) < 0) { return -1; }
+		v = (v << 1) | bit;
+	}
+	return v;
+}
+
+static int ReadSymbol(bit_reader* r) {
+	int code = ReadCode(r, 7);
+
+	if (code < 0) { return -1; }
+	if (code <= 0x17) { return 256 + code; }
+	code = (code << 1) | ReadBits(r, 1);
+	if (code >= 0x30 && code <= 0xbf) { return code - 0x30; }
+	if (code >= 0xc0 && code <= 0xc7) { return 280 + code - 0xc0; }
+	code = (code << 1) | ReadBits(r, 1);
+	if (code >= 0x190 && code <= 0x1ff) { return 144 + code - 0x190; }
+	return -1;
+}
+
+/* inflate a zlib stream into out, returning the number of bytes written, or
+ * -1 if it is malformed, uses dynamic Huffman codes, or does not fit */
+static long Inflate(const uint8_t* data, size_t len, uint8_t* out, size_t cap) {
+	static const int length_base[29] = {
+		3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+		35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258
+	};
+	static const int length_extra[29] = {
+		0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+		3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0
+	};
+	static const int dist_base[30] = {
+		1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+		257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289,
+		16385, 24577
+	};
+	static const int dist_extra[30] = {
+		0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+		7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13
+	};
+	bit_reader r = {data, len, 16};
+	size_t n = 0;
+	uint32_t s1 = 1;
+	uint32_t s2 = 0;
+	int final;
+	int type;
+	int sym;
+	int code;
+	int length;
+	int dist;
+
+	if (len < 6 || (data[0] & 0x0f) != 8 || ((data[0] << 8) | data[1]) % 31 != 0) { return -1; }
+
+	do {
+		final = ReadBits(&r, 1);
+		type = ReadBits(&r, 2);
+
+		if (type == 0) {
+			r.pos = (r.pos + 7) / 8 * 8;
+			length = ReadBits(&r, 16);
+			if (length < 0 || ReadBits(&r, 16) != (~length & 0xffff)) { return -1; }
+			if (n + length > cap || r.pos / 8 + length > len) { return -1; }
+			memcpy(&out[n], &data[r.pos / 8], length);
+			n += length;
+			r.pos += (size_t) length * 8;
+
+		} else if (type == 1) {
+			while ((sym = ReadSymbol(&r)) != 256) {
+				if (sym < 0) { return -1; }
+				if (sym < 256) {
+					if (n >= cap) { return -1; }
+					out[n++] = sym;
+					continue;
+				}
+
+				/* the length's extra bits come before the distance code */
+				if (sym - 257 >= 29) { return -1; }
+				length = length_base[sym - 257] + ReadBits(&r, length_extra[sym - 257]);
+				if ((code = ReadCode(&r, 5)) < 0 || code >= 30) { return -1; }
+				dist = dist_base[code] + ReadBits(&r, dist_extra[code]);
+				if ((size_t) dist > n || n + length > cap) { return -1; }
+				for (int i = 0 ; i < length ; i++, n++) { out[n] = out[n - dist]; }
+			}
+
+		} else {
+			return -1;
+		}
+	} while (final == 0);
+
+	/* adler32 of the uncompressed data follows, byte aligned */
+	r.pos = (r.pos + 7) / 8;
+	if (r.pos + 4 > len) { return -1; }
+	for (size_t i = 0 ; i < n ; i++) {
+		s1 = (s1 + out[i]) % 65521;
+		s2 = (s2 + s1) % 65521;
+	}
+	if (((uint32_t) data[r.pos] << 24 | (uint32_t) data[r.pos + 1] << 16 |
+			(uint32_t) data[r.pos + 2] << 8 | data[r.pos + 3]) != ((s2 << 16) | s1)) {
+		return -1;
+	}
+
+	return n;
+}
+
+/* 1 if the PNG decodes to exactly the pixels of the canvas */
+static int PNGMatches(nocviz_raster* rs, const uint8_t* png, size_t len) {
+	size_t stride = (size_t) rs->w * 3;
+	size_t size = (stride + 1) * rs->h;
+	uint8_t* idat = malloc(len);
+	uint8_t* raw = malloc(size + 1);
+	size_t idat_len = 0;
+	size_t pos = 8;
+	size_t n;
+	int matches = 1;
+
+	while (pos + 12 <= len) {
+		n = (size_t) png[pos] << 24 | png[pos + 1] << 16 | png[pos + 2] << 8 | png[pos + 3];
+		if (pos + 12 + n > len) { break; }
+		if (memcmp(&png[pos + 4], "IDAT", 4) == 0) {
+			memcpy(&idat[idat_len], &png[pos + 8], n);
+			idat_len += n;
+		}
+		pos += 12 + n;
+	}
+
+	if (pos != len || Inflate(idat, idat_len, raw, size + 1) != (long) size) {
+		matches = 0;
+	}
+
+	/* every row should be unfiltered */
+	for (int y = 0 ; matches && y < rs->h ; y++) {
+		if (raw[y * (stride + 1)] != 0 ||
+				memcmp(&raw[y * (stride + 1) + 1], &rs->px[y * stride], stride) != 0) {
+			matches = 0;
+		}
+	}
+
+	free(idat);
+	free(raw);
+	return matches;
+}
+
+int main() {
+	nocviz_graph* g;
+	nocviz_node* n;
+	nocviz_render_opts opts;
+	nocviz_render_format format;
+	nocviz_raster* rs;
+	uint8_t* png;
+	size_t len;
+	char* svg;
+	FILE* f;
+	bool sequence;
+
+	g = nocviz_graph_init();
+	n = nocviz_graph_new_node(g, "a");
+	AG_ColorRGBA_8(&n->c, 255, 0, 0, 255);
+	n = nocviz_graph_new_node(g, "b");
+	n->col = 1;
+	free(n->title);
+	n->title = strdup("<b>");
+	nocviz_graph_new_link(g, "a", "b", NOCVIZ_LINK_DIRECTED);
+
+	/* at it's natural size, the 120x40 graph is centered in the margin */
+	nocviz_render_opts_init(&opts);
+	rs = nocviz_render_raster(g, &opts);
+	should_not_be_null(rs);
+	should_equal(rs->w, 120 + NOCVIZ_RENDER_MARGIN * 2);
+	should_equal(rs->h, 40 + NOCVIZ_RENDER_MARGIN * 2);
+	pixel_should_equal(rs, 0, 0, 255, 255, 255);
+	pixel_should_equal(rs, 36, 36, 255, 0, 0);
+	pixel_should_equal(rs, 116, 36, 128, 128, 128);
+
+	/* links are opaque, even though they default to transparent */
+	pixel_should_equal(rs, 76, 36, 0, 0, 0);
+
+	/* the label of a is drawn from the top left corner of it's node */
+	pixel_should_equal(rs, 17, 18, 0, 0, 0);
+
+	png = nocviz_raster_encode_png(rs, &len);
+	should_be_true(len > 33);
+	should_be_true(memcmp(png, "\x89PNG\r\n\x1a\n", 8) == 0);
+	should_be_true(memcmp(&png[12], "IHDR", 4) == 0);
+	should_equal(png[19], rs->w);
+	should_equal(png[23], rs->h);
+	should_be_true(memcmp(&png[len - 8], "IEND", 4) == 0);
+	should_be_true(PNGMatches(rs, png, len));
+	free(png);
+	nocviz_raster_free(rs);
+
+	/* a width alone keeps the aspect ratio of the graph */
+	opts.width = 304;
+	rs = nocviz_render_raster(g, &opts);
+	should_equal(rs->w, 304);
+	should_equal(rs->h, 123);
+	nocviz_raster_free(rs);
+
+	/* both scale the graph to fit, and center it */
+	opts.height = 300;
+	opts.labels = 0;
+	rs = nocviz_render_raster(g, &opts);
+	should_equal(rs->w, 304);
+	should_equal(rs->h, 300);
+	pixel_should_equal(rs, 20, 150, 255, 0, 0);
+	pixel_should_equal(rs, 20, 80, 255, 255, 255);
+
+	/* long runs are encoded as matches, and every pixel survives */
+	png = nocviz_raster_encode_png(rs, &len);
+	should_not_be_null(png);
+	should_be_true(len < (size_t) rs->w * rs->h);
+	should_be_true(PNGMatches(rs, png, len));
+	png[len / 2] ^= 0x10;
+	should_be_true(!PNGMatches(rs, png, len));
+	free(png);
+	nocviz_raster_free(rs);
+
+	/* svg labels are escaped */
+	nocviz_render_opts_init(&opts);
+	opts.labels = NOCVIZ_RENDER_NODE_LABELS | NOCVIZ_RENDER_LINK_LABELS;
+	f = open_memstream(&svg, &len);
+	should_be_true(nocviz_render_svg(g, f, &opts));
+	fclose(f);
+	should_not_be_null(strstr(svg, "width=\"152\" height=\"72\""));
+	should_not_be_null(strstr(svg, "fill=\"#ff0000\""));
+	should_not_be_null(strstr(svg, ">&lt;b&gt;</text>"));
+	should_not_be_null(strstr(svg, ">a -&gt; b</text>"));
+	should_not_be_null(strstr(svg, "<path d=\"M 36.0 36.0 L 116.0 36.0\""));
+	free(svg);
+
+	should_be_true(nocviz_render_format_from_path("out/frame%04d.PNG", &format));
+	should_equal(format, NOCVIZ_RENDER_PNG);
+	should_be_true(nocviz_render_format_from_path("graph.svg", &format));
+	should_equal(format, NOCVIZ_RENDER_SVG);
+	should_be_true(!nocviz_render_format_from_path("graph.jpg", &format));
+	should_be_true(!nocviz_render_format_from_path("graph", &format));
+
+	frame_path_should_equal("frame%04d.png", 7, "frame0007.png", true);
+	frame_path_should_equal("%d.png", 12, "12.png", true);
+	frame_path_should_equal("100%%.svg", 3, "100%.svg", false);
+	frame_path_should_equal("graph.png", 3, "graph.png", false);
+	should_be_null(nocviz_render_frame_path("%d-%d.png", 0, &sequence));
+	should_be_null(nocviz_render_frame_path("%s.png", 0, &sequence));
+	should_be_null(nocviz_render_frame_path("%100d.png", 0, &sequence));
+	should_be_null(nocviz_render_frame_path("graph%", 0, &sequence));
+
+	nocviz_graph_free(g);
+
+	return 0;
+}
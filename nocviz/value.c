@@ -0,0 +1,277 @@
+#include "value.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <inttypes.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+nocviz_val* nocviz_val_new(void) {
+	nocviz_val* val;
+
+	val = noctools_malloc(sizeof(nocviz_val));
+	val->type = NOCVIZ_VAL_INT;
+	val->as.i = 0;
+	val->len = 0;
+	val->str = NULL;
+
+	return val;
+}
+
+nocviz_val* nocviz_val_new_string(char* str) {
+	nocviz_val* val;
+
+	val = nocviz_val_new();
+	val->type = NOCVIZ_VAL_STRING;
+	val->str = str;
+
+	return val;
+}
+
+/* free whatever the value owns, leaving it's storage to be reused */
+static void nocviz_val_clear(nocviz_val* val) {
+	if (val->str != NULL && val->str != val->num) {
+		free(val->str);
+	}
+	val->str = NULL;
+
+	if (val->type == NOCVIZ_VAL_INTS) {
+		free(val->as.ints);
+	} else if (val->type == NOCVIZ_VAL_DOUBLES) {
+		free(val->as.doubles);
+	}
+	val->len = 0;
+}
+
+/* invalidate the string representation of a number */
+static void nocviz_val_touch(nocviz_val* val) {
+	if (val->str != NULL && val->str != val->num) {
+		free(val->str);
+	}
+	val->str = NULL;
+}
+
+void nocviz_val_free(nocviz_val* val) {
+	nocviz_val_clear(val);
+	free(val);
+}
+
+void nocviz_val_set_string(nocviz_val* val, char* str) {
+	nocviz_val_clear(val);
+	val->type = NOCVIZ_VAL_STRING;
+	val->str = str;
+}
+
+void nocviz_val_set_int(nocviz_val* val, int64_t i) {
+	if (val->type != NOCVIZ_VAL_INT) {
+		nocviz_val_clear(val);
+		val->type = NOCVIZ_VAL_INT;
+	}
+	val->as.i = i;
+	val->str = NULL;
+}
+
+void nocviz_val_set_double(nocviz_val* val, double d) {
+	if (val->type != NOCVIZ_VAL_DOUBLE) {
+		nocviz_val_clear(val);
+		val->type = NOCVIZ_VAL_DOUBLE;
+	}
+	val->as.d = d;
+	val->str = NULL;
+}
+
+void nocviz_val_set_ints(nocviz_val* val, const int64_t* ints, size_t len) {
+	if (val->type != NOCVIZ_VAL_INTS || val->len != len) {
+		nocviz_val_clear(val);
+		val->type = NOCVIZ_VAL_INTS;
+		val->as.ints = noctools_malloc(sizeof(int64_t) * (len > 0 ? len : 1));
+		val->len = len;
+	}
+	memcpy(val->as.ints, ints, sizeof(int64_t) * len);
+	nocviz_val_touch(val);
+}
+
+void nocviz_val_set_doubles(nocviz_val* val, const double* doubles, size_t len) {
+	if (val->type != NOCVIZ_VAL_DOUBLES || val->len != len) {
+		nocviz_val_clear(val);
+		val->type = NOCVIZ_VAL_DOUBLES;
+		val->as.doubles = noctools_malloc(sizeof(double) * (len > 0 ? len : 1));
+		val->len = len;
+	}
+	memcpy(val->as.doubles, doubles, sizeof(double) * len);
+	nocviz_val_touch(val);
+}
+
+/* write the string representation of a number to buf, which must have room
+ * for at least NOCVIZ_VAL_NUM_SPACE characters */
+static void nocviz_val_print_int(int64_t i, char* buf) {
+	sprintf(buf, "%" PRId64, i);
+}
+
+/* As TCL would show a double: the fewest digits that read back as the same
+ * value, in exponential notation only if they are very large or small, and
+ * with a trailing .0 if they are integers. */
+static void nocviz_val_print_double(double d, char* buf) {
+	char digits[32];
+	char* mantissa;
+	char* e;
+	int ndigits;
+	int exp;
+	int p;
+
+	if (isnan(d)) { strcpy(buf, "NaN"); return; }
+	if (isinf(d)) { strcpy(buf, d < 0 ? "-Inf" : "Inf"); return; }
+
+	for (p = 1 ; p < 17 ; p++) {
+		snprintf(digits, sizeof(digits), "%.*e", p - 1, d);
+		if (strtod(digits, NULL) == d) { break; }
+	}
+	snprintf(digits, sizeof(digits), "%.*e", p - 1, d);
+
+	/* split -d.ddde+XX into it's sign, digits, and exponent */
+	if (digits[0] == '-') { *buf++ = '-'; }
+	mantissa = digits[0] == '-' ? digits + 1 : digits;
+	e = strchr(mantissa, 'e');
+	exp = atoi(e + 1);
+	*e = '\0';
+	if (mantissa[1] == '.') { memmove(mantissa + 1, mantissa + 2, strlen(mantissa + 2) + 1); }
+	ndigits = strlen(mantissa);
+
+	if (exp < -4 || exp >= 17) {
+		*buf++ = mantissa[0];
+		if (ndigits > 1) { buf += sprintf(buf, ".%s", mantissa + 1); }
+		sprintf(buf, "e%c%d", exp < 0 ? '-' : '+', abs(exp));
+		return;
+	}
+
+	if (exp < 0) {
+		*buf++ = '0';
+		*buf++ = '.';
+		for (int i = -1 ; i > exp ; i--) { *buf++ = '0'; }
+		strcpy(buf, mantissa);
+		return;
+	}
+
+	/* digits before the point, padded with zeros if there are too few */
+	for (int i = 0 ; i <= exp ; i++) {
+		*buf++ = i < ndigits ? mantissa[i] : '0';
+	}
+	sprintf(buf, ".%s", ndigits > exp + 1 ? mantissa + exp + 1 : "0");
+}
+
+/* the string representation of an array, as a TCL list */
+static char* nocviz_val_print_array(nocviz_val* val) {
+	char num[NOCVIZ_VAL_NUM_SPACE];
+	size_t len = 0;
+	size_t n;
+	char* buf;
+
+	/* every element fits in NOCVIZ_VAL_NUM_SPACE characters */
+	buf = noctools_malloc(val->len * NOCVIZ_VAL_NUM_SPACE + 1);
+	buf[0] = '\0';
+
+	for (size_t i = 0 ; i < val->len ; i++) {
+		if (val->type == NOCVIZ_VAL_INTS) {
+			nocviz_val_print_int(val->as.ints[i], num);
+		} else {
+			nocviz_val_print_double(val->as.doubles[i], num);
+		}
+
+		n = strlen(num);
+		if (i > 0) { buf[len++] = ' '; }
+		memcpy(buf + len, num, n + 1);
+		len += n;
+	}
+
+	return buf;
+}
+
+/**
+ * @brief Retrieve the string representation of a value, generating it if
+ * the value has changed since it was last asked for.
+ *
+ * @param val
+ *
+ * @return a string which belongs to the value, and is valid until the value
+ * next changes
+ */
+char* nocviz_val_str(nocviz_val* val) {
+	if (val->str != NULL) { return val->str; }
+
+	switch (val->type) {
+	case NOCVIZ_VAL_INT:
+		nocviz_val_print_int(val->as.i, val->num);
+		val->str = val->num;
+		break;
+
+	case NOCVIZ_VAL_DOUBLE:
+		nocviz_val_print_double(val->as.d, val->num);
+		val->str = val->num;
+		break;
+
+	case NOCVIZ_VAL_INTS:
+	case NOCVIZ_VAL_DOUBLES:
+		val->str = nocviz_val_print_array(val);
+		break;
+
+	default:
+		/* strings always have a representation */
+		break;
+	}
+
+	return val->str;
+}
+
+/* true if str was parsed up to end, ignoring trailing whitespace */
+static bool nocviz_val_parsed_all(const char* str, const char* end) {
+	if (end == str) { return false; }
+	while (isspace((unsigned char) *end)) { end++; }
+	return *end == '\0';
+}
+
+bool nocviz_val_int(nocviz_val* val, int64_t* i) {
+	long long parsed;
+	char* end;
+
+	switch (val->type) {
+	case NOCVIZ_VAL_INT:
+		*i = val->as.i;
+		return true;
+
+	case NOCVIZ_VAL_STRING:
+		errno = 0;
+		parsed = strtoll(val->str, &end, 10);
+		if (errno != 0 || !nocviz_val_parsed_all(val->str, end)) { return false; }
+		*i = parsed;
+		return true;
+
+	default:
+		return false;
+	}
+}
+
+bool nocviz_val_double(nocviz_val* val, double* d) {
+	double parsed;
+	char* end;
+
+	switch (val->type) {
+	case NOCVIZ_VAL_INT:
+		*d = (double) val->as.i;
+		return true;
+
+	case NOCVIZ_VAL_DOUBLE:
+		*d = val->as.d;
+		return true;
+
+	case NOCVIZ_VAL_STRING:
+		parsed = strtod(val->str, &end);
+		if (!nocviz_val_parsed_all(val->str, end)) { return false; }
+		*d = parsed;
+		return true;
+
+	default:
+		return false;
+	}
+}
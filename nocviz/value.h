@@ -0,0 +1,74 @@
+#ifndef NOCVIZ_VALUE_H
+#define NOCVIZ_VALUE_H
+
+#include "../common/util.h"
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/******************************************************************************
+ *
+ * Values stored in a datastore's key-value pair store. A value is either a
+ * string, a 64 bit integer, a double, or a fixed-size array of integers or
+ * doubles.
+ *
+ * Numeric values are stored as numbers, so that they can be updated in place
+ * without allocating anything, and read back without parsing a string. Their
+ * string representation, the same as TCL would show, is only generated when it is
+ * asked for, and is kept until the value next changes.
+ *
+ * Setting a value of a different type than it already has converts it. An
+ * array which is set to an array of the same type and length is updated in
+ * place.
+ *
+ *****************************************************************************/
+
+/* enough for the string representation of any integer or double */
+#define NOCVIZ_VAL_NUM_SPACE 32
+
+typedef enum nocviz_val_type_t {
+	NOCVIZ_VAL_STRING,
+	NOCVIZ_VAL_INT,
+	NOCVIZ_VAL_DOUBLE,
+	NOCVIZ_VAL_INTS,
+	NOCVIZ_VAL_DOUBLES,
+} nocviz_val_type;
+
+typedef struct nocviz_val_t {
+	nocviz_val_type type;
+	union {
+		int64_t i;
+		double d;
+		int64_t* ints;
+		double* doubles;
+	} as;
+	size_t len;	/* number of elements, for arrays */
+	char* str;	/* string representation, NULL if it must be generated */
+	char num[NOCVIZ_VAL_NUM_SPACE];	/* storage for str, for numbers */
+} nocviz_val;
+
+/* create a string value, which takes ownership of str */
+nocviz_val* nocviz_val_new_string(char* str);
+
+/* create an empty integer value, to be set with one of the setters below */
+nocviz_val* nocviz_val_new(void);
+
+void nocviz_val_free(nocviz_val* val);
+
+/* setters, which update the value in place */
+void nocviz_val_set_string(nocviz_val* val, char* str);
+void nocviz_val_set_int(nocviz_val* val, int64_t i);
+void nocviz_val_set_double(nocviz_val* val, double d);
+void nocviz_val_set_ints(nocviz_val* val, const int64_t* ints, size_t len);
+void nocviz_val_set_doubles(nocviz_val* val, const double* doubles, size_t len);
+
+/* the string representation of the value, which belongs to the value */
+char* nocviz_val_str(nocviz_val* val);
+
+/* Retrieve the value as a number. Strings are parsed, and doubles are not
+ * integers. Returns false if the value is not a number of the right kind. */
+bool nocviz_val_int(nocviz_val* val, int64_t* i);
+bool nocviz_val_double(nocviz_val* val, double* d);
+
+#endif